@@ -0,0 +1,145 @@
+#!/bin/sh
+#
+#  gcml2 -- an implementation of Eric Raymond's CML2 in C
+#  Copyright (C) 2000-2001 Greg Banks
+#
+#  This library is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU Library General Public
+#  License as published by the Free Software Foundation; either
+#  version 2 of the License, or (at your option) any later version.
+#
+#  This library is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+#  Library General Public License for more details.
+#
+#  You should have received a copy of the GNU Library General Public
+#  License along with this library; if not, write to the Free
+#  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+#
+#
+# Runs cml-bench over the benchmark corpus and compares the median
+# latency of each scenario against perf-baseline.tsv.  Fails if any
+# scenario is slower than its baseline times the tolerance on that
+# baseline line, and also more than $FLOOR_USEC slower, so that
+# sub-microsecond noise doesn't count.  With --update, writes the
+# results as the new baseline instead, keeping existing tolerances.
+#
+# The baseline is only meaningful on the machine it was made on, so
+# it isn't distributed: the first run writes one from its own results
+# and later runs compare against that.
+#
+
+BENCH=./cml-bench
+BASELINE=perf-baseline.tsv
+RESULTS=perf-results.tsv
+TOLERANCE=2.0
+SAVE_TOLERANCE=4.0  # saving is dominated by the filesystem
+FLOOR_USEC=${FLOOR_USEC:-20}
+SCENARIOS="parse parse_post load_defconfig random_walk check_all_rules save_defconfig"
+DO_UPDATE=
+
+usage ()
+{
+    echo "Usage: $0 [--update]"
+    exit ${1:-1}
+}
+
+fatal ()
+{
+    echo "$0: $*"
+    exit 1
+}
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+    --help) usage 0 ;;
+    --update) DO_UPDATE=yes ;;
+    *) usage 1 ;;
+    esac
+    shift
+done
+
+# run_corpus name iterations cml-bench-args...
+run_corpus ()
+{
+    name=$1
+    iterations=$2
+    shift 2
+    flags=
+    for sc in $SCENARIOS ; do
+    	flags="$flags --scenario $sc"
+    done
+    $BENCH --format=tsv --seed 1 --iterations $iterations $flags "$@" \
+    	> $RESULTS.tmp || fatal "cml-bench failed on $name"
+    sed -e "s|^|$name	|" < $RESULTS.tmp >> $RESULTS
+    rm -f $RESULTS.tmp
+}
+
+: > $RESULTS
+run_corpus small 50 corpus/small.cml
+run_corpus cml1 50 --arch i386 corpus/cml1/config.in
+run_corpus large 5 --defconfig corpus/large.config corpus/large.cml
+
+if [ -z "$DO_UPDATE" -a ! -r $BASELINE ]; then
+    echo "$0: no $BASELINE yet, making one from this run"
+    DO_UPDATE=yes
+fi
+
+if [ -n "$DO_UPDATE" ]; then
+    old=$BASELINE
+    [ -r $old ] || old=/dev/null
+    # columns are corpus, scenario, p50 usec, tolerance
+    awk -F'\t' -v OFS='\t' -v deftol=$TOLERANCE -v savetol=$SAVE_TOLERANCE '
+    	FILENAME == ARGV[1] { if ($1 !~ /^#/) tol[$1 "\t" $2] = $4; next }
+	FNR == 1 { print "# corpus", "scenario", "p50_usec", "tolerance" }
+	{
+	    key = $1 "\t" $2
+	    if (!(key in tol))
+	    	tol[key] = ($2 == "save_defconfig" ? savetol : deftol)
+	    print $1, $2, $6, tol[key]
+	}
+    ' $old $RESULTS > $BASELINE.new || fatal "failed to write $BASELINE"
+    mv $BASELINE.new $BASELINE
+    echo "$0: wrote $BASELINE"
+    exit 0
+fi
+
+awk -F'\t' -v floor=$FLOOR_USEC '
+    BEGIN {
+	printf "%-8s %-16s %12s %12s\n", "corpus", "scenario", "base_usec", "p50_usec"
+    }
+    FILENAME == ARGV[1] {
+    	if ($1 !~ /^#/)
+	{
+	    base[$1 "\t" $2] = $3
+	    tol[$1 "\t" $2] = $4
+	}
+	next
+    }
+    {
+    	key = $1 "\t" $2
+	if (!(key in base))
+	{
+	    printf "%-8s %-16s %12s %12.1f  new\n", $1, $2, "-", $6
+	    next
+	}
+	limit = base[key] * tol[key]
+	if (limit < base[key] + floor)
+	    limit = base[key] + floor
+	status = "ok"
+	if ($6 > limit)
+	{
+	    status = "REGRESSED"
+	    nfail++
+	}
+	printf "%-8s %-16s %12.1f %12.1f  %s\n", $1, $2, base[key], $6, status
+    }
+    END {
+	if (nfail > 0)
+	{
+	    printf "%d scenario(s) regressed\n", nfail
+	    exit 1
+	}
+    }
+' $BASELINE $RESULTS
@@ -0,0 +1,698 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Generates a synthetic CML2 rulebase of a given shape, and
+ * optionally a .config for it, for measuring how libcml scales
+ * beyond the size of any real tree.  The output depends only on
+ * the arguments, so a rulebase can be regenerated rather than
+ * checked in.
+ *
+ * The rulebase has these parts:
+ *
+ * symbols  S0..Sn, mostly boolean with some tristate, decimal,
+ *	    hexadecimal and string symbols.
+ * menus    M0..Mn in a tree `fanout' wide under the main menu,
+ *	    sharing the symbols out in order.  Within each menu the
+ *	    symbols form subtrees `depth' deep and `fanout' wide,
+ *	    so each guard symbol has dependants.
+ * choices  C0..Cn, each a menu of `choice-size' booleans.
+ * derived  D0..Dn, each the `and' or `or' of two booleans.
+ * rules    `require Sa implies (Sb or Sc)' on booleans and
+ *	    `require Sa <= Sb' on tristates, where Sb and Sc
+ *	    come before Sa.
+ * visibility `unless Sg suppress Sx' or `unless Dk suppress Sx',
+ *	    where the guard comes before Sx and each Sx is different.
+ *
+ * The .config is a random assignment which has been cut back
+ * until it obeys the subtree dependencies and the rules.  Like a
+ * .config gcml2 saves, it leaves out symbols which aren't visible,
+ * and they are planned at their defaults since that's what loading
+ * the file will leave them at.
+ */
+
+#include "common.h"
+#include <stdlib.h>
+
+CVSID("$Id$");
+
+static char *argv0;
+static const char *output_filename = 0;
+static const char *config_filename = 0;
+static int nsymbols = 1000;
+static int nmenus = 10;
+static int nchoices = 10;
+static int choice_size = 3;
+static int nderived = 50;
+static int nrules = 500;
+static int nvisibility = 100;
+static int depth = 2;
+static int fanout = 4;
+static unsigned long seed = 1;
+
+#define N   0
+#define M   1
+#define Y   2
+
+typedef struct
+{
+    char suffix;    	    /* type as a menu suffix: ' ' '?' '%' '@' '$' */
+    int guard;	    	    /* index of subtree guard, or -1 */
+    int size;	    	    /* of subtree including this symbol */
+    long value;     	    /* N/M/Y for booleans and tristates */
+    int visibility; 	    /* index into visibility, or -1 */
+    gboolean visible;
+} gen_symbol;
+
+typedef struct
+{
+    int a, b, c;    	    /* c < 0 for a tristate `<=' rule */
+} gen_rule;
+
+typedef struct
+{
+    int a, b;
+    gboolean is_or;
+} gen_derived;
+
+typedef struct
+{
+    int x;  	    	    /* symbol suppressed */
+    int guard;	    	    /* symbol or derived index */
+    gboolean is_derived;
+} gen_visibility;
+
+static gen_symbol *symbols;
+static gen_rule *rules;
+static gen_derived *derived;
+static gen_visibility *visibility;
+static int nvisibility_planned;
+static int *booleans;	    	/* indices of boolean symbols */
+static int nbooleans;
+static int *tristates;	    	/* indices of tristate symbols */
+static int ntristates;
+static int *choice_values;  	/* which alternative of each choice is set */
+static int next_symbol;
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+/*
+ * The same xorshift generator as cml-bench.
+ */
+static unsigned long random_state;
+
+static void
+gen_srandom(unsigned long s)
+{
+    random_state = (s == 0 ? 1 : s);
+}
+
+static int
+gen_random(int minv, int maxv)
+{
+    unsigned long x = random_state & 0xffffffffUL;
+
+    x ^= (x << 13) & 0xffffffffUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xffffffffUL;
+    random_state = x;
+    return minv + (int)(x % (unsigned long)(maxv - minv + 1));
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static char
+random_leaf_suffix(void)
+{
+    int r = gen_random(0, 99);
+
+    if (r < 60)
+    	return ' ';
+    if (r < 85)
+    	return '?';
+    if (r < 92)
+    	return '%';
+    if (r < 96)
+    	return '@';
+    return '$';
+}
+
+/*
+ * Lay out one subtree in symbol order, starting at the next
+ * unused symbol and stopping short of `end'.
+ */
+static void
+plan_subtree(int guard, int level, int end)
+{
+    int i = next_symbol++;
+    int f;
+
+    symbols[i].guard = guard;
+    if (level < depth && next_symbol < end)
+    {
+    	symbols[i].suffix = (gen_random(0, 3) == 0 ? '?' : ' ');
+	for (f = 0 ; f < fanout && next_symbol < end ; f++)
+	    plan_subtree(i, level+1, end);
+    }
+    else
+    	symbols[i].suffix = random_leaf_suffix();
+    symbols[i].size = next_symbol - i;
+}
+
+static int
+menu_start(int m)
+{
+    return (int)((double)nsymbols * m / nmenus);
+}
+
+static void
+plan(void)
+{
+    int i, m;
+
+    symbols = g_new0(gen_symbol, nsymbols);
+    next_symbol = 0;
+    for (m = 0 ; m < nmenus ; m++)
+    {
+	while (next_symbol < menu_start(m+1))
+	    plan_subtree(-1, 0, menu_start(m+1));
+    }
+
+    booleans = g_new(int, nsymbols);
+    tristates = g_new(int, nsymbols);
+    for (i = 0 ; i < nsymbols ; i++)
+    {
+    	if (symbols[i].suffix == ' ')
+	    booleans[nbooleans++] = i;
+    	else if (symbols[i].suffix == '?')
+	    tristates[ntristates++] = i;
+    }
+
+    derived = g_new(gen_derived, nderived);
+    for (i = 0 ; i < nderived ; i++)
+    {
+    	if (nbooleans < 2)
+	{
+	    nderived = i;
+	    break;
+	}
+    	derived[i].a = booleans[gen_random(0, nbooleans-1)];
+	do
+	    derived[i].b = booleans[gen_random(0, nbooleans-1)];
+	while (derived[i].b == derived[i].a);
+	derived[i].is_or = gen_random(0, 1);
+    }
+
+    rules = g_new(gen_rule, nrules);
+    for (i = 0 ; i < nrules ; i++)
+    {
+    	gen_rule *r = &rules[i];
+
+    	if (ntristates >= 2 && (nbooleans < 3 || gen_random(0, 3) == 0))
+	{
+	    int j = gen_random(1, ntristates-1);
+
+	    r->a = tristates[j];
+	    r->b = tristates[gen_random(0, j-1)];
+	    r->c = -1;
+	}
+	else if (nbooleans >= 3)
+	{
+	    int j = gen_random(2, nbooleans-1);
+
+	    r->a = booleans[j];
+	    r->b = booleans[gen_random(0, j-1)];
+	    do
+		r->c = booleans[gen_random(0, j-1)];
+	    while (r->c == r->b);
+	}
+	else
+	{
+	    nrules = i;
+	    break;
+	}
+    }
+}
+
+/*
+ * Each visibility rule suppresses a different symbol, spread evenly
+ * so that no symbol gathers a huge `or', and is guarded by a boolean
+ * or derived symbol which comes before it.
+ */
+static void
+plan_visibility(void)
+{
+    int i, j;
+
+    visibility = g_new(gen_visibility, nvisibility);
+    for (i = 0 ; i < nsymbols ; i++)
+    	symbols[i].visibility = -1;
+    for (i = 0 ; i < nvisibility && nbooleans > 0 ; i++)
+    {
+    	int x = 1 + (int)((double)(nsymbols-1) * i / nvisibility);
+	gen_visibility *v = &visibility[nvisibility_planned];
+
+	if (nderived > 0 && gen_random(0, 1))
+	{
+	    int k = gen_random(0, nderived-1);
+
+	    if (derived[k].a < x && derived[k].b < x)
+	    {
+	    	v->x = x;
+		v->guard = k;
+		v->is_derived = TRUE;
+		symbols[x].visibility = nvisibility_planned++;
+		continue;
+	    }
+	}
+	j = gen_random(0, nbooleans-1);
+	if (booleans[j] < x)
+	{
+	    v->x = x;
+	    v->guard = booleans[j];
+	    v->is_derived = FALSE;
+	    symbols[x].visibility = nvisibility_planned++;
+	}
+    }
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+/*
+ * Whether symbol `i' is visible with the current values, given
+ * that the symbols before it have been worked out already.  As
+ * in libcml a subtree's symbols are hidden with its guard.
+ */
+static gboolean
+symbol_visible(int i)
+{
+    const gen_symbol *s = &symbols[i];
+    const gen_visibility *v;
+    gboolean b;
+
+    if (s->guard >= 0 && !symbols[s->guard].visible)
+    	return FALSE;
+    if (s->visibility < 0)
+    	return TRUE;
+    v = &visibility[s->visibility];
+    if (!v->is_derived)
+    	return (symbols[v->guard].value == Y);
+    b = (symbols[derived[v->guard].a].value == Y);
+    if (derived[v->guard].is_or)
+    	return (b || symbols[derived[v->guard].b].value == Y);
+    return (b && symbols[derived[v->guard].b].value == Y);
+}
+
+/*
+ * Choose a random configuration, then repeatedly turn things
+ * down until nothing breaks a dependency, a rule or visibility.
+ * Values only ever decrease, and so visibility can only be lost,
+ * so this terminates.
+ */
+static void
+plan_config(void)
+{
+    int i;
+    gboolean changed;
+
+    for (i = 0 ; i < nsymbols ; i++)
+    {
+    	gen_symbol *s = &symbols[i];
+
+	switch (s->suffix)
+	{
+	case ' ': s->value = (gen_random(0, 1) ? Y : N); break;
+	case '?': s->value = gen_random(N, Y); break;
+	case '%': s->value = gen_random(0, 9999); break;
+	case '@': s->value = gen_random(0, 0xffff); break;
+	case '$': s->value = i; break;
+	}
+    }
+
+    choice_values = g_new(int, nchoices);
+    for (i = 0 ; i < nchoices ; i++)
+    	choice_values[i] = gen_random(0, choice_size-1);
+
+    plan_visibility();
+
+    do
+    {
+    	changed = FALSE;
+
+	for (i = 0 ; i < nsymbols ; i++)
+	{
+    	    gen_symbol *s = &symbols[i];
+	    long gv;
+
+	    if (s->suffix != ' ' && s->suffix != '?')
+	    {
+	    	s->visible = symbol_visible(i);
+		if (!s->visible && s->suffix != '$')
+		    s->value = i;   /* the default */
+	    	continue;
+	    }
+	    if (!(s->visible = symbol_visible(i)) && s->value != N)
+	    {
+	    	s->value = N;
+		changed = TRUE;
+	    }
+	    if (s->guard < 0)
+	    	continue;
+	    gv = symbols[s->guard].value;
+	    if (s->value > gv)
+	    {
+	    	s->value = (s->suffix == ' ' && gv == M ? N : gv);
+		changed = TRUE;
+	    }
+	}
+
+	for (i = 0 ; i < nrules ; i++)
+	{
+    	    gen_rule *r = &rules[i];
+
+	    if (r->c < 0)
+	    {
+	    	if (symbols[r->a].value > symbols[r->b].value)
+		{
+		    symbols[r->a].value = symbols[r->b].value;
+		    changed = TRUE;
+		}
+	    }
+	    else if (symbols[r->a].value == Y &&
+	    	     symbols[r->b].value != Y &&
+		     symbols[r->c].value != Y)
+	    {
+	    	symbols[r->a].value = N;
+		changed = TRUE;
+	    }
+	}
+    } while (changed);
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static void
+emit_subtree(FILE *fp, int i)
+{
+    int j;
+
+    fprintf(fp, " S%d", i);
+    if (symbols[i].suffix != ' ')
+    	fputc(symbols[i].suffix, fp);
+    if (symbols[i].size > 1)
+    {
+    	fprintf(fp, " {");
+	for (j = i+1 ; j < i + symbols[i].size ; j += symbols[j].size)
+	    emit_subtree(fp, j);
+    	fprintf(fp, " }");
+    }
+}
+
+static void
+emit_menu(FILE *fp, int m)
+{
+    int k, i;
+
+    fprintf(fp, "menu M%d", m);
+    for (k = (m+1) * fanout ; k < (m+2) * fanout && k < nmenus ; k++)
+    	fprintf(fp, " M%d", k);
+    for (k = m ; k < nchoices ; k += nmenus)
+    	fprintf(fp, " C%d", k);
+    for (i = menu_start(m) ; i < menu_start(m+1) ; i += symbols[i].size)
+    {
+    	fprintf(fp, "\n   ");
+	emit_subtree(fp, i);
+    }
+    fputc('\n', fp);
+}
+
+static void
+emit_rulebase(FILE *fp)
+{
+    int i, j;
+
+    fprintf(fp, "# generated by cml-gen --symbols %d --menus %d --choices %d"
+    	    	" --choice-size %d --derived %d --rules %d --visibility %d"
+		" --depth %d --fanout %d --seed %lu\n",
+	    nsymbols, nmenus, nchoices, choice_size, nderived, nrules,
+	    nvisibility, depth, fanout, seed);
+
+    fprintf(fp, "symbols\n");
+    for (i = 0 ; i < nsymbols ; i++)
+    	fprintf(fp, "S%d \"Symbol %d\"\n", i, i);
+    for (i = 0 ; i < nchoices ; i++)
+	for (j = 0 ; j < choice_size ; j++)
+    	    fprintf(fp, "C%d_%d \"Choice %d alternative %d\"\n", i, j, i, j);
+
+    fprintf(fp, "menus\nmain \"Main menu\"\n");
+    for (i = 0 ; i < nmenus ; i++)
+    	fprintf(fp, "M%d \"Menu %d\"\n", i, i);
+    for (i = 0 ; i < nchoices ; i++)
+    	fprintf(fp, "C%d \"Choice %d\"\n", i, i);
+
+    fprintf(fp, "start main\nprefix \"CONFIG_\"\n");
+
+    fprintf(fp, "menu main");
+    for (i = 0 ; i < fanout && i < nmenus ; i++)
+    	fprintf(fp, " M%d", i);
+    fputc('\n', fp);
+    for (i = 0 ; i < nmenus ; i++)
+    	emit_menu(fp, i);
+
+    for (i = 0 ; i < nchoices ; i++)
+    {
+    	fprintf(fp, "choices C%d", i);
+	for (j = 0 ; j < choice_size ; j++)
+    	    fprintf(fp, " C%d_%d", i, j);
+    	fprintf(fp, " default C%d_0\n", i);
+    }
+
+    for (i = 0 ; i < nsymbols ; i++)
+    {
+    	if (symbols[i].suffix == '%' || symbols[i].suffix == '@')
+	    fprintf(fp, "default S%d from %d\n", i, i);
+    }
+
+    for (i = 0 ; i < nderived ; i++)
+    	fprintf(fp, "derive D%d from S%d %s S%d\n",
+	    	i, derived[i].a, (derived[i].is_or ? "or" : "and"), derived[i].b);
+
+    for (i = 0 ; i < nrules ; i++)
+    {
+    	if (rules[i].c < 0)
+	    fprintf(fp, "require S%d <= S%d\n", rules[i].a, rules[i].b);
+	else
+	    fprintf(fp, "require S%d implies (S%d or S%d)\n",
+	    	    rules[i].a, rules[i].b, rules[i].c);
+    }
+
+    for (i = 0 ; i < nvisibility_planned ; i++)
+    	fprintf(fp, "unless %c%d suppress S%d\n",
+	    	(visibility[i].is_derived ? 'D' : 'S'), visibility[i].guard,
+		visibility[i].x);
+}
+
+static void
+emit_config(FILE *fp)
+{
+    int i;
+
+    for (i = 0 ; i < nsymbols ; i++)
+    {
+    	gen_symbol *s = &symbols[i];
+
+	if (!s->visible)
+	    continue;
+	switch (s->suffix)
+	{
+	case ' ':
+	case '?':
+	    if (s->value == N)
+	    	fprintf(fp, "# CONFIG_S%d is not set\n", i);
+	    else
+	    	fprintf(fp, "CONFIG_S%d=%c\n", i, (s->value == Y ? 'y' : 'm'));
+	    break;
+	case '%':
+	    fprintf(fp, "CONFIG_S%d=%ld\n", i, s->value);
+	    break;
+	case '@':
+	    fprintf(fp, "CONFIG_S%d=0x%lX\n", i, s->value);
+	    break;
+	case '$':
+	    fprintf(fp, "CONFIG_S%d=\"string %ld\"\n", i, s->value);
+	    break;
+	}
+    }
+    /*
+     * Only the chosen alternative, as explicitly setting
+     * a radio button to n is an error when loading.
+     */
+    for (i = 0 ; i < nchoices ; i++)
+	fprintf(fp, "CONFIG_C%d_%d=y\n", i, choice_values[i]);
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static const char usage_str[] =
+"Usage: %s [options]\n"
+"options are:\n"
+"--symbols N             number of ordinary symbols (default 1000)\n"
+"--menus N               number of menus (default 10)\n"
+"--choices N             number of choice menus (default 10)\n"
+"--choice-size N         alternatives per choice (default 3)\n"
+"--derived N             number of derived symbols (default 50)\n"
+"--rules N               number of require rules (default 500)\n"
+"--visibility N          number of visibility rules (default 100)\n"
+"--depth N               depth of symbol subtrees (default 2)\n"
+"--fanout N              width of subtrees and of the menu tree (default 4)\n"
+"--seed N                seed for the random choices (default 1)\n"
+"--output FILE           write the rulebase to FILE instead of stdout\n"
+"--config FILE           also write a matching .config to FILE\n"
+"--version               print version and exit\n"
+"--help                  print this message and exit\n"
+;
+
+static void
+usagef(int ec, const char *fmt, ...)
+{
+    if (fmt != 0)
+    {
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "%s: ", argv0);
+	vfprintf(stderr, fmt, args);
+	fputc('\n', stderr);
+	va_end(args);
+    }
+
+    fprintf(stderr, usage_str, argv0);
+
+    fflush(stderr); /* JIC */
+
+    exit(ec);
+}
+
+static int
+parse_count(int argc, char **argv, int *ip, int minv)
+{
+    const char *opt = argv[*ip];
+    int n;
+
+    if (++(*ip) == argc || (n = atoi(argv[*ip])) < minv)
+	usagef(1, "Expecting a number of at least %d for %s\n", minv, opt);
+    return n;
+}
+
+static void
+parse_args(int argc, char **argv)
+{
+    int i;
+
+    argv0 = argv[0];
+
+    for (i = 1 ; i < argc ; i++)
+    {
+	if (!strcmp(argv[i], "--help"))
+	    usagef(0, 0);
+	else if (!strcmp(argv[i], "--version"))
+	{
+	    printf("cml-gen %s\n", VERSION);
+	    exit(0);
+	}
+	else if (!strcmp(argv[i], "--symbols"))
+	    nsymbols = parse_count(argc, argv, &i, 1);
+	else if (!strcmp(argv[i], "--menus"))
+	    nmenus = parse_count(argc, argv, &i, 1);
+	else if (!strcmp(argv[i], "--choices"))
+	    nchoices = parse_count(argc, argv, &i, 0);
+	else if (!strcmp(argv[i], "--choice-size"))
+	    choice_size = parse_count(argc, argv, &i, 2);
+	else if (!strcmp(argv[i], "--derived"))
+	    nderived = parse_count(argc, argv, &i, 0);
+	else if (!strcmp(argv[i], "--rules"))
+	    nrules = parse_count(argc, argv, &i, 0);
+	else if (!strcmp(argv[i], "--visibility"))
+	    nvisibility = parse_count(argc, argv, &i, 0);
+	else if (!strcmp(argv[i], "--depth"))
+	    depth = parse_count(argc, argv, &i, 0);
+	else if (!strcmp(argv[i], "--fanout"))
+	    fanout = parse_count(argc, argv, &i, 1);
+	else if (!strcmp(argv[i], "--seed"))
+	{
+	    if (++i == argc)
+    		usagef(1, "Expecting argument for --seed\n");
+	    seed = strtoul(argv[i], 0, 0);
+	}
+	else if (!strcmp(argv[i], "--output"))
+	{
+	    if ((output_filename = argv[++i]) == 0)
+    		usagef(1, "Expecting argument for --output\n");
+	}
+	else if (!strcmp(argv[i], "--config"))
+	{
+	    if ((config_filename = argv[++i]) == 0)
+    		usagef(1, "Expecting argument for --config\n");
+	}
+	else
+	    usagef(1, "Unknown option \"%s\"", argv[i]);
+    }
+    if (nmenus > nsymbols)
+    	nmenus = nsymbols;
+    if (nvisibility > nsymbols-1)
+    	nvisibility = nsymbols-1;
+}
+
+int
+main(int argc, char **argv)
+{
+    FILE *fp;
+
+    parse_args(argc, argv);
+
+    gen_srandom(seed);
+    plan();
+    plan_config();
+
+    if (output_filename == 0)
+    	fp = stdout;
+    else if ((fp = fopen(output_filename, "w")) == 0)
+    {
+    	perror(output_filename);
+	return 1;
+    }
+    emit_rulebase(fp);
+    if (fp != stdout)
+    	fclose(fp);
+
+    if (config_filename != 0)
+    {
+	if ((fp = fopen(config_filename, "w")) == 0)
+	{
+    	    perror(config_filename);
+	    return 1;
+	}
+	emit_config(fp);
+	fclose(fp);
+    }
+    return 0;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*END*/
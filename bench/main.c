@@ -0,0 +1,634 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Runs a set of named scenarios against a rulebase, timing each
+ * operation, and reports throughput and latency percentiles as
+ * JSON.  All random choices come from a generator seeded with
+ * --seed, so two runs with the same arguments do the same work.
+ */
+
+#include "common.h"
+#include "libcml.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+CVSID("$Id$");
+
+static char *argv0;
+static char *arch = "i386";
+static char **files;
+static int nfiles;
+static char *defconfig_filename = 0;
+static int niterations = 10;
+static unsigned long seed = 1;
+static GList *scenario_names = 0;   /* list of char*, 0 means all */
+static const char *format = "json";
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+/*
+ * A small xorshift generator, so the sequence doesn't
+ * depend on the C library's random().
+ */
+static unsigned long random_state;
+
+static void
+bench_srandom(unsigned long s)
+{
+    random_state = (s == 0 ? 1 : s);
+}
+
+static int
+bench_random(int minv, int maxv)
+{
+    unsigned long x = random_state & 0xffffffffUL;
+
+    x ^= (x << 13) & 0xffffffffUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xffffffffUL;
+    random_state = x;
+    return minv + (int)(x % (unsigned long)(maxv - minv + 1));
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+typedef struct
+{
+    double *samples;	    /* seconds per operation */
+    int nsamples;
+    int maxsamples;
+    double total;
+} bench_result;
+
+static void
+result_add(bench_result *res, double seconds)
+{
+    if (res->nsamples == res->maxsamples)
+    {
+    	res->maxsamples = (res->maxsamples == 0 ? 64 : res->maxsamples * 2);
+	res->samples = g_renew(double, res->samples, res->maxsamples);
+    }
+    res->samples[res->nsamples++] = seconds;
+    res->total += seconds;
+}
+
+static int
+compare_samples(const void *v1, const void *v2)
+{
+    double d1 = *(const double *)v1;
+    double d2 = *(const double *)v2;
+
+    return (d1 < d2 ? -1 : (d1 > d2 ? 1 : 0));
+}
+
+/* nearest-rank percentile of sorted samples */
+static double
+result_percentile(const bench_result *res, int pc)
+{
+    int i;
+
+    if (res->nsamples == 0)
+    	return 0.0;
+    i = (res->nsamples * pc + 99) / 100 - 1;
+    if (i < 0)
+    	i = 0;
+    return res->samples[i];
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static void
+quiet_error_func(
+    cml_severity sev,
+    const cml_location *loc,
+    const char *fmt,
+    va_list args)
+{
+}
+
+/*
+ * Parse the rulebase files, optionally deferring post-parse
+ * in the same way as merge mode.
+ */
+static cml_rulebase *
+load_rulebase(gboolean merge, gboolean post, gboolean progressive)
+{
+    cml_rulebase *rb;
+    int i;
+
+    rb = cml_rulebase_new();
+    if (merge)
+	cml_rulebase_set_merge_mode(rb);
+    cml_rulebase_set_progressive(rb, progressive);
+    cml_rulebase_set_arch(rb, arch);
+    for (i = 0 ; i < nfiles ; i++)
+    {
+	if (!cml_rulebase_parse(rb, files[i]))
+	{
+	    cml_rulebase_delete(rb);
+	    return 0;
+	}
+    }
+    if (merge && post && !cml_rulebase_post_parse(rb))
+    {
+	cml_rulebase_delete(rb);
+	return 0;
+    }
+    return rb;
+}
+
+static char *
+tmp_filename(const char *suffix)
+{
+    return g_strdup_printf("%s/cml-bench.%d.%s",
+    	    	    	   g_get_tmp_dir(), (int)getpid(), suffix);
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*
+ * The scenarios.  Each is passed a freshly parsed rulebase
+ * which it may change, and records one sample per operation.
+ */
+
+static void
+bench_parse(cml_rulebase *rb, bench_result *res)
+{
+    cml_rulebase *prb;
+    int i;
+    double start;
+
+    for (i = 0 ; i < niterations ; i++)
+    {
+    	start = cml_timer_now();
+	prb = load_rulebase(TRUE, FALSE, FALSE);
+	result_add(res, cml_timer_now() - start);
+	if (prb != 0)
+	    cml_rulebase_delete(prb);
+    }
+}
+
+static void
+bench_parse_post(cml_rulebase *rb, bench_result *res)
+{
+    cml_rulebase *prb;
+    int i;
+    double start;
+
+    for (i = 0 ; i < niterations ; i++)
+    {
+    	start = cml_timer_now();
+	prb = load_rulebase(TRUE, TRUE, FALSE);
+	result_add(res, cml_timer_now() - start);
+	if (prb != 0)
+	    cml_rulebase_delete(prb);
+    }
+}
+
+/*
+ * How long a progressive front end takes to show the top menu:
+ * parsing, the menu checks and the top menu's visible children,
+ * but not the rule checks.
+ */
+static void
+bench_first_screen(cml_rulebase *rb, bench_result *res)
+{
+    cml_rulebase *prb;
+    int i;
+    double start;
+
+    for (i = 0 ; i < niterations ; i++)
+    {
+    	start = cml_timer_now();
+	prb = load_rulebase(TRUE, TRUE, TRUE);
+	if (prb != 0)
+	    cml_node_get_visible_children(cml_rulebase_get_start(prb));
+	result_add(res, cml_timer_now() - start);
+	if (prb != 0)
+	    cml_rulebase_delete(prb);
+    }
+}
+
+static void
+bench_load_defconfig(cml_rulebase *rb, bench_result *res)
+{
+    int i;
+    double start;
+    char *filename = defconfig_filename;
+
+    if (filename == 0)
+    {
+    	filename = tmp_filename("config");
+	cml_rulebase_save_defconfig(rb, filename);
+    }
+
+    for (i = 0 ; i < niterations ; i++)
+    {
+    	start = cml_timer_now();
+	cml_rulebase_load_defconfig(rb, filename);
+	cml_rulebase_commit(rb, /*freeze*/FALSE);
+	result_add(res, cml_timer_now() - start);
+	cml_rulebase_clear(rb);
+    }
+
+    if (filename != defconfig_filename)
+    {
+    	char *oldfile = g_strconcat(filename, ".old", 0);
+    	unlink(filename);
+    	unlink(oldfile);
+	g_free(oldfile);
+	g_free(filename);
+    }
+}
+
+static void
+bench_save_defconfig(cml_rulebase *rb, bench_result *res)
+{
+    int i;
+    double start;
+    char *filename = tmp_filename("config");
+    char *oldfile = g_strconcat(filename, ".old", 0);
+
+    for (i = 0 ; i < niterations ; i++)
+    {
+    	start = cml_timer_now();
+	cml_rulebase_save_defconfig(rb, filename);
+	result_add(res, cml_timer_now() - start);
+    }
+
+    unlink(filename);
+    unlink(oldfile);
+    g_free(filename);
+    g_free(oldfile);
+}
+
+static void
+bench_check_all_rules(cml_rulebase *rb, bench_result *res)
+{
+    int i;
+    double start;
+
+    for (i = 0 ; i < niterations ; i++)
+    {
+    	start = cml_timer_now();
+	cml_rulebase_check_all_rules(rb);
+	result_add(res, cml_timer_now() - start);
+    }
+}
+
+/*
+ * Visit every visible symbol and give boolean and tristate
+ * symbols a random value, committing each change.
+ */
+static cml_visit_result
+random_set_visitor(cml_rulebase *rb, cml_node *mn, int depth, void *user_data)
+{
+    static const cml_tritval trits[3] = { CML_Y, CML_M, CML_N };
+    bench_result *res = (bench_result *)user_data;
+    const cml_atom *val;
+    cml_atom a;
+    double start;
+
+    if (!cml_node_is_visible(mn) || cml_node_is_radio(mn))
+    	return CML_SKIP;
+    if (cml_node_get_treetype(mn) != MN_SYMBOL ||
+	(val = cml_node_get_value(mn)) == 0)
+    	return CML_CONTINUE;
+
+    /* CML1 symbols start out with no value at all */
+    a = *val;
+    a.type = cml_node_get_value_type(mn);
+    switch (a.type)
+    {
+    case A_BOOLEAN:
+	a.value.tritval = trits[bench_random(0, 1) * 2];
+	break;
+    case A_TRISTATE:
+	a.value.tritval = trits[bench_random(0, 2)];
+	break;
+    default:
+	return CML_CONTINUE;
+    }
+    if (val->type == a.type && a.value.tritval == val->value.tritval)
+    	return CML_CONTINUE;
+
+    start = cml_timer_now();
+    cml_node_set_value(mn, &a);
+    cml_rulebase_commit(rb, /*freeze*/FALSE);
+    if (res != 0)
+	result_add(res, cml_timer_now() - start);
+
+    return CML_CONTINUE;
+}
+
+static void
+bench_random_walk(cml_rulebase *rb, bench_result *res)
+{
+    int i;
+
+    for (i = 0 ; i < niterations ; i++)
+	cml_rulebase_menu_apply(rb, random_set_visitor, res);
+}
+
+static void
+bench_undo_redo(cml_rulebase *rb, bench_result *res)
+{
+    int i, n;
+    double start;
+
+    /* build up some history to undo */
+    cml_rulebase_menu_apply(rb, random_set_visitor, 0);
+
+    for (i = 0 ; i < niterations ; i++)
+    {
+    	for (n = 0 ; cml_rulebase_can_undo(rb) ; n++)
+	{
+	    start = cml_timer_now();
+	    cml_rulebase_undo(rb);
+	    result_add(res, cml_timer_now() - start);
+	}
+	while (n-- > 0 && cml_rulebase_can_redo(rb))
+	{
+	    start = cml_timer_now();
+	    cml_rulebase_redo(rb);
+	    result_add(res, cml_timer_now() - start);
+	}
+    }
+}
+
+static cml_visit_result
+visibility_visitor(cml_rulebase *rb, cml_node *mn, int depth, void *user_data)
+{
+    int *nvisiblep = (int *)user_data;
+
+    if (cml_node_is_visible(mn))
+    	(*nvisiblep)++;
+    return CML_CONTINUE;
+}
+
+static void
+bench_visibility_sweep(cml_rulebase *rb, bench_result *res)
+{
+    int i, nvisible;
+    double start;
+
+    for (i = 0 ; i < niterations ; i++)
+    {
+    	nvisible = 0;
+    	start = cml_timer_now();
+	cml_rulebase_menu_apply(rb, visibility_visitor, &nvisible);
+	result_add(res, cml_timer_now() - start);
+    }
+}
+
+typedef struct
+{
+    const char *name;
+    void (*func)(cml_rulebase *, bench_result *);
+} bench_scenario;
+
+static const bench_scenario scenarios[] =
+{
+    {"parse",	    	    bench_parse},
+    {"parse_post",  	    bench_parse_post},
+    {"first_screen",  	    bench_first_screen},
+    {"load_defconfig",	    bench_load_defconfig},
+    {"save_defconfig",	    bench_save_defconfig},
+    {"check_all_rules",     bench_check_all_rules},
+    {"random_walk", 	    bench_random_walk},
+    {"undo_redo",   	    bench_undo_redo},
+    {"visibility_sweep",    bench_visibility_sweep},
+    {0, 0}
+};
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+/*
+ * Print one scenario's results, either as a JSON object or as
+ * a TSV line of name, ops, seconds, ops/sec and percentiles.
+ */
+static void
+print_result(FILE *fp, const char *name, bench_result *res)
+{
+    qsort(res->samples, res->nsamples, sizeof(double), compare_samples);
+
+    if (!strcmp(format, "tsv"))
+    {
+	fprintf(fp, "%s\t%d\t%.6f\t%.1f\t%.1f\t%.1f\t%.1f\n",
+	    	name, res->nsamples, res->total,
+    	    	(res->total > 0.0 ? res->nsamples / res->total : 0.0),
+		result_percentile(res, 50) * 1e6,
+		result_percentile(res, 95) * 1e6,
+		result_percentile(res, 99) * 1e6);
+	return;
+    }
+
+    fprintf(fp, "    {\"name\": \"%s\", \"ops\": %d, \"seconds\": %.6f, ",
+    	    name, res->nsamples, res->total);
+    fprintf(fp, "\"ops_per_sec\": %.1f, ",
+    	    (res->total > 0.0 ? res->nsamples / res->total : 0.0));
+    fprintf(fp, "\"p50_usec\": %.1f, \"p95_usec\": %.1f, \"p99_usec\": %.1f}",
+	    result_percentile(res, 50) * 1e6,
+	    result_percentile(res, 95) * 1e6,
+	    result_percentile(res, 99) * 1e6);
+}
+
+static gboolean
+scenario_selected(const char *name)
+{
+    GList *list;
+
+    if (scenario_names == 0)
+    	return TRUE;
+    for (list = scenario_names ; list != 0 ; list = list->next)
+    	if (!strcmp((char *)list->data, name))
+	    return TRUE;
+    return FALSE;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static const char usage_str[] =
+"Usage: %s [--arch arch] [--iterations n] [--seed n] [--defconfig file]\n"
+"    [--scenario name]... [--format=json|tsv] [--list] rulesfile [rulesfile...]\n"
+;
+
+static void
+usagef(int ec, const char *fmt, ...)
+{
+    if (fmt != 0)
+    {
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "%s: ", argv0);
+	vfprintf(stderr, fmt, args);
+	fputc('\n', stderr);
+	va_end(args);
+    }
+
+    fprintf(stderr, usage_str, argv0);
+
+    fflush(stderr); /* JIC */
+
+    exit(ec);
+}
+
+static void
+parse_args(int argc, char **argv)
+{
+    int i;
+    const bench_scenario *sc;
+
+    argv0 = argv[0];
+
+    files = (char **)g_malloc0(sizeof(char *) * argc);
+
+    for (i = 1 ; i < argc ; i++)
+    {
+    	if (argv[i][0] == '-')
+	{
+	    if (!strcmp(argv[i], "--help"))
+	    {
+	    	usagef(0, 0);
+	    }
+	    else if (!strcmp(argv[i], "--version"))
+	    {
+	    	printf("cml-bench %s\n", VERSION);
+    		exit(0);
+	    }
+	    else if (!strcmp(argv[i], "--list"))
+	    {
+	    	for (sc = scenarios ; sc->name != 0 ; sc++)
+		    printf("%s\n", sc->name);
+    		exit(0);
+	    }
+	    else if (!strcmp(argv[i], "--arch"))
+	    {
+		if ((arch = argv[++i]) == 0)
+    		    usagef(1, "Expecting argument for --arch\n");
+	    }
+	    else if (!strcmp(argv[i], "--iterations"))
+	    {
+		if (++i == argc || (niterations = atoi(argv[i])) <= 0)
+    		    usagef(1, "Expecting a positive number for --iterations\n");
+	    }
+	    else if (!strcmp(argv[i], "--seed"))
+	    {
+		if (++i == argc)
+    		    usagef(1, "Expecting argument for --seed\n");
+	    	seed = strtoul(argv[i], 0, 0);
+	    }
+	    else if (!strcmp(argv[i], "--defconfig"))
+	    {
+		if ((defconfig_filename = argv[++i]) == 0)
+    		    usagef(1, "Expecting argument for --defconfig\n");
+	    }
+	    else if (!strncmp(argv[i], "--format=", 9))
+	    {
+	    	format = argv[i]+9;
+		if (strcmp(format, "json") && strcmp(format, "tsv"))
+    		    usagef(1, "Expecting json or tsv for --format\n");
+	    }
+	    else if (!strcmp(argv[i], "--scenario"))
+	    {
+		if (++i == argc)
+    		    usagef(1, "Expecting argument for --scenario\n");
+		for (sc = scenarios ; sc->name != 0 ; sc++)
+		    if (!strcmp(sc->name, argv[i]))
+		    	break;
+		if (sc->name == 0)
+    		    usagef(1, "Unknown scenario \"%s\"", argv[i]);
+	    	scenario_names = g_list_append(scenario_names, argv[i]);
+	    }
+	    else
+	    	usagef(1, "Unknown option \"%s\"", argv[i]);
+	}
+	else
+	{
+	    files[nfiles++] = argv[i];
+	}
+    }
+    if (nfiles == 0)
+    	usagef(1, "expecting at least one rulebase filename\n");
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+int
+main(int argc, char **argv)
+{
+    cml_rulebase *rb;
+    const bench_scenario *sc;
+    bench_result res;
+    int i, n = 0;
+    gboolean json;
+
+    parse_args(argc, argv);
+
+    /* report any problems with the rulebase once, then keep quiet */
+    if ((rb = load_rulebase((nfiles > 1), TRUE, FALSE)) == 0)
+    {
+	fprintf(stderr, "%s: failed to load rulebase\n", argv0);
+	return 1;
+    }
+    cml_rulebase_delete(rb);
+    cml_set_error_func(quiet_error_func);
+
+    json = !strcmp(format, "json");
+    if (json)
+    {
+	printf("{\n  \"rulebase\": [");
+	for (i = 0 ; i < nfiles ; i++)
+	{
+    	    if (i > 0)
+		printf(", ");
+    	    cml_print_json_string(stdout, files[i]);
+	}
+	printf("],\n  \"arch\": ");
+	cml_print_json_string(stdout, arch);
+	printf(",\n  \"iterations\": %d,\n  \"seed\": %lu,\n  \"scenarios\": [\n",
+    		niterations, seed);
+    }
+
+    for (sc = scenarios ; sc->name != 0 ; sc++)
+    {
+    	if (!scenario_selected(sc->name))
+	    continue;
+
+	/* every scenario starts from the same state */
+	bench_srandom(seed);
+	rb = load_rulebase((nfiles > 1), TRUE, FALSE);
+	memset(&res, 0, sizeof(res));
+	(*sc->func)(rb, &res);
+	cml_rulebase_delete(rb);
+
+	if (json && n++ > 0)
+	    printf(",\n");
+	print_result(stdout, sc->name, &res);
+	g_free(res.samples);
+    }
+
+    if (json)
+	printf("\n  ]\n}\n");
+    return 0;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*END*/
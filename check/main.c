@@ -22,15 +22,30 @@
 #include "debug.h"
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 #if PROFILE
 #include <sys/time.h>
 #endif
+#if defined(__linux__) && !defined(HAVE_INOTIFY)
+#define HAVE_INOTIFY 1
+#endif
+#if HAVE_INOTIFY
+#include <sys/inotify.h>
+#include <sys/poll.h>
+#endif
 
 static char *argv0;
 static char *arch = "i386";
 static char **files;
 static int nfiles;
 static char *xref_filename = 0;
+static gboolean mem_stats_flag = FALSE;
+static gboolean stats_flag = FALSE;
+static const char *timings_format = 0;
+static char **defconfigs;
+static int ndefconfigs;
+static gboolean watch_flag = FALSE;
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
@@ -100,8 +115,49 @@ post_parse(void)
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
+static void
+print_mem_stats(cml_rulebase *rb)
+{
+    cml_mem_stats stats[CML_MEM_NUM_TAGS], total;
+    int tag;
+    
+    if (!cml_rulebase_get_memory_stats(rb, stats))
+    {
+    	fprintf(stderr, "%s: memory statistics not available, rebuild with MEMSTATS=1\n",
+	    	argv0);
+	return;
+    }
+    
+    memset(&total, 0, sizeof(total));
+    printf("%-14s %12s %12s %10s %10s\n",
+    	    "tag", "live-bytes", "peak-bytes", "allocs", "live");
+    for (tag = 0 ; tag < CML_MEM_NUM_TAGS ; tag++)
+    {
+    	printf("%-14s %12lu %12lu %10lu %10lu\n",
+	    cml_mem_tag_name(tag),
+	    stats[tag].live_bytes,
+	    stats[tag].peak_bytes,
+	    stats[tag].num_allocs,
+	    stats[tag].num_live);
+	total.live_bytes += stats[tag].live_bytes;
+	total.peak_bytes += stats[tag].peak_bytes;
+	total.num_allocs += stats[tag].num_allocs;
+	total.num_live += stats[tag].num_live;
+    }
+    /* the sum of the peaks is only an upper bound on the overall peak */
+    printf("%-14s %12lu %12lu %10lu %10lu\n",
+	"total",
+	total.live_bytes,
+	total.peak_bytes,
+	total.num_allocs,
+	total.num_live);
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
 static const char usage_str[] = 
-"Usage: %s [--arch arch] [--xref file] rulesfile [rulesfile...]\n"
+"Usage: %s [--arch arch] [--xref file] [--mem-stats] [--stats] [--timings[=json|tsv]]\n"
+"       [--defconfig file]... [--watch] rulesfile [rulesfile...]\n"
 ;
 
 static void
@@ -178,6 +234,7 @@ parse_args(int argc, char **argv)
     argv0 = argv[0];
     
     files = (char **)g_malloc0(sizeof(char *) * argc);
+    defconfigs = (char **)g_malloc0(sizeof(char *) * argc);
     
     for (i = 1 ; i < argc ; i++)
     {
@@ -218,6 +275,38 @@ parse_args(int argc, char **argv)
 		if (*(xref_filename = argv[i]+7) == '\0')
     		    usagef(1, "Expecting argument for --xref\n");
 	    }
+	    else if (!strcmp(argv[i], "--defconfig"))
+	    {
+		if ((defconfigs[ndefconfigs++] = argv[++i]) == 0)
+    		    usagef(1, "Expecting argument for --defconfig\n");
+	    }
+	    else if (!strncmp(argv[i], "--defconfig=", 12))
+	    {
+		if (*(defconfigs[ndefconfigs++] = argv[i]+12) == '\0')
+    		    usagef(1, "Expecting argument for --defconfig\n");
+	    }
+	    else if (!strcmp(argv[i], "--watch"))
+	    {
+	    	watch_flag = TRUE;
+	    }
+	    else if (!strcmp(argv[i], "--mem-stats"))
+	    {
+	    	mem_stats_flag = TRUE;
+	    }
+	    else if (!strcmp(argv[i], "--stats"))
+	    {
+	    	stats_flag = TRUE;
+	    }
+	    else if (!strcmp(argv[i], "--timings"))
+	    {
+	    	timings_format = "json";
+	    }
+	    else if (!strncmp(argv[i], "--timings=", 10))
+	    {
+	    	timings_format = argv[i]+10;
+		if (strcmp(timings_format, "json") && strcmp(timings_format, "tsv"))
+    		    usagef(1, "Expecting json or tsv for --timings\n");
+	    }
 	    else if (!strncmp(argv[i], "-W", 2))
 	    {
 	    	parse_warning_opt(argv[i]+2);
@@ -244,42 +333,382 @@ parse_args(int argc, char **argv)
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
-int
-main(int argc, char **argv)
+static cml_rulebase *
+parse_rulebase(int *retp)
 {
     cml_rulebase *rb;
     int i;
-    int ret = 0;
-    
-    parse_args(argc, argv);
     
     rb = cml_rulebase_new();
     if (nfiles > 1)
 	cml_rulebase_set_merge_mode(rb);
     cml_rulebase_set_arch(rb, arch);
+    if (timings_format != 0)
+    	cml_rulebase_enable_timings(rb);
     if (xref_filename != 0)
     	cml_rulebase_set_xref_filename(rb, xref_filename);
     for (i = 0 ; i < num_warnings ; i++)
     	if (warnings[i])
 	    cml_rulebase_set_warning(rb, i, (warnings[i] > 0));
 
-    pre_parse();
-
     for (i = 0 ; i < nfiles ; i++)
     {
 	if (!cml_rulebase_parse(rb, files[i]))
 	{
     	    fprintf(stderr, "%s: failed to load rulebase \"%s\"\n",
 	    		argv0, files[i]);
-	    ret = 2;
+	    *retp = 2;
 	}
     }
     
     if (nfiles > 1 && !cml_rulebase_post_parse(rb))
-    	ret = 2;
+    	*retp = 2;
+
+    return rb;
+}
+
+static int
+report_broken_rules(cml_rulebase *rb)
+{
+    GList *list = cml_rulebase_get_broken_rules(rb);
+    int n = g_list_length(list);
+    
+    printf("%s: %d broken rule%s\n", argv0, n, (n == 1 ? "" : "s"));
+    while (list != 0)
+    {
+	char *explanation = cml_rule_get_explanation((cml_rule *)list->data);
+
+	printf("    %s\n", explanation);
+	g_free(explanation);
+	list = g_list_remove_link(list, list);
+    }
+    fflush(stdout);
+    return n;
+}
+
+/*
+ * Load all the --defconfig files and check every rule
+ * against the result.
+ */
+static int
+load_defconfigs(cml_rulebase *rb)
+{
+    int i;
+    int ret = 0;
+    
+    for (i = 0 ; i < ndefconfigs ; i++)
+    {
+	if (!cml_rulebase_load_defconfig(rb, defconfigs[i]))
+	    ret = 2;
+    }
+    cml_rulebase_commit(rb, /*freeze*/FALSE);
+    cml_rulebase_check_all_rules(rb);
+    
+    if (report_broken_rules(rb) > 0 && ret == 0)
+    	ret = 1;
+    return ret;
+}
+
+/*
+ * Apply just the changed lines of one --defconfig file.  Only
+ * the rules using the changed symbols are re-triggered, so the
+ * broken rules set is brought up to date incrementally.
+ */
+static void
+update_defconfig(cml_rulebase *rb, const char *filename)
+{
+    int n;
+    
+    if ((n = cml_rulebase_update_defconfig(rb, filename)) < 0)
+    	return;
+    printf("%s: %s: %d symbol%s changed\n",
+    	    argv0, filename, n, (n == 1 ? "" : "s"));
+
+    if (!cml_rulebase_commit(rb, /*freeze*/FALSE))
+    {
+    	printf("%s: %s: changes rejected\n", argv0, filename);
+	report_broken_rules(rb);
+	/* the values have been rolled back, so resync the broken set */
+	cml_rulebase_check_all_rules(rb);
+	return;
+    }
+    report_broken_rules(rb);
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*
+ * Watch mode: keep running, and when a rules file or a --defconfig
+ * file is written, revalidate.  A changed .config is diff-loaded
+ * into the live rulebase.  A changed rules file means parsing the
+ * rulebase again, because post-parse checks are global, after which
+ * the .config files are reloaded in full so no bindings are lost.
+ */
+
+typedef struct
+{
+    char *filename;
+    const char *basename;   	/* points into filename */
+    gboolean is_rules;
+    gboolean changed;
+    int wd; 	    	    	/* inotify watch on the directory */
+#if !HAVE_INOTIFY
+    struct stat sb; 	    	/* for polling */
+    gboolean exists;
+#endif
+} watched_file;
+
+static GList *watched;	    	/* list of watched_file */
+#if HAVE_INOTIFY
+static int inotify_fd = -1;
+#endif
+
+static void
+watch_file(const char *filename, gboolean is_rules)
+{
+    watched_file *wf = g_new0(watched_file, 1);
+    const char *p;
+    
+    wf->filename = g_strdup(filename);
+    wf->basename = ((p = strrchr(wf->filename, '/')) == 0 ? wf->filename : p+1);
+    wf->is_rules = is_rules;
+    wf->wd = -1;
+#if !HAVE_INOTIFY
+    wf->exists = (stat(filename, &wf->sb) == 0);
+#else
+    {
+	/*
+	 * Editors often save by renaming a new file over the
+	 * old one, so watch the directory rather than the file.
+	 */
+    	char *dir = g_dirname(filename);
+
+	if ((wf->wd = inotify_add_watch(inotify_fd, dir,
+	    	    	    IN_CLOSE_WRITE|IN_MOVED_TO|IN_CREATE|IN_DELETE)) < 0)
+	    perror(dir);
+	g_free(dir);
+    }
+#endif
+    watched = g_list_append(watched, wf);
+}
+
+static void
+unwatch_all(void)
+{
+    while (watched != 0)
+    {
+    	watched_file *wf = (watched_file *)watched->data;
+	
+#if HAVE_INOTIFY
+	/*
+	 * Files in the same directory share a watch, so all but
+	 * the first removal of it fail, harmlessly.
+	 */
+	if (wf->wd >= 0)
+	    inotify_rm_watch(inotify_fd, wf->wd);
+#endif
+	g_free(wf->filename);
+	g_free(wf);
+	watched = g_list_remove_link(watched, watched);
+    }
+}
+
+static void
+watch_rulebase(cml_rulebase *rb)
+{
+    const GList *list;
+    int i;
     
+    unwatch_all();
+    for (list = cml_rulebase_get_filenames(rb) ; list != 0 ; list = list->next)
+    	watch_file((const char *)list->data, TRUE);
+    for (i = 0 ; i < ndefconfigs ; i++)
+    	watch_file(defconfigs[i], FALSE);
+}
+
+#if HAVE_INOTIFY
+
+static gboolean
+read_events(void)
+{
+    char buf[4096];
+    int n, off;
+    GList *list;
+    gboolean any = FALSE;
+    
+    if ((n = read(inotify_fd, buf, sizeof(buf))) < 0)
+    {
+    	if (errno != EINTR)
+	    perror("inotify");
+    	return FALSE;
+    }
+    for (off = 0 ; off < n ; )
+    {
+    	struct inotify_event *ev = (struct inotify_event *)(buf + off);
+	
+	off += sizeof(*ev) + ev->len;
+	if (ev->len == 0)
+	    continue;
+	for (list = watched ; list != 0 ; list = list->next)
+	{
+	    watched_file *wf = (watched_file *)list->data;
+	    
+	    if (wf->wd == ev->wd && !strcmp(wf->basename, ev->name))
+	    	wf->changed = any = TRUE;
+	}
+    }
+    return any;
+}
+
+static void
+wait_for_changes(void)
+{
+    struct pollfd pfd;
+    
+    while (!read_events())
+    	;
+    /* a save is often several events; wait for them to settle */
+    pfd.fd = inotify_fd;
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, /*millisec*/100) > 0)
+    	read_events();
+}
+
+#else /* !HAVE_INOTIFY */
+
+static gboolean
+poll_file(watched_file *wf)
+{
+    struct stat sb;
+    gboolean exists = (stat(wf->filename, &sb) == 0);
+    
+    if (exists == wf->exists &&
+    	(!exists ||
+	 (sb.st_mtime == wf->sb.st_mtime &&
+	  sb.st_size == wf->sb.st_size &&
+	  sb.st_ino == wf->sb.st_ino)))
+	return FALSE;
+    wf->exists = exists;
+    wf->sb = sb;
+    return TRUE;
+}
+
+static void
+wait_for_changes(void)
+{
+    GList *list;
+    gboolean any = FALSE;
+    
+    while (!any)
+    {
+    	sleep(1);
+	for (list = watched ; list != 0 ; list = list->next)
+	{
+	    watched_file *wf = (watched_file *)list->data;
+
+	    if (poll_file(wf))
+	    	wf->changed = any = TRUE;
+	}
+    }
+}
+
+#endif /* !HAVE_INOTIFY */
+
+static void
+watch_loop(cml_rulebase *rb)
+{
+    GList *list;
+    gboolean rules_changed;
+    
+#if HAVE_INOTIFY
+    if ((inotify_fd = inotify_init()) < 0)
+    {
+    	perror("inotify_init");
+	exit(2);
+    }
+#endif
+    watch_rulebase(rb);
+    printf("%s: watching %d files\n", argv0, g_list_length(watched));
+    fflush(stdout);
+
+    for (;;)
+    {
+    	wait_for_changes();
+	
+	rules_changed = FALSE;
+	for (list = watched ; list != 0 ; list = list->next)
+	{
+	    watched_file *wf = (watched_file *)list->data;
+
+	    if (wf->changed && wf->is_rules)
+	    	rules_changed = TRUE;
+	}
+	
+	if (rules_changed)
+	{
+	    cml_rulebase *newrb;
+	    int ret = 0;
+	    
+	    printf("%s: rules changed, reparsing\n", argv0);
+	    fflush(stdout);
+	    newrb = parse_rulebase(&ret);
+	    if (ret != 0)
+	    {
+	    	/* keep the old rulebase until the errors are fixed */
+	    	cml_rulebase_delete(newrb);
+		rules_changed = FALSE;
+	    }
+	    else
+	    {
+		cml_rulebase_delete(rb);
+		rb = newrb;
+		load_defconfigs(rb);
+		/* the set of sourced files may have changed */
+		watch_rulebase(rb);
+		continue;
+	    }
+	}
+	
+	for (list = watched ; list != 0 ; list = list->next)
+	{
+	    watched_file *wf = (watched_file *)list->data;
+
+	    if (wf->changed && !wf->is_rules)
+	    	update_defconfig(rb, wf->filename);
+	    wf->changed = FALSE;
+	}
+    }
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+int
+main(int argc, char **argv)
+{
+    cml_rulebase *rb;
+    int ret = 0;
+    
+    parse_args(argc, argv);
+    
+    pre_parse();
+    rb = parse_rulebase(&ret);
     post_parse();
     
+    if (mem_stats_flag)
+    	print_mem_stats(rb);
+    if (stats_flag)
+    	cml_rulebase_print_stats(rb, stdout);
+    if (timings_format != 0)
+    	cml_rulebase_print_timings(rb, stdout, timings_format);
+    
+    if (ret == 0 && ndefconfigs > 0)
+    	ret = load_defconfigs(rb);
+    if (watch_flag)
+    {
+    	if (ret == 2)
+	    return ret;     /* need a good rulebase to start from */
+    	watch_loop(rb);
+    }
+    
     return ret;
 }
 
@@ -26,7 +26,6 @@
 #include <libintl.h>
 #include <assert.h>
 #include <stdarg.h>
-#include "strvec.h"
 
 #ifndef DEBUG
 #define DEBUG 0
@@ -25,6 +25,8 @@
 
 static int list_width, check_x, item_x, checkflag;
 
+#define ITEM(i)	((*dl->text) (dl, (i)))
+
 /*
  * Print list item
  */
@@ -114,10 +116,10 @@ print_buttons( WINDOW *dialog, int height, int width, int selected)
  */
 int
 dialog_checklist (const char *title, const char *prompt, int height, int width,
-	int list_height, int item_no, const char * const * items, int flag)
+	int list_height, dialog_list *dl, int flag)
 	
 {
-    int i, x, y, box_x, box_y;
+    int i, x, y, box_x, box_y, item_no = dl->item_no;
     int key = 0, button = 0, choice = 0, scroll = 0, max_choice, *status;
     WINDOW *dialog, *list;
 
@@ -133,10 +135,12 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
 
     /* Initializes status */
     for (i = 0; i < item_no; i++) {
-	status[i] = !strcasecmp (items[i * 3 + 2], "on");
+	status[i] = (*dl->status) (dl, i);
 	if (!choice && status[i])
             choice = i;
     }
+    if (dl->current >= 0 && dl->current < item_no)
+	choice = dl->current;
 
     max_choice = MIN (list_height, item_no);
 
@@ -191,7 +195,7 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
     /* Find length of longest item in order to center checklist */
     check_x = 0;
     for (i = 0; i < item_no; i++) 
-	check_x = MAX (check_x, + strlen (items[i * 3 + 1]) + 4);
+	check_x = MAX (check_x, + strlen (ITEM (i)) + 4);
 
     check_x = (list_width - check_x) / 2;
     item_x = check_x + 4;
@@ -203,7 +207,7 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
 
     /* Print the list */
     for (i = 0; i < max_choice; i++) {
-	print_item (list, items[(scroll+i) * 3 + 1],
+	print_item (list, ITEM (scroll+i),
 		    status[i+scroll], i, i == choice);
     }
 
@@ -218,7 +222,7 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
 	key = wgetch (dialog);
 
     	for (i = 0; i < max_choice; i++)
-            if (toupper(key) == toupper(items[(scroll+i)*3+1][0]))
+            if (toupper(key) == toupper(ITEM (scroll+i)[0]))
                 break;
 
 
@@ -231,14 +235,14 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
 		    /* Scroll list down */
 		    if (list_height > 1) {
 			/* De-highlight current first item */
-			print_item (list, items[scroll * 3 + 1],
+			print_item (list, ITEM (scroll),
 					status[scroll], 0, FALSE);
 			scrollok (list, TRUE);
 			wscrl (list, -1);
 			scrollok (list, FALSE);
 		    }
 		    scroll--;
-		    print_item (list, items[scroll * 3 + 1],
+		    print_item (list, ITEM (scroll),
 				status[scroll], 0, TRUE);
 		    wnoutrefresh (list);
 
@@ -257,7 +261,7 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
 		    /* Scroll list up */
 		    if (list_height > 1) {
 			/* De-highlight current last item before scrolling up */
-			print_item (list, items[(scroll + max_choice - 1) * 3 + 1],
+			print_item (list, ITEM (scroll + max_choice - 1),
 				    status[scroll + max_choice - 1],
 				    max_choice - 1, FALSE);
 			scrollok (list, TRUE);
@@ -265,7 +269,7 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
 			scrollok (list, FALSE);
 		    }
 		    scroll++;
-		    print_item (list, items[(scroll + max_choice - 1) * 3 + 1],
+		    print_item (list, ITEM (scroll + max_choice - 1),
 				status[scroll + max_choice - 1],
 				max_choice - 1, TRUE);
 		    wnoutrefresh (list);
@@ -281,11 +285,11 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
 	    }
 	    if (i != choice) {
 		/* De-highlight current item */
-		print_item (list, items[(scroll + choice) * 3 + 1],
+		print_item (list, ITEM (scroll + choice),
 			    status[scroll + choice], choice, FALSE);
 		/* Highlight new item */
 		choice = i;
-		print_item (list, items[(scroll + choice) * 3 + 1],
+		print_item (list, ITEM (scroll + choice),
 			    status[scroll + choice], choice, TRUE);
 		wnoutrefresh (list);
 		wrefresh (dialog);
@@ -298,6 +302,7 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
 	case '?':
 	    delwin (dialog);
 	    free (status);
+	    dl->current = scroll + choice;
 	    return 1;
 	case TAB:
 	case KEY_LEFT:
@@ -324,24 +329,14 @@ dialog_checklist (const char *title, const char *prompt, int height, int width,
 			    status[i] = 0;
 			status[scroll + choice] = 1;
 			for (i = 0; i < max_choice; i++)
-			    print_item (list, items[(scroll + i) * 3 + 1],
+			    print_item (list, ITEM (scroll + i),
 					status[scroll + i], i, i == choice);
 		    }
 		}
 		wnoutrefresh (list);
 		wrefresh (dialog);
-            
-		for (i = 0; i < item_no; i++) {
-		    if (status[i]) {
-			if (flag == FLAG_CHECK) {
-			    fprintf (stderr, "\"%s\" ", items[i * 3]);
-			} else {
-			    fprintf (stderr, "%s", items[i * 3]);
-			}
-
-		    }
-		}
             }
+	    dl->current = scroll + choice;
 	    delwin (dialog);
 	    free (status);
 	    return button;
@@ -154,12 +154,34 @@ int dialog_yesno (const char *title, const char *prompt, int height, int width);
 int dialog_msgbox (const char *title, const char *prompt, int height,
 		int width, int pause);
 int dialog_textbox (const char *title, const char *file, int height, int width);
+
+/*
+ * The items of a menu or checklist are supplied by the caller one
+ * row at a time, and the chosen item is passed back in `current'
+ * instead of being printed on stderr.  A menu may also let the
+ * caller act on the y/n/m/space keys without closing: `key' is
+ * called with `current' set, may change `item_no' and `current',
+ * and says what needs redrawing.
+ */
+typedef struct dialog_list dialog_list;
+struct dialog_list {
+    int item_no;
+    int current;		/* item under the cursor, in and out */
+    const char *(*text) (dialog_list *dl, int item);
+    int (*status) (dialog_list *dl, int item);	/* checklist only */
+    int (*key) (dialog_list *dl, int key);	/* menu only, may be NULL */
+    int (*changed) (dialog_list *dl, int item);	/* NULL means all */
+    void *data;
+};
+
+#define DIALOG_KEY_CLOSE	(-1)	/* close the menu, returning the key */
+#define DIALOG_KEY_ROWS		0	/* redraw the rows changed() reports */
+#define DIALOG_KEY_ALL		1	/* redraw the whole menu */
+
 int dialog_menu (const char *title, const char *prompt, int height, int width,
-		int menu_height, const char *choice, int item_no, 
-		const char * const * items);
+		int menu_height, dialog_list *dl);
 int dialog_checklist (const char *title, const char *prompt, int height,
-		int width, int list_height, int item_no,
-		const char * const * items, int flag);
+		int width, int list_height, dialog_list *dl, int flag);
 extern unsigned char dialog_input_result[];
 int dialog_inputbox (const char *title, const char *prompt, int height,
 		int width, const char *init);
@@ -155,13 +155,67 @@ print_buttons (WINDOW *win, int height, int width, int selected)
     wrefresh (win);
 }
 
+#define ITEM(i)	((*dl->text) (dl, (i)))
+
+/*
+ * Redraw the menu rows after the caller has handled a key, keeping
+ * the cursor on the caller's current item.  Only the rows the caller
+ * says have changed are redrawn, unless the list itself has changed.
+ */
+static void
+relayout (WINDOW * dialog, WINDOW * menu, dialog_list * dl, int how,
+		int *scrollp, int *choicep, int *max_choicep,
+		int y, int x, int height, int width, int menu_height,
+		int box_y, int box_x)
+{
+    int i, cur, scroll = *scrollp, all = (how == DIALOG_KEY_ALL);
+    int max_choice = MIN (menu_height, dl->item_no);
+
+    cur = MAX (0, MIN (dl->current, dl->item_no - 1));
+    if (cur < scroll)
+	scroll = cur;
+    else if (cur >= scroll + max_choice)
+	scroll = cur - max_choice + 1;
+    if (scroll + max_choice > dl->item_no)
+	scroll = MAX (0, dl->item_no - max_choice);
+
+    if (max_choice != *max_choicep || scroll != *scrollp)
+	all = TRUE;
+
+    if (how == DIALOG_KEY_ALL) {
+	/* something was drawn over us */
+	dialog_clear ();
+	draw_shadow (stdscr, y, x, height, width);
+	touchwin (dialog);
+    }
+
+    for (i = 0; i < menu_height; i++) {
+	if (i >= max_choice) {
+	    wattrset (menu, menubox_attr);
+	    wmove (menu, i, 0);
+	    wclrtoeol (menu);
+	} else if (all || i == *choicep || i == cur - scroll ||
+		   dl->changed == NULL || (*dl->changed) (dl, scroll + i))
+	    print_item (menu, ITEM (scroll + i), i, i == cur - scroll, TRUE);
+    }
+
+    print_arrows (dialog, dl->item_no, scroll, box_y,
+		  box_x + item_x + 1, menu_height);
+
+    *scrollp = scroll;
+    *choicep = cur - scroll;
+    *max_choicep = max_choice;
+
+    wnoutrefresh (menu);
+    wrefresh (dialog);
+}
+
 /*
  * Display a menu for choosing among a number of options
  */
 int
 dialog_menu (const char *title, const char *prompt, int height, int width,
-		int menu_height, const char *current, int item_no,
-		const char * const * items)
+		int menu_height, dialog_list *dl)
 
 {
     int i, j, x, y, box_x, box_y;
@@ -169,7 +223,7 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
     WINDOW *dialog, *menu;
     FILE *f;
 
-    max_choice = MIN (menu_height, item_no);
+    max_choice = MIN (menu_height, dl->item_no);
 
     /* center dialog box on screen */
     x = (COLS - width) / 2;
@@ -225,10 +279,10 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
      * Set 'choice' to default item. 
      */
     item_x = 0;
-    for (i = 0; i < item_no; i++) {
-	item_x = MAX (item_x, MIN(menu_width, strlen (items[i * 2 + 1]) + 2));
-	if (strcmp(current, items[i*2]) == 0) choice = i;
-    }
+    for (i = 0; i < dl->item_no; i++)
+	item_x = MAX (item_x, MIN(menu_width, strlen (ITEM (i)) + 2));
+    if (dl->current >= 0 && dl->current < dl->item_no)
+	choice = dl->current;
 
     item_x = (menu_width - item_x) / 2;
 
@@ -236,7 +290,7 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
     if ( (f=fopen("lxdialog.scrltmp","r")) != NULL ) {
 	if ( (fscanf(f,"%d\n",&scroll) == 1) && (scroll <= choice) &&
 	     (scroll+max_choice > choice) && (scroll >= 0) &&
-	     (scroll+max_choice <= item_no) ) {
+	     (scroll+max_choice <= dl->item_no) ) {
 	    first_item = scroll;
 	    choice = choice - scroll;
 	    fclose(f);
@@ -248,8 +302,8 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
 	}
     }
     if ( (choice >= max_choice) || (f==NULL && choice >= max_choice/2) ) {
-	if (choice >= item_no-max_choice/2)
-	    scroll = first_item = item_no-max_choice;
+	if (choice >= dl->item_no-max_choice/2)
+	    scroll = first_item = dl->item_no-max_choice;
 	else
 	    scroll = first_item = choice - max_choice/2;
 	choice = choice - scroll;
@@ -257,13 +311,12 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
 
     /* Print the menu */
     for (i=0; i < max_choice; i++) {
-	print_item (menu, items[(first_item + i) * 2 + 1], i, i == choice,
-                    (items[(first_item + i)*2][0] != ':'));
+	print_item (menu, ITEM (first_item + i), i, i == choice, TRUE);
     }
 
     wnoutrefresh (menu);
 
-    print_arrows(dialog, item_no, scroll,
+    print_arrows(dialog, dl->item_no, scroll,
 		 box_y, box_x+item_x+1, menu_height);
 
     print_buttons (dialog, height, width, 0);
@@ -277,14 +330,16 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
 		i = max_choice;
 	else {
         for (i = choice+1; i < max_choice; i++) {
-		j = first_alpha(items[(scroll+i)*2+1], "YyNnMm");
-		if (key == tolower(items[(scroll+i)*2+1][j]))
+		const char *item = ITEM (scroll+i);
+		j = first_alpha(item, "YyNnMm");
+		if (key == tolower(item[j]))
                 	break;
 	}
 	if (i == max_choice)
        		for (i = 0; i < max_choice; i++) {
-			j = first_alpha(items[(scroll+i)*2+1], "YyNnMm");
-			if (key == tolower(items[(scroll+i)*2+1][j]))
+			const char *item = ITEM (scroll+i);
+			j = first_alpha(item, "YyNnMm");
+			if (key == tolower(item[j]))
                 		break;
 		}
 	}
@@ -294,8 +349,7 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
             key == '-' || key == '+' ||
             key == KEY_PPAGE || key == KEY_NPAGE) {
 
-            print_item (menu, items[(scroll+choice)*2+1], choice, FALSE,
-                       (items[(scroll+choice)*2][0] != ':'));
+            print_item (menu, ITEM (scroll+choice), choice, FALSE, TRUE);
 
 	    if (key == KEY_UP || key == '-') {
                 if (choice < 2 && scroll) {
@@ -306,18 +360,16 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
 
                     scroll--;
 
-                    print_item (menu, items[scroll * 2 + 1], 0, FALSE,
-                               (items[scroll*2][0] != ':'));
+                    print_item (menu, ITEM (scroll), 0, FALSE, TRUE);
 		} else
 		    choice = MAX(choice - 1, 0);
 
 	    } else if (key == KEY_DOWN || key == '+')  {
 
-		print_item (menu, items[(scroll+choice)*2+1], choice, FALSE,
-                                (items[(scroll+choice)*2][0] != ':'));
+		print_item (menu, ITEM (scroll+choice), choice, FALSE, TRUE);
 
                 if ((choice > max_choice-3) &&
-                    (scroll + max_choice < item_no)
+                    (scroll + max_choice < dl->item_no)
                    ) {
 		    /* Scroll menu up */
 		    scrollok (menu, TRUE);
@@ -326,9 +378,8 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
 
                     scroll++;
 
-                    print_item (menu, items[(scroll+max_choice-1)*2+1],
-                               max_choice-1, FALSE,
-                               (items[(scroll+max_choice-1)*2][0] != ':'));
+                    print_item (menu, ITEM (scroll+max_choice-1),
+                               max_choice-1, FALSE, TRUE);
                 } else
                     choice = MIN(choice+1, max_choice-1);
 
@@ -338,8 +389,7 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
                     if (scroll > 0) {
                 	wscrl (menu, -1);
                 	scroll--;
-                	print_item (menu, items[scroll * 2 + 1], 0, FALSE,
-                	(items[scroll*2][0] != ':'));
+                	print_item (menu, ITEM (scroll), 0, FALSE, TRUE);
                     } else {
                         if (choice > 0)
                             choice--;
@@ -349,14 +399,13 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
 
             } else if (key == KEY_NPAGE) {
                 for (i=0; (i < max_choice); i++) {
-                    if (scroll+max_choice < item_no) {
+                    if (scroll+max_choice < dl->item_no) {
 			scrollok (menu, TRUE);
 			scroll(menu);
 			scrollok (menu, FALSE);
                 	scroll++;
-                	print_item (menu, items[(scroll+max_choice-1)*2+1],
-			            max_choice-1, FALSE,
-			            (items[(scroll+max_choice-1)*2][0] != ':'));
+                	print_item (menu, ITEM (scroll+max_choice-1),
+			            max_choice-1, FALSE, TRUE);
 		    } else {
 			if (choice+1 < max_choice)
 			    choice++;
@@ -366,10 +415,9 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
             } else
                 choice = i;
 
-            print_item (menu, items[(scroll+choice)*2+1], choice, TRUE,
-                       (items[(scroll+choice)*2][0] != ':'));
+            print_item (menu, ITEM (scroll+choice), choice, TRUE, TRUE);
 
-            print_arrows(dialog, item_no, scroll,
+            print_arrows(dialog, dl->item_no, scroll,
                          box_y, box_x+item_x+1, menu_height);
 
             wnoutrefresh (menu);
@@ -393,13 +441,26 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
 	case 'y':
 	case 'n':
 	case 'm':
+	    dl->current = scroll + choice;
+	    if (dl->key != NULL) {
+		int how = (*dl->key) (dl, key);
+
+		if (how != DIALOG_KEY_CLOSE) {
+		    if (dl->item_no == 0)
+			break;	/* nothing left, like ESC */
+		    relayout (dialog, menu, dl, how, &scroll, &choice,
+			      &max_choice, y, x, height, width, menu_height,
+			      box_y, box_x);
+		    print_buttons (dialog, height, width, button);
+		    continue;
+		}
+	    }
 	    /* save scroll info */
 	    if ( (f=fopen("lxdialog.scrltmp","w")) != NULL ) {
 		fprintf(f,"%d\n",scroll);
 		fclose(f);
 	    }
 	    delwin (dialog);
-            fprintf(stderr, "%s\n", items[(scroll + choice) * 2]);
             switch (key) {
             case 's': return 3;
             case 'y': return 3;
@@ -413,14 +474,7 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
 	    button = 2;
 	case '\n':
 	    delwin (dialog);
-	    if (button == 2) 
-            	fprintf(stderr, "%s \"%s\"\n", 
-			items[(scroll + choice) * 2],
-			items[(scroll + choice) * 2 + 1] +
-			first_alpha(items[(scroll + choice) * 2 + 1],""));
-	    else
-            	fprintf(stderr, "%s\n", items[(scroll + choice) * 2]);
-
+	    dl->current = scroll + choice;
 	    remove("lxdialog.scrltmp");
 	    return button;
 	case 'e':
@@ -429,6 +483,8 @@ dialog_menu (const char *title, const char *prompt, int height, int width,
 	case ESC:
 	    break;
 	}
+	if (dl->item_no == 0)
+	    break;
     }
 
     delwin (dialog);
@@ -20,13 +20,10 @@
 #include "common.h"
 #undef MIN  	/* fmeh */
 #undef MAX
-#include "strvec.h"
 #include "dialog.h"
 #include "libcml.h"
 #include "debug.h"
 #include <unistd.h>
-#include <sys/fcntl.h>
-#include <sys/errno.h>
 
 CVSID("$Id: main.c,v 1.17 2002/07/22 13:58:58 gnb Exp $");
 
@@ -35,6 +32,7 @@ static char *arch = "i386";
 static char *rulebase_filename = "rules.cml";
 static char *defconfig_filename = ".config";
 static gboolean freeze_flag = TRUE;
+static gboolean stats_flag = FALSE;
 static cml_rulebase *rb;
 static gboolean changed = FALSE;
 
@@ -60,18 +58,17 @@ static gboolean changed = FALSE;
 #define DEBUG_RET() \
     if (debug & DEBUG_GUI) \
     { \
-	fprintf(stderr, "\n\nRETURN=%d\nSTDERR=\"%s\"\n", retcode, retstr); \
+	fprintf(stderr, "\n\nRETURN=%d\n", retcode); \
 	fflush(stderr); \
     }
 #else
 #define DEBUG_RET()
 #endif
 
-static void capture_init(void);
-static void capture_begin(void);
-static char *capture_end(void);
+#if TESTSCRIPT
 static void capture_to_file(const char *which, char **filenamep);
 static void capture_to_file_end(void);
+#endif
 
 static void show_menu(cml_node *mn);
 static void show_radio(cml_node *mn);
@@ -150,20 +147,64 @@ static const char menuconfig_help[] =
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
-static cml_node *
-find_child(cml_node *mn, const char *name)
+/*
+ * The lxdialog menu and checklist ask us for each row's text as
+ * they draw it.  A row is a node, one of the root menu's commands,
+ * or a value of a limited int.  The text is built when first asked
+ * for and kept until the change notifier says the node has changed,
+ * so after a keypress only the rows which changed get rebuilt and
+ * redrawn.
+ */
+typedef struct
 {
-    GList *list;
+    cml_node *node;
+    const char *command;    	/* e.g. "#load", when node == 0 */
+    long value;     	    	/* for limited ints */
+    char *text;
+    gboolean dirty; 	    	/* text needs rebuilding */
+} menu_row;
+
+typedef struct menu_page_s menu_page;
+struct menu_page_s
+{
+    menu_page *parent;	    	/* next menu down the stack */
+    cml_node *menu;
+    int nrows;
+    menu_row *rows;
+    gboolean relist;	    	/* visible children have changed */
+};
+
+static menu_page *top_page;
+static gboolean overdrawn = FALSE;  /* another dialog drew over the menu */
+
+static menu_row *
+rows_new(int n)
+{
+    return (n == 0 ? 0 : g_new0(menu_row, n));
+}
+
+static void
+rows_free(menu_row *rows, int n)
+{
+    int i;
     
-    for (list = cml_node_get_children(mn) ; list != 0 ; list = list->next)
+    for (i = 0 ; i < n ; i++)
     {
-    	cml_node *child = (cml_node *)list->data;
-	
-    	if (!strcmp(name, cml_node_get_name(child)))
-	    return child;
+    	if (rows[i].node != 0 && cml_node_get_user_data(rows[i].node) == &rows[i])
+	    cml_node_set_user_data(rows[i].node, 0);
+    	if (rows[i].text != 0)
+	    g_free(rows[i].text);
     }
-    
-    return 0;
+    if (rows != 0)
+	g_free(rows);
+}
+
+static const char *
+row_text(dialog_list *dl, int item)
+{
+    menu_page *page = (menu_page *)dl->data;
+
+    return page->rows[item].text;
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
@@ -204,7 +245,6 @@ show_broken_rules(void)
 {
     FILE *fp;
     GList *list;
-    char *retstr;
     char *filename = 0;
     int retcode;
     
@@ -238,13 +278,12 @@ show_broken_rules(void)
     }
     fclose(fp);
     
-    capture_begin();
+    overdrawn = TRUE;
     dialog_clear();
     retcode = dialog_textbox(
     	"Broken Rules",    	    	/* title */
 	filename,   	    	    	/* file */
 	height, width); 	    	/* height, width */
-    retstr = capture_end();
 
     DEBUG_RET();
 
@@ -310,21 +349,18 @@ show_error(const char *error)
 static void
 show_load(void)
 {
-    char *retstr;
     int retcode;
     gboolean done = FALSE;
     char *filename;
 
     do
     {
-	capture_begin();
 	dialog_clear();
 	retcode = dialog_inputbox(
     	    0,	    	    	    	    	/* title */
 	    load_instructions,	    	    	/* prompt */
 	    load_height, load_width,	    	/* height, width */
 	    defconfig_filename);    	    	/* string */
-	retstr = capture_end();
 
     	DEBUG_RET();
 
@@ -363,21 +399,18 @@ show_load(void)
 static void
 show_saveas(void)
 {
-    char *retstr;
     int retcode;
     gboolean done = FALSE;
     char *filename;
 
     do
     {
-	capture_begin();
 	dialog_clear();
 	retcode = dialog_inputbox(
     	    0,	    	    	    	    	/* title */
 	    saveas_instructions,    	    	/* prompt */
 	    saveas_height, saveas_width,    	/* height, width */
 	    "");     	    	    	    	/* string */
-	retstr = capture_end();
 
     	DEBUG_RET();
 
@@ -416,7 +449,6 @@ show_runtest(void)
     gboolean success;
     char *filename = 0;
     int retcode;
-    char *retstr;
 
     capture_to_file("test", &filename);
     success = cml_rulebase_run_test(rb);
@@ -428,13 +460,11 @@ show_runtest(void)
     if (!success)
 	beep();
 
-    capture_begin();
     dialog_clear();
     retcode = dialog_textbox(
     	"Rulebase Test Script",     	/* title */
 	filename,   	    	    	/* file */
 	height, width);     	    	/* height, width */
-    retstr = capture_end();
 
     DEBUG_RET();
 
@@ -448,7 +478,6 @@ static void
 show_text_help(const char *title, const char *helptext)
 {
     FILE *fp;
-    char *retstr;
     int retcode;
     char *filename = 0;
     
@@ -461,12 +490,10 @@ show_text_help(const char *title, const char *helptext)
     fputs(helptext, fp);
     fclose(fp);
     
-    capture_begin();
     retcode = dialog_textbox(
     	title,    	    	    	/* title */
 	filename,   	    	    	/* file */
 	height, width);	    	    	/* height, width */
-    retstr = capture_end();
 
     DEBUG_RET();
 
@@ -486,7 +513,6 @@ static void
 show_string(cml_node *mn)
 {
     const cml_atom *ap;
-    char *retstr;
     int retcode;
     cml_atom a;
 
@@ -494,14 +520,12 @@ show_string(cml_node *mn)
 
     for (;;)
     {
-	capture_begin();
 	dialog_clear();
 	retcode = dialog_inputbox(
     	    cml_node_get_banner(mn),	    	/*title*/
 	    inputbox_instructions_string,   	/*prompt*/
 	    input_height, input_width,	    	/* height, width */
 	    ap->value.string);	    	    	/* string */
-	retstr = capture_end();
 
     	DEBUG_RET();
 
@@ -526,7 +550,6 @@ show_simple_int(cml_node *mn)
 {
     const cml_atom *ap;
     char *valstr;
-    char *retstr;
     int retcode;
     cml_atom a;
     gboolean done = FALSE;
@@ -538,7 +561,6 @@ show_simple_int(cml_node *mn)
 
     do
     {
-	capture_begin();
 	dialog_clear();
 	retcode = dialog_inputbox(
     	    cml_node_get_banner(mn),	    	/*title*/
@@ -547,7 +569,6 @@ show_simple_int(cml_node *mn)
 		inputbox_instructions_dec),   	/*prompt*/
 	    input_height, input_width,	    	/* height, width */
 	    valstr);	    	    	    	/* string */
-	retstr = capture_end();
 
     	DEBUG_RET();
 
@@ -574,55 +595,63 @@ show_simple_int(cml_node *mn)
 
 #define LIMITED_MAX 32
 
+static int
+int_status(dialog_list *dl, int item)
+{
+    menu_page *page = (menu_page *)dl->data;
+    
+    /* TODO: deal with alias problem */
+    return (cml_node_get_value(page->menu)->value.integer == page->rows[item].value);
+}
+
 static void
 show_int(cml_node *mn)
 {
     const GList *list;
-    strvec_t menu;
+    menu_page page;
+    dialog_list dl;
+    menu_row *row;
     int nitems;
     const cml_atom *ap;
-    char *retstr;
     int retcode;
     cml_atom a;
     gboolean done = FALSE;
     gboolean ishex;
 
-    strvec_init(&menu);
+    memset(&page, 0, sizeof(page));
+    page.menu = mn;
     
     ap = cml_node_get_value(mn);
     ishex = (cml_node_get_value_type(mn) == A_HEXADECIMAL);
 
     if ((list = cml_node_get_enumdefs(mn)) != 0)
     {
-	strvec_preallocate(&menu, 3*g_list_length((GList *)list));
+	page.rows = row = rows_new(g_list_length((GList *)list));
 
-	for ( ; list != 0 ; list = list->next)
+	for ( ; list != 0 ; list = list->next, row++)
 	{
 	    cml_enumdef *ed = (cml_enumdef *)list->data;
 
-	    strvec_appendf(&menu, (ishex ? "0x%lX" : "%ld"), ed->value);
-	    strvec_append(&menu, cml_node_get_banner(ed->symbol));
-	    /* TODO: deal with alias problem */
-	    strvec_append(&menu, ap->value.integer == ed->value ? "ON" : "OFF");
+	    row->value = ed->value;
+	    row->text = g_strdup(cml_node_get_banner(ed->symbol));
+	    page.nrows++;
 	}
     }
     else if ((nitems = cml_node_get_range_count(mn)) > 0 &&
              nitems < LIMITED_MAX)
     {
-	strvec_preallocate(&menu, 3*nitems);
+	page.rows = row = rows_new(nitems);
 	
 	for (list = cml_node_get_range(mn) ; list != 0 ; list = list->next)
     	{
 	    cml_subrange *sr = (cml_subrange *)list->data;
 	    int value;
 	    
-	    for (value = sr->begin ; value <= sr->end ; value++)
+	    for (value = sr->begin ; value <= sr->end ; value++, row++)
 	    {
-	    	char *valstr = g_strdup_printf((ishex ? "0x%lX" : "%ld"), value);
-		strvec_append(&menu, valstr);
-		strvec_appendm(&menu, valstr);
-		/* TODO: deal with alias problem */
-		strvec_append(&menu, (ap->value.integer == value ? "ON" : "OFF"));
+		row->value = value;
+	    	row->text = g_strdup_printf((ishex ? "0x%lX" : "%ld"), (long)value);
+		page.nrows++;
 	    }
 	}
     }
@@ -633,40 +662,31 @@ show_int(cml_node *mn)
 	return;
     }
     
+    memset(&dl, 0, sizeof(dl));
+    dl.item_no = page.nrows;
+    dl.current = -1;
+    dl.text = row_text;
+    dl.status = int_status;
+    dl.data = &page;
     
     do
     {
 
-	capture_begin();
 	retcode = dialog_checklist(
     	    cml_node_get_banner(mn),    	/*title*/
 	    radio_instructions,  	    	/*prompt*/
 	    height, width, list_height,	    	/* height, width, list_height */
-	    menu.nitems/3, (const char * const *)menu.items, /* item_no, items */
-	    FLAG_CHECK);
-	retstr = capture_end();
+	    &dl, FLAG_CHECK);
 
     	DEBUG_RET();
 
 	switch (retcode)
 	{
 	case 0: /* `Select' button */
-	    if (retstr != 0)
+	    if (page.rows[dl.current].value != ap->value.integer)
 	    {
 		a.type = cml_node_get_value_type(mn);
-		/*
-		 * Stupid bloody output is the old node name and the
-		 * new node name, quoted, in their order of appearance
-		 * in the menu.  So have to futz about to figure out
-		 * the new one.
-		 */
-		a.value.integer = strtol(strtok(retstr, "\""), 0, (ishex ? 16 : 10));
-		if (a.value.integer == ap->value.integer)
-		{
-	    	    /* second name output is the new one */
-		    strtok(0, "\"");    /* skip the space */
-		    a.value.integer = strtol(strtok(0, "\""), 0, (ishex ? 16 : 10));
-		}
+		a.value.integer = page.rows[dl.current].value;
 		set_value(mn, &a);
     	    }
     	    done = TRUE;
@@ -678,82 +698,79 @@ show_int(cml_node *mn)
     }
     while (!done);
     
-    strvec_free(&menu);
+    rows_free(page.rows, page.nrows);
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
+static int
+radio_status(dialog_list *dl, int item)
+{
+    menu_page *page = (menu_page *)dl->data;
+    
+    return cml_node_get_value(page->rows[item].node)->value.tritval;
+}
+
 static void
 show_radio(cml_node *mn)
 {
-    GList *list;
-    strvec_t menu;
+    int n;
+    cml_node_iter kids;
+    menu_page page;
+    dialog_list dl;
+    menu_row *row;
     const cml_atom *ap;
-    char *retstr;
     int retcode;
     cml_atom a;
     cml_node *child;
     gboolean done = FALSE;
 
-    list = cml_node_get_children(mn);
+    n = cml_node_get_num_children(mn);
     
-    strvec_init(&menu);
-    strvec_preallocate(&menu, 3*g_list_length(list));
+    memset(&page, 0, sizeof(page));
+    page.menu = mn;
+    page.rows = row = rows_new(n);
     
-    for ( ; list != 0 ; list = list->next)
+    cml_node_iter_children(&kids, mn);
+    for ( ; (child = cml_node_iter_next(&kids)) != 0 ; row++)
     {
-    	child = (cml_node *)list->data;
-
     	/* Note: we deliberately don't allow radio children to be invisible */
 	/* TODO: ask esr about that */	
 	ap = cml_node_get_value(child);
     	assert(ap->type == A_BOOLEAN);
 	
-	strvec_append(&menu, cml_node_get_name(child));
-	strvec_append(&menu, cml_node_get_banner(child));
-	strvec_append(&menu, (ap->value.tritval ? "ON" : "OFF"));
+	row->node = child;
+	row->text = g_strdup(cml_node_get_banner(child));
+	page.nrows++;
     }
     
+    memset(&dl, 0, sizeof(dl));
+    dl.item_no = page.nrows;
+    dl.current = -1;
+    dl.text = row_text;
+    dl.status = radio_status;
+    dl.data = &page;
+    
     do
     {
 
-	capture_begin();
 	retcode = dialog_checklist(
     	    cml_node_get_banner(mn),    	/*title*/
 	    radio_instructions,  	    	/*prompt*/
 	    height, width, list_height,	    	/* height, width, list_height */
-	    menu.nitems/3, (const char * const *)menu.items, /* item_no, items */
-	    0);
-	retstr = capture_end();
+	    &dl, 0);
 
     	DEBUG_RET();
 
 	switch (retcode)
 	{
 	case 0: /* `Select' button */
-	    if (retstr != 0)
+	    child = page.rows[dl.current].node;
+	    if (child != cml_node_get_value(mn)->value.node)
 	    {
 		a.type = A_BOOLEAN;
 		a.value.tritval = CML_Y;
-		/*
-		 * Stupid bloody output is the old node name and the
-		 * new node name, quoted, in their order of appearance
-		 * in the menu.  So have to futz about to figure out
-		 * the new one.
-		 */
-		child = find_child(mn, strtok(retstr, "\""));
-		assert(child != 0);
-		if (child != cml_node_get_value(mn)->value.node)
-		{
-	    	    /* first name output is the new one */
-		    set_value(child, &a);
-		}
-		else
-		{
-	    	    /* second name output is the new one */
-		    strtok(0, "\"");    /* skip the space */
-		    set_value(find_child(mn, strtok(0, "\"")), &a);
-		}
+		set_value(child, &a);
 	    }
     	    done = TRUE;
 	    break;
@@ -764,7 +781,7 @@ show_radio(cml_node *mn)
     }
     while (!done);
     
-    strvec_free(&menu);
+    rows_free(page.rows, page.nrows);
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
@@ -841,7 +858,7 @@ build_menustring(cml_node *mn)
 
 	break;
     case MN_MENU:
-    	if (cml_node_get_children(mn) == 0)
+    	if (cml_node_get_num_children(mn) == 0)
 	{
 	    /* banner */
 	    menustring = g_strdup_printf("--- %s", banner);
@@ -982,7 +999,7 @@ handle_event(cml_node *mn, char event)
 
 	break;
     case MN_MENU:
-    	if (cml_node_get_children(mn) == 0)
+    	if (cml_node_get_num_children(mn) == 0)
 	{
 	    /* banner */
 	}
@@ -1006,171 +1023,233 @@ handle_event(cml_node *mn, char event)
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
+/*
+ * (Re)build the rows for the visible children of a menu, keeping
+ * the cursor on the same row if it's still there.
+ */
 static void
-show_menu(cml_node *mn)
+menu_page_list(menu_page *page, dialog_list *dl)
 {
-    GList *list;
-    strvec_t menu;
-    char *retstr;
-    int retcode;
-    cml_node *selected = 0;
-    static char retcode2key[] = {
-	'\n', /* 0: `Select' button */
-	'q',  /* 1: `Exit' button */
-	'?',  /* 2: `Help' button */
-	'y',  /* 3: `y' key */
-	'n',  /* 4: `n' key */
-	'm',  /* 5: `m' key */
-	' ',  /* 6: ` ' key (toggle) */
-    };
-
-    strvec_init(&menu);
-    strvec_preallocate(&menu, g_list_length(cml_node_get_children(mn)));
+    const GList *list;
+    menu_row *row, *oldrows = page->rows;
+    int i, oldnrows = page->nrows;
+    cml_node *curnode = 0;
+    const char *curcommand = 0;
+    int n;
     
-    for (;;)
+    if (dl->current >= 0 && dl->current < oldnrows)
     {
-	strvec_truncate(&menu);
-	for (list = cml_node_get_children(mn) ; list != 0 ; list = list->next)
-	{
-	    char *menustring;
-    	    cml_node *child = (cml_node *)list->data;
-
-	    if (!cml_node_is_visible(child))
-		continue;
-
-	    if ((menustring = build_menustring(child)) == 0)
-	    	continue;
+    	curnode = oldrows[dl->current].node;
+    	curcommand = oldrows[dl->current].command;
+    }
+    
+    list = cml_node_get_visible_children(page->menu);
+    n = g_list_length((GList *)list);
+    if (page->menu == cml_rulebase_get_start(rb))
+    	n += 4;
+    page->rows = row = rows_new(n);
+    page->nrows = 0;
+    page->relist = FALSE;
+    
+    for ( ; list != 0 ; list = list->next)
+    {
+    	cml_node *child = (cml_node *)list->data;
 
-    	    strvec_append(&menu, cml_node_get_name(child));
-    	    strvec_appendm(&menu, menustring);
-	}
-	
-	if (mn == cml_rulebase_get_start(rb))
+	switch (cml_node_get_treetype(child))
 	{
-	    /* root menu bletchery */
-	    strvec_append(&menu, "#sep");
-	    strvec_append(&menu, "--- ");
-
-	    strvec_append(&menu, "#load");
-	    strvec_append(&menu, "Load an Alternate Configuration File");
-
-	    strvec_append(&menu, "#saveas");
-	    strvec_append(&menu, "Save Configuration to an Alternate File");
-
+	case MN_SYMBOL:
+	case MN_MENU:
+	    break;
+	default:
+	    continue;	/* build_menustring() has nothing to say */
+	}
+	row->node = child;
+	row->dirty = TRUE;
+	cml_node_set_user_data(child, row);
+	row++;
+	page->nrows++;
+    }
+    
+    if (page->menu == cml_rulebase_get_start(rb))
+    {
+	/* root menu bletchery */
+	static const char *commands[] = {
+	    "#sep", "--- ",
+	    "#load", "Load an Alternate Configuration File",
+	    "#saveas", "Save Configuration to an Alternate File",
 #if TESTSCRIPT
-	    strvec_append(&menu, "#runtest");
-	    strvec_append(&menu, "Run Test Script");
+	    "#runtest", "Run Test Script",
 #endif
+	    0
+	};
+
+	for (i = 0 ; commands[i] != 0 ; i += 2, row++)
+	{
+	    row->command = commands[i];
+	    row->text = g_strdup(commands[i+1]);
+	    row->dirty = TRUE;	/* just to get it drawn */
+	    page->nrows++;
 	}
-	
-	if (menu.nitems == 0)
-	    break;  	/* empty menu */
+    }
+    
+    rows_free(oldrows, oldnrows);
 
-	capture_begin();
-	retcode = dialog_menu(
-    	    cml_node_get_banner(mn),    	/*title*/
-	    menu_instructions,  	    	/*prompt*/
-	    height, width, menu_height,	    	/* height, width, menu_height */
-	    (selected == 0 ? "" : cml_node_get_name(selected)),/* default */
-	    menu.nitems/2, (const char * const *)menu.items); /* item_no, items */
-	retstr = capture_end();
+    for (i = 0 ; i < page->nrows ; i++)
+    {
+    	if ((curnode != 0 && page->rows[i].node == curnode) ||
+	    (curcommand != 0 && page->rows[i].command == curcommand))
+	    break;
+    }
+    if (i == page->nrows)
+    	i = MIN(MAX(dl->current, 0), page->nrows-1);
+    dl->current = i;
+    dl->item_no = page->nrows;
+}
 
-    	DEBUG_RET();
+static const char *
+menu_text(dialog_list *dl, int item)
+{
+    menu_page *page = (menu_page *)dl->data;
+    menu_row *row = &page->rows[item];
 
-    	if (retcode == -1/* ESC key */ || retcode == 1/* `Exit' button */)
-	    break;
-	    
-    	if (retstr[0] == '#')
-	    handle_command_event(retstr, retcode2key[retcode]);
-	else
+    if (row->dirty)
+    {
+    	row->dirty = FALSE;
+	if (row->node != 0)
 	{
-    	    selected = find_child(mn, trim(retstr));
-	    handle_event(selected, retcode2key[retcode]);
+	    if (row->text != 0)
+		g_free(row->text);
+	    row->text = build_menustring(row->node);
 	}
     }
-    
-    strvec_free(&menu);
+    return row->text;
+}
+
+static int
+menu_changed(dialog_list *dl, int item)
+{
+    menu_page *page = (menu_page *)dl->data;
+
+    return page->rows[item].dirty;
 }
 
-/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 /*
- * Initialise the godawful hack required to get output from
- * lxdialog, which comes out on stderr.  No, really.
+ * Called by lxdialog for y, n, m and space.  Boolean and tristate
+ * values are changed without closing the menu; anything else closes
+ * it so that show_menu() can open a submenu or dialog.
  */
- 
-static int cap_fd;
-static FILE *cap_real_stderr, *cap_fake_stderr;
-static char cap_buf[4096/*TODO*/];
-
 static int
-set_nonblocking(int fd)
+menu_key(dialog_list *dl, int key)
 {
-    int flags;
+    menu_page *page = (menu_page *)dl->data;
+    cml_node *mn = page->rows[dl->current].node;
+
+    if (key == 's')
+    	key = 'y';
+    if (mn == 0 ||
+    	cml_node_get_treetype(mn) != MN_SYMBOL ||
+    	(cml_node_get_value_type(mn) != A_BOOLEAN &&
+	 cml_node_get_value_type(mn) != A_TRISTATE))
+	return (key == ' ' ? DIALOG_KEY_CLOSE : DIALOG_KEY_ROWS);
+
+    overdrawn = FALSE;
+    handle_event(mn, key);
+    if (page->relist)
+    	menu_page_list(page, dl);
     
-    if ((flags = fcntl(fd, F_GETFL)) < 0)
-    	return -1;
-    if (fcntl(fd, F_SETFL, (long)(flags | O_NONBLOCK)) < 0)
-    	return -1;
-    return 0;
+    return (overdrawn ? DIALOG_KEY_ALL : DIALOG_KEY_ROWS);
 }
 
+/*
+ * Called by libcml after each commit for each node which changed.
+ */
 static void
-capture_init(void)
+node_changed(cml_rulebase *rb, cml_node *mn, unsigned int changed, void *ud)
 {
-#define PIPEREAD  0
-#define PIPEWRITE 1
-    int pipefds[2];
-    
-    if (pipe(pipefds) < 0)
-    {
-    	perror("pipe");
-	exit(1);
-    }
+    menu_row *row;
+    menu_page *page;
     
-    cap_fd = pipefds[PIPEREAD];
-    if (set_nonblocking(cap_fd) < 0)
+    if ((row = (menu_row *)cml_node_get_user_data(mn)) != 0)
+	row->dirty = TRUE;
+
+    if ((changed & CML_CHANGED_VISIBLE))
     {
-    	perror("nonblocking");
-	exit(1);
+    	cml_node *parent = cml_node_get_parent(mn);
+
+	for (page = top_page ; page != 0 ; page = page->parent)
+	{
+	    if (page->menu == parent)
+	    	page->relist = TRUE;
+	}
     }
-    
-    
-    cap_fake_stderr = fdopen(pipefds[PIPEWRITE], "w");
-#undef PIPEREAD
-#undef PIPEWRITE
 }
 
 static void
-capture_begin(void)
+show_menu(cml_node *mn)
 {
-    cap_real_stderr = stderr;
-    stderr = cap_fake_stderr;
-}
+    menu_page page;
+    dialog_list dl;
+    menu_row *row;
+    int retcode;
+    static char retcode2key[] = {
+	'\n', /* 0: `Select' button */
+	'q',  /* 1: `Exit' button */
+	'?',  /* 2: `Help' button */
+	'y',  /* 3: `y' key */
+	'n',  /* 4: `n' key */
+	'm',  /* 5: `m' key */
+	' ',  /* 6: ` ' key (toggle) */
+    };
 
-static char *
-capture_end(void)
-{
-    int n;
-    char *p;
+    memset(&page, 0, sizeof(page));
+    page.menu = mn;
+    page.parent = top_page;
+    page.relist = TRUE;
+    top_page = &page;
     
-    fflush(stderr);
-    stderr = cap_real_stderr;
-    n = read(cap_fd, cap_buf, sizeof(cap_buf)-1);
-    if (n < 0)
+    memset(&dl, 0, sizeof(dl));
+    dl.text = menu_text;
+    dl.key = menu_key;
+    dl.changed = menu_changed;
+    dl.data = &page;
+    
+    for (;;)
     {
-    	if (errno == EWOULDBLOCK)
-	    return 0;
-    	fprintf(stderr, "Godammit, lxdialog output failed\n");
-    	exit(1);
+    	if (page.relist)
+	    menu_page_list(&page, &dl);
+	
+	if (page.nrows == 0)
+	    break;  	/* empty menu */
+
+	retcode = dialog_menu(
+    	    cml_node_get_banner(mn),    	/*title*/
+	    menu_instructions,  	    	/*prompt*/
+	    height, width, menu_height,	    	/* height, width, menu_height */
+	    &dl);
+
+    	DEBUG_RET();
+
+    	if (retcode == -1/* ESC key */ || retcode == 1/* `Exit' button */)
+	    break;
+	    
+	row = &page.rows[dl.current];
+    	if (row->node == 0)
+	    handle_command_event(row->command, retcode2key[retcode]);
+	else
+	    handle_event(row->node, retcode2key[retcode]);
     }
-    cap_buf[n] = '\0';
-    if ((p = strrchr(cap_buf, '\r')) != 0)
-    	*p = '\0';
-    if ((p = strrchr(cap_buf, '\n')) != 0)
-    	*p = '\0';
-    return cap_buf;
+    
+    top_page = page.parent;
+    rows_free(page.rows, page.nrows);
 }
 
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+#if TESTSCRIPT
+/*
+ * Send stderr to a temporary file, for the test script's output.
+ */
+ 
+static FILE *cap_real_stderr;
 
 static void
 capture_to_file(const char *which, char **filenamep)
@@ -1186,6 +1265,7 @@ capture_to_file_end(void)
     stderr = cap_real_stderr;
 }
 
+#endif
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 static void
@@ -1199,12 +1279,13 @@ ui_run(void)
      */    
     backtitle = cml_rulebase_get_banner(rb);
     init_dialog();
-    capture_init();
+    cml_rulebase_set_change_func(rb, node_changed, 0);
     
     /*
      * Show the root menu
      */
     show_menu(cml_rulebase_get_start(rb));
+    cml_rulebase_set_change_func(rb, 0, 0);
     
     /*
      * Deal with saving any changes.
@@ -1259,7 +1340,7 @@ ui_run(void)
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 static const char usage_str[] = 
-"Usage: %s [--arch arch] [rules-file [defconfig-file]]\n"
+"Usage: %s [--arch arch] [--stats] [rules-file [defconfig-file]]\n"
 ;
 
 static void
@@ -1311,6 +1392,10 @@ parse_args(int argc, char **argv)
     		    usagef(1, "Expecting argument for --arch\n");
 	    	arch = argv[i];
 	    }
+	    else if (!strcmp(argv[i], "--stats"))
+	    {
+	    	stats_flag = TRUE;
+	    }
 	    else
 	    	usagef(1, "Unknown option \"%s\"", argv[i]);
 	}
@@ -1362,6 +1447,8 @@ main(int argc, char **argv)
 
     ui_run();
     
+    if (stats_flag)
+    	cml_rulebase_print_stats(rb, stderr);
     return 0;
 }
 
@@ -28,6 +28,13 @@ static char *arch = "i386";
 static char *rulebase_filename = "rules.cml";
 static char *defconfig_filename = ".config";
 static gboolean freeze_flag = TRUE;
+static gboolean stats_flag = FALSE;
+static const char *timings_format = 0;
+static int profile_count = 0;
+static char *trace_filename = 0;
+static gboolean olddefconfig_flag = FALSE;
+static char *answers_filename = 0;
+static GList *defconfig_filenames = 0;
 
 #define INDENT 4
 
@@ -37,6 +44,52 @@ static gboolean freeze_flag = TRUE;
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
+/*
+ * Print the `n' most expensive rules and derived symbols.
+ */
+static void
+print_profile(cml_rulebase *rb, FILE *fp, int n)
+{
+    GList *profile, *list;
+    
+    profile = cml_rulebase_get_profile(rb);
+    fprintf(fp, "%12s %10s %10s %8s %8s  %s\n",
+    	    "seconds", "evals", "tabled", "broken", "punts", "what");
+    for (list = profile ; list != 0 && n-- > 0 ; list = list->next)
+    {
+    	const cml_profile_entry *pe = (const cml_profile_entry *)list->data;
+	
+	fprintf(fp, "%12.6f %10lu %10lu %8lu %8lu  %s:%d: ",
+	    	pe->seconds, pe->evaluations, pe->tabled, pe->broken, pe->punts,
+		pe->location.filename, pe->location.lineno);
+	if (pe->symbol != 0)
+	    fprintf(fp, "derived %s\n", pe->symbol);
+	else
+	    fprintf(fp, "rule %lu\n", pe->uniqueid);
+    }
+    g_list_free(profile);
+}
+
+
+/*
+ * Print whichever reports were asked for on the command line.
+ */
+static gboolean
+print_reports(cml_rulebase *rb)
+{
+    if (stats_flag)
+    	cml_rulebase_print_stats(rb, stderr);
+    if (timings_format != 0)
+    	cml_rulebase_print_timings(rb, stderr, timings_format);
+    if (profile_count > 0)
+    	print_profile(rb, stderr, profile_count);
+    if (trace_filename != 0 && !cml_rulebase_save_trace(rb, trace_filename))
+    	return FALSE;
+    return TRUE;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
 int
 gcml_random(int minv, int maxv)
 {
@@ -304,6 +357,7 @@ get_value(cml_rulebase *rb, cml_node *mn, gboolean islong)
     if (fgets(buf, sizeof(buf), stdin) == 0)
     {
     	fprintf(stderr, "\n%s: quitting\n", argv0);
+	print_reports(rb);
 	exit(0);
     }
     if ((p = strrchr(buf, '\n')) != 0)
@@ -372,6 +426,8 @@ static cml_visit_result
 query_visitor(cml_rulebase *rb, cml_node *mn, int depth, void *user_data)
 {
     int i;
+    cml_node_iter kids;
+    cml_node *child;
     cml_atom a;
     const cml_atom *ap;
     const GList *list;
@@ -447,14 +503,15 @@ query_visitor(cml_rulebase *rb, cml_node *mn, int depth, void *user_data)
 	}
     	break;
     case MN_MENU:
-    	if (cml_node_get_children(mn) == 0)
+    	if (cml_node_get_num_children(mn) == 0)
 	    hasval = FALSE;
 	else if (cml_node_is_radio(mn))
 	{
+	    ap = cml_node_get_value(mn);
 	    res = CML_SKIP;
-	    for (list = cml_node_get_children(mn) ; list != 0 ; list = list->next)
+	    cml_node_iter_children(&kids, mn);
+	    while ((child = cml_node_iter_next(&kids)) != 0)
 	    {
-	    	cml_node *child = (cml_node *)list->data;
 		a.type = ap->type;
 		a.value.node = child;
 		ch = choice_add(cml_node_get_banner(child), &a);
@@ -463,7 +520,12 @@ query_visitor(cml_rulebase *rb, cml_node *mn, int depth, void *user_data)
 	    }
 	}
 	else
+	{
 	    hasval = FALSE;
+	    /* don't visit every child just to find them all invisible */
+	    if (cml_node_get_visible_children(mn) == 0)
+	    	res = CML_SKIP;
+	}
 	break;
     default:
 	break;
@@ -521,10 +583,102 @@ query_visitor(cml_rulebase *rb, cml_node *mn, int depth, void *user_data)
 }
 
 #endif /* NORMAL */
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*
+ * Batch mode, like the kernel's `make olddefconfig'.  Each .config
+ * is loaded, any symbol it doesn't mention is given its answer from
+ * the answers file or else left at its default, and the result is
+ * saved over it.  The rulebase is parsed only once for all of them.
+ */
+
+/*
+ * Commit, and complain unless that worked and left no rule broken.
+ */
+static gboolean
+commit_cleanly(cml_rulebase *rb, const char *filename)
+{
+    GList *list;
+    gboolean ok;
+    
+    ok = cml_rulebase_commit(rb, /*freeze*/FALSE);
+    list = cml_rulebase_get_broken_rules(rb);
+    if (ok && list == 0)
+    	return TRUE;
+
+    fprintf(stderr, "%s: not updating \"%s\"", argv0, filename);
+    if (list != 0)
+	fprintf(stderr, ", %d broken rules:", g_list_length(list));
+    fputc('\n', stderr);
+    while (list != 0)
+    {
+	cml_rule *rule = (cml_rule *)list->data;
+	char *explanation = cml_rule_get_explanation(rule);
+	fprintf(stderr, "    %s\n", explanation);
+	g_free(explanation);
+	list = g_list_remove_link(list, list);
+    }
+    return FALSE;
+}
+
+static gboolean
+olddefconfig_one(cml_rulebase *rb, const char *filename)
+{
+    cml_rulebase_clear(rb);
+    
+    if (!cml_rulebase_load_defconfig(rb, filename))
+    {
+    	fprintf(stderr, "%s: failed to load defconfig \"%s\"\n",
+	    	    argv0, filename);
+	return FALSE;
+    }
+    if (answers_filename != 0)
+    {
+    	int n = cml_rulebase_load_answers(rb, answers_filename);
+	
+	if (n < 0)
+	{
+	    cml_rulebase_abort(rb);
+	    return FALSE;
+	}
+	DDPRINTF2(DEBUG_GUI, "%s: %d answers used\n", filename, n);
+    }
+    if (!commit_cleanly(rb, filename))
+	return FALSE;
+    
+    if (!cml_rulebase_save_defconfig(rb, filename))
+    {
+    	fprintf(stderr, "%s: failed to save defconfig \"%s\"\n",
+	    	    argv0, filename);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Returns the number of .config files which couldn't be updated.
+ */
+static int
+olddefconfig(cml_rulebase *rb)
+{
+    GList *list;
+    int nfailed = 0;
+    
+    for (list = defconfig_filenames ; list != 0 ; list = list->next)
+    {
+    	if (!olddefconfig_one(rb, (const char *)list->data))
+	    nfailed++;
+    }
+    return nfailed;
+}
+
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 static const char usage_str[] = 
-"Usage: %s [--arch arch] [rules-file [defconfig-file]]\n"
+"Usage: %s [--arch arch] [--stats] [--timings[=json|tsv]] [--profile[=n]]\n"
+"    [--trace file] [rules-file [defconfig-file]]\n"
+"   or: %s --olddefconfig [--answers file] [--arch arch] [--stats]\n"
+"    [--timings[=json|tsv]] [--profile[=n]] [--trace file]\n"
+"    rules-file defconfig-file...\n"
 ;
 
 static void
@@ -541,7 +695,7 @@ usagef(int ec, const char *fmt, ...)
 	va_end(args);
     }
     
-    fprintf(stderr, usage_str, argv0);
+    fprintf(stderr, usage_str, argv0, argv0);
 
     fflush(stderr); /* JIC */
     
@@ -576,6 +730,45 @@ parse_args(int argc, char **argv)
     		    usagef(1, "Expecting argument for --arch\n");
 	    	arch = argv[i];
 	    }
+	    else if (!strcmp(argv[i], "--stats"))
+	    {
+	    	stats_flag = TRUE;
+	    }
+	    else if (!strcmp(argv[i], "--timings"))
+	    {
+	    	timings_format = "json";
+	    }
+	    else if (!strcmp(argv[i], "--trace"))
+	    {
+		if (++i == argc)
+    		    usagef(1, "Expecting argument for --trace\n");
+	    	trace_filename = argv[i];
+	    }
+	    else if (!strcmp(argv[i], "--profile"))
+	    {
+	    	profile_count = 20;
+	    }
+	    else if (!strncmp(argv[i], "--profile=", 10))
+	    {
+	    	if ((profile_count = atoi(argv[i]+10)) <= 0)
+    		    usagef(1, "Expecting a positive number for --profile\n");
+	    }
+	    else if (!strcmp(argv[i], "--olddefconfig"))
+	    {
+	    	olddefconfig_flag = TRUE;
+	    }
+	    else if (!strcmp(argv[i], "--answers"))
+	    {
+		if (++i == argc)
+    		    usagef(1, "Expecting argument for --answers\n");
+	    	answers_filename = argv[i];
+	    }
+	    else if (!strncmp(argv[i], "--timings=", 10))
+	    {
+	    	timings_format = argv[i]+10;
+		if (strcmp(timings_format, "json") && strcmp(timings_format, "tsv"))
+    		    usagef(1, "Expecting json or tsv for --timings\n");
+	    }
 	    else
 	    	usagef(1, "Unknown option \"%s\"", argv[i]);
 	}
@@ -588,13 +781,22 @@ parse_args(int argc, char **argv)
 		break;
 	    case 2:
 	    	defconfig_filename = argv[i];
+	    	defconfig_filenames = g_list_append(defconfig_filenames, argv[i]);
 		break;
 	    default:
-	    	usagef(1, "too many filenames at \"%s\"", argv[i]);
+	    	defconfig_filenames = g_list_append(defconfig_filenames, argv[i]);
 		break;
 	    }
 	}
     }
+    
+    if (nfiles > 2 && !olddefconfig_flag)
+    	usagef(1, "too many filenames at \"%s\"",
+	    	(char *)g_list_nth_data(defconfig_filenames, 1));
+    if (answers_filename != 0 && !olddefconfig_flag)
+    	usagef(1, "--answers only makes sense with --olddefconfig");
+    if (defconfig_filenames == 0)
+    	defconfig_filenames = g_list_append(0, defconfig_filename);
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
@@ -609,6 +811,12 @@ main(int argc, char **argv)
     
     rb = cml_rulebase_new();
     cml_rulebase_set_arch(rb, arch);
+    if (timings_format != 0)
+    	cml_rulebase_enable_timings(rb);
+    if (profile_count > 0)
+    	cml_rulebase_enable_profile(rb);
+    if (trace_filename != 0)
+    	cml_rulebase_enable_trace(rb);
     if (!cml_rulebase_parse(rb, rulebase_filename))
     {
     	fprintf(stderr, "%s: failed to load rulebase \"%s\"\n",
@@ -616,6 +824,15 @@ main(int argc, char **argv)
 	exit(1);
     }
     
+    if (olddefconfig_flag)
+    {
+    	int nfailed = olddefconfig(rb);
+	
+	if (!print_reports(rb) || nfailed > 0)
+	    exit(1);
+	return 0;
+    }
+    
     if (!cml_rulebase_load_defconfig(rb, defconfig_filename))
     {
     	fprintf(stderr, "%s: failed to load defconfig \"%s\"\n",
@@ -650,6 +867,8 @@ main(int argc, char **argv)
     }
 #endif
     
+    if (!print_reports(rb))
+    	exit(1);
     return 0;
 }
 
@@ -62,7 +62,8 @@ on_choice_combo_changed(GtkWidget *w, void *ud)
 static void
 choice_build_value(node_gui_t *ng)
 {
-    GList *list;
+    cml_node_iter kids;
+    cml_node *child;
     GtkWidget *listw;
     GtkWidget *selitem = 0;
     cml_node *selchild = cml_node_get_value(ng->node)->value.node;
@@ -79,9 +80,9 @@ choice_build_value(node_gui_t *ng)
     listw = GTK_COMBO(ng->combo)->list;
     
     gtk_list_clear_items(GTK_LIST(listw), 0, -1);
-    for (list = cml_node_get_children(ng->node) ; list != 0 ; list = list->next)
+    cml_node_iter_children(&kids, ng->node);
+    while ((child = cml_node_iter_next(&kids)) != 0)
     {
-	cml_node *child = (cml_node *)list->data;
 	GtkWidget *item = gtk_list_item_new_with_label(cml_node_get_banner(child));
 	gtk_object_set_user_data(GTK_OBJECT(item), (gpointer)child);
 	gtk_widget_show(item);
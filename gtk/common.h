@@ -41,7 +41,6 @@ void grey_items(void);
 void set_value(cml_node *mn, const cml_atom *valp);
 GladeXML *load_widget_tree(const char *root);
 int gcml_random(int minv, int maxv);
-void push_page(cml_node *mn);
 #if PROFILE
 void profile_exercise(void);
 void time_mark(void);
@@ -53,6 +52,17 @@ void logwin_init(gboolean stderr_flag);
 void logwin_insertv(const char **strp);
 void logwin_insert(const char *str);
 void logwin_show(void);
+char *logwin_format(cml_severity sev, const cml_location *loc,
+    	    	    const char *fmt, va_list args);
+void logwin_attach(void);
+
+/* worker.c */
+typedef gboolean (*worker_func)(void *user_data);
+typedef void (*worker_done_func)(gboolean result, gboolean cancelled,
+    	    	    	    	 void *user_data);
+void worker_run(const char *title, worker_func func,
+    	    	worker_done_func done, void *user_data);
+gboolean worker_is_busy(void);
 
 /* brokenwin.c */
 void brokenwin_init(void);
@@ -149,13 +149,13 @@ dependency_dump_visitor(
     int depth,
     void *user_data)
 {
-    GList *iter;
+    cml_adj_iter iter;
+    cml_node *dep;
 
     fprintf(stderr, "%s:", cml_node_get_name(mn));
-    for (iter = mn->dependees ; iter != 0 ; iter = iter->next)
+    mn_adj_iter_init(&iter, mn, MN_ADJ_DEPENDEES);
+    while ((dep = (cml_node *)mn_adj_iter_next(&iter)) != 0)
     {
-    	cml_node *dep = (cml_node *)iter->data;
-	
     	fprintf(stderr, " %s", cml_node_get_name(dep));
     }
     fprintf(stderr, "\n");
@@ -206,21 +206,6 @@ on_debug_run_test_activate(GtkWidget *w, void *ud)
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 #if PROFILE
 
-static GtkWidget *
-gtk_0th_child(GtkWidget *con)
-{
-    GList *list;
-    GtkWidget *kid0;
-    
-    list = gtk_container_children(GTK_CONTAINER(con));
-    if (list == 0)
-    	return 0;
-    kid0 = (GtkWidget *)list->data;
-    while (list != 0)
-    	list = g_list_remove_link(list, list);
-    return kid0;
-}
-
 static void
 gtk_flush(void)
 {
@@ -236,50 +221,30 @@ gtk_flush(void)
 static void
 profile_visit_page(node_gui_t *pageng)
 {
-    node_gui_t **items;
-    GtkWidget *table;
-    GList *list;
+    GtkCList *clist = GTK_CLIST(pageng->clist);
     int row;
     
-    table = gtk_0th_child(gtk_0th_child(pageng->child_page));
-    
     /*
-     * Build a lookup table of node_gui's indexed by row.
+     * Iterate over all rows.  Changing a value may add or remove
+     * rows further down, so re-read the row count each time.
      */
-    items = g_new(node_gui_t*, GTK_TABLE(table)->nrows);
-    memset(items, 0, sizeof(node_gui_t*) * GTK_TABLE(table)->nrows);
-    for (list = GTK_TABLE(table)->children ; list != 0 ; list = list->next)
+    for (row = 0 ; row < clist->rows ; row++)
     {
-    	GtkTableChild *tc = (GtkTableChild *)list->data;
-	
-	if (tc->left_attach == LABEL)
-	    items[tc->top_attach] = node_gui_from_widget(tc->widget);
-    }
-    
-    /*
-     * Iterate over all items.
-     */
-    for (row = 0 ; row < GTK_TABLE(table)->nrows ; row++)
-    {
-    	node_gui_t *ng = items[row];
+    	cml_node *mn = (cml_node *)gtk_clist_get_row_data(clist, row);
+    	node_gui_t *ng = (node_gui_t *)cml_node_get_user_data(mn);
 	
     	assert(ng != 0);
-	
-	if (!GTK_WIDGET_VISIBLE(ng->colwidgets[LABEL]))
-    	    continue;
 
-	if (ng->colwidgets[ARROW] != 0)
+	if (node_gui_has_submenu(ng))
 	{
-	    if (GTK_WIDGET_VISIBLE(ng->colwidgets[ARROW]))
-	    {
 #if DEBUG > 5
-		fprintf(stderr, "Visiting complex %s\n",
-	    	    	    cml_node_get_name(ng->node));
+	    fprintf(stderr, "Visiting complex %s\n",
+	    	    	cml_node_get_name(ng->node));
 #endif
-		push_page(ng->node);
-		gtk_flush();
-	    	profile_visit_page(ng);
-    	    }
+	    page_gui_push(ng->node);
+	    grey_items();
+	    gtk_flush();
+	    profile_visit_page(ng);
 	}
 	else
 	{
@@ -287,7 +252,10 @@ profile_visit_page(node_gui_t *pageng)
 	    fprintf(stderr, "Visiting simple %s\n",
 	    	    	cml_node_get_name(ng->node));
 #endif
-	    if (ng->ops->simulate != 0)
+	    /* selecting the row builds its value widgets */
+	    gtk_clist_select_row(clist, row, 0);
+	    gtk_flush();
+	    if (ng->ops->simulate != 0 && ng->colwidgets[LABEL] != 0)
 	    {
     		(*ng->ops->simulate)(ng);
     	    	gtk_flush();
@@ -300,13 +268,17 @@ profile_visit_page(node_gui_t *pageng)
      * Go back up the page stack
      */
     if (cml_node_get_parent(pageng->node) != 0)
-    	push_page(cml_node_get_parent(pageng->node));
+    {
+    	page_gui_push(cml_node_get_parent(pageng->node));
+	grey_items();
+    }
 }
 
 void
 profile_exercise(void)
 {
-    profile_visit_page(node_gui_get_current());
+    profile_visit_page(
+    	(node_gui_t *)cml_node_get_user_data(page_gui_get_current()));
     
     time_mark();
     cml_rulebase_save_defconfig(rb, "profile.config");
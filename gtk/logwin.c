@@ -32,14 +32,18 @@ static const char *severity_strings[_CML_MAX_SEVERITY] =
 "info: ", "warning: ", "error: "
 };
 
-static void
-logwin_error_func(
+/*
+ * Format a libcml message as the log window shows it.  Safe to
+ * call from the worker thread, unlike the rest of this file.
+ */
+char *
+logwin_format(
     cml_severity sev,
     const cml_location *loc,
     const char *fmt,
     va_list args)
 {
-    char *msg;
+    char *msg, *all;
     const char *txt[16];
     char linenobuf[32];
     int i = 0;
@@ -63,10 +67,34 @@ logwin_error_func(
     txt[i++] = "\n";
     txt[i] = 0;
 
-    logwin_insertv(txt);
+    all = g_strjoinv("", (char **)txt);
         
     if (msg != 0)
 	g_free(msg);
+    return all;
+}
+
+static void
+logwin_error_func(
+    cml_severity sev,
+    const cml_location *loc,
+    const char *fmt,
+    va_list args)
+{
+    char *msg = logwin_format(sev, loc, fmt, args);
+    
+    logwin_insert(msg);
+    g_free(msg);
+}
+
+/*
+ * Send libcml's messages to the log window again,
+ * after the worker has been borrowing them.
+ */
+void
+logwin_attach(void)
+{
+    cml_set_error_func(logwin_error_func);
 }
 
 void
@@ -80,7 +108,7 @@ logwin_init(gboolean stderr_flag)
     logwin_window = glade_xml_get_widget(xml, "log");
     logwin_text = glade_xml_get_widget(xml, "log_text");
 
-    cml_set_error_func(logwin_error_func);
+    logwin_attach();
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
@@ -41,6 +41,8 @@ static const char *rulebase_filename;
 static const char *arch = "i386";
 static const char *defconfig_filename;
 static gboolean changed = FALSE;
+static gboolean checking = FALSE;
+static gboolean broken_changed = FALSE;
 static GtkWidget *edit_undo;
 static GtkWidget *edit_redo;
 static GtkWidget *edit_freeze_changes;
@@ -53,13 +55,16 @@ static WidgetSet widgets_up;
 static WidgetSet widgets_down;
 static WidgetSet widgets_save;
 static WidgetSet widgets_save_as;
+static WidgetSet widgets_checked;
 static GtkWidget *load_window;
 static GtkWidget *save_as_window;
 static GtkWidget *save_query_window;
+static GtkWidget *load_query_window;
 static GtkWidget *about_window;
 static GtkWidget *licence_window;
 static gboolean stderr_flag = FALSE;
 static gboolean freeze_changes_flag = TRUE;
+static gboolean quit_after_save = FALSE;
 static char *argv0;
 
 
@@ -154,25 +159,110 @@ grey_items(void)
     widgetset_set_sensitive(&widgets_down, (curr != leafmost));
     widgetset_set_sensitive(&widgets_save, changed && (defconfig_filename != 0));
     widgetset_set_sensitive(&widgets_save_as, changed);
+    widgetset_set_sensitive(&widgets_checked, !checking);
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
+/*
+ * Called back by libcml for each node which changed as a result
+ * of a commit, undo or redo, so that only their rows and widgets
+ * need to be refreshed rather than every row on the current page.
+ */
 static void
-do_load(void)
+node_changed(cml_rulebase *rb, cml_node *mn, unsigned int what, void *user_data)
 {
-    cml_rulebase_clear(rb);
-    if (!cml_rulebase_load_defconfig(rb, defconfig_filename))
+    node_gui_t *ng = (node_gui_t *)cml_node_get_user_data(mn);
+    cml_node *parent = cml_node_get_parent(mn);
+    node_gui_t *parentng = (parent == 0 ? 0 :
+    	    	    	    (node_gui_t *)cml_node_get_user_data(parent));
+
+    if (what & CML_CHANGED_BROKEN)
+    	broken_changed = TRUE;
+
+    /*
+     * Pages only make a node_gui for the children they show, so a
+     * node which just became visible on an existing page needs one
+     * before it can get a row there.
+     */
+    if (ng == 0 && (what & CML_CHANGED_VISIBLE) &&
+    	parentng != 0 && parentng->clist != 0)
+    	ng = node_gui_new(mn);
+    if (ng != 0)
+    	node_gui_update(ng);
+
+    /* the parent's arrow depends on it having visible children */
+    if ((what & CML_CHANGED_VISIBLE) && parentng != 0)
+    	node_gui_update(parentng);
+}
+
+/*
+ * Finish what node_changed() started, once per batch of
+ * changes rather than once per changed node.
+ */
+static void
+update_changed(void)
+{
+    page_gui_flush();
+    if (broken_changed)
+    {
+	brokenwin_update(rb);
+	broken_changed = FALSE;
+    }
+}
+
+/*
+ * Parsing, loading and saving run on the worker thread,
+ * see worker.c.  These are the functions it runs.
+ */
+static gboolean
+parse_job(void *user_data)
+{
+    return cml_rulebase_parse(rb, rulebase_filename);
+}
+
+static gboolean
+load_job(void *user_data)
+{
+    return cml_rulebase_load_defconfig(rb, defconfig_filename);
+}
+
+static gboolean
+save_job(void *user_data)
+{
+    return cml_rulebase_save_defconfig(rb, defconfig_filename);
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static void
+load_done(gboolean result, gboolean cancelled, void *user_data)
+{
+    if (!result)
     {
-    	/* TODO: alert */
-    	fprintf(stderr, "Failed to load defconfig \"%s\"\n",
-	    	    defconfig_filename);
+    	cml_rulebase_abort(rb);
+	if (!cancelled)
+	{
+	    /* TODO: alert */
+    	    fprintf(stderr, "Failed to load defconfig \"%s\"\n",
+	    	    	defconfig_filename);
+	}
+	grey_items();
+	update_changed();
     	return;
     }
     cml_rulebase_commit(rb, /*freeze*/TRUE);
     changed = FALSE;
-    page_gui_update_current();
     grey_items();
+    update_changed();
+}
+
+static void
+do_load(void)
+{
+    cml_rulebase_clear(rb);
+    update_changed();
+    worker_run(_("GCML2: Loading"), load_job, load_done, 0);
 }
 
 GLADE_CALLBACK void
@@ -190,8 +280,8 @@ on_load_cancel_clicked(GtkWidget *w, void *ud)
     gtk_widget_hide(load_window);
 }
 
-GLADE_CALLBACK void
-on_file_load_activate(GtkWidget *w, void *ud)
+static void
+show_load_window(void)
 {
     if (load_window == 0)
     {
@@ -203,14 +293,63 @@ on_file_load_activate(GtkWidget *w, void *ud)
     gtk_widget_show(load_window);
 }
 
+GLADE_CALLBACK void
+on_load_query_load_clicked(GtkWidget *w, void *ud)
+{
+    gtk_widget_hide(load_query_window);
+    show_load_window();
+}
+
+GLADE_CALLBACK void
+on_load_query_cancel_clicked(GtkWidget *w, void *ud)
+{
+    gtk_widget_hide(load_query_window);
+}
+
+/*
+ * A load starts from a cleared rulebase, and even a failed or
+ * cancelled one leaves it that way, so warn before throwing
+ * away unsaved changes.
+ */
+GLADE_CALLBACK void
+on_file_load_activate(GtkWidget *w, void *ud)
+{
+    if (!changed)
+    {
+    	show_load_window();
+    }
+    else
+    {
+	if (load_query_window == 0)
+	{
+	    GladeXML *xml = load_widget_tree("load_query");    
+	    load_query_window = glade_xml_get_widget(xml, "load_query");
+	}
+	gtk_widget_show(load_query_window);
+    }
+}
+
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
+static void do_quit(void);
+
+static void
+save_done(gboolean result, gboolean cancelled, void *user_data)
+{
+    if (result)
+    {
+	changed = FALSE;
+	grey_items();
+	if (quit_after_save)
+	    do_quit();
+    }
+    quit_after_save = FALSE;
+}
+
 static void
 do_actual_save(void)
 {
-    cml_rulebase_save_defconfig(rb, defconfig_filename);
-    changed = FALSE;
-    grey_items();
+    worker_run(_("GCML2: Saving"), save_job, save_done, 0);
 }
 
 GLADE_CALLBACK void
@@ -291,9 +430,11 @@ do_quit(void)
 GLADE_CALLBACK void
 on_save_query_save_clicked(GtkWidget *w, void *ud)
 {
+    /* the save finishes later, and quits if it worked */
+    quit_after_save = TRUE;
     do_save();
-    if (!changed)
-	do_quit();
+    if (!worker_is_busy())
+    	quit_after_save = FALSE;    /* Save As was cancelled */
 }
 
 GLADE_CALLBACK void
@@ -332,16 +473,16 @@ GLADE_CALLBACK void
 on_edit_undo_activate(GtkWidget *w, void *ud)
 {
     cml_rulebase_undo(rb);
-    page_gui_update_current();
     grey_items();
+    update_changed();
 }
 
 GLADE_CALLBACK void
 on_edit_redo_activate(GtkWidget *w, void *ud)
 {
     cml_rulebase_redo(rb);
-    page_gui_update_current();
     grey_items();
+    update_changed();
 }
 
 GLADE_CALLBACK void
@@ -349,8 +490,8 @@ on_edit_freeze_changes_activate(GtkWidget *w, void *ud)
 {
     cml_rulebase_commit(rb, /*freeze*/TRUE);
     changed = TRUE;
-    page_gui_update_current();
     grey_items();
+    update_changed();
 }
 
 GLADE_CALLBACK void
@@ -358,6 +499,7 @@ on_edit_check_all_rules_activate(GtkWidget *w, void *ud)
 {
     cml_rulebase_check_all_rules(rb);
     brokenwin_update(rb);
+    broken_changed = FALSE;
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
@@ -418,12 +560,17 @@ on_help_about_activate(GtkWidget *w, void *ud)
 void
 set_value(cml_node *mn, const cml_atom *valp)
 {
+    if (checking)
+    {
+    	/* not yet, see check_idle(); put the widget back */
+	node_gui_update((node_gui_t *)cml_node_get_user_data(mn));
+    	return;
+    }
     cml_node_set_value(mn, valp);
     cml_rulebase_commit(rb, freeze_changes_flag);
-    page_gui_update_current();
     changed = TRUE;
     grey_items();
-    brokenwin_update(rb);
+    update_changed();
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
@@ -660,40 +807,13 @@ set_icon(void)
 }
 
 
-static gboolean
-delayed_initialise(void *data)
+/*
+ * The last part of initialisation, once the rulebase is
+ * parsed and the defconfig (if any) is loaded.
+ */
+static void
+finish_initialise(void)
 {
-    const char *banner;
-    char *title;
-    
-
-#if PROFILE
-    time_mark();
-#endif /* PROFILE */
-    rb = cml_rulebase_new();
-    cml_rulebase_set_arch(rb, arch);
-    if (!cml_rulebase_parse(rb, rulebase_filename))
-    {
-    	GtkWidget *errorwin;
-	GladeXML *xml;
-	
-	xml = load_widget_tree("rulebase_fail");
-	errorwin = glade_xml_get_widget(xml, "rulebase_fail");
-    	gtk_widget_show(errorwin);
-	return FALSE;   /* stop calling me already */
-    }
-#if PROFILE
-    fprintf(stderr, "Parse took %g sec\n", time_elapsed());
-#endif /* PROFILE */
-    
-    gtk_widget_show(main_window);
-    if (defconfig_filename != 0)
-    {
-	if (cml_rulebase_load_defconfig(rb, defconfig_filename))
-	    cml_rulebase_commit(rb, /*freeze*/TRUE);
-    }
-    
-
     creating = TRUE;
     gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(show_node_name_check),
     	    	    	    	    show_node_name);
@@ -706,24 +826,124 @@ delayed_initialise(void *data)
     gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(show_suppressed_check),
     	    	    	    	    show_suppressed);
 
+    grey_items();
+
+    creating = FALSE;
+    
+#if PROFILE
+    profile_exercise();
+    creating = TRUE;	/* suppress callbacks */
+    gtk_main_quit();
+#endif /* PROFILE */
+}
+
+static void
+initial_load_done(gboolean result, gboolean cancelled, void *user_data)
+{
+    if (result)
+	cml_rulebase_commit(rb, /*freeze*/TRUE);
+    else
+    	cml_rulebase_abort(rb);
+    update_changed();
+    finish_initialise();
+}
+
+static void
+rulebase_failed(void)
+{
+    GtkWidget *errorwin;
+    GladeXML *xml;
+
+    gtk_widget_hide(main_window);
+    xml = load_widget_tree("rulebase_fail");
+    errorwin = glade_xml_get_widget(xml, "rulebase_fail");
+    gtk_widget_show(errorwin);
+}
+
+static void
+check_done(gboolean result)
+{
+    checking = FALSE;
+    grey_items();
+    if (!result)
+    {
+    	rulebase_failed();
+	return;
+    }
+#if PROFILE
+    fprintf(stderr, "Parse took %g sec\n", time_elapsed());
+#endif /* PROFILE */
+
+    /* the load's changes reach the top page through node_changed() */
+    cml_rulebase_set_change_func(rb, node_changed, 0);
+    if (defconfig_filename != 0)
+	worker_run(_("GCML2: Loading"), load_job, initial_load_done, 0);
+    else
+    	finish_initialise();
+}
+
+/*
+ * Checks the rules a piece at a time whenever the main loop is
+ * idle, so the pages can be browsed meanwhile.  This isn't a worker
+ * job because the pages read the graph and visibility caches which
+ * the check rebuilds, and libcml has no locking.  Until it's done
+ * nothing may set values or load, see grey_items() and set_value().
+ */
+static gint
+check_idle(void *data)
+{
+    if (cml_rulebase_finish_parse_step(rb))
+    	return TRUE;	/* call me again */
+    check_done(cml_rulebase_finish_parse(rb));
+    return FALSE;   /* stop calling me already */
+}
+
+/*
+ * The rulebase was parsed progressively, so its menus are complete
+ * but its rules aren't checked yet.  Show the top page now, so the
+ * user can look around while the rules are checked.
+ */
+static void
+parse_done(gboolean result, gboolean cancelled, void *user_data)
+{
+    const char *banner;
+    char *title;
+
+    if (!result)
+    {
+    	rulebase_failed();
+	return;
+    }
+    
     if ((banner = cml_rulebase_get_banner(rb)) == 0)
     	banner = rulebase_filename;
     title = g_strdup_printf(_("GCML2: %s"), banner);
     gtk_window_set_title(GTK_WINDOW(main_window), title);
     g_free(title);
     
+    /* the icon and the page's pixmaps need a realized window */
+    gtk_widget_show(main_window);
     set_icon();
-    
+
+    creating = TRUE;
     page_gui_push(cml_rulebase_get_start(rb));
+    creating = FALSE;
+
+    checking = TRUE;
     grey_items();
+    gtk_idle_add(check_idle, 0);
+}
 
-    creating = FALSE;
-    
+static gboolean
+delayed_initialise(void *data)
+{
 #if PROFILE
-    profile_exercise();
-    creating = TRUE;	/* suppress callbacks */
-    gtk_main_quit();
+    time_mark();
 #endif /* PROFILE */
+    rb = cml_rulebase_new();
+    cml_rulebase_set_arch(rb, arch);
+    cml_rulebase_set_progressive(rb, TRUE);
+    worker_run(_("GCML2: Parsing"), parse_job, parse_done, 0);
 
     return FALSE;   /* stop calling me already */
 }
@@ -760,6 +980,8 @@ ui_create(void)
     widgetset_add(&widgets_save, glade_xml_get_widget(xml, "file_save"));
     widgetset_add(&widgets_save_as, glade_xml_get_widget(xml, "file_save_as"));
     widgetset_add(&widgets_save, glade_xml_get_widget(xml, "tool_save"));
+    widgetset_add(&widgets_checked, glade_xml_get_widget(xml, "file_load"));
+    widgetset_add(&widgets_checked, glade_xml_get_widget(xml, "edit_check_all_rules"));
     edit_undo = glade_xml_get_widget(xml, "edit_undo");
     edit_redo = glade_xml_get_widget(xml, "edit_redo");
     edit_freeze_changes = glade_xml_get_widget(xml, "edit_freeze_changes");
@@ -934,6 +1156,7 @@ parse_args(int argc, char **argv)
 int
 main(int argc, char **argv)
 {
+    g_thread_init(0);	/* libcml runs on the worker thread too */
     ui_init(&argc, &argv);
     parse_args(argc, argv);
     ui_create();
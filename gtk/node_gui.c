@@ -81,7 +81,7 @@ node_gui_classify(cml_node *mn)
 	}
     	break;
     case MN_MENU:
-    	if (cml_node_get_children(mn) == 0)
+    	if (cml_node_get_num_children(mn) == 0)
 	    return &banner_ops;
 	else if (cml_node_is_radio(mn))
 	    return &choice_ops;
@@ -105,6 +105,7 @@ node_gui_new(cml_node *mn)
     memset(ng, 0, sizeof(*ng));
     
     ng->node = mn;
+    ng->page_row = -1;
     cml_node_set_user_data(mn, ng);
     
     ng->ops = node_gui_classify(ng->node);
@@ -241,7 +242,7 @@ node_gui_default_build_arrow(node_gui_t *ng)
     
     button = gtk_button_new();
 
-    if (cml_node_get_children(ng->node) != 0)
+    if (cml_node_get_num_children(ng->node) != 0)
     {
 	if (right_pm == 0)
 	    right_pm = gdk_pixmap_create_from_xpm_d(main_window->window,
@@ -288,7 +289,7 @@ node_gui_build_help(node_gui_t *ng)
     
     button = gtk_button_new();
 
-    if (cml_node_get_help_text(ng->node) != 0)
+    if (cml_node_has_help_text(ng->node))
     {
 	if (help_pm == 0)
 	    help_pm = gdk_pixmap_create_from_xpm_d(main_window->window,
@@ -339,21 +340,39 @@ node_gui_build(node_gui_t *ng, GtkWidget *table, int row)
     g_free(txt);
 }
 
+/*
+ * Destroy the widgets built by node_gui_build(), when
+ * the node's row is no longer selected.
+ */
+void
+node_gui_unbuild(node_gui_t *ng)
+{
+    int i;
+    
+    creating = TRUE;
+    for (i = 0 ; i < NUM_COLUMNS ; i++)
+    {
+    	if (ng->colwidgets[i] != 0)
+	    gtk_widget_destroy(ng->colwidgets[i]);
+	ng->colwidgets[i] = 0;
+    }
+    creating = FALSE;
+    
+    ng->table = 0;
+    ng->label = 0;
+    ng->button = 0;
+    ng->entry = 0;
+    ng->combo = 0;
+    for (i = 0 ; i < 3 ; i++)
+    	ng->toggles[i] = 0;
+}
+
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 static gboolean
 node_has_visible_children(cml_node *mn)
 {
-    const GList *list;
-    
-    for (list = cml_node_get_children(mn) ; list != 0 ; list = list->next)
-    {
-    	cml_node *child = (cml_node *)list->data;
-	
-	if (cml_node_is_visible(child))
-	    return TRUE;
-    }
-    return FALSE;
+    return (cml_node_get_visible_children(mn) != 0);
 }
 
 static void
@@ -366,13 +385,26 @@ gtk_widget_set_visible(GtkWidget *w, gboolean vis)
 }
 
 
-static gboolean
-node_is_visible(node_gui_t *ng)
+gboolean
+node_gui_has_value(node_gui_t *ng)
+{
+    return (ng->ops != &menu_ops && ng->ops != &banner_ops);
+}
+
+gboolean
+node_gui_has_submenu(node_gui_t *ng)
+{
+    return (ng->ops->build_arrow == node_gui_default_build_arrow &&
+    	    node_has_visible_children(ng->node));
+}
+
+gboolean
+node_gui_is_shown(node_gui_t *ng)
 {
     if (!show_suppressed && !cml_node_is_visible(ng->node))
     	return FALSE;
 	
-    if (ng->colwidgets[VALUE] == 0 &&
+    if (!node_gui_has_value(ng) &&
     	!node_has_visible_children(ng->node))
     	return FALSE;
 	
@@ -385,7 +417,11 @@ node_gui_update(node_gui_t *ng)
     int i;
     char *label;
     
-    if (!node_is_visible(ng))
+    page_gui_update_row(ng);
+    if (ng->colwidgets[LABEL] == 0)
+    	return;     /* not selected, so has no widgets */
+    
+    if (!node_gui_is_shown(ng))
     {
     	/* nothing to see here, move along */
 	for (i=0 ; i<NUM_COLUMNS ; i++)
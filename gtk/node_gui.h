@@ -42,6 +42,7 @@ struct node_gui_s
     cml_node *node;
     GtkWidget *table;
     int row;
+    int page_row;   	    /* row on the parent's page, or -1 if none */
     GtkWidget *colwidgets[NUM_COLUMNS];
     GtkWidget *label;	    /* banner, bool, tristate, string, int, hex */
     GtkWidget *button;	    /* menu */
@@ -49,6 +50,9 @@ struct node_gui_s
     GtkWidget *combo;	    /* radio, limited_int or limited_hex */
     GtkWidget *toggles[3];  /* bool, tristate */
     GtkWidget *child_page;  /* menu */
+    GtkWidget *clist;	    /* menu: one row per child shown */
+    GtkWidget *editor;	    /* menu: holds the selected child's widgets */
+    node_gui_t *editing;    /* menu: the selected child */
 };
 
 
@@ -58,12 +62,14 @@ void node_gui_attach_widget(node_gui_t *ng, GtkWidget *child,
 node_gui_t *node_gui_new(cml_node *mn);
 void node_gui_set_page(node_gui_t *ng, GtkWidget *page);
 node_gui_t *node_gui_from_widget(GtkWidget *w);
-node_gui_t *node_gui_get_current(void);
-void node_gui_set_current(node_gui_t *ng);
 char *node_gui_default_format_label(node_gui_t *ng);
 void node_gui_default_build_arrow(node_gui_t *ng);
 void show_node_help(cml_node *mn);
 void node_gui_build(node_gui_t *ng, GtkWidget *table, int row);
+void node_gui_unbuild(node_gui_t *ng);
+gboolean node_gui_has_value(node_gui_t *ng);
+gboolean node_gui_has_submenu(node_gui_t *ng);
+gboolean node_gui_is_shown(node_gui_t *ng);
 void node_gui_update_label(node_gui_t *ng);
 void node_gui_update(node_gui_t *ng);
 
@@ -25,6 +25,7 @@ CVSID("$Id: page_gui.c,v 1.2 2002/06/07 15:46:29 gnb Exp $");
 
 static GList *page_stack;
 static GtkWidget *notebook;
+static GList *pages_to_fill;	/* node_gui_t* whose rows come or go */
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
@@ -63,116 +64,293 @@ page_gui_get_leafmost(void)
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*
+ * Each page shows its menu's children as rows of text in a CList,
+ * which only draws the rows currently scrolled into view, so a menu
+ * with thousands of children costs thousands of strings rather than
+ * thousands of widgets.  The value widgets for whichever row is
+ * selected are built by the node_gui ops into a one-row table below
+ * the list, and destroyed when the selection moves on.
+ */
 
-void
-page_gui_move_rootmost(void)
+enum PageGuiColumn { ROW_LABEL, ROW_VALUE };
+#define NUM_ROW_COLUMNS 2
+
+static void
+row_get_text(node_gui_t *ng, char *text[NUM_ROW_COLUMNS])
 {
-    cml_node *mn;
-    
-    CALLED();
-    mn = (cml_node *)g_list_last(page_stack)->data;
-    page_gui_update(mn, /*make_current*/TRUE);
+    text[ROW_LABEL] = (*ng->ops->format_label)(ng);
+    if (node_gui_has_submenu(ng))
+    	text[ROW_VALUE] = g_strdup("--->");
+    else if (!node_gui_has_value(ng) ||
+    	     (text[ROW_VALUE] = cml_node_get_value_as_string(ng->node)) == 0)
+    	text[ROW_VALUE] = g_strdup("");
 }
 
-void
-page_gui_move_up(void)
+static void
+row_free_text(char *text[NUM_ROW_COLUMNS])
 {
-    cml_node *mn;
+    int i;
     
-    CALLED();
-    mn = page_gui_get_current();
-    mn = (cml_node *)g_list_find(page_stack, mn)->next->data;
-    page_gui_update(mn, /*make_current*/TRUE);
+    for (i = 0 ; i < NUM_ROW_COLUMNS ; i++)
+    	g_free(text[i]);
 }
 
-void
-page_gui_move_down(void)
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static void
+page_gui_edit(node_gui_t *pageng, node_gui_t *ng)
 {
-    cml_node *mn;
-    
-    CALLED();
-    mn = page_gui_get_current();
-    mn = (cml_node *)g_list_find(page_stack, mn)->prev->data;
-    page_gui_update(mn, /*make_current*/TRUE);
+    if (pageng->editing == ng)
+    	return;
+    if (pageng->editing != 0)
+    	node_gui_unbuild(pageng->editing);
+    pageng->editing = ng;
+    if (ng != 0)
+    {
+    	node_gui_build(ng, pageng->editor, 0);
+	node_gui_update(ng);
+    }
 }
 
-void
-page_gui_move_leafmost(void)
+static void
+on_page_clist_select_row(
+    GtkWidget *w,
+    gint row,
+    gint column,
+    GdkEventButton *event,
+    gpointer user_data)
 {
+    node_gui_t *pageng = (node_gui_t *)user_data;
+    node_gui_t *ng;
     cml_node *mn;
     
+    if (creating)
+    	return;
+
     CALLED();
-    mn = (cml_node *)g_list_first(page_stack)->data;
-    page_gui_update(mn, /*make_current*/TRUE);
+    mn = (cml_node *)gtk_clist_get_row_data(GTK_CLIST(w), row);
+    ng = (node_gui_t *)cml_node_get_user_data(mn);
+    page_gui_edit(pageng, ng);
+    
+    /* double-click enters a submenu, like its arrow button */
+    if (event != 0 && event->type == GDK_2BUTTON_PRESS &&
+    	node_gui_has_submenu(ng))
+    {
+	page_gui_push(mn);
+	grey_items();
+    }
 }
 
-
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
-void
-page_gui_update(cml_node *mn, gboolean make_current)
+static void
+page_gui_build(node_gui_t *ng)
 {
-    GtkWidget *table = 0;
-    const GList *list;
-    node_gui_t *ng;
-    int row;
+    GtkWidget *vbox;
+    GtkWidget *sw;
+    GtkCList *clist;
     
-    ng = (node_gui_t *)cml_node_get_user_data(mn);
-    if (ng == 0)
-    	ng = node_gui_new(mn);
-
-    list = cml_node_get_children(ng->node);
-    
-    if (ng->child_page == 0)
-    {
-	GtkWidget *sw;
-
-    	creating = TRUE;
-	/* create new table and scrolledwindow and populate it */
-	table = gtk_table_new(g_list_length((GList *)list), NUM_COLUMNS, /*homogeneous*/FALSE);
-	gtk_table_set_row_spacings(GTK_TABLE(table), 0);
-	gtk_table_set_col_spacings(GTK_TABLE(table), 0);
-	gtk_container_set_border_width(GTK_CONTAINER(table), SPACING);
-	gtk_widget_show(table);
+    creating = TRUE;
     
-	sw = gtk_scrolled_window_new(0, 0);
-	gtk_container_set_border_width(GTK_CONTAINER(sw), SPACING);
-	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(sw),
-    	    GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-	gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(sw), table);
-
-	gtk_notebook_append_page(GTK_NOTEBOOK(notebook), sw, 
-    	    gtk_label_new(cml_node_get_banner(ng->node)));
-	
-	node_gui_set_page(ng, sw);
-    	creating = FALSE;
-    }
+    ng->clist = gtk_clist_new(NUM_ROW_COLUMNS);
+    clist = GTK_CLIST(ng->clist);
+    gtk_clist_set_selection_mode(clist, GTK_SELECTION_BROWSE);
+    gtk_clist_column_titles_hide(clist);
+    gtk_clist_set_column_justification(clist, ROW_LABEL, GTK_JUSTIFY_RIGHT);
+    gtk_clist_set_column_auto_resize(clist, ROW_LABEL, TRUE);
+    gtk_signal_connect(GTK_OBJECT(ng->clist), "select_row", 
+    	GTK_SIGNAL_FUNC(on_page_clist_select_row), ng);
+    gtk_widget_show(ng->clist);
+
+    /* a CList scrolls itself, so needs no viewport */
+    sw = gtk_scrolled_window_new(0, 0);
+    gtk_container_set_border_width(GTK_CONTAINER(sw), SPACING);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(sw),
+    	GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(sw), ng->clist);
+    gtk_widget_show(sw);
     
+    ng->editor = gtk_table_new(1, NUM_COLUMNS, /*homogeneous*/FALSE);
+    gtk_table_set_row_spacings(GTK_TABLE(ng->editor), 0);
+    gtk_table_set_col_spacings(GTK_TABLE(ng->editor), 0);
+    gtk_container_set_border_width(GTK_CONTAINER(ng->editor), SPACING);
+    gtk_widget_show(ng->editor);
+
+    vbox = gtk_vbox_new(/*homogeneous*/FALSE, /*spacing*/0);
+    gtk_box_pack_start(GTK_BOX(vbox), sw,
+    	    	    	/*expand*/TRUE, /*fill*/TRUE, /*padding*/0);
+    gtk_box_pack_start(GTK_BOX(vbox), ng->editor,
+    	    	    	/*expand*/FALSE, /*fill*/TRUE, /*padding*/0);
+    gtk_widget_show(vbox);
+
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook), vbox, 
+    	gtk_label_new(cml_node_get_banner(ng->node)));
+
+    node_gui_set_page(ng, vbox);
+    creating = FALSE;
+}
+
+/*
+ * Replace the page's rows with one per child currently shown.
+ */
+static void
+page_gui_fill(node_gui_t *ng)
+{
+    GtkCList *clist = GTK_CLIST(ng->clist);
+    const GList *list;
+    GList *all = 0;
+    char *text[NUM_ROW_COLUMNS];
+    gboolean editing_shown = FALSE;
+    int row;
+
+    pages_to_fill = g_list_remove(pages_to_fill, ng);
+    for (row = 0 ; row < clist->rows ; row++)
+    	((node_gui_t *)cml_node_get_user_data(
+	    (cml_node *)gtk_clist_get_row_data(clist, row)))->page_row = -1;
+
+    if (show_suppressed)
+    	list = all = cml_node_get_children(ng->node);
+    else
+    	list = cml_node_get_visible_children(ng->node);
     
-    for (row = 0 ;
-    	 list != 0 ;
-	 list = list->next, row++)
+    creating = TRUE;
+    gtk_clist_freeze(clist);
+    gtk_clist_clear(clist);
+    for ( ; list != 0 ; list = list->next)
     {
     	cml_node *child = (cml_node *)list->data;
 	node_gui_t *childng = (node_gui_t *)cml_node_get_user_data(child);
 	
 	if (childng == 0)
-	{
 	    childng = node_gui_new(child);
-	    node_gui_build(childng, table, row);
+	if (!node_gui_is_shown(childng))
+	    continue;
+	    
+	row_get_text(childng, text);
+	row = gtk_clist_append(clist, text);
+	row_free_text(text);
+	gtk_clist_set_row_data(clist, row, child);
+	childng->page_row = row;
+	
+	if (childng == ng->editing)
+	{
+	    gtk_clist_select_row(clist, row, ROW_LABEL);
+	    editing_shown = TRUE;
 	}
+    }
+    gtk_clist_thaw(clist);
+    creating = FALSE;
+    g_list_free(all);
+
+    /*
+     * A browse mode CList always has a row selected once it has any
+     * rows, so if the row being edited went away, edit whichever
+     * row the CList selected instead.
+     */
+    if (!editing_shown)
+    {
+    	node_gui_t *selng = 0;
 
-	node_gui_update(childng);
+	if (clist->selection != 0)
+	{
+	    row = GPOINTER_TO_INT(clist->selection->data);
+	    selng = (node_gui_t *)cml_node_get_user_data(
+	    	    	(cml_node *)gtk_clist_get_row_data(clist, row));
+	}
+    	page_gui_edit(ng, selng);
     }
+}
 
-    if (make_current)
+/*
+ * Called when a node's state may have changed, to bring its
+ * row on its parent's page (if that page exists) up to date.
+ * If the row has to appear or disappear the page is only marked,
+ * so that many such changes from one commit cost one refill in
+ * page_gui_flush().
+ */
+void
+page_gui_update_row(node_gui_t *ng)
+{
+    cml_node *parent = cml_node_get_parent(ng->node);
+    node_gui_t *pageng;
+    char *text[NUM_ROW_COLUMNS];
+    int i;
+    
+    if (parent == 0 ||
+    	(pageng = (node_gui_t *)cml_node_get_user_data(parent)) == 0 ||
+	pageng->clist == 0)
+    	return;
+	
+    if ((ng->page_row >= 0) != node_gui_is_shown(ng))
     {
-    	creating = TRUE;
-	gtk_widget_show(ng->child_page);
-	gtk_notebook_set_page(GTK_NOTEBOOK(notebook),
-	    gtk_notebook_page_num(GTK_NOTEBOOK(notebook), ng->child_page));
-    	creating = FALSE;
+    	if (g_list_find(pages_to_fill, pageng) == 0)
+	    pages_to_fill = g_list_prepend(pages_to_fill, pageng);
+	return;
     }
+    if (ng->page_row < 0)
+    	return;
+	
+    row_get_text(ng, text);
+    for (i = 0 ; i < NUM_ROW_COLUMNS ; i++)
+    	gtk_clist_set_text(GTK_CLIST(pageng->clist), ng->page_row, i, text[i]);
+    row_free_text(text);
+}
+
+/*
+ * Refill the pages marked by page_gui_update_row(), once each.
+ * Called after anything which notifies libcml's changes.
+ */
+void
+page_gui_flush(void)
+{
+    while (pages_to_fill != 0)
+    	page_gui_fill((node_gui_t *)pages_to_fill->data);
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static node_gui_t *
+page_gui_get(cml_node *mn)
+{
+    node_gui_t *ng;
+    
+    ng = (node_gui_t *)cml_node_get_user_data(mn);
+    if (ng == 0)
+    	ng = node_gui_new(mn);
+    if (ng->child_page == 0)
+    {
+    	page_gui_build(ng);
+	page_gui_fill(ng);
+    }
+    return ng;
+}
+
+static void
+page_gui_make_current(node_gui_t *ng)
+{
+    creating = TRUE;
+    gtk_widget_show(ng->child_page);
+    gtk_notebook_set_page(GTK_NOTEBOOK(notebook),
+	gtk_notebook_page_num(GTK_NOTEBOOK(notebook), ng->child_page));
+    creating = FALSE;
+}
+
+/*
+ * Rebuild a page's rows from scratch, e.g. when the display
+ * options change.  Value changes don't need this, they arrive
+ * row by row through page_gui_update_row().
+ */
+void
+page_gui_update(cml_node *mn, gboolean make_current)
+{
+    node_gui_t *ng = page_gui_get(mn);
+
+    page_gui_fill(ng);
+    if (ng->editing != 0)
+    	node_gui_update(ng->editing);
+    if (make_current)
+    	page_gui_make_current(ng);
 }
 
 void
@@ -181,6 +359,58 @@ page_gui_update_current(void)
     page_gui_update(page_gui_get_current(), FALSE);
 }
 
+/*
+ * Switch to a page, building it if this is the first visit.
+ */
+static void
+page_gui_show(cml_node *mn)
+{
+    page_gui_make_current(page_gui_get(mn));
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+void
+page_gui_move_rootmost(void)
+{
+    cml_node *mn;
+    
+    CALLED();
+    mn = (cml_node *)g_list_last(page_stack)->data;
+    page_gui_show(mn);
+}
+
+void
+page_gui_move_up(void)
+{
+    cml_node *mn;
+    
+    CALLED();
+    mn = page_gui_get_current();
+    mn = (cml_node *)g_list_find(page_stack, mn)->next->data;
+    page_gui_show(mn);
+}
+
+void
+page_gui_move_down(void)
+{
+    cml_node *mn;
+    
+    CALLED();
+    mn = page_gui_get_current();
+    mn = (cml_node *)g_list_find(page_stack, mn)->prev->data;
+    page_gui_show(mn);
+}
+
+void
+page_gui_move_leafmost(void)
+{
+    cml_node *mn;
+    
+    CALLED();
+    mn = (cml_node *)g_list_first(page_stack)->data;
+    page_gui_show(mn);
+}
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
@@ -218,7 +448,7 @@ page_gui_push(cml_node *mn)
 	    page_stack = g_list_remove_link(page_stack, page_stack);
 	}
 	page_stack = g_list_prepend(page_stack, mn);
-	page_gui_update(mn, /*make_current*/TRUE);
+	page_gui_show(mn);
     }
 }
 
@@ -228,11 +458,9 @@ GLADE_CALLBACK void
 on_notebook_switch_page(GtkWidget *w, gpointer page, int page_num)
 {
     CALLED();
+    /* rows are kept up to date as nodes change, so just regrey */
     if (!creating)
-    {
-	page_gui_update(page_gui_get_nth(page_num), /*make_current*/FALSE);
 	grey_items();
-    }
 }
 
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
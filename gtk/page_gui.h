@@ -32,6 +32,8 @@ void page_gui_move_leafmost(void);
 void page_gui_push(cml_node *mn);
 void page_gui_update(cml_node *, gboolean make_current);
 void page_gui_update_current(void);
+void page_gui_update_row(node_gui_t *ng);
+void page_gui_flush(void);
 
 
 #endif /* _page_gui_h_ */
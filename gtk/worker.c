@@ -0,0 +1,320 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "common.h"
+#include <pthread.h>
+
+CVSID("$Id$");
+
+/*
+ * Runs one long libcml operation (parse, load or save)
+ * at a time on a second thread, so the main window keeps redrawing.
+ * The worker thread never touches GTK: libcml's progress and error
+ * callbacks just record what happened under the lock, and a timeout
+ * on the main loop copies it into the progress window and the log
+ * window, and calls the done function once the job has finished.
+ * While a job runs the main window is insensitive, so nothing else
+ * calls into libcml; libcml has no locking of its own.
+ */
+
+#define POLL_INTERVAL	100 	/* millisec */
+
+typedef struct
+{
+    gboolean busy;
+    gboolean finished;	    	/* set by worker thread */
+    gboolean result;	    	/* set by worker thread */
+    gboolean cancel;	    	/* set by Cancel button */
+    gboolean threaded;
+    pthread_t thread;
+    worker_func func;
+    worker_done_func done;
+    void *user_data;
+    /* progress, set by worker thread */
+    cml_progress_phase phase;
+    char *filename;
+    unsigned long progress_done;
+    unsigned long progress_total;
+    GList *messages;	    	/* formatted, in reverse order */
+} worker_state;
+
+G_LOCK_DEFINE_STATIC(worker);
+static worker_state state;
+static GtkWidget *progress_window;
+static GtkWidget *progress_label;
+static GtkWidget *progress_bar;
+
+static const char *phase_strings[] =
+{
+"Parsing", "Loading", "Saving", "Checking"
+};
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/* Called on the worker thread */
+
+static gboolean
+worker_progress_func(
+    cml_rulebase *rb,
+    cml_progress_phase phase,
+    const char *filename,
+    unsigned long done,
+    unsigned long total,
+    void *user_data)
+{
+    gboolean cancel;
+
+    G_LOCK(worker);
+    state.phase = phase;
+    if (filename != 0 &&
+    	(state.filename == 0 || strcmp(state.filename, filename)))
+    {
+    	if (state.filename != 0)
+	    g_free(state.filename);
+	state.filename = g_strdup(filename);
+    }
+    state.progress_done = done;
+    state.progress_total = total;
+    cancel = state.cancel;
+    G_UNLOCK(worker);
+
+    return !cancel;
+}
+
+static void
+worker_error_func(
+    cml_severity sev,
+    const cml_location *loc,
+    const char *fmt,
+    va_list args)
+{
+    char *msg = logwin_format(sev, loc, fmt, args);
+
+    G_LOCK(worker);
+    state.messages = g_list_prepend(state.messages, msg);
+    G_UNLOCK(worker);
+}
+
+static void *
+worker_main(void *arg)
+{
+    gboolean result;
+
+    result = (*state.func)(state.user_data);
+
+    G_LOCK(worker);
+    state.result = result;
+    state.finished = TRUE;
+    G_UNLOCK(worker);
+
+    return 0;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static void
+on_progress_cancel_clicked(GtkWidget *w, void *ud)
+{
+    G_LOCK(worker);
+    state.cancel = TRUE;
+    G_UNLOCK(worker);
+    gtk_widget_set_sensitive(w, FALSE);
+}
+
+static gint
+on_progress_delete_event(GtkWidget *w, GdkEvent *event, void *ud)
+{
+    return TRUE;    /* don't close, the worker still needs us */
+}
+
+static void
+progress_window_create(void)
+{
+    GtkWidget *vbox, *bbox, *button;
+
+    progress_window = gtk_window_new(GTK_WINDOW_DIALOG);
+    gtk_window_set_position(GTK_WINDOW(progress_window), GTK_WIN_POS_CENTER);
+    gtk_container_set_border_width(GTK_CONTAINER(progress_window), SPACING);
+    gtk_signal_connect(GTK_OBJECT(progress_window), "delete_event",
+    	    GTK_SIGNAL_FUNC(on_progress_delete_event), 0);
+
+    vbox = gtk_vbox_new(FALSE, SPACING);
+    gtk_container_add(GTK_CONTAINER(progress_window), vbox);
+    gtk_widget_show(vbox);
+
+    progress_label = gtk_label_new("");
+    gtk_misc_set_alignment(GTK_MISC(progress_label), 0.0, 0.5);
+    gtk_box_pack_start(GTK_BOX(vbox), progress_label, FALSE, FALSE, 0);
+    gtk_widget_show(progress_label);
+
+    progress_bar = gtk_progress_bar_new();
+    gtk_widget_set_usize(progress_bar, 300, -1);
+    gtk_box_pack_start(GTK_BOX(vbox), progress_bar, FALSE, FALSE, 0);
+    gtk_widget_show(progress_bar);
+
+    bbox = gtk_hbutton_box_new();
+    gtk_box_pack_start(GTK_BOX(vbox), bbox, FALSE, FALSE, 0);
+    gtk_widget_show(bbox);
+
+    button = gtk_button_new_with_label(_("Cancel"));
+    gtk_signal_connect(GTK_OBJECT(button), "clicked",
+    	    GTK_SIGNAL_FUNC(on_progress_cancel_clicked), 0);
+    gtk_container_add(GTK_CONTAINER(bbox), button);
+    gtk_widget_show(button);
+
+    gtk_object_set_data(GTK_OBJECT(progress_window), "cancel_button", button);
+}
+
+/*
+ * Copy the worker's latest progress into the progress window.
+ * Called with the lock held.
+ */
+static void
+progress_window_update(void)
+{
+    char *txt;
+
+    txt = g_strdup_printf("%s %s...", _(phase_strings[state.phase]),
+    	    	    	  (state.filename == 0 ? "" : state.filename));
+    gtk_label_set_text(GTK_LABEL(progress_label), txt);
+    g_free(txt);
+
+    if (state.progress_total != 0)
+    {
+    	gtk_progress_set_activity_mode(GTK_PROGRESS(progress_bar), FALSE);
+	gtk_progress_bar_update(GTK_PROGRESS_BAR(progress_bar),
+	    (gfloat)MIN(state.progress_done, state.progress_total) /
+	    (gfloat)state.progress_total);
+    }
+    else
+    {
+    	/* number of files parsed so far, no idea how many to come */
+    	gtk_progress_set_activity_mode(GTK_PROGRESS(progress_bar), TRUE);
+	gtk_progress_set_value(GTK_PROGRESS(progress_bar),
+	    (gfloat)(state.progress_done % 100));
+    }
+}
+
+static gint
+worker_poll(void *data)
+{
+    GList *messages, *list;
+    gboolean finished;
+
+    G_LOCK(worker);
+    messages = g_list_reverse(state.messages);
+    state.messages = 0;
+    finished = state.finished;
+    if (!finished)
+	progress_window_update();
+    G_UNLOCK(worker);
+
+    for (list = messages ; list != 0 ; list = list->next)
+    {
+    	logwin_insert((char *)list->data);
+	g_free(list->data);
+    }
+    g_list_free(messages);
+
+    if (!finished)
+    	return TRUE;	/* call me again */
+
+    if (state.threaded)
+	pthread_join(state.thread, 0);
+    DDPRINTF2(DEBUG_GUI, "worker finished, result=%d cancel=%d\n",
+    	    	state.result, state.cancel);
+
+    gtk_widget_hide(progress_window);
+    gtk_widget_set_sensitive(main_window, TRUE);
+    cml_rulebase_set_progress_func(rb, 0, 0);
+    logwin_attach();
+    if (state.filename != 0)
+    {
+    	g_free(state.filename);
+	state.filename = 0;
+    }
+    state.busy = FALSE;
+
+    if (state.done != 0)
+	(*state.done)(state.result, state.cancel, state.user_data);
+
+    return FALSE;   /* stop calling me already */
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+/*
+ * Start `func' on the worker thread and return immediately.  When
+ * it returns, `done' is called on the main loop with its result and
+ * whether the user pressed Cancel; any messages logged meanwhile
+ * have already been copied to the log window by then.
+ */
+void
+worker_run(
+    const char *title,
+    worker_func func,
+    worker_done_func done,
+    void *user_data)
+{
+    GtkWidget *button;
+
+    assert(!state.busy);
+
+    if (progress_window == 0)
+    	progress_window_create();
+    gtk_window_set_title(GTK_WINDOW(progress_window), title);
+    button = gtk_object_get_data(GTK_OBJECT(progress_window), "cancel_button");
+    gtk_widget_set_sensitive(button, TRUE);
+    gtk_label_set_text(GTK_LABEL(progress_label), "");
+    gtk_progress_bar_update(GTK_PROGRESS_BAR(progress_bar), 0.0);
+    gtk_widget_show(progress_window);
+    if (main_window != 0)
+	gtk_widget_set_sensitive(main_window, FALSE);
+
+    state.busy = TRUE;
+    state.finished = FALSE;
+    state.result = FALSE;
+    state.cancel = FALSE;
+    state.func = func;
+    state.done = done;
+    state.user_data = user_data;
+    state.phase = CML_PROGRESS_PARSE;
+    state.progress_done = 0;
+    state.progress_total = 0;
+
+    cml_rulebase_set_progress_func(rb, worker_progress_func, 0);
+    cml_set_error_func(worker_error_func);
+
+    state.threaded = (pthread_create(&state.thread, 0, worker_main, 0) == 0);
+    if (!state.threaded)
+    {
+    	/* no threads, just do it here and now */
+	perror("pthread_create");
+	worker_main(0);
+    }
+    gtk_timeout_add(POLL_INTERVAL, worker_poll, 0);
+}
+
+gboolean
+worker_is_busy(void)
+{
+    return state.busy;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*END*/
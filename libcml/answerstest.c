@@ -0,0 +1,146 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Parses a rules file, then for each answers file given loads
+ * the .config, applies the answers and commits, the way
+ * `cml-glass --olddefconfig --answers' does.  Prints how many
+ * answers were used and the bindings saved, then runs the same
+ * again over the saved file and says whether it changed.  The
+ * saved header is left out, so the output doesn't depend on the
+ * version.
+ */
+
+#include "private.h"
+#include <unistd.h>
+
+CVSID("$Id$");
+
+#define SAVED1	"answerstest.out1"
+#define SAVED2	"answerstest.out2"
+
+/*
+ * Returns the bindings in a saved .config, including unset ones
+ * but not the other comments, or 0 if it can't be read.
+ */
+static char *
+read_bindings(const char *filename)
+{
+    FILE *fp;
+    char buf[1024];
+    char *s, *old;
+
+    if ((fp = fopen(filename, "r")) == 0)
+    	return 0;
+    s = g_strdup("");
+    while (fgets(buf, sizeof(buf), fp) != 0)
+    {
+    	if (buf[0] == '\n' ||
+	    (buf[0] == '#' && strstr(buf, " is not set") == 0))
+	    continue;
+	old = s;
+	s = g_strconcat(old, buf, (char *)0);
+	g_free(old);
+    }
+    fclose(fp);
+    return s;
+}
+
+/*
+ * Loads `defconfig' and `answers', commits and saves to `saved'.
+ * Returns FALSE if the commit failed and nothing was saved.
+ */
+static gboolean
+olddefconfig(
+    cml_rulebase *rb,
+    const char *defconfig,
+    const char *answers,
+    const char *saved)
+{
+    int n;
+
+    cml_rulebase_clear(rb);
+    if (!cml_rulebase_load_defconfig(rb, defconfig))
+    {
+    	printf("load %s failed\n", defconfig);
+	return FALSE;
+    }
+    if ((n = cml_rulebase_load_answers(rb, answers)) < 0)
+    {
+    	printf("answers %s failed\n", answers);
+	cml_rulebase_abort(rb);
+	return FALSE;
+    }
+    printf("%d answers used\n", n);
+    if (!cml_rulebase_commit(rb, FALSE) ||
+    	cml_rulebase_get_broken_rules(rb) != 0)
+    {
+    	printf("commit failed\n");
+	return FALSE;
+    }
+    if (!cml_rulebase_save_defconfig(rb, saved))
+    {
+    	printf("save %s failed\n", saved);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+int
+main(int argc, char **argv)
+{
+    cml_rulebase *rb;
+    char *first, *second;
+    int i;
+
+    if (argc < 4)
+    {
+    	fprintf(stderr, "Usage: %s rulesfile defconfig answers...\n", argv[0]);
+	return 1;
+    }
+
+    rb = cml_rulebase_new();
+    if (!cml_rulebase_parse(rb, argv[1]) || !cml_rulebase_post_parse(rb))
+    	return 1;
+
+    for (i = 3 ; i < argc ; i++)
+    {
+    	printf("answers %s\n", argv[i]);
+	if (!olddefconfig(rb, argv[2], argv[i], SAVED1))
+	    continue;
+	first = read_bindings(SAVED1);
+	fputs(first, stdout);
+
+	printf("second pass\n");
+	if (olddefconfig(rb, SAVED1, argv[i], SAVED2))
+	{
+	    second = read_bindings(SAVED2);
+	    printf("%s\n", (strcmp(first, second) ? "changed" : "unchanged"));
+	    g_free(second);
+	}
+	g_free(first);
+    }
+
+    unlink(SAVED1);
+    unlink(SAVED2);
+    cml_rulebase_delete(rb);
+    return 0;
+}
+
+/*END*/
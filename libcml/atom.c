@@ -23,11 +23,41 @@ CVSID("$Id: atom.c,v 1.13 2002/09/01 08:12:06 gnb Exp $");
 
 /*============================================================*/
 
+/*
+ * String values of atoms owned by the library are kept in one
+ * pool, so that copying an atom only bumps a reference count
+ * and equal strings compare equal by pointer.  Atoms are public
+ * structures and don't know which rulebase they belong to, so
+ * this pool is shared by all rulebases.
+ */
+static cml_strpool *atom_strings;
+
 void
 atom_ctor(cml_atom *a)
 {
     if (a->type == A_STRING && a->value.string != 0)
-    	a->value.string = g_strdup(a->value.string);
+    {
+    	if (atom_strings == 0)
+	    atom_strings = strpool_new();
+    	a->value.string = strpool_ref(atom_strings, a->value.string);
+    }
+}
+
+/*
+ * Like atom_ctor() but takes over an existing g_malloc()ed
+ * string value, e.g. from cml_atom_from_string().
+ */
+void
+atom_intern(cml_atom *a)
+{
+    char *old;
+
+    if (a->type == A_STRING && a->value.string != 0)
+    {
+    	old = a->value.string;
+	atom_ctor(a);
+	g_free(old);
+    }
 }
 
 cml_atom *
@@ -46,7 +76,7 @@ atom_dtor(cml_atom *a)
 {
     if (a->type == A_STRING && a->value.string != 0)
     {
-    	g_free(a->value.string);
+    	strpool_unref(atom_strings, a->value.string);
 	a->value.string = 0;
     }
 }
@@ -110,7 +140,7 @@ cml_atom_value_as_string(const cml_atom *ap)
     case A_STRING:
     	return g_strdup(ap->value.string == 0 ? "" : ap->value.string);
     case A_NODE:
-    	return g_strdup(ap->value.node == 0 ? "" : ap->value.node->banner);
+    	return g_strdup(ap->value.node == 0 ? "" : ap->value.node->cold->banner);
     case A_BOOLEAN:
     case A_TRISTATE:
     	switch (ap->value.tritval)
@@ -213,6 +243,8 @@ _atom_compare(const cml_atom *left, const cml_atom *right)
     	{
 	    char *ls = left->value.string;
 	    char *rs = right->value.string;
+	    if (ls == rs)
+	    	return 0;   	/* both pooled, or both 0 */
 	    if (ls == 0)
 	    	ls = "";
 	    if (rs == 0)
@@ -0,0 +1,655 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "cml1.h"
+#if OVERLAP_BDD
+#include "bdd.h"
+#endif
+#include "debug.h"
+#include <limits.h>
+
+CVSID("$Id$");
+
+#if OVERLAP_BDD
+
+/*============================================================*/
+/*
+ * Each BDD variable stands for one test `symbol == value' found
+ * in a condition.  Tests which are not of that form get a private
+ * variable of their own, with a null symbol.  Values of the same
+ * symbol are mutually exclusive, which is imposed explicitly when
+ * checking for overlap.
+ */
+
+typedef struct
+{
+    cml_node *symbol;
+    cml_atom value;
+    char *desc;     	    	/* for private variables */
+} bdd_var_t;
+
+typedef struct
+{
+    int op;
+    bdd_t f, g, r;
+} bdd_cache_entry_t;
+
+#define BDD_OP_AND  	1
+#define BDD_OP_OR   	2
+#define BDD_OP_NOT  	3
+
+#define BDD_CACHE_SIZE	    (1<<14)
+#define BDD_TERMINAL_LEVEL  INT_MAX
+
+struct bdd_manager_s
+{
+    /* node table, indexed by bdd_t */
+    int nnodes, maxnodes;
+    int *level;
+    bdd_t *lo, *hi;
+    /* unique table, chained through `next' */
+    int nbuckets;
+    int *buckets;
+    int *next;
+    bdd_cache_entry_t *cache;
+    /* variables, indexed by level */
+    int nvars, maxvars;
+    bdd_var_t *vars;
+    GHashTable *symvars;    	/* cml_node* -> GList of variable numbers */
+    GHashTable *exprvars;   	/* cml_expr* -> private variable number+1 */
+};
+
+/*============================================================*/
+
+#define bdd_hash(m, v, l, h) \
+    ((unsigned)((v) * 12582917 + (l) * 4256249 + (h)) & ((m)->nbuckets-1))
+
+static void
+bdd_rehash(bdd_manager_t *m)
+{
+    bdd_t f;
+    unsigned int b;
+
+    m->buckets = g_renew(int, m->buckets, m->nbuckets);
+    for (b = 0 ; b < m->nbuckets ; b++)
+    	m->buckets[b] = -1;
+    for (f = 2 ; f < m->nnodes ; f++)
+    {
+    	b = bdd_hash(m, m->level[f], m->lo[f], m->hi[f]);
+	m->next[f] = m->buckets[b];
+	m->buckets[b] = f;
+    }
+}
+
+static bdd_t
+bdd_mk(bdd_manager_t *m, int level, bdd_t lo, bdd_t hi)
+{
+    bdd_t f;
+    unsigned int b;
+
+    if (lo == hi)
+    	return lo;
+
+    b = bdd_hash(m, level, lo, hi);
+    for (f = m->buckets[b] ; f >= 0 ; f = m->next[f])
+    	if (m->level[f] == level && m->lo[f] == lo && m->hi[f] == hi)
+	    return f;
+
+    if (m->nnodes == m->maxnodes)
+    {
+    	m->maxnodes *= 2;
+	m->level = g_renew(int, m->level, m->maxnodes);
+	m->lo = g_renew(bdd_t, m->lo, m->maxnodes);
+	m->hi = g_renew(bdd_t, m->hi, m->maxnodes);
+	m->next = g_renew(int, m->next, m->maxnodes);
+    }
+    f = m->nnodes++;
+    m->level[f] = level;
+    m->lo[f] = lo;
+    m->hi[f] = hi;
+
+    if (m->nnodes > 2 * m->nbuckets)
+    {
+    	m->nbuckets *= 2;
+	bdd_rehash(m);
+    }
+    else
+    {
+	m->next[f] = m->buckets[b];
+	m->buckets[b] = f;
+    }
+    return f;
+}
+
+/*============================================================*/
+
+bdd_manager_t *
+bdd_manager_new(void)
+{
+    bdd_manager_t *m = g_new0(bdd_manager_t, 1);
+    int i;
+
+    m->maxnodes = 1024;
+    m->level = g_new(int, m->maxnodes);
+    m->lo = g_new(bdd_t, m->maxnodes);
+    m->hi = g_new(bdd_t, m->maxnodes);
+    m->next = g_new(int, m->maxnodes);
+    for (i = BDD_FALSE ; i <= BDD_TRUE ; i++)
+    {
+	m->level[i] = BDD_TERMINAL_LEVEL;
+	m->lo[i] = m->hi[i] = i;
+	m->next[i] = -1;
+    }
+    m->nnodes = 2;
+
+    m->nbuckets = 512;
+    bdd_rehash(m);
+
+    m->cache = g_new0(bdd_cache_entry_t, BDD_CACHE_SIZE);
+
+    m->symvars = g_hash_table_new(g_direct_hash, g_direct_equal);
+    m->exprvars = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    return m;
+}
+
+static gboolean
+free_symvars(gpointer key, gpointer value, gpointer user_data)
+{
+    g_list_free((GList *)value);
+    return TRUE;
+}
+
+void
+bdd_manager_delete(bdd_manager_t *m)
+{
+    int i;
+
+    DDPRINTF2(DEBUG_DNF, "%d BDD nodes, %d variables\n", m->nnodes, m->nvars);
+
+    for (i = 0 ; i < m->nvars ; i++)
+    {
+    	atom_dtor(&m->vars[i].value);
+	strdelete(m->vars[i].desc);
+    }
+    g_free(m->vars);
+    g_hash_table_foreach_remove(m->symvars, free_symvars, 0);
+    g_hash_table_destroy(m->symvars);
+    g_hash_table_destroy(m->exprvars);
+    g_free(m->cache);
+    g_free(m->buckets);
+    g_free(m->next);
+    g_free(m->level);
+    g_free(m->lo);
+    g_free(m->hi);
+    g_free(m);
+}
+
+/*============================================================*/
+
+static bdd_t
+bdd_apply(bdd_manager_t *m, int op, bdd_t f, bdd_t g)
+{
+    bdd_cache_entry_t *ce;
+    bdd_t r, f0, f1, g0, g1;
+    int level;
+
+    switch (op)
+    {
+    case BDD_OP_AND:
+    	if (f == BDD_FALSE || g == BDD_FALSE)
+	    return BDD_FALSE;
+    	if (f == BDD_TRUE || f == g)
+	    return g;
+	if (g == BDD_TRUE)
+	    return f;
+	break;
+    case BDD_OP_OR:
+    	if (f == BDD_TRUE || g == BDD_TRUE)
+	    return BDD_TRUE;
+    	if (f == BDD_FALSE || f == g)
+	    return g;
+	if (g == BDD_FALSE)
+	    return f;
+	break;
+    case BDD_OP_NOT:
+    	if (f <= BDD_TRUE)
+	    return !f;
+	break;
+    }
+
+    /* both AND and OR commute */
+    if (op != BDD_OP_NOT && f > g)
+    {
+    	r = f;
+	f = g;
+	g = r;
+    }
+
+    ce = &m->cache[(unsigned)(f * 31 + g * 7 + op) & (BDD_CACHE_SIZE-1)];
+    if (ce->op == op && ce->f == f && ce->g == g)
+    	return ce->r;
+
+    if (op == BDD_OP_NOT)
+    {
+	level = m->level[f];
+    	f0 = bdd_apply(m, op, m->lo[f], 0);
+    	f1 = bdd_apply(m, op, m->hi[f], 0);
+	r = bdd_mk(m, level, f0, f1);
+    }
+    else
+    {
+	level = MIN(m->level[f], m->level[g]);
+	f0 = (m->level[f] == level ? m->lo[f] : f);
+	f1 = (m->level[f] == level ? m->hi[f] : f);
+	g0 = (m->level[g] == level ? m->lo[g] : g);
+	g1 = (m->level[g] == level ? m->hi[g] : g);
+	r = bdd_mk(m, level,
+	    	   bdd_apply(m, op, f0, g0),
+		   bdd_apply(m, op, f1, g1));
+    }
+
+    ce->op = op;
+    ce->f = f;
+    ce->g = (op == BDD_OP_NOT ? 0 : g);
+    ce->r = r;
+    return r;
+}
+
+bdd_t
+bdd_not(bdd_manager_t *m, bdd_t f)
+{
+    return bdd_apply(m, BDD_OP_NOT, f, 0);
+}
+
+bdd_t
+bdd_and(bdd_manager_t *m, bdd_t f, bdd_t g)
+{
+    return bdd_apply(m, BDD_OP_AND, f, g);
+}
+
+bdd_t
+bdd_or(bdd_manager_t *m, bdd_t f, bdd_t g)
+{
+    return bdd_apply(m, BDD_OP_OR, f, g);
+}
+
+/*============================================================*/
+
+/*
+ * Existentially quantify `f' over every variable v with quant[v] set.
+ */
+static bdd_t
+bdd_exists2(
+    bdd_manager_t *m,
+    bdd_t f,
+    const unsigned char *quant,
+    GHashTable *memo)
+{
+    gpointer orig, res;
+    bdd_t r, r0, r1;
+
+    if (f <= BDD_TRUE)
+    	return f;
+    if (g_hash_table_lookup_extended(memo, GINT_TO_POINTER(f), &orig, &res))
+    	return GPOINTER_TO_INT(res);
+
+    r0 = bdd_exists2(m, m->lo[f], quant, memo);
+    r1 = bdd_exists2(m, m->hi[f], quant, memo);
+    if (quant[m->level[f]])
+    	r = bdd_or(m, r0, r1);
+    else
+    	r = bdd_mk(m, m->level[f], r0, r1);
+
+    g_hash_table_insert(memo, GINT_TO_POINTER(f), GINT_TO_POINTER(r));
+    return r;
+}
+
+static bdd_t
+bdd_forall(bdd_manager_t *m, bdd_t f, const unsigned char *quant)
+{
+    GHashTable *memo = g_hash_table_new(g_direct_hash, g_direct_equal);
+    bdd_t r;
+
+    r = bdd_not(m, bdd_exists2(m, bdd_not(m, f), quant, memo));
+    g_hash_table_destroy(memo);
+    return r;
+}
+
+/*============================================================*/
+
+static bdd_t
+bdd_var(bdd_manager_t *m, int v)
+{
+    return bdd_mk(m, v, BDD_FALSE, BDD_TRUE);
+}
+
+static int
+bdd_new_var(bdd_manager_t *m, cml_node *symbol, const cml_atom *value)
+{
+    bdd_var_t *var;
+
+    if (m->nvars == m->maxvars)
+    {
+    	m->maxvars = (m->maxvars == 0 ? 64 : m->maxvars * 2);
+	m->vars = g_renew(bdd_var_t, m->vars, m->maxvars);
+    }
+    var = &m->vars[m->nvars];
+    memset(var, 0, sizeof(*var));
+    var->symbol = symbol;
+    if (value != 0)
+    {
+    	var->value = *value;
+	atom_ctor(&var->value);
+    }
+    return m->nvars++;
+}
+
+static gboolean
+bdd_same_value(const cml_atom *a1, const cml_atom *a2)
+{
+    gboolean logical1 = (a1->type == A_BOOLEAN || a1->type == A_TRISTATE);
+    gboolean logical2 = (a2->type == A_BOOLEAN || a2->type == A_TRISTATE);
+
+    if (a1->type != a2->type && !(logical1 && logical2))
+    	return FALSE;
+    return (_atom_compare(a1, a2) == 0);
+}
+
+static int
+bdd_symbol_var(bdd_manager_t *m, cml_node *symbol, const cml_atom *value)
+{
+    GList *list, *vars;
+    int v;
+
+    vars = (GList *)g_hash_table_lookup(m->symvars, symbol);
+    for (list = vars ; list != 0 ; list = list->next)
+    {
+    	v = GPOINTER_TO_INT(list->data);
+	if (bdd_same_value(&m->vars[v].value, value))
+	    return v;
+    }
+
+    v = bdd_new_var(m, symbol, value);
+    g_hash_table_insert(m->symvars, symbol,
+    	    	    	g_list_append(vars, GINT_TO_POINTER(v)));
+    return v;
+}
+
+static int
+bdd_private_var(bdd_manager_t *m, const cml_expr *expr)
+{
+    int v;
+
+    if ((v = GPOINTER_TO_INT(g_hash_table_lookup(m->exprvars, expr))) != 0)
+    	return v-1;
+
+    v = bdd_new_var(m, 0, 0);
+    m->vars[v].desc = expr_as_string(expr);
+    g_hash_table_insert(m->exprvars, (gpointer)expr, GINT_TO_POINTER(v+1));
+    return v;
+}
+
+/*
+ * Values of a symbol are mutually exclusive.
+ */
+static bdd_t
+bdd_exclusive(bdd_manager_t *m, cml_node *symbol)
+{
+    GList *l1, *l2;
+    bdd_t f = BDD_TRUE;
+
+    for (l1 = (GList *)g_hash_table_lookup(m->symvars, symbol) ;
+    	 l1 != 0 ;
+	 l1 = l1->next)
+    {
+    	for (l2 = l1->next ; l2 != 0 ; l2 = l2->next)
+	{
+	    bdd_t both = bdd_and(m,
+	    	    	    bdd_var(m, GPOINTER_TO_INT(l1->data)),
+	    	    	    bdd_var(m, GPOINTER_TO_INT(l2->data)));
+	    f = bdd_and(m, f, bdd_not(m, both));
+	}
+    }
+    return f;
+}
+
+static bdd_t
+bdd_exclusive_list(bdd_manager_t *m, const GList *syms)
+{
+    bdd_t f = BDD_TRUE;
+
+    for ( ; syms != 0 ; syms = syms->next)
+    	f = bdd_and(m, f, bdd_exclusive(m, (cml_node *)syms->data));
+    return f;
+}
+
+/*============================================================*/
+
+static int
+compare_ptrs(gconstpointer v1, gconstpointer v2)
+{
+    return (v1 < v2 ? -1 : v1 > v2 ? 1 : 0);
+}
+
+static void
+bdd_add_symbol(GList **symsp, cml_node *symbol)
+{
+    if (g_list_find(*symsp, symbol) == 0)
+    	*symsp = g_list_insert_sorted(*symsp, symbol, compare_ptrs);
+}
+
+gboolean
+bdd_syms_intersect(const GList *syms1, const GList *syms2)
+{
+    while (syms1 != 0 && syms2 != 0)
+    {
+    	if (syms1->data == syms2->data)
+	    return TRUE;
+	if (compare_ptrs(syms1->data, syms2->data) < 0)
+	    syms1 = syms1->next;
+	else
+	    syms2 = syms2->next;
+    }
+    return FALSE;
+}
+
+/*============================================================*/
+
+bdd_t
+bdd_from_expr(bdd_manager_t *m, const cml_expr *expr, GList **symsp)
+{
+    const cml_expr *sym, *val;
+    bdd_t f;
+
+    if (expr == 0)
+    	return BDD_TRUE;
+
+    switch (expr->type)
+    {
+    case E_AND:
+    	return bdd_and(m,
+	    	       bdd_from_expr(m, expr->children[0], symsp),
+		       bdd_from_expr(m, expr->children[1], symsp));
+
+    case E_OR:
+    	return bdd_or(m,
+	    	      bdd_from_expr(m, expr->children[0], symsp),
+		      bdd_from_expr(m, expr->children[1], symsp));
+
+    case E_NOT:
+    	return bdd_not(m, bdd_from_expr(m, expr->children[0], symsp));
+
+    case E_EQUALS:
+    case E_NOT_EQUALS:
+    	if (expr->children[0]->type == E_SYMBOL &&
+	    expr->children[1]->type == E_ATOM)
+	{
+	    sym = expr->children[0];
+	    val = expr->children[1];
+	}
+	else if (expr->children[1]->type == E_SYMBOL &&
+	    	 expr->children[0]->type == E_ATOM)
+	{
+	    sym = expr->children[1];
+	    val = expr->children[0];
+	}
+	else
+	    break;  /* e.g. the CONFIG_DECSTATION bug */
+	f = bdd_var(m, bdd_symbol_var(m, sym->symbol, &val->value));
+	bdd_add_symbol(symsp, sym->symbol);
+	return (expr->type == E_NOT_EQUALS ? bdd_not(m, f) : f);
+
+    case E_ATOM:
+    	if (expr->value.type == A_BOOLEAN || expr->value.type == A_TRISTATE)
+	    return (expr->value.value.tritval == CML_N ? BDD_FALSE : BDD_TRUE);
+	break;
+
+    default:
+	break;
+    }
+
+    return bdd_var(m, bdd_private_var(m, expr));
+}
+
+/*============================================================*/
+
+static int
+compare_strs(const void *v1, const void *v2)
+{
+    return strcmp(*(const char **)v1, *(const char **)v2);
+}
+
+/*
+ * Describe the first satisfying path through `f'.
+ */
+static char *
+bdd_path_string(bdd_manager_t *m, bdd_t f)
+{
+    GPtrArray *pa = g_ptr_array_new();
+    bdd_var_t *var;
+    gboolean positive;
+    char *s, *vs;
+    int i;
+
+    assert(f != BDD_FALSE);
+    while (f != BDD_TRUE)
+    {
+    	var = &m->vars[m->level[f]];
+	positive = (m->lo[f] == BDD_FALSE);
+
+	if (var->symbol == 0)
+	    s = g_strdup_printf((positive ? "%s" : "not %s"), var->desc);
+	else
+	{
+	    vs = cml_atom_value_as_string(&var->value);
+	    s = g_strdup_printf("%s%s%s", var->symbol->name,
+	    	    	    	(positive ? "==" : "!="), vs);
+	    g_free(vs);
+	}
+    	g_ptr_array_add(pa, s);
+	f = (positive ? m->hi[f] : m->lo[f]);
+    }
+
+    if (pa->len == 0)
+    	s = g_strdup("always");
+    else
+    {
+	qsort(pa->pdata, pa->len, sizeof(char*), compare_strs);
+	g_ptr_array_add(pa, 0);
+	s = g_strjoinv(" and ", (char **)pa->pdata);
+	for (i = 0 ; pa->pdata[i] != 0 ; i++)
+    	    g_free(pa->pdata[i]);
+    }
+    g_ptr_array_free(pa, TRUE);
+
+    return s;
+}
+
+/*
+ * Returns the condition that `f' holds whatever the values of
+ * any variables except those of the symbols in `shared'.
+ */
+static bdd_t
+bdd_restrict_to(
+    bdd_manager_t *m,
+    bdd_t f,
+    const GList *syms,
+    const GList *shared,
+    unsigned char *quant)
+{
+    const GList *list;
+    bdd_t excl = BDD_TRUE;
+    int v;
+
+    for (list = syms ; list != 0 ; list = list->next)
+    	if (g_list_find((GList *)shared, list->data) == 0)
+	    excl = bdd_and(m, excl, bdd_exclusive(m, (cml_node *)list->data));
+
+    for (v = 0 ; v < m->nvars ; v++)
+    	quant[v] = (m->vars[v].symbol == 0 ||
+	    	    g_list_find((GList *)shared, m->vars[v].symbol) == 0);
+
+    /* forall others: (exclusive -> f) */
+    return bdd_forall(m, bdd_or(m, bdd_not(m, excl), f), quant);
+}
+
+char *
+bdd_overlap(
+    bdd_manager_t *m,
+    bdd_t f1, const GList *syms1,
+    bdd_t f2, const GList *syms2)
+{
+    GList *shared = 0;
+    const GList *list;
+    unsigned char *quant;
+    bdd_t g;
+
+    if (f1 == BDD_FALSE || f2 == BDD_FALSE)
+    	return 0;
+
+    if (f1 == BDD_TRUE || f2 == BDD_TRUE)
+    {
+    	/* one branch applies everywhere: any consistent case of the other */
+	g = bdd_and(m, bdd_and(m, f1, f2),
+	    	    bdd_and(m, bdd_exclusive_list(m, syms1),
+		    	       bdd_exclusive_list(m, syms2)));
+	return (g == BDD_FALSE ? 0 : bdd_path_string(m, g));
+    }
+
+    for (list = syms1 ; list != 0 ; list = list->next)
+    	if (g_list_find((GList *)syms2, list->data) != 0)
+	    shared = g_list_append(shared, list->data);
+    if (shared == 0)
+    	return 0;
+
+    quant = g_new(unsigned char, m->nvars);
+    g = bdd_and(m,
+    	    bdd_restrict_to(m, f1, syms1, shared, quant),
+	    bdd_restrict_to(m, f2, syms2, shared, quant));
+    g = bdd_and(m, g, bdd_exclusive_list(m, shared));
+    g_free(quant);
+    g_list_free(shared);
+
+    return (g == BDD_FALSE ? 0 : bdd_path_string(m, g));
+}
+
+/*============================================================*/
+#endif /* OVERLAP_BDD */
+/*END*/
@@ -0,0 +1,70 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+ 
+#ifndef _bdd_h_
+#define _bdd_h_ 1
+
+#include <glib.h>
+
+/*
+ * Package for handling CML1 expressions as reduced ordered Binary
+ * Decision Diagrams, which is useful for detecting branches with
+ * overlapping conditions.  All the BDDs built by one bdd_manager_t
+ * share a single hash-consed node table, so equivalent conditions
+ * are represented by the same bdd_t.
+ */
+
+typedef int bdd_t;
+typedef struct bdd_manager_s bdd_manager_t;
+
+#define BDD_FALSE   0
+#define BDD_TRUE    1
+
+extern bdd_manager_t *bdd_manager_new(void);
+extern void bdd_manager_delete(bdd_manager_t *);
+
+extern bdd_t bdd_not(bdd_manager_t *, bdd_t f);
+extern bdd_t bdd_and(bdd_manager_t *, bdd_t f, bdd_t g);
+extern bdd_t bdd_or(bdd_manager_t *, bdd_t f, bdd_t g);
+
+/*
+ * Convert a gcml2 expression into a bdd_t.  Only handles the
+ * subset of expressions generated by the CML1 parser, anything
+ * else becomes a variable private to that subexpression.  The
+ * symbols tested are merged into the sorted list *symsp.
+ */
+extern bdd_t bdd_from_expr(bdd_manager_t *, const cml_expr *expr, GList **symsp);
+
+/*
+ * Returns a new string describing values for the symbols in both
+ * `syms1' and `syms2' for which both conditions are true whatever
+ * the values of any other symbols, or 0 if there are none.  A
+ * condition which is always true overlaps any satisfiable one.
+ * The string needs to be g_free()d.
+ */
+extern char *bdd_overlap(bdd_manager_t *,
+    	    	    	 bdd_t f1, const GList *syms1,
+			 bdd_t f2, const GList *syms2);
+
+/*
+ * Returns TRUE if the sorted symbol lists have a symbol in common.
+ */
+extern gboolean bdd_syms_intersect(const GList *syms1, const GList *syms2);
+
+#endif /* _bdd_h_ */
@@ -19,6 +19,7 @@
  
 #include "common.h"
 #include "private.h"
+#include <sys/stat.h>
 
 CVSID("$Id: blob.c,v 1.5 2001/04/23 06:44:43 gnb Exp $");
 
@@ -64,5 +65,87 @@ blob_delete(cml_blob *blob)
     g_free(blob);
 }
 
+/*============================================================*/
+
+/*
+ * Remember that a rules file can't be read back, so that the
+ * error is reported once rather than on every repaint.
+ */
+static void
+textref_file_failed(cml_rulebase *rb, const char *filename)
+{
+    cml_file_stamp *stamp;
+
+    if (rb->file_stamps == 0)
+    	rb->file_stamps = g_hash_table_new(g_direct_hash, g_direct_equal);
+    if ((stamp = g_hash_table_lookup(rb->file_stamps, filename)) == 0)
+    {
+	stamp = g_new0(cml_file_stamp, 1);
+	g_hash_table_insert(rb->file_stamps, (gpointer)filename, stamp);
+    }
+    stamp->unreadable = TRUE;
+}
+
+/*
+ * Reads the region from the file into a new nul-terminated
+ * string, or returns 0 if it can't be read.  A file which has
+ * changed since the rulebase was parsed is refused, since the
+ * region's offset no longer means anything.  Once a file has
+ * failed it isn't tried again until the rules are reparsed.
+ */
+char *
+textref_read(cml_rulebase *rb, const cml_text_ref *ref)
+{
+    FILE *fp;
+    char *buf;
+    struct stat sb;
+    const cml_file_stamp *stamp = 0;
+    cml_location loc;
+    
+    if (ref->length == 0)
+    	return 0;
+    if (rb->file_stamps != 0)
+    	stamp = g_hash_table_lookup(rb->file_stamps, ref->filename);
+    if (stamp != 0 && stamp->unreadable)
+    	return 0;
+	
+    if ((fp = fopen(ref->filename, "r")) == 0)
+    {
+    	cml_perror(ref->filename);
+	textref_file_failed(rb, ref->filename);
+	return 0;
+    }
+    
+    loc.filename = ref->filename;
+    loc.lineno = 0;
+    if (stamp != 0 &&
+    	(fstat(fileno(fp), &sb) < 0 ||
+	 sb.st_size != stamp->size ||
+	 sb.st_mtime != stamp->mtime))
+    {
+    	cml_errorl(&loc, "file has changed since the rules were read, "
+	    	    	 "reload them to see its text.");
+	textref_file_failed(rb, ref->filename);
+	fclose(fp);
+	return 0;
+    }
+    
+    buf = g_new(char, ref->length+1);
+    if (fseek(fp, ref->offset, SEEK_SET) < 0 ||
+    	fread(buf, 1, ref->length, fp) != ref->length)
+    {
+    	cml_errorl(&loc, "can't read %lu bytes at offset %lu.",
+	    	   ref->length, ref->offset);
+	textref_file_failed(rb, ref->filename);
+	g_free(buf);
+	fclose(fp);
+	return 0;
+    }
+    buf[ref->length] = '\0';
+    fclose(fp);
+    
+    return buf;
+}
+
 /*============================================================*/
 /*END*/
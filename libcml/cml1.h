@@ -20,13 +20,27 @@
 #ifndef _cml1_h_
 #define _cml1_h_ 1
 
+/*
+ * Overlapping branch conditions are detected using BDDs by default,
+ * or with the older DNF code if built with OVERLAP_DNF=1.
+ */
+#ifndef OVERLAP_BDD
+#if defined(OVERLAP_DNF) && OVERLAP_DNF
+#define OVERLAP_BDD 0
+#else
+#define OVERLAP_BDD 1
+#endif
+#endif
+
 #ifndef OVERLAP_DNF
-#define OVERLAP_DNF 1
+#define OVERLAP_DNF 0
 #endif
 
 
 #include "private.h"
-#if OVERLAP_DNF
+#if OVERLAP_BDD
+#include "bdd.h"
+#elif OVERLAP_DNF
 #include "dnf.h"
 #endif
 
@@ -82,7 +96,11 @@ struct cml_branch_s
 #define BR_WAS_BANNER	    	(1<<9)	/* this branch's banner became the node's */
 
 
-#if OVERLAP_DNF
+#if OVERLAP_BDD
+    /* used in branches_overlap */
+    bdd_t cond_bdd;
+    GList *cond_syms;	    	/* symbols tested in cond, sorted */
+#elif OVERLAP_DNF
     /* ***HACK*** used in branches_overlap */
     dnf_t *cond_dnf;	    	
 #else
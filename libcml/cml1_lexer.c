@@ -768,6 +768,10 @@ yylex_push_file(const char *relfilename)
 	rec->location.lineno = yylocation.lineno;
     }
     
+    if (!rb_progress(rb, CML_PROGRESS_PARSE, relfilename,
+    	    	     g_list_length(rb->filenames), 0))
+    	return FALSE;
+
     filename = g_strdup(relfilename);
     if ((fp = fopen(filename, "r")) == 0)
     {
@@ -780,7 +784,8 @@ yylex_push_file(const char *relfilename)
     
     /* create new record */
     rec = g_new(source_stack_rec, 1);
-    rec->location.filename = filename;
+    rec->location.filename = rb_intern_take(rb, filename);
+    rb_add_filename(rb, rec->location.filename, fp);
     rec->location.lineno = 1;
     rec->filep = fp;
     rec->buffer = cml1_yy_create_buffer(rec->filep,YY_BUF_SIZE);
@@ -788,7 +793,6 @@ yylex_push_file(const char *relfilename)
     /* push new record */    
     source_stack = g_list_prepend(source_stack, rec);
     yylocation = rec->location;
-    rb->filenames = g_list_prepend(rb->filenames, filename);
     cml1_yy_switch_to_buffer(rec->buffer);
     lineno_debug();
     
@@ -834,7 +838,7 @@ cml1_yywrap(void)
 
 /* used to handle multi-line prompts */
 
-#line 838 "cml1_lexer.c"
+#line 842 "cml1_lexer.c"
 
 #define INITIAL 0
 #define CON_SOURCE 1
@@ -1018,10 +1022,10 @@ YY_DECL
 	register char *yy_cp, *yy_bp;
 	register int yy_act;
     
-#line 138 "cml1_lexer.l"
+#line 142 "cml1_lexer.l"
 
 
-#line 1025 "cml1_lexer.c"
+#line 1029 "cml1_lexer.c"
 
 	if ( !(yy_init) )
 		{
@@ -1106,232 +1110,232 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 140 "cml1_lexer.l"
+#line 144 "cml1_lexer.l"
 return K_AND;
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 141 "cml1_lexer.l"
+#line 145 "cml1_lexer.l"
 statement_start(); return K_BOOL;
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 142 "cml1_lexer.l"
+#line 146 "cml1_lexer.l"
 statement_start(); return K_CHOICE;
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 143 "cml1_lexer.l"
+#line 147 "cml1_lexer.l"
 statement_start(); return K_COMMENT;
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 144 "cml1_lexer.l"
+#line 148 "cml1_lexer.l"
 statement_start(); return K_DEFINE_BOOL;
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 145 "cml1_lexer.l"
+#line 149 "cml1_lexer.l"
 statement_start(); return K_DEFINE_HEX;
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 146 "cml1_lexer.l"
+#line 150 "cml1_lexer.l"
 statement_start(); return K_DEFINE_INT;
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 147 "cml1_lexer.l"
+#line 151 "cml1_lexer.l"
 statement_start(); return K_DEFINE_STRING;
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 148 "cml1_lexer.l"
+#line 152 "cml1_lexer.l"
 statement_start(); return K_DEFINE_TRISTATE;
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 149 "cml1_lexer.l"
+#line 153 "cml1_lexer.l"
 statement_start(); return K_DEP_BOOL;
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 150 "cml1_lexer.l"
+#line 154 "cml1_lexer.l"
 statement_start(); return K_DEP_HEX;
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 151 "cml1_lexer.l"
+#line 155 "cml1_lexer.l"
 statement_start(); return K_DEP_INT;
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 152 "cml1_lexer.l"
+#line 156 "cml1_lexer.l"
 statement_start(); return K_DEP_MBOOL;
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 153 "cml1_lexer.l"
+#line 157 "cml1_lexer.l"
 statement_start(); return K_DEP_STRING;
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 154 "cml1_lexer.l"
+#line 158 "cml1_lexer.l"
 statement_start(); return K_DEP_TRISTATE;
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 155 "cml1_lexer.l"
+#line 159 "cml1_lexer.l"
 return K_ELSE;
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 156 "cml1_lexer.l"
+#line 160 "cml1_lexer.l"
 return K_ENDMENU;
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 157 "cml1_lexer.l"
+#line 161 "cml1_lexer.l"
 return K_FI;
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 158 "cml1_lexer.l"
+#line 162 "cml1_lexer.l"
 statement_start(); return K_HEX;
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 159 "cml1_lexer.l"
+#line 163 "cml1_lexer.l"
 return K_IF;
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
-#line 160 "cml1_lexer.l"
+#line 164 "cml1_lexer.l"
 statement_start(); return K_INT;
 	YY_BREAK
 case 22:
 YY_RULE_SETUP
-#line 161 "cml1_lexer.l"
+#line 165 "cml1_lexer.l"
 statement_start(); return K_MAINMENU_NAME;
 	YY_BREAK
 case 23:
 YY_RULE_SETUP
-#line 162 "cml1_lexer.l"
+#line 166 "cml1_lexer.l"
 statement_start(); return K_MAINMENU_OPTION;
 	YY_BREAK
 case 24:
 YY_RULE_SETUP
-#line 163 "cml1_lexer.l"
+#line 167 "cml1_lexer.l"
 return K_NEXT_COMMENT;
 	YY_BREAK
 case 25:
 YY_RULE_SETUP
-#line 164 "cml1_lexer.l"
+#line 168 "cml1_lexer.l"
 return K_NULL;
 	YY_BREAK
 case 26:
 YY_RULE_SETUP
-#line 165 "cml1_lexer.l"
+#line 169 "cml1_lexer.l"
 return K_OR;
 	YY_BREAK
 case 27:
 YY_RULE_SETUP
-#line 166 "cml1_lexer.l"
+#line 170 "cml1_lexer.l"
 return K_EQUALS;
 	YY_BREAK
 case 28:
 YY_RULE_SETUP
-#line 167 "cml1_lexer.l"
+#line 171 "cml1_lexer.l"
 return K_NOT;
 	YY_BREAK
 case 29:
 YY_RULE_SETUP
-#line 168 "cml1_lexer.l"
+#line 172 "cml1_lexer.l"
 return K_NOT_EQUALS;
 	YY_BREAK
 case 30:
 YY_RULE_SETUP
-#line 169 "cml1_lexer.l"
+#line 173 "cml1_lexer.l"
 BEGIN(CON_SOURCE);
 	YY_BREAK
 case 31:
 YY_RULE_SETUP
-#line 170 "cml1_lexer.l"
+#line 174 "cml1_lexer.l"
 statement_start(); return K_STRING;
 	YY_BREAK
 case 32:
 YY_RULE_SETUP
-#line 171 "cml1_lexer.l"
+#line 175 "cml1_lexer.l"
 return K_THEN;
 	YY_BREAK
 case 33:
 YY_RULE_SETUP
-#line 172 "cml1_lexer.l"
+#line 176 "cml1_lexer.l"
 statement_start(); return K_TRISTATE;
 	YY_BREAK
 case 34:
 YY_RULE_SETUP
-#line 173 "cml1_lexer.l"
+#line 177 "cml1_lexer.l"
 statement_start(); return K_UNSET;
 	YY_BREAK
 case 35:
 YY_RULE_SETUP
-#line 175 "cml1_lexer.l"
+#line 179 "cml1_lexer.l"
 statement_start(); return K_TEST_ASSERT;
 	YY_BREAK
 case 36:
 YY_RULE_SETUP
-#line 176 "cml1_lexer.l"
+#line 180 "cml1_lexer.l"
 statement_start(); return K_TEST_CLEAR;
 	YY_BREAK
 case 37:
 YY_RULE_SETUP
-#line 177 "cml1_lexer.l"
+#line 181 "cml1_lexer.l"
 statement_start(); return K_TEST_COMMIT;
 	YY_BREAK
 case 38:
 YY_RULE_SETUP
-#line 178 "cml1_lexer.l"
+#line 182 "cml1_lexer.l"
 statement_start(); return K_TEST_FREEZE;
 	YY_BREAK
 case 39:
 YY_RULE_SETUP
-#line 179 "cml1_lexer.l"
+#line 183 "cml1_lexer.l"
 statement_start(); return K_TEST_ERROR;
 	YY_BREAK
 case 40:
 YY_RULE_SETUP
-#line 180 "cml1_lexer.l"
+#line 184 "cml1_lexer.l"
 statement_start(); return K_TEST_NOERROR;
 	YY_BREAK
 case 41:
 YY_RULE_SETUP
-#line 181 "cml1_lexer.l"
+#line 185 "cml1_lexer.l"
 return K_TEST_PARSETEST;
 	YY_BREAK
 case 42:
 YY_RULE_SETUP
-#line 182 "cml1_lexer.l"
+#line 186 "cml1_lexer.l"
 statement_start(); return K_TEST_SET;
 	YY_BREAK
 case 43:
 YY_RULE_SETUP
-#line 183 "cml1_lexer.l"
+#line 187 "cml1_lexer.l"
 statement_start(); return K_TEST_SUCCEEDED;
 	YY_BREAK
 case 44:
 YY_RULE_SETUP
-#line 184 "cml1_lexer.l"
+#line 188 "cml1_lexer.l"
 statement_start(); return K_TEST_VISIBLE;
 	YY_BREAK
 case 45:
 YY_RULE_SETUP
-#line 185 "cml1_lexer.l"
+#line 189 "cml1_lexer.l"
 statement_start(); return K_TEST_SAVEABLE;
 	YY_BREAK
 case 46:
 YY_RULE_SETUP
-#line 187 "cml1_lexer.l"
+#line 191 "cml1_lexer.l"
 {
 		    yylval.string = g_strdup(cml1_yytext);
 		    return TRISTATE;
@@ -1339,7 +1343,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 47:
 YY_RULE_SETUP
-#line 192 "cml1_lexer.l"
+#line 196 "cml1_lexer.l"
 {
     	    	    cml1_yytext[2] = '\0';
 		    yylval.string = g_strdup(cml1_yytext+1);
@@ -1348,7 +1352,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 48:
 YY_RULE_SETUP
-#line 198 "cml1_lexer.l"
+#line 202 "cml1_lexer.l"
 {
 		    yylval.string = g_strdup(cml1_yytext);
 		    return SYMBOL;
@@ -1356,7 +1360,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 49:
 YY_RULE_SETUP
-#line 203 "cml1_lexer.l"
+#line 207 "cml1_lexer.l"
 {
 		    yylval.string = g_strdup(cml1_yytext+1);
 		    return SYMBOLREF;
@@ -1364,7 +1368,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 50:
 YY_RULE_SETUP
-#line 208 "cml1_lexer.l"
+#line 212 "cml1_lexer.l"
 {
     	    	    cml1_yytext[cml1_yyleng-1] = '\0'; /* lose trailing quote */
 		    yylval.string = g_strdup(cml1_yytext+2);
@@ -1373,7 +1377,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 51:
 YY_RULE_SETUP
-#line 214 "cml1_lexer.l"
+#line 218 "cml1_lexer.l"
 {
     	    	    /* The undocumented $ARCH symbol is used in some rules */
     	    	    cml1_yytext[cml1_yyleng-1] = '\0'; /* lose trailing quote */
@@ -1385,7 +1389,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 52:
 YY_RULE_SETUP
-#line 223 "cml1_lexer.l"
+#line 227 "cml1_lexer.l"
 {
     	    	    /*
 		     * Unquoted string immediately after `source' is filename
@@ -1398,7 +1402,7 @@ YY_RULE_SETUP
 case 53:
 /* rule 53 can match eol */
 YY_RULE_SETUP
-#line 232 "cml1_lexer.l"
+#line 236 "cml1_lexer.l"
 {
     	    	    /* start of a multi-line prompt */
 		    /*
@@ -1417,7 +1421,7 @@ YY_RULE_SETUP
 case 54:
 /* rule 54 can match eol */
 YY_RULE_SETUP
-#line 247 "cml1_lexer.l"
+#line 251 "cml1_lexer.l"
 {
     	    	    /* continuation of a multi-line prompt */
 		    /* Note: for some reason the corpus as of 2.5.20 comprised
@@ -1437,7 +1441,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 55:
 YY_RULE_SETUP
-#line 264 "cml1_lexer.l"
+#line 268 "cml1_lexer.l"
 {
     	    	    /* end of a multi-line prompt */
 		    cml1_yyleng--;
@@ -1451,7 +1455,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 56:
 YY_RULE_SETUP
-#line 275 "cml1_lexer.l"
+#line 279 "cml1_lexer.l"
 {
     	    	    /* single-line prompt, double-quoted or single-quoted */
 		    if (!strncmp(cml1_yytext, "\"CONFIG_", 8) &&
@@ -1466,7 +1470,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 57:
 YY_RULE_SETUP
-#line 287 "cml1_lexer.l"
+#line 291 "cml1_lexer.l"
 {
     	    	    yylval.string = g_strdup(cml1_yytext);
 		    return DECIMAL;
@@ -1474,7 +1478,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 58:
 YY_RULE_SETUP
-#line 292 "cml1_lexer.l"
+#line 296 "cml1_lexer.l"
 {
     	    	    yylval.string = g_strdup(cml1_yytext);
 		    return HEXADECIMAL;
@@ -1482,14 +1486,14 @@ YY_RULE_SETUP
 	YY_BREAK
 case 59:
 YY_RULE_SETUP
-#line 297 "cml1_lexer.l"
+#line 301 "cml1_lexer.l"
 {
     	    	    /* eat comments (matches to end of line or file) */
     	    	}
 	YY_BREAK
 case 60:
 YY_RULE_SETUP
-#line 301 "cml1_lexer.l"
+#line 305 "cml1_lexer.l"
 {
     	    	    yylval.string = g_strdup(cml1_yytext);
 		    return WORD;
@@ -1497,13 +1501,13 @@ YY_RULE_SETUP
 	YY_BREAK
 case 61:
 YY_RULE_SETUP
-#line 306 "cml1_lexer.l"
+#line 310 "cml1_lexer.l"
 /* eat whitespace */
 	YY_BREAK
 case 62:
 /* rule 62 can match eol */
 YY_RULE_SETUP
-#line 309 "cml1_lexer.l"
+#line 313 "cml1_lexer.l"
 {
     	    	    /* escaped newline */
     	    	    ++yylocation.lineno;
@@ -1513,7 +1517,7 @@ YY_RULE_SETUP
 case 63:
 /* rule 63 can match eol */
 YY_RULE_SETUP
-#line 315 "cml1_lexer.l"
+#line 319 "cml1_lexer.l"
 {
     	    	    /* escaped newline */
     	    	    ++yylocation.lineno;
@@ -1523,7 +1527,7 @@ YY_RULE_SETUP
 case 64:
 /* rule 64 can match eol */
 YY_RULE_SETUP
-#line 321 "cml1_lexer.l"
+#line 325 "cml1_lexer.l"
 {
     	    	    ++yylocation.lineno;
 		    lineno_debug();
@@ -1533,7 +1537,7 @@ YY_RULE_SETUP
 case 65:
 /* rule 65 can match eol */
 YY_RULE_SETUP
-#line 327 "cml1_lexer.l"
+#line 331 "cml1_lexer.l"
 {
     	    	    ++yylocation.lineno;
 		    lineno_debug();
@@ -1542,17 +1546,17 @@ YY_RULE_SETUP
 	YY_BREAK
 case 66:
 YY_RULE_SETUP
-#line 333 "cml1_lexer.l"
+#line 337 "cml1_lexer.l"
 {
     	    	    return cml1_yytext[0];
 		}
 	YY_BREAK
 case 67:
 YY_RULE_SETUP
-#line 337 "cml1_lexer.l"
+#line 341 "cml1_lexer.l"
 ECHO;
 	YY_BREAK
-#line 1556 "cml1_lexer.c"
+#line 1560 "cml1_lexer.c"
 case YY_STATE_EOF(INITIAL):
 case YY_STATE_EOF(CON_SOURCE):
 case YY_STATE_EOF(CON_MLPROMPT):
@@ -2551,7 +2555,7 @@ void cml1_yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 337 "cml1_lexer.l"
+#line 341 "cml1_lexer.l"
 
 
 
@@ -470,12 +470,12 @@ add_compound_branch(char *banner, cml_branch_t *branch)
 	    mn->flags |= MN_FLAG_IS_RADIO;
 	mn_add_child(menu_top(), mn);
 	/* TODO: check that normalised banners are the same */
-	mn->banner = banner;
+	mn->cold->banner = rb_intern_take(rb, banner);
     }
 
-    mn->location = branch->location;
+    mn->cold->location = branch->location;
     branch->node = mn;
-    mn->user_data = g_list_append((GList *)mn->user_data, branch);
+    mn->cold->user_data = g_list_append((GList *)mn->cold->user_data, branch);
     
     DDPRINTF1(DEBUG_CONVERT, "\"%s\"\n", mn->name);
 
@@ -614,7 +614,7 @@ find_banner_location(const cml_node *mn)
     GList *iter;
     const cml_location *loc = 0;
     
-    for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+    for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
     {
     	cml_branch_t *branch = (cml_branch_t *)iter->data;
 	
@@ -641,7 +641,7 @@ add_primitive_branch(char *name, char *banner, cml_branch_t *branch)
 	    	       "%s \"%s\" redefined as primitive",
 		        mn_get_treetype_as_string(mn),
 		       mn->name);
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 	    	       "location of previous definition");
 	    return 0;
 	}
@@ -650,31 +650,31 @@ add_primitive_branch(char *name, char *banner, cml_branch_t *branch)
 	    /* result of a forward reference */
 	    mn_add_child(menu_top(), mn);
 
-    	    while (mn->forward_refs != 0)
+    	    while (mn->cold->forward_refs != 0)
 	    {
-	    	cml_location *loc = (cml_location *)mn->forward_refs->data;
+	    	cml_location *loc = (cml_location *)mn->cold->forward_refs->data;
 		
 		if (mn->expr_count > 0 &&
 	    	    rb_warning_enabled(rb, CW_FORWARD_REFERENCE))
 		    cml_warningl(loc,
 			"forward reference to \"%s\"", mn->name);
 		g_free(loc);
-	    	mn->forward_refs = g_list_remove_link(mn->forward_refs, mn->forward_refs);
+	    	mn->cold->forward_refs = g_list_remove_link(mn->cold->forward_refs, mn->cold->forward_refs);
 	    }
 	    if (mn->expr_count > 0 &&
 	    	rb_warning_enabled(rb, CW_FORWARD_REFERENCE))
 		cml_warningl(&branch->location,
 	    		   "location of definition");
-    	    while (mn->forward_deps != 0)
+    	    while (mn->cold->forward_deps != 0)
 	    {
-	    	cml_location *loc = (cml_location *)mn->forward_deps->data;
+	    	cml_location *loc = (cml_location *)mn->cold->forward_deps->data;
 		
 		if (rb_warning_enabled(rb, CW_FORWARD_DEPENDENCY))
 		    cml_warningl(loc,
 	    		"forward declared symbol \"%s\" used in dependency list",
 			mn->name);
 		g_free(loc);
-	    	mn->forward_deps = g_list_remove_link(mn->forward_deps, mn->forward_deps);
+	    	mn->cold->forward_deps = g_list_remove_link(mn->cold->forward_deps, mn->cold->forward_deps);
 	    }
 	}
 	else
@@ -691,7 +691,7 @@ add_primitive_branch(char *name, char *banner, cml_branch_t *branch)
 		cml_warningl(&branch->location, 
 	    		   "symbol \"%s\" redefined with different parent",
 			   mn->name);
-		cml_warningl(&mn->location,
+		cml_warningl(&mn->cold->location,
 	    		   "location of previous definition");
 	    }
 	    if (branch->type != N_DEFINE && (mn->flags & MN_WEAK_POSITION))
@@ -709,14 +709,14 @@ add_primitive_branch(char *name, char *banner, cml_branch_t *branch)
 	{
 	    branch->flags |= BR_HAS_BANNER;
 	    banner = normalise_prompt(banner, &branch->flags);
-	    if (mn->banner == 0)
+	    if (mn->cold->banner == 0)
 	    {
-		mn->banner = banner;
+		mn->cold->banner = rb_intern_take(rb, banner);
 		branch->flags |= BR_WAS_BANNER;
 	    }
 	    else
 	    {
-		if (strcmp(mn->banner, banner))
+		if (strcmp(mn->cold->banner, banner))
 		{
 		    if (rb_warning_enabled(rb, CW_DIFFERENT_BANNER))
 		    {
@@ -743,7 +743,7 @@ add_primitive_branch(char *name, char *banner, cml_branch_t *branch)
 	if (banner != 0)
 	{
 	    banner = normalise_prompt(banner, &branch->flags);
-	    mn->banner = banner;
+	    mn->cold->banner = rb_intern_take(rb, banner);
 	    branch->flags |= BR_WAS_BANNER|BR_HAS_BANNER;
 	}
 	if (branch->type == N_DEFINE)
@@ -798,7 +798,7 @@ add_primitive_branch(char *name, char *banner, cml_branch_t *branch)
 		if (rb_warning_enabled(rb, CW_FORWARD_DEPENDENCY) &&
 		    expr->symbol->parent == 0)
 		    /* Remember location for reporting later. */
-		    expr->symbol->forward_deps = g_list_append(expr->symbol->forward_deps,
+		    expr->symbol->cold->forward_deps = g_list_append(expr->symbol->cold->forward_deps,
 				    	g_memdup(&branch->location,
 					    sizeof(branch->location)));
 #if 0
@@ -820,7 +820,7 @@ add_primitive_branch(char *name, char *banner, cml_branch_t *branch)
 	 branch->value_type != A_BOOLEAN ||
 	 ((cml_expr *)branch->exprs->data)->type != E_ATOM ||
 	 ((cml_expr *)branch->exprs->data)->value.value.tritval != CML_Y ||
-	 mn->user_data != 0))
+	 mn->cold->user_data != 0))
     {
     	cml_warningl(&branch->location,
 	    "misuse of constant symbol \"%s\"",
@@ -855,9 +855,9 @@ add_primitive_branch(char *name, char *banner, cml_branch_t *branch)
     
 
     assert(mn->parent != 0);
-    mn->location = branch->location;
+    mn->cold->location = branch->location;
     branch->node = mn;
-    mn->user_data = g_list_append((GList *)mn->user_data, branch);
+    mn->cold->user_data = g_list_append((GList *)mn->cold->user_data, branch);
     
     if (branch->flags & BR_HAS_BANNER)
 	check_magic_tags(branch);
@@ -961,27 +961,27 @@ check_undefined_symbol(gpointer key, gpointer value, gpointer user_data)
 
     if (mn->treetype == MN_UNKNOWN)
     {
-    	while (mn->forward_refs != 0)
+    	while (mn->cold->forward_refs != 0)
 	{
-	    cml_location *loc = (cml_location *)mn->forward_refs->data;
+	    cml_location *loc = (cml_location *)mn->cold->forward_refs->data;
 
 	    if (rb_warning_enabled(rb, CW_UNDECLARED_SYMBOL))
 		cml_warningl(loc,
 		    "symbol \"%s\" used but not declared, defaults to \"\"",
 		    mn->name);
 	    g_free(loc);
-	    mn->forward_refs = g_list_remove_link(mn->forward_refs, mn->forward_refs);
+	    mn->cold->forward_refs = g_list_remove_link(mn->cold->forward_refs, mn->cold->forward_refs);
 	}
-    	while (mn->forward_deps != 0)
+    	while (mn->cold->forward_deps != 0)
 	{
-	    cml_location *loc = (cml_location *)mn->forward_deps->data;
+	    cml_location *loc = (cml_location *)mn->cold->forward_deps->data;
 
 	    if (rb_warning_enabled(rb, CW_UNDECLARED_DEPENDENCY))
 		cml_warningl(loc,
 		    "symbol \"%s\" used in dependency list but not declared",
 		    mn->name);
 	    g_free(loc);
-	    mn->forward_deps = g_list_remove_link(mn->forward_deps, mn->forward_deps);
+	    mn->cold->forward_deps = g_list_remove_link(mn->cold->forward_deps, mn->cold->forward_deps);
 	}
 	
 	mn->treetype = MN_SYMBOL;
@@ -1165,7 +1165,7 @@ mainmenu_name_statement:  K_MAINMENU_NAME PROMPT EOL
 				else
 				{
     				    rb->banner = rb_add_node(rb, "__banner");
-				    rb->banner->banner = $2;
+				    rb->banner->cold->banner = rb_intern_take(rb, $2);
 				}
 			    }
     	    	    	;
@@ -1177,7 +1177,7 @@ menu_definition:	  menu_def_header block K_ENDMENU EOL
 /*
 			| menu_def_header block error EOL
 			    {
-			    	cml_errorl(&menu_top()->location,
+			    	cml_errorl(&menu_top()->cold->location,
 				    	    "unbalanced mainmenu_option");
 			    	YYABORT;
 			    }
@@ -1563,7 +1563,7 @@ choice_statement:   	  K_CHOICE PROMPT PROMPT word_or_symbol EOL
 				    if (rb_warning_enabled(rb, CW_DEFAULT_NOT_IN_CHOICES))
 					cml_warningl(&branch->location,
 				    	    "default \"%s\" not in choices list, using \"%s\"",
-						$4, defchild->banner);
+						$4, defchild->cold->banner);
 				}
 				if (deflt != 0)
 				    branch->choice_default = g_strdup(deflt);
@@ -1740,14 +1740,14 @@ logical_atom:	    	  SYMBOLREF
 				{
 				    /* handle forward references */
 				    mn = rb_add_node(rb, $1);
-				    mn->location = yylocation;
+				    mn->cold->location = yylocation;
 				    if (is_constant_symbol($1))
 				    	mn->flags |= MN_CONSTANT;
 				}
 				if (mn->parent == 0)
 				{
 				    /* Remember location for reporting later. */
-				    mn->forward_refs = g_list_append(mn->forward_refs,
+				    mn->cold->forward_refs = g_list_append(mn->cold->forward_refs,
 				    	    	    	g_memdup(&yylocation,
 							    sizeof(yylocation)));
 				}
@@ -1806,8 +1806,24 @@ symbols:    	    	  SYMBOL
 
 %%
 
+/* the parser calls yylex() below, which times the real lexer */
+#define YY_DECL static int lex_token(void)
 #include "cml1_lexer.c"
 
+static int
+yylex(void)
+{
+    double start;
+    int token;
+
+    if (rb->timings == 0)
+    	return lex_token();
+    start = cml_timer_now();
+    token = lex_token();
+    rb_add_file_lex_timing(rb, yylocation.filename, cml_timer_now() - start);
+    return token;
+}
+
 static void
 yyerror(const char *fmt, ...)
 {
@@ -1820,8 +1836,6 @@ yyerror(const char *fmt, ...)
 
 /*============================================================*/
 
-extern void cml1_pass2(cml_rulebase *rb);
-
 static gboolean
 str_has_prefix(const char *s, const char *pref)
 {
@@ -1859,6 +1873,7 @@ gboolean
 _cml_rulebase_parse_cml1(cml_rulebase *rbi, const char *filename)
 {
     gboolean failed = FALSE;
+    int parse_failed;
     
 #if DEBUG
     cml1_yy_flex_debug = (debug & DEBUG_LEXER ? 1 : 0);
@@ -1901,7 +1916,10 @@ _cml_rulebase_parse_cml1(cml_rulebase *rbi, const char *filename)
 	    	    	expr_new_symbol(cml_rulebase_find_node(rb, "ARCH")),
 			expr_new_atom_v(A_STRING, intuit_arch(filename))));
     
-    if (yyparse())
+    PHASE_BEGIN(rb, CML_PHASE_PARSE)
+    parse_failed = yyparse();
+    PHASE_END(rb, CML_PHASE_PARSE)
+    if (parse_failed)
     {
     	/* clean up possibly unbalanced parsetime stacks */
     	while (cond_stack != 0)
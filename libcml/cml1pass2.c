@@ -218,7 +218,7 @@ calc_compound_treetype(cml_node *mn)
     GList *iter;
     const cml_location *prev_loc = 0;
     
-    for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+    for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
     {
     	cml_branch_t *branch = (cml_branch_t *)iter->data;
 	
@@ -283,7 +283,7 @@ pass2_compound(cml_rulebase *rb, cml_node *mn)
     	return;
     }
 
-    for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+    for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
     {
     	cml_branch_t *branch = (cml_branch_t *)iter->data;
 
@@ -294,13 +294,13 @@ pass2_compound(cml_rulebase *rb, cml_node *mn)
     
 #if DEBUG
     if ((debug & DEBUG_CONVERT) &&
-    	g_list_length((GList *)mn->user_data) > 1)
+    	g_list_length((GList *)mn->cold->user_data) > 1)
     {
     	DDPRINTF2(DEBUG_CONVERT, "%s \"%s\" has multiple branches:\n",
 	    	branch_type_as_string(type),
 		mn->name);
 
-	for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+	for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
 	{
     	    cml_branch_t *branch = (cml_branch_t *)iter->data;
     	    DDPRINTF2(DEBUG_CONVERT, "    %s:%d\n",
@@ -361,7 +361,7 @@ calc_value_type(cml_node *mn)
     GList *iter;
     const cml_location *prevloc = 0;
     
-    for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+    for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
     {
     	cml_branch_t *branch = (cml_branch_t *)iter->data;
 	
@@ -435,7 +435,7 @@ calc_primitive_treetype(cml_node *mn)
     cml_node_treetype newtype;
     GList *iter;
     
-    for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+    for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
     {
     	cml_branch_t *branch = (cml_branch_t *)iter->data;
 	
@@ -526,7 +526,7 @@ calc_flags(cml_node *mn)
     
     memset(bflags, 0, sizeof(bflags));
 
-    for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+    for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
     {
     	cml_branch_t *branch = (cml_branch_t *)iter->data;
 
@@ -674,7 +674,101 @@ calc_branch_visibility_expr(cml_rulebase *rb, cml_branch_t *branch)
 
 /*============================================================*/
 
-#if OVERLAP_DNF
+#if OVERLAP_BDD
+
+static bdd_manager_t *overlap_bdd;  /* shared by all branch conditions */
+
+static gboolean
+branches_overlap(cml_branch_t *branch1, cml_branch_t *branch2)
+{
+    char *varb;
+    
+    varb = bdd_overlap(overlap_bdd,
+    	    	       branch1->cond_bdd, branch1->cond_syms,
+		       branch2->cond_bdd, branch2->cond_syms);
+    if (varb == 0)
+    	return FALSE;
+	
+    cml_warningl(&branch1->location, "overlap is \"%s\"", varb);
+    g_free(varb);
+    return TRUE;
+}
+
+static void
+free_bucket(gpointer key, gpointer value, gpointer user_data)
+{
+    g_list_free((GList *)value);
+}
+
+/*
+ * Two branches whose conditions test no symbol in common cannot
+ * overlap unless one of them is unconditional, so bucket the
+ * branches by the symbols they test and only mark as candidates
+ * those pairs which share a bucket.  Returns an n*n matrix of flags.
+ */
+static unsigned char *
+branch_overlap_candidates(cml_branch_t **branches, int n)
+{
+    unsigned char *cand = g_new0(unsigned char, n*n);
+    GHashTable *buckets;
+    GList *syms, *bucket;
+    int i, j;
+    
+    if (overlap_bdd == 0)
+    	overlap_bdd = bdd_manager_new();
+    buckets = g_hash_table_new(g_direct_hash, g_direct_equal);
+	
+    for (i = 0 ; i < n ; i++)
+    {
+    	cml_branch_t *branch = branches[i];
+	
+	branch->cond_bdd = bdd_from_expr(overlap_bdd, branch->cond,
+	    	    	    	    	 &branch->cond_syms);
+	if (branch->cond_bdd == BDD_TRUE)
+	{
+	    for (j = 0 ; j < n ; j++)
+		cand[i*n+j] = cand[j*n+i] = 1;
+	}
+
+    	for (syms = branch->cond_syms ; syms != 0 ; syms = syms->next)
+	{
+	    bucket = (GList *)g_hash_table_lookup(buckets, syms->data);
+	    for ( ; bucket != 0 ; bucket = bucket->next)
+	    {
+		j = GPOINTER_TO_INT(bucket->data);
+		cand[i*n+j] = cand[j*n+i] = 1;
+	    }
+	    bucket = (GList *)g_hash_table_lookup(buckets, syms->data);
+	    g_hash_table_insert(buckets, syms->data,
+	    	    	    	g_list_prepend(bucket, GINT_TO_POINTER(i)));
+	}
+    }
+    
+    g_hash_table_foreach(buckets, free_bucket, 0);
+    g_hash_table_destroy(buckets);
+    
+    return cand;
+}
+
+static void
+branch_overlap_cleanup(cml_branch_t *branch)
+{
+    g_list_free(branch->cond_syms);
+    branch->cond_syms = 0;
+    branch->cond_bdd = BDD_FALSE;
+}
+
+static void
+overlap_shutdown(void)
+{
+    if (overlap_bdd != 0)
+    {
+    	bdd_manager_delete(overlap_bdd);
+	overlap_bdd = 0;
+    }
+}
+
+#elif OVERLAP_DNF
 
 static gboolean
 branches_overlap(cml_branch_t *branch1, cml_branch_t *branch2)
@@ -745,6 +839,27 @@ branch_overlap_cleanup(cml_branch_t *branch)
     branch->cond_str = 0;
 }
 
+#endif
+
+#if !OVERLAP_BDD
+
+/*
+ * Without BDDs every pair of branches is a candidate.
+ */
+static unsigned char *
+branch_overlap_candidates(cml_branch_t **branches, int n)
+{
+    unsigned char *cand = g_new(unsigned char, n*n);
+    
+    memset(cand, 1, n*n);
+    return cand;
+}
+
+static void
+overlap_shutdown(void)
+{
+}
+
 #endif
 /*============================================================*/
 
@@ -796,20 +911,31 @@ classify_mixed_overlap(cml_branch_t *branch1, cml_branch_t *branch2)
 static void
 check_branches_are_disjoint(cml_node *mn)
 {
-    GList *iter1, *iter2;
+    GList *iter;
+    cml_branch_t **branches;
+    unsigned char *cand;
+    int i, j, n;
 
     DDPRINTF1(DEBUG_DNF, "checking %s for disjoint branches\n", mn->name);
     
-    for (iter1 = (GList *)mn->user_data ; iter1 != 0 ; iter1 = iter1->next)
+    if ((n = g_list_length((GList *)mn->cold->user_data)) < 2)
+    	return;
+    branches = g_new(cml_branch_t*, n);
+    for (iter = (GList *)mn->cold->user_data, i = 0 ; iter != 0 ; iter = iter->next)
+    	branches[i++] = (cml_branch_t *)iter->data;
+    PHASE_BEGIN(mn->rulebase, CML_PHASE_OVERLAP)
+    cand = branch_overlap_candidates(branches, n);
+    
+    for (i = 0 ; i < n ; i++)
     {
-    	cml_branch_t *branch1 = (cml_branch_t *)iter1->data;
+    	cml_branch_t *branch1 = branches[i];
 
-	for (iter2 = (GList *)mn->user_data ;
-	     iter2 != 0 && iter2 != iter1;
-	     iter2 = iter2->next)
+	for (j = 0 ; j < i ; j++)
 	{
-    	    cml_branch_t *branch2 = (cml_branch_t *)iter2->data;
+    	    cml_branch_t *branch2 = branches[j];
 	    
+	    if (!cand[i*n+j])
+	    	continue;
 	    if (branches_overlap(branch1, branch2))
 	    {
 	    	cml_node_treetype treetype1 = calc_branch_treetype(branch1);
@@ -829,10 +955,10 @@ check_branches_are_disjoint(cml_node *mn)
 			cml_warningl(&branch2->location,
 		    		"location of previous definition");
 #if 0
-			cml_warningl(&branch2->parent->location,
+			cml_warningl(&branch2->parent->cold->location,
 		    		"first parent is \"%s\"",
 				branch2->parent->name);
-			cml_warningl(&branch1->parent->location,
+			cml_warningl(&branch1->parent->cold->location,
 		    		"second parent is \"%s\"",
 				branch1->parent->name);
 #endif
@@ -855,12 +981,11 @@ check_branches_are_disjoint(cml_node *mn)
     }
 
 
-    for (iter1 = (GList *)mn->user_data ; iter1 != 0 ; iter1 = iter1->next)
-    {
-    	cml_branch_t *branch1 = (cml_branch_t *)iter1->data;
-
-    	branch_overlap_cleanup(branch1);
-    }
+    for (i = 0 ; i < n ; i++)
+    	branch_overlap_cleanup(branches[i]);
+    PHASE_END(mn->rulebase, CML_PHASE_OVERLAP)
+    g_free(branches);
+    g_free(cand);
 }
 
 /*============================================================*/
@@ -887,7 +1012,7 @@ pass2_primitive(cml_rulebase *rb, cml_node *mn)
 
     if (rb->xref_fp != 0)
     {
-	for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+	for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
 	{
     	    cml_branch_t *branch = (cml_branch_t *)iter->data;
 
@@ -900,7 +1025,7 @@ pass2_primitive(cml_rulebase *rb, cml_node *mn)
     	rb_warning_enabled(rb, CW_OVERLAPPING_DEFINITIONS))
 	check_branches_are_disjoint(mn);
 
-    for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+    for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
     {
     	cml_branch_t *branch = (cml_branch_t *)iter->data;
 
@@ -943,12 +1068,34 @@ pass2_primitive(cml_rulebase *rb, cml_node *mn)
     /* 
      * Add rules and modify branch->cond to implement dep_bool etc
      */
-    for (iter = (GList *)mn->user_data ; iter != 0 ; iter = iter->next)
+    for (iter = (GList *)mn->cold->user_data ; iter != 0 ; iter = iter->next)
 	add_dependency_rules(rb, mn, (cml_branch_t *)iter->data);
 }
 
 /*============================================================*/
 
+/*
+ * Detach and free the branch information, including anything
+ * cached for the overlap checks.  Returns the bytes released.
+ */
+unsigned long
+cml1_discard_branches(cml_node *mn)
+{
+    unsigned long nbytes = 0;
+    GList *list;
+
+    while ((list = (GList *)mn->cold->user_data) != 0)
+    {
+    	cml_branch_t *branch = (cml_branch_t *)list->data;
+	branch_overlap_cleanup(branch);
+	branch_delete(branch);
+    	mn->cold->user_data = g_list_remove_link(list, list);
+	g_list_free(list);
+	nbytes += sizeof(cml_branch_t) + sizeof(GList);
+    }
+    return nbytes;
+}
+
 static void
 pass2_node(cml_rulebase *rb, cml_node *mn)
 {
@@ -957,14 +1104,7 @@ pass2_node(cml_rulebase *rb, cml_node *mn)
     else
     	pass2_primitive(rb, mn);
 
-    /* Detach and free the branch information */
-    while (mn->user_data != 0)
-    {
-    	cml_branch_t *branch = (cml_branch_t *)((GList *)mn->user_data)->data;
-	branch_delete(branch);
-    	mn->user_data = g_list_remove_link((GList *)mn->user_data,
-	    	    	    	    	   (GList *)mn->user_data);
-    }
+    cml1_discard_branches(mn);
 }
 
 /*============================================================*/
@@ -986,6 +1126,7 @@ detach_derived_symbol(gpointer key, gpointer value, gpointer user_data)
 void
 cml1_pass2(cml_rulebase *rb)
 {
+    PHASE_BEGIN(rb, CML_PHASE_CML1_PASS2)
     init_type_upgrade();
     init_compound_treetype_upgrade();
 
@@ -999,10 +1140,10 @@ cml1_pass2(cml_rulebase *rb)
 	 * having a banner for the root node and a separate banner for
 	 * the rulebase as a whole.
 	 */
-	assert(rb->banner->banner != 0);
-	assert(rb->start->banner == 0);
-	rb->start->banner = rb->banner->banner;
-	rb->banner->banner = 0;
+	assert(rb->banner->cold->banner != 0);
+	assert(rb->start->cold->banner == 0);
+	rb->start->cold->banner = rb->banner->cold->banner;
+	rb->banner->cold->banner = 0;
 	rb_remove_node(rb, rb->banner);
 	mn_delete(rb->banner);
 	rb->banner = rb->start;
@@ -1020,6 +1161,9 @@ cml1_pass2(cml_rulebase *rb)
      * that their save order in unpredictable.
      */
     g_hash_table_foreach(rb->menu_nodes, detach_derived_symbol, rb);
+    
+    overlap_shutdown();
+    PHASE_END(rb, CML_PHASE_CML1_PASS2)
 }
 
 /*============================================================*/
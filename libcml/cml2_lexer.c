@@ -696,7 +696,6 @@ char *cml2_yytext;
  */
  
 
-#include "base64.h"
 #include <ctype.h>
 #define YY_NO_UNPUT 1	/* prevent compiler warning from unused fn */
 
@@ -704,13 +703,41 @@ CVSID2("$Id: cml2_lexer.l,v 1.2 2002/09/01 08:40:06 gnb Exp $");
 
 /*============================================================*/
 
-static char *textdata;
+/*
+ * Help text and icon data are not copied out of the file, only
+ * their position is recorded, so the byte offset of the start of
+ * the next token in the current file is tracked in yyoffset.
+ */
+static unsigned long yyoffset;
+#define YY_USER_ACTION	yyoffset += yyleng;
+static cml_text_ref textref;
+
+static void
+textref_extend(void)
+{
+    if (textref.length == 0)
+    {
+    	textref.filename = yylocation.filename;
+	textref.offset = yyoffset - yyleng;
+    }
+    textref.length = yyoffset - textref.offset;
+}
+
+static cml_text_ref
+textref_take(void)
+{
+    cml_text_ref ref = textref;
+
+    memset(&textref, 0, sizeof(textref));
+    return ref;
+}
 
 /*============================================================*/
 
 typedef struct
 {
     cml_location location;  /* filename, lineno */
+    unsigned long offset;
     FILE *filep;
     YY_BUFFER_STATE buffer;
 } source_stack_rec;
@@ -770,8 +797,13 @@ yylex_push_file(const char *relfilename)
     {
 	rec = (source_stack_rec *)source_stack->data;
 	rec->location.lineno = yylocation.lineno;
+	rec->offset = yyoffset;
     }
     
+    if (!rb_progress(rb, CML_PROGRESS_PARSE, relfilename,
+    	    	     g_list_length(rb->filenames), 0))
+    	return FALSE;
+
     filename = find_file(relfilename);
     if ((fp = fopen(filename, "r")) == 0)
     {
@@ -784,15 +816,17 @@ yylex_push_file(const char *relfilename)
     
     /* create new record */
     rec = g_new(source_stack_rec, 1);
-    rec->location.filename = filename;
+    rec->location.filename = rb_intern_take(rb, filename);
+    rb_add_filename(rb, rec->location.filename, fp);
     rec->location.lineno = 1;
+    rec->offset = 0;
     rec->filep = fp;
     rec->buffer = cml2_yy_create_buffer(rec->filep,YY_BUF_SIZE);
 
     /* push new record */    
     source_stack = g_list_prepend(source_stack, rec);
     yylocation = rec->location;
-    rb->filenames = g_list_prepend(rb->filenames, filename);
+    yyoffset = rec->offset;
     cml2_yy_switch_to_buffer(rec->buffer);
     
     return TRUE;
@@ -822,6 +856,7 @@ cml2_yywrap(void)
 	rec = (source_stack_rec *)source_stack->data;
 	cml2_yy_switch_to_buffer(rec->buffer);
 	yylocation = rec->location;
+	yyoffset = rec->offset;
     	return FALSE;	    /* outer file to continue reading */
     }
     return TRUE;
@@ -838,7 +873,7 @@ cml2_yywrap(void)
 
 /* used to handle text data for `text' statement */
 
-#line 842 "cml2_lexer.c"
+#line 877 "cml2_lexer.c"
 
 #define INITIAL 0
 #define CON_SOURCE 1
@@ -1026,10 +1061,10 @@ YY_DECL
 	register char *yy_cp, *yy_bp;
 	register int yy_act;
     
-#line 168 "cml2_lexer.l"
+#line 203 "cml2_lexer.l"
 
 
-#line 1033 "cml2_lexer.c"
+#line 1068 "cml2_lexer.c"
 
 	if ( !(yy_init) )
 		{
@@ -1115,301 +1150,293 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 170 "cml2_lexer.l"
+#line 205 "cml2_lexer.l"
 return K_AND;
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 171 "cml2_lexer.l"
+#line 206 "cml2_lexer.l"
 return K_BANNER;
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 172 "cml2_lexer.l"
+#line 207 "cml2_lexer.l"
 return K_CHOICES;
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 173 "cml2_lexer.l"
+#line 208 "cml2_lexer.l"
 statement_start(); return K_CONDITION;
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 174 "cml2_lexer.l"
+#line 209 "cml2_lexer.l"
 return K_DEBUG;
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 175 "cml2_lexer.l"
+#line 210 "cml2_lexer.l"
 return K_DEFAULT;
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 176 "cml2_lexer.l"
+#line 211 "cml2_lexer.l"
 return K_DEPENDENT;
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 177 "cml2_lexer.l"
+#line 212 "cml2_lexer.l"
 statement_start(); return K_DERIVE;
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 178 "cml2_lexer.l"
+#line 213 "cml2_lexer.l"
 return K_ENUM;
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 179 "cml2_lexer.l"
+#line 214 "cml2_lexer.l"
 return K_EXPLANATION;
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 180 "cml2_lexer.l"
+#line 215 "cml2_lexer.l"
 return K_EXPLANATIONS;
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 181 "cml2_lexer.l"
+#line 216 "cml2_lexer.l"
 return K_EQUALS;
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 182 "cml2_lexer.l"
+#line 217 "cml2_lexer.l"
 return K_FROM;
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 183 "cml2_lexer.l"
+#line 218 "cml2_lexer.l"
 return K_GREATER_EQUALS;
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 184 "cml2_lexer.l"
+#line 219 "cml2_lexer.l"
 BEGIN(CON_BASE64); return K_ICON;
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 185 "cml2_lexer.l"
+#line 220 "cml2_lexer.l"
 return K_IMPLIES;
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 186 "cml2_lexer.l"
+#line 221 "cml2_lexer.l"
 return K_LESS_EQUALS;
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 187 "cml2_lexer.l"
+#line 222 "cml2_lexer.l"
 return K_MENU;
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 188 "cml2_lexer.l"
+#line 223 "cml2_lexer.l"
 return K_MENUS;
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 189 "cml2_lexer.l"
+#line 224 "cml2_lexer.l"
 return K_NOHELP;
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
-#line 190 "cml2_lexer.l"
+#line 225 "cml2_lexer.l"
 return K_NOT;
 	YY_BREAK
 case 22:
 YY_RULE_SETUP
-#line 191 "cml2_lexer.l"
+#line 226 "cml2_lexer.l"
 return K_NOT_EQUALS;
 	YY_BREAK
 case 23:
 YY_RULE_SETUP
-#line 192 "cml2_lexer.l"
+#line 227 "cml2_lexer.l"
 return K_ON;
 	YY_BREAK
 case 24:
 YY_RULE_SETUP
-#line 193 "cml2_lexer.l"
+#line 228 "cml2_lexer.l"
 return K_OR;
 	YY_BREAK
 case 25:
 YY_RULE_SETUP
-#line 194 "cml2_lexer.l"
+#line 229 "cml2_lexer.l"
 return K_PREFIX;
 	YY_BREAK
 case 26:
 YY_RULE_SETUP
-#line 195 "cml2_lexer.l"
+#line 230 "cml2_lexer.l"
 statement_start(); return K_PROHIBIT;
 	YY_BREAK
 case 27:
 YY_RULE_SETUP
-#line 196 "cml2_lexer.l"
+#line 231 "cml2_lexer.l"
 return K_RANGE;
 	YY_BREAK
 case 28:
 YY_RULE_SETUP
-#line 197 "cml2_lexer.l"
+#line 232 "cml2_lexer.l"
 statement_start(); return K_REQUIRE;
 	YY_BREAK
 case 29:
 YY_RULE_SETUP
-#line 198 "cml2_lexer.l"
+#line 233 "cml2_lexer.l"
 return K_SAVE;
 	YY_BREAK
 case 30:
 YY_RULE_SETUP
-#line 199 "cml2_lexer.l"
+#line 234 "cml2_lexer.l"
 return K_SHOW;
 	YY_BREAK
 case 31:
 YY_RULE_SETUP
-#line 200 "cml2_lexer.l"
+#line 235 "cml2_lexer.l"
 BEGIN(CON_SOURCE);
 	YY_BREAK
 case 32:
 YY_RULE_SETUP
-#line 201 "cml2_lexer.l"
+#line 236 "cml2_lexer.l"
 statement_start(); return K_START;
 	YY_BREAK
 case 33:
 YY_RULE_SETUP
-#line 202 "cml2_lexer.l"
+#line 237 "cml2_lexer.l"
 return K_SUPPRESS;
 	YY_BREAK
 case 34:
 YY_RULE_SETUP
-#line 203 "cml2_lexer.l"
+#line 238 "cml2_lexer.l"
 return K_SYMBOLS;
 	YY_BREAK
 case 35:
 YY_RULE_SETUP
-#line 204 "cml2_lexer.l"
+#line 239 "cml2_lexer.l"
 BEGIN(CON_TEXT); return K_TEXT;
 	YY_BREAK
 case 36:
 YY_RULE_SETUP
-#line 205 "cml2_lexer.l"
+#line 240 "cml2_lexer.l"
 return K_TRITS;
 	YY_BREAK
 case 37:
 YY_RULE_SETUP
-#line 206 "cml2_lexer.l"
+#line 241 "cml2_lexer.l"
 return K_UNLESS;
 	YY_BREAK
 case 38:
 YY_RULE_SETUP
-#line 207 "cml2_lexer.l"
+#line 242 "cml2_lexer.l"
 return K_WARNDEPEND;
 	YY_BREAK
 case 39:
 YY_RULE_SETUP
-#line 208 "cml2_lexer.l"
+#line 243 "cml2_lexer.l"
 return K_WHEN;
 	YY_BREAK
 case 40:
 YY_RULE_SETUP
-#line 210 "cml2_lexer.l"
+#line 245 "cml2_lexer.l"
 statement_start(); return K_TEST_ASSERT;
 	YY_BREAK
 case 41:
 YY_RULE_SETUP
-#line 211 "cml2_lexer.l"
+#line 246 "cml2_lexer.l"
 statement_start(); return K_TEST_CLEAR;
 	YY_BREAK
 case 42:
 YY_RULE_SETUP
-#line 212 "cml2_lexer.l"
+#line 247 "cml2_lexer.l"
 statement_start(); return K_TEST_COMMIT;
 	YY_BREAK
 case 43:
 YY_RULE_SETUP
-#line 213 "cml2_lexer.l"
+#line 248 "cml2_lexer.l"
 statement_start(); return K_TEST_FREEZE;
 	YY_BREAK
 case 44:
 YY_RULE_SETUP
-#line 214 "cml2_lexer.l"
+#line 249 "cml2_lexer.l"
 statement_start(); return K_TEST_ERROR;
 	YY_BREAK
 case 45:
 YY_RULE_SETUP
-#line 215 "cml2_lexer.l"
+#line 250 "cml2_lexer.l"
 statement_start(); return K_TEST_NOERROR;
 	YY_BREAK
 case 46:
 YY_RULE_SETUP
-#line 216 "cml2_lexer.l"
+#line 251 "cml2_lexer.l"
 return K_TEST_PARSETEST;
 	YY_BREAK
 case 47:
 YY_RULE_SETUP
-#line 217 "cml2_lexer.l"
+#line 252 "cml2_lexer.l"
 statement_start(); return K_TEST_SET;
 	YY_BREAK
 case 48:
 YY_RULE_SETUP
-#line 218 "cml2_lexer.l"
+#line 253 "cml2_lexer.l"
 statement_start(); return K_TEST_SUCCEEDED;
 	YY_BREAK
 case 49:
 YY_RULE_SETUP
-#line 219 "cml2_lexer.l"
+#line 254 "cml2_lexer.l"
 statement_start(); return K_TEST_VISIBLE;
 	YY_BREAK
 case 50:
 YY_RULE_SETUP
-#line 220 "cml2_lexer.l"
+#line 255 "cml2_lexer.l"
 statement_start(); return K_TEST_SAVEABLE;
 	YY_BREAK
 case 51:
 YY_RULE_SETUP
-#line 222 "cml2_lexer.l"
+#line 257 "cml2_lexer.l"
 {
-    	    	    	/* base64 data */
-			b64_decode_input(cml2_yytext);
+    	    	    	/* base64 data, decoded on demand */
+			textref_extend();
     	    	}
 	YY_BREAK
 case 52:
 /* rule 52 can match eol */
 YY_RULE_SETUP
-#line 227 "cml2_lexer.l"
+#line 262 "cml2_lexer.l"
 {
     	    	    /* single period terminates text data */
-		    yylval.string = textdata;
-		    textdata = 0;
+		    yylval.text = textref_take();
 		    ++yylocation.lineno;
 		    BEGIN(0);
-		    return STRING;
+		    return TEXTDATA;
     	    	}
 	YY_BREAK
 case 53:
 YY_RULE_SETUP
-#line 236 "cml2_lexer.l"
+#line 270 "cml2_lexer.l"
 {
-    	    	    /* text data */
-		    char *old = textdata;
-		    if (old == 0)
-			textdata = g_strdup(cml2_yytext);
-		    else
-		    {
-			textdata = g_strconcat(old, "\n", cml2_yytext, 0);
-			g_free(old);
-		    }
+    	    	    /* text data, read on demand */
+		    textref_extend();
     	    	}
 	YY_BREAK
 case 54:
 /* rule 54 can match eol */
 YY_RULE_SETUP
-#line 248 "cml2_lexer.l"
+#line 275 "cml2_lexer.l"
 {   /* swallow newlines, they get put in again later */
 		    ++yylocation.lineno;
     	    	}
 	YY_BREAK
 case 55:
 YY_RULE_SETUP
-#line 252 "cml2_lexer.l"
+#line 279 "cml2_lexer.l"
 {
 		    yylval.tritval = CML_Y;
 		    return TRITVAL;
@@ -1417,7 +1444,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 56:
 YY_RULE_SETUP
-#line 257 "cml2_lexer.l"
+#line 284 "cml2_lexer.l"
 {
 		    yylval.tritval = CML_M;
 		    return TRITVAL;
@@ -1425,7 +1452,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 57:
 YY_RULE_SETUP
-#line 262 "cml2_lexer.l"
+#line 289 "cml2_lexer.l"
 {
 		    yylval.tritval = CML_N;
 		    return TRITVAL;
@@ -1433,7 +1460,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 58:
 YY_RULE_SETUP
-#line 267 "cml2_lexer.l"
+#line 294 "cml2_lexer.l"
 {
     	    	    cml_node *mn;
 		    char *name;
@@ -1448,7 +1475,7 @@ YY_RULE_SETUP
 		    if (mn == 0)
 		    {
 			mn = rb_add_node(rb, name);
-			mn->location = yylocation;
+			mn->cold->location = yylocation;
 		    }
 		    yylval.node = mn;
 		    return SYMBOL;
@@ -1457,7 +1484,7 @@ YY_RULE_SETUP
 case 59:
 /* rule 59 can match eol */
 YY_RULE_SETUP
-#line 287 "cml2_lexer.l"
+#line 314 "cml2_lexer.l"
 {
     	    	    /*
 		     * Quoted string immediately after `source' is filename
@@ -1471,7 +1498,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 60:
 YY_RULE_SETUP
-#line 298 "cml2_lexer.l"
+#line 325 "cml2_lexer.l"
 {
     	    	    /*
 		     * Unquoted string immediately after `source' is also
@@ -1485,7 +1512,7 @@ YY_RULE_SETUP
 case 61:
 /* rule 61 can match eol */
 YY_RULE_SETUP
-#line 308 "cml2_lexer.l"
+#line 335 "cml2_lexer.l"
 {
     	    	    cml2_yytext[cml2_yyleng-1] = '\0';	/* lose trailing quote */
     	    	    yylval.string = g_strdup(cml2_yytext+1);
@@ -1494,7 +1521,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 62:
 YY_RULE_SETUP
-#line 314 "cml2_lexer.l"
+#line 341 "cml2_lexer.l"
 {
     	    	    yylval.integer = atoi(cml2_yytext);
 		    return DECIMAL;
@@ -1502,7 +1529,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 63:
 YY_RULE_SETUP
-#line 319 "cml2_lexer.l"
+#line 346 "cml2_lexer.l"
 {
     	    	    yylval.integer = strtol(cml2_yytext, (char **)0, 16);
 		    return HEXADECIMAL;
@@ -1510,17 +1537,16 @@ YY_RULE_SETUP
 	YY_BREAK
 case 64:
 YY_RULE_SETUP
-#line 325 "cml2_lexer.l"
+#line 352 "cml2_lexer.l"
 /* eat whitespace */
 	YY_BREAK
 case 65:
 /* rule 65 can match eol */
 YY_RULE_SETUP
-#line 328 "cml2_lexer.l"
+#line 355 "cml2_lexer.l"
 {
     	    	    /* comment terminates base64 data */
-		    yylval.blob = b64_decode_take_data_as_blob();
-		    b64_decode_end();
+		    yylval.text = textref_take();
 		    ++yylocation.lineno;
 		    BEGIN(0);
 		    return BINARYDATA;
@@ -1528,7 +1554,7 @@ YY_RULE_SETUP
 	YY_BREAK
 case 66:
 YY_RULE_SETUP
-#line 337 "cml2_lexer.l"
+#line 363 "cml2_lexer.l"
 {
     	    	    /* eat comments (matches to end of line or file) */
     	    	}
@@ -1536,11 +1562,10 @@ YY_RULE_SETUP
 case 67:
 /* rule 67 can match eol */
 YY_RULE_SETUP
-#line 341 "cml2_lexer.l"
+#line 367 "cml2_lexer.l"
 {
     	    	    /* empty line terminates base64 data */
-		    yylval.blob = b64_decode_take_data_as_blob();
-		    b64_decode_end();
+		    yylval.text = textref_take();
     	    	    ++yylocation.lineno;
 		    BEGIN(0);
 		    return BINARYDATA;
@@ -1549,24 +1574,24 @@ YY_RULE_SETUP
 case 68:
 /* rule 68 can match eol */
 YY_RULE_SETUP
-#line 350 "cml2_lexer.l"
+#line 375 "cml2_lexer.l"
 {
     	    	    ++yylocation.lineno;
 		}
 	YY_BREAK
 case 69:
 YY_RULE_SETUP
-#line 354 "cml2_lexer.l"
+#line 379 "cml2_lexer.l"
 {
     	    	    return cml2_yytext[0];
 		}
 	YY_BREAK
 case 70:
 YY_RULE_SETUP
-#line 358 "cml2_lexer.l"
+#line 383 "cml2_lexer.l"
 ECHO;
 	YY_BREAK
-#line 1570 "cml2_lexer.c"
+#line 1595 "cml2_lexer.c"
 case YY_STATE_EOF(INITIAL):
 case YY_STATE_EOF(CON_SOURCE):
 case YY_STATE_EOF(CON_BASE64):
@@ -2569,7 +2594,7 @@ void cml2_yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 358 "cml2_lexer.l"
+#line 383 "cml2_lexer.l"
 
 
 
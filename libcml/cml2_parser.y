@@ -145,7 +145,7 @@ set_mn_treetype(cml_node *mn, cml_node_treetype tt)
 	    mn_treetype_as_string(tt),
 	    mn->name,
 	    mn_get_treetype_as_string(mn));
-	cml_errorl(&mn->location,
+	cml_errorl(&mn->cold->location,
 		"previous definition of `%s'",
 		mn->name);
 	return FALSE;
@@ -290,10 +290,12 @@ handle_subtree(cml_node *guard, GList *list)
 	if (mn->treetype == MN_SYMBOL)
 	    mn_add_dependant(guard, mn);
 	    
-	mn_add_visibility_expr(mn, expr);
+	/* each node owns its visibility expr, so give it a copy */
+	mn_add_visibility_expr(mn, expr_deep_copy(expr));
 
 	mn->flags |= MN_SUBTREE_SEEN;
     }
+    expr_destroy(expr);
 }
 
 /*============================================================*/
@@ -311,7 +313,7 @@ handle_subtree(cml_node *guard, GList *list)
     cml_subrange subrange;
     cml_enumdef *enumdef;
     GList *list;
-    cml_blob *blob;
+    cml_text_ref text;
 }
 
 /* terminal symbols */
@@ -319,7 +321,8 @@ handle_subtree(cml_node *guard, GList *list)
 %token <string> STRING
 %token <integer> DECIMAL
 %token <integer> HEXADECIMAL
-%token <blob> BINARYDATA
+%token <text> BINARYDATA
+%token <text> TEXTDATA
 %token <tritval> TRITVAL
 
 /* nonterminal symbols */
@@ -333,7 +336,7 @@ handle_subtree(cml_node *guard, GList *list)
 %type <list> name_or_subtree
 %type <list> name_or_subtree_list symbol_list name_list
 %type <integer> dependant_flag unless_when
-%type <string> helptext
+%type <text> helptext
 
 /* operators -- precedence according to CML2 0.6.1 spec */
 %right '?' ':'
@@ -458,16 +461,16 @@ symbol_def_list: 	  /* nothing */
 symbol_def: 	    	  SYMBOL STRING helptext
     	    	    	    {
 			    	set_mn_treetype($1, MN_SYMBOL);
-			    	$1->banner = $2;
-				$1->help_text = $3;
+			    	$1->cold->banner = rb_intern_take(rb, $2);
+				$1->cold->help_ref = $3;
 			    }
 			;
 			
 helptext:   	    	  /* nothing */
     	    	    	    {
-				$$ = 0;
+				memset(&$$, 0, sizeof($$));
 			    }
-		    	| K_TEXT STRING
+		    	| K_TEXT TEXTDATA
 			    {
 			    	$$ = $2;
 			    }
@@ -499,8 +502,8 @@ menuid_def_list: 	  /* nothing */
 menuid_def: 	    	  SYMBOL STRING helptext
     	    	    	    {
 			    	set_mn_treetype($1, MN_MENU);
-			    	$1->banner = $2;
-				$1->help_text = $3;
+			    	$1->cold->banner = rb_intern_take(rb, $2);
+				$1->cold->help_ref = $3;
 			    }
     	    	    	;
 
@@ -525,7 +528,7 @@ explan_def_list: 	  /* nothing */
 explan_def: 	    	  SYMBOL STRING
     	    	    	    {
 			    	set_mn_treetype($1, MN_EXPLANATION);
-			    	$1->banner = $2;
+			    	$1->cold->banner = rb_intern_take(rb, $2);
 			    }
 
 symbol_list:	    	  SYMBOL
@@ -614,11 +617,12 @@ visibility_rule:    	  unless_when logical K_SUPPRESS dependant_flag name_list
 				{
 				    cml_node *mn = (cml_node *)node->data;
 
-    	    	    	    	    mn_add_visibility_expr(mn, expr);
+    	    	    	    	    mn_add_visibility_expr(mn, expr_deep_copy(expr));
 				    if ($4)
 					_expr_add_dependant(expr, mn);
 				    node = g_list_remove_link(node, node);
 				}
+				expr_destroy(expr);
 			    }
 			;
 			
@@ -636,9 +640,10 @@ visibility_rule2:    	  unless_when logical K_SHOW name_list
 				{
 				    cml_node *mn = (cml_node *)node->data;
 
-    	    	    	    	    mn_add_visibility_expr(mn, expr);
+    	    	    	    	    mn_add_visibility_expr(mn, expr_deep_copy(expr));
 				    node = g_list_remove_link(node, node);
 				}
+				expr_destroy(expr);
 			    }
 			;
 			
@@ -661,9 +666,10 @@ saveability_rule:    	  unless_when logical K_SAVE name_list
 				{
 				    cml_node *mn = (cml_node *)node->data;
 
-    	    	    	    	    mn_add_saveability_expr(mn, expr);
+    	    	    	    	    mn_add_saveability_expr(mn, expr_deep_copy(expr));
 				    node = g_list_remove_link(node, node);
 				}
+				expr_destroy(expr);
 			    }
 			;
 			
@@ -859,7 +865,7 @@ derive_definition:  	  K_DERIVE SYMBOL K_FROM expr
 				    if (check_mn_is_derived($2))
 				    {
 					yyerror("derived symbol `%s' derived twice", $2->name);
-					cml_errorl(&$2->location, "is previous definition");
+					cml_errorl(&$2->cold->location, "is previous definition");
 				    }
 				    break;
 				}
@@ -899,7 +905,7 @@ default_definition: 	  K_DEFAULT SYMBOL K_FROM expr
     	    	    	| K_DEFAULT SYMBOL K_FROM expr K_ENUM enumdef_list
     	    	    	    {
 				set_default_expr($2, $4);
-				$2->enumdefs = $6;
+				$2->cold->enumdefs = $6;
 			    }
 			;
 			
@@ -1181,7 +1187,7 @@ warndepend_declaration:   K_WARNDEPEND symbol_list
  */
 icon_definition:    	  K_ICON BINARYDATA
     	    	    	    {
-			    	rb->icon = $2;
+			    	rb->icon_ref = $2;
 			    }
     	    	    	;
 
@@ -1375,7 +1381,7 @@ atom:	    	    	  SYMBOL
 				     * forward-declared symbols were a poor CML
 				     * coding practice, hence the warning.
 				     */
-				    cml_warningl(&$1->location,
+				    cml_warningl(&$1->cold->location,
 				    	"Symbol `%s' is used in expression before it is defined\n",
 					$1->name);
 				    /* set_mn_treetype($1, MN_DERIVED); */
@@ -1426,8 +1432,24 @@ integer:    	      	  DECIMAL
 	    
 %%
 
+/* the parser calls yylex() below, which times the real lexer */
+#define YY_DECL static int lex_token(void)
 #include "cml2_lexer.c"
 
+static int
+yylex(void)
+{
+    double start;
+    int token;
+
+    if (rb->timings == 0)
+    	return lex_token();
+    start = cml_timer_now();
+    token = lex_token();
+    rb_add_file_lex_timing(rb, yylocation.filename, cml_timer_now() - start);
+    return token;
+}
+
 static void
 yyerror(const char *fmt, ...)
 {
@@ -1450,15 +1472,21 @@ _cml_rulebase_parse_cml2(cml_rulebase *rbi, const char *filename)
     cml2_yydebug = (debug & DEBUG_PARSER ? 1 : 0);
 #endif
 
+    /* the lexer needs the rulebase to intern the filename */
+    rb = rbi;
     if (!yylex_push_file(filename))
+    {
+    	rb = 0;
     	return FALSE;
+    }
 
     statement_init();
     cml_message_count[CML_ERROR] = 0;
 
-    rb = rbi;
+    PHASE_BEGIN(rb, CML_PHASE_PARSE)
     if (yyparse())
     	failed = TRUE;
+    PHASE_END(rb, CML_PHASE_PARSE)
     rb = 0;
 
     return !failed;
@@ -86,6 +86,10 @@
 extern void sylvester(void *);
 #endif
 
+#ifndef MEMSTATS
+#define MEMSTATS 0
+#endif
+
 /*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
 
 
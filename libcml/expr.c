@@ -18,6 +18,7 @@
  */
  
 #include "private.h"
+#include <limits.h>
 
 CVSID("$Id: expr.c,v 1.28 2002/09/01 08:45:35 gnb Exp $");
 
@@ -30,6 +31,10 @@ typedef struct
     const char *func;
     int nexprs;
     const cml_expr *exprs[LOOP_CHECK_MAX];
+    /* hypothetical symbol values used by expr_evaluate_assigned() */
+    int nassigned;
+    cml_node *const *assigned_syms;
+    const cml_atom *assigned_vals;
 } expr_loop_context_t;
 
 static void
@@ -38,6 +43,20 @@ expr_loop_init(expr_loop_context_t *lc, const char *fn)
     lc->node = 0;
     lc->nexprs = 0;
     lc->func = fn;
+    lc->nassigned = 0;
+    lc->assigned_syms = 0;
+    lc->assigned_vals = 0;
+}
+
+static const cml_atom *
+expr_loop_get_assigned(expr_loop_context_t *lc, const cml_node *mn)
+{
+    int i;
+    
+    for (i = 0 ; i < lc->nassigned ; i++)
+    	if (lc->assigned_syms[i] == mn)
+	    return &lc->assigned_vals[i];
+    return 0;
 }
 
 /*
@@ -58,7 +77,7 @@ expr_loop_push(expr_loop_context_t *lc, const cml_expr *expr)
 		    "INTERNAL ERROR: expression loop in %s",
 		    lc->func);
 	    else
-		cml_errorl(&lc->node->location,
+		cml_errorl(&lc->node->cold->location,
 		    "INTERNAL ERROR: expression loop expanding \"%s\" in %s",
 		    lc->node->name,
 		    lc->func);
@@ -97,7 +116,11 @@ expr_loop_pop(expr_loop_context_t *lc)
 cml_expr *
 expr_new(void)
 {
-    cml_expr *expr = g_new(cml_expr, 1);
+    cml_expr *expr;
+    
+    MEM_TAG_BEGIN(CML_MEM_EXPRS)
+    expr = g_new(cml_expr, 1);
+    MEM_TAG_END
     if (expr == 0)
     	return 0;
     memset(expr, 0, sizeof(*expr));
@@ -108,7 +131,11 @@ expr_new(void)
 cml_expr *
 expr_copy(const cml_expr *expr)
 {
-    cml_expr *copy = g_new(cml_expr, 1);
+    cml_expr *copy;
+    
+    MEM_TAG_BEGIN(CML_MEM_EXPRS)
+    copy = g_new(cml_expr, 1);
+    MEM_TAG_END
     if (copy == 0)
     	return 0;
     *copy = *expr;
@@ -121,8 +148,11 @@ cml_expr *
 expr_deep_copy(const cml_expr *expr)
 {
     int i;
+    cml_expr *copy;
 
-    cml_expr *copy = g_new(cml_expr, 1);
+    MEM_TAG_BEGIN(CML_MEM_EXPRS)
+    copy = g_new(cml_expr, 1);
+    MEM_TAG_END
     if (copy == 0)
     	return 0;
     *copy = *expr;
@@ -179,6 +209,7 @@ expr_new_atom(const cml_atom *atom)
 	
     expr->type = E_ATOM;
     expr->value = *atom;
+    atom_intern(&expr->value);
     return expr;
 }
 
@@ -206,6 +237,7 @@ expr_new_atom_v(cml_atom_type type, ...)
     	break;
     case A_STRING:
     	expr->value.value.string = va_arg(args, char*);
+	atom_intern(&expr->value);
     	break;
     case A_NODE:
     	expr->value.value.node = va_arg(args, cml_node*);
@@ -517,6 +549,28 @@ static const cml_tritval truth_implies[3][3] = {
 /* m */{   -1,    -1,    -1}
 };
 
+static void expr_evaluate2(expr_loop_context_t *lc, const cml_expr *expr,
+    	    	    	   cml_atom *val);
+
+/*
+ * Recalculate a derived symbol's value into the node.  Whether
+ * asked for directly or read from inside another expression,
+ * this is where its cost goes into the profile.
+ */
+static void
+evaluate_derived(expr_loop_context_t *lc, cml_node *mn)
+{
+    double start = 0.0;
+
+    assert(mn->expr != 0);
+    if (mn->rulebase->profile != 0)
+    	start = cml_timer_now();
+    cml_atom_init(&mn->value);
+    expr_evaluate2(lc, mn->expr, &mn->value);
+    if (mn->rulebase->profile != 0)
+	rb_profile_symbol(mn->rulebase, mn, cml_timer_now() - start);
+}
+
 static void
 expr_evaluate2(expr_loop_context_t *lc, const cml_expr *expr, cml_atom *val)
 {
@@ -668,13 +722,29 @@ expr_evaluate2(expr_loop_context_t *lc, const cml_expr *expr, cml_atom *val)
 	break;
 	
     case E_SYMBOL:
-    	if (expr->symbol->treetype == MN_DERIVED)
+    	if (expr->symbol->rulebase->tracer != 0)
+	    trace_push_symbol(expr->symbol->rulebase->tracer, expr->symbol);
+    	if (lc->nassigned > 0 &&
+	    expr->symbol->treetype != MN_DERIVED)
 	{
-	    cml_node *mn = expr->symbol;
-	    assert(mn->expr != 0);
-	    cml_atom_init(&mn->value);
-	    expr_evaluate2(lc, mn->expr, &mn->value);
-	    *val = mn->value;
+	    const cml_atom *v = expr_loop_get_assigned(lc, expr->symbol);
+	    if (v == 0)
+	    	v = cml_node_get_value(expr->symbol);
+	    if (v == 0)
+	    	cml_atom_init(val);
+	    else
+		*val = *v;
+	}
+    	else if (lc->nassigned > 0)
+	{
+	    /* don't scribble hypothetical values into the node */
+	    assert(expr->symbol->expr != 0);
+	    expr_evaluate2(lc, expr->symbol->expr, val);
+	}
+    	else if (expr->symbol->treetype == MN_DERIVED)
+	{
+	    evaluate_derived(lc, expr->symbol);
+	    *val = expr->symbol->value;
 	}
 	else
     	{
@@ -684,6 +754,8 @@ expr_evaluate2(expr_loop_context_t *lc, const cml_expr *expr, cml_atom *val)
 	    else
 		*val = *v;
 	}
+    	if (expr->symbol->rulebase->tracer != 0)
+	    trace_pop(expr->symbol->rulebase->tracer);
     	break;
 	
     case E_TRINARY:
@@ -698,11 +770,127 @@ expr_evaluate(const cml_expr *expr, cml_atom *val)
 {
     expr_loop_context_t lc;
     
+    STAT_INC(CML_STAT_EXPR_EVALUATE);
     expr_loop_init(&lc, "expr_evaluate");
     expr_evaluate2(&lc, expr, val);
     assert(lc.nexprs == 0);
 }
 
+void
+expr_evaluate_derived(cml_node *mn)
+{
+    expr_loop_context_t lc;
+    
+    STAT_INC(CML_STAT_EXPR_EVALUATE);
+    expr_loop_init(&lc, "expr_evaluate_derived");
+    lc.node = mn;
+    evaluate_derived(&lc, mn);
+    assert(lc.nexprs == 0);
+}
+
+/*
+ * Evaluate the expression as if each of the `nsyms' symbols
+ * in `syms' had the corresponding value in `vals', without
+ * touching any bindings.  Used to precompute rule tables.
+ */
+void
+expr_evaluate_assigned(
+    const cml_expr *expr,
+    int nsyms,
+    cml_node *const *syms,
+    const cml_atom *vals,
+    cml_atom *val)
+{
+    expr_loop_context_t lc;
+    
+    expr_loop_init(&lc, "expr_evaluate_assigned");
+    lc.nassigned = nsyms;
+    lc.assigned_syms = syms;
+    lc.assigned_vals = vals;
+    expr_evaluate2(&lc, expr, val);
+    assert(lc.nexprs == 0);
+}
+
+/*============================================================*/
+
+static int
+expr_get_free_symbols2(
+    expr_loop_context_t *lc,
+    const cml_expr *expr,
+    cml_node **syms,
+    int nsyms,
+    int maxsyms)
+{
+    int i;
+    
+    if (nsyms < 0 || expr_loop_push(lc, expr))
+    	return -1;
+
+    switch (expr->type)
+    {
+    case E_SYMBOL:
+    	switch (expr->symbol->treetype)
+	{
+	case MN_DERIVED:
+	    nsyms = expr_get_free_symbols2(lc, expr->symbol->expr,
+	    	    	    	    	   syms, nsyms, maxsyms);
+	    break;
+	case MN_SYMBOL:
+	    if (expr->symbol->flags & MN_CONSTANT)
+	    	break;
+	    if (expr->symbol->value_type != A_BOOLEAN &&
+	    	expr->symbol->value_type != A_TRISTATE)
+	    {
+	    	nsyms = -1;
+		break;
+	    }
+	    for (i = 0 ; i < nsyms ; i++)
+	    	if (syms[i] == expr->symbol)
+		    break;
+	    if (i < nsyms)
+	    	break;	    /* already seen */
+	    if (nsyms == maxsyms)
+	    	nsyms = -1;
+	    else
+	    	syms[nsyms++] = expr->symbol;
+	    break;
+	default:
+	    /* radio menus and anything odd are left to expr_solve() */
+	    nsyms = -1;
+	    break;
+	}
+	break;
+    default:
+	for (i=0 ; i<EXPR_MAX_CHILDREN ; i++)
+	    if (expr->children[i] != 0)
+    		nsyms = expr_get_free_symbols2(lc, expr->children[i],
+		    	    	    	       syms, nsyms, maxsyms);
+    	break;
+    }
+	    
+    expr_loop_pop(lc);
+    return nsyms;
+}
+
+/*
+ * Collect into `syms' the distinct non-constant boolean and
+ * tristate symbols which the expression depends on, looking
+ * through derived symbols.  Returns the number of symbols, or
+ * -1 if there are more than `maxsyms' or the expression depends
+ * on anything which is not a boolean or tristate symbol.
+ */
+int
+expr_get_free_symbols(const cml_expr *expr, cml_node **syms, int maxsyms)
+{
+    expr_loop_context_t lc;
+    int nsyms;
+    
+    expr_loop_init(&lc, "expr_get_free_symbols");
+    nsyms = expr_get_free_symbols2(&lc, expr, syms, 0, maxsyms);
+    assert(lc.nexprs == 0);
+    return nsyms;
+}
+
 /*============================================================*/
 
 const char *
@@ -789,7 +977,9 @@ expr_is_constant(cml_expr *expr)
 	
     if (expr->type == E_SYMBOL && (expr->symbol->flags & MN_CONSTANT))
     {
+    	atom_dtor(&expr->value);
     	expr_evaluate(expr, &expr->value);
+	atom_ctor(&expr->value);
     	return TRUE;
     }
     
@@ -887,6 +1077,151 @@ expr_solve_tristate(
     return 1;
 }
 
+/*
+ * Solve `cond ? first : second'.  If only one of the branches
+ * can possibly produce the target, force the condition to
+ * select that branch and then solve the branch.
+ */
+static int
+expr_solve_trinary(
+    const cml_expr *expr,
+    const cml_atom *target,
+    cml_node *source)
+{
+    int i, branch = 0, nbranches = 0;
+    int nsol;
+    cml_atom a;
+    
+    for (i = 1 ; i <= 2 ; i++)
+    {
+    	cml_expr *child = expr->children[i];
+	
+    	if (is_atom(child) &&
+	    (child->value.type == target->type ||
+	     (is_logical(child) &&
+	      (target->type == A_BOOLEAN || target->type == A_TRISTATE))) &&
+	    _atom_compare(&child->value, target) != 0)
+	    continue;	/* this branch can never produce the target */
+	branch = i;
+	nbranches++;
+    }
+    if (nbranches != 1)
+    	return (nbranches == 0 ? 0 : 2);
+	
+    cml_atom_init(&a);
+    a.type = A_BOOLEAN;
+    a.value.tritval = (branch == 1 ? CML_Y : CML_N);
+    nsol = expr_solve(expr->children[0], &a, source);
+    if (nsol != 1)
+    	return nsol;
+	
+    return expr_solve(expr->children[branch], target, source);
+}
+
+/*
+ * Solve an integer relation between a symbol and a constant, by
+ * counting the values in the symbol's range which satisfy it.
+ * The symbol is forced only when exactly one value does.
+ */
+static int
+expr_solve_integer(
+    const cml_expr *expr,
+    const cml_atom *target,
+    cml_node *source)
+{
+    cml_expr *sym, *cons;
+    cml_expr_type op = expr->type;
+    const cml_range *range;
+    unsigned long c, count, first = 0, first2 = 0, count2;
+    cml_atom a;
+    
+    assert(target->type == A_BOOLEAN);
+    
+    if (expr->children[0]->type == E_SYMBOL && is_atom(expr->children[1]))
+    {
+    	sym = expr->children[0];
+	cons = expr->children[1];
+    }
+    else if (expr->children[1]->type == E_SYMBOL && is_atom(expr->children[0]))
+    {
+    	sym = expr->children[1];
+	cons = expr->children[0];
+	/* mirror the relation so the symbol is on the left */
+	switch (op)
+	{
+	case E_LESS: op = E_GREATER; break;
+	case E_LESS_EQUALS: op = E_GREATER_EQUALS; break;
+	case E_GREATER: op = E_LESS; break;
+	case E_GREATER_EQUALS: op = E_LESS_EQUALS; break;
+	default: break;
+	}
+    }
+    else
+    	return 2;
+	
+    range = sym->symbol->range;
+    if (sym->symbol->treetype != MN_SYMBOL ||
+    	range == 0 ||
+	(sym->symbol->value_type != A_DECIMAL &&
+	 sym->symbol->value_type != A_HEXADECIMAL) ||
+    	(cons->value.type != A_DECIMAL &&
+	 cons->value.type != A_HEXADECIMAL) ||
+	cons->value.value.integer < 0)
+    	return 2;
+	
+    if (target->value.tritval == CML_N)
+    {
+    	/* force the opposite relation */
+	switch (op)
+	{
+	case E_EQUALS: op = E_NOT_EQUALS; break;
+	case E_NOT_EQUALS: op = E_EQUALS; break;
+	case E_LESS: op = E_GREATER_EQUALS; break;
+	case E_LESS_EQUALS: op = E_GREATER; break;
+	case E_GREATER: op = E_LESS_EQUALS; break;
+	case E_GREATER_EQUALS: op = E_LESS; break;
+	default: return 2;
+	}
+    }
+    
+    c = cons->value.value.integer;
+    switch (op)
+    {
+    case E_EQUALS:
+    	count = range_count_within(range, c, c, &first);
+	break;
+    case E_NOT_EQUALS:
+    	count = (c == 0 ? 0 : range_count_within(range, 0, c-1, &first));
+	count2 = (c == ULONG_MAX ? 0 : range_count_within(range, c+1, ULONG_MAX, &first2));
+	if (count == 0)
+	    first = first2;
+	count += count2;
+	break;
+    case E_LESS:
+    	count = (c == 0 ? 0 : range_count_within(range, 0, c-1, &first));
+	break;
+    case E_LESS_EQUALS:
+    	count = range_count_within(range, 0, c, &first);
+	break;
+    case E_GREATER:
+    	count = (c == ULONG_MAX ? 0 : range_count_within(range, c+1, ULONG_MAX, &first));
+	break;
+    case E_GREATER_EQUALS:
+    	count = range_count_within(range, c, ULONG_MAX, &first);
+	break;
+    default:
+    	return 2;
+    }
+    
+    if (count != 1)
+    	return (count == 0 ? 0 : 2);
+
+    cml_atom_init(&a);
+    a.type = sym->symbol->value_type;
+    a.value.integer = first;
+    return expr_solve(sym, &a, source);
+}
+
  
 int
 expr_solve(
@@ -896,6 +1231,7 @@ expr_solve(
 {
     cml_atom a;
     
+    STAT_INC(CML_STAT_EXPR_SOLVE);
     switch (expr->type)
     {
     case E_NONE:
@@ -940,6 +1276,7 @@ expr_solve(
 	    	a.value.tritval = !expr->children[1]->value.value.tritval;
 		return expr_solve(expr->children[0], &a, source);
 	    }
+	    return expr_solve_integer(expr, target, source);
 	}
 	return 2;   /* more than 1 solution */
     
@@ -949,7 +1286,7 @@ expr_solve(
 	    is_logical(expr->children[1]))
 	    return expr_solve_tristate(expr, target, truth_not_equals, source);
 	else
-	    return 2;	/* TODO */
+	    return expr_solve_integer(expr, target, source);
     
     case E_LESS:
     	assert(target->type == A_BOOLEAN);
@@ -957,7 +1294,7 @@ expr_solve(
 	    is_logical(expr->children[1]))
 	    return expr_solve_tristate(expr, target, truth_less, source);
 	else
-	    return 2;	/* TODO */
+	    return expr_solve_integer(expr, target, source);
 	
     /* TODO: use truthtable */
     case E_LESS_EQUALS:
@@ -966,7 +1303,7 @@ expr_solve(
 	    is_logical(expr->children[1]))
 	    return expr_solve_tristate(expr, target, truth_less_equals, source);
 	else
-	    return 2;	/* TODO */
+	    return expr_solve_integer(expr, target, source);
 	
     case E_GREATER:
     	assert(target->type == A_BOOLEAN);
@@ -974,7 +1311,7 @@ expr_solve(
 	    is_logical(expr->children[1]))
 	    return expr_solve_tristate(expr, target, truth_greater, source);
 	else
-	    return 2;	/* TODO */
+	    return expr_solve_integer(expr, target, source);
     
     case E_GREATER_EQUALS:
     	assert(target->type == A_BOOLEAN);
@@ -982,7 +1319,7 @@ expr_solve(
 	    is_logical(expr->children[1]))
 	    return expr_solve_tristate(expr, target, truth_greater_equals, source);
 	else
-	    return 2;	/* TODO */
+	    return expr_solve_integer(expr, target, source);
 
     case E_MDEP:
     	assert(target->type == A_BOOLEAN);
@@ -1012,8 +1349,7 @@ expr_solve(
     
     /* trinary ?: operator */
     case E_TRINARY:
-    	/* TODO */
-    	return 0;
+    	return expr_solve_trinary(expr, target, source);
 
     /* atom */
     case E_ATOM:
@@ -1044,6 +1380,7 @@ expr_simplify_to_atom(cml_expr *expr)
     /* evaluate the operation on the 0 to 2 children */
     atom_dtor(&expr->value);
     expr_evaluate(expr, &expr->value);
+    atom_ctor(&expr->value);	/* the children own the old value */
     
     /* become an atomic node */
     expr->type = E_ATOM;
@@ -1403,6 +1740,7 @@ expr_simplify(cml_expr *expr)
 {
     expr_loop_context_t lc;
     
+    STAT_INC(CML_STAT_EXPR_SIMPLIFY);
     expr_loop_init(&lc, "expr_simplify");
     expr = expr_simplify2(&lc, expr);
     assert(lc.nexprs == 0);
@@ -0,0 +1,375 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "private.h"
+#include "debug.h"
+
+CVSID("$Id$");
+
+/*============================================================*/
+/*
+ * While a rulebase is being parsed the adjacency relations
+ * between nodes (children, dependants, dependees, rules_using)
+ * are built up as GLists in each node.  Once post-parse has
+ * succeeded they no longer change, so they are frozen into one
+ * compressed sparse row array per relation, indexed by the node's
+ * adj_index, and the GLists are freed.  Everything inside libcml
+ * and the front ends reads them through mn_adj_iter, mn_adj_count()
+ * and mn_adj_nth() or the public wrappers of those.
+ *
+ * Anything which modifies a relation after the freeze thaws the
+ * whole rulebase back into GLists first.
+ */
+
+static GList **
+mn_adj_field(cml_node *mn, cml_adjacency rel)
+{
+    switch (rel)
+    {
+    case MN_ADJ_CHILDREN:   	return &mn->children;
+    case MN_ADJ_DEPENDANTS: 	return &mn->dependants;
+    case MN_ADJ_DEPENDEES:  	return &mn->dependees;
+    case MN_ADJ_RULES_USING:	return &mn->rules_using;
+    case MN_ADJ_NUM:	    	break;
+    }
+    assert(0);
+    return 0;
+}
+
+static void
+collect_node(gpointer key, gpointer value, gpointer user_data)
+{
+    cml_rulebase *rb = (cml_rulebase *)user_data;
+    cml_node *mn = (cml_node *)value;
+
+    mn->adj_index = rb->num_adj_nodes;
+    rb->adj_nodes[rb->num_adj_nodes++] = mn;
+}
+
+void
+rb_freeze_graph(cml_rulebase *rb)
+{
+    int i, rel;
+    unsigned int nedges;
+    GList **fieldp, *list;
+    cml_csr *csr;
+
+    if (rb->adj_nodes != 0)
+    	return;
+
+    MEM_TAG_BEGIN(CML_MEM_NODES)
+    rb->adj_nodes = g_new(cml_node*, g_hash_table_size(rb->menu_nodes));
+    rb->num_adj_nodes = 0;
+    g_hash_table_foreach(rb->menu_nodes, collect_node, rb);
+
+    for (rel = 0 ; rel < MN_ADJ_NUM ; rel++)
+    {
+    	csr = &rb->adjacency[rel];
+	csr->offsets = g_new(unsigned int, rb->num_adj_nodes+1);
+
+	nedges = 0;
+	for (i = 0 ; i < rb->num_adj_nodes ; i++)
+	{
+	    csr->offsets[i] = nedges;
+	    nedges += g_list_length(*mn_adj_field(rb->adj_nodes[i], rel));
+	}
+	csr->offsets[i] = nedges;
+
+	csr->edges = g_new(gpointer, (nedges == 0 ? 1 : nedges));
+	for (i = 0 ; i < rb->num_adj_nodes ; i++)
+	{
+	    gpointer *edge = csr->edges + csr->offsets[i];
+
+	    fieldp = mn_adj_field(rb->adj_nodes[i], rel);
+	    for (list = *fieldp ; list != 0 ; list = list->next)
+	    	*edge++ = list->data;
+	    listclear(*fieldp);
+	}
+
+	DDPRINTF3(DEBUG_NODES, "relation %d has %d nodes %u edges\n",
+	    	  rel, rb->num_adj_nodes, nedges);
+    }
+    MEM_TAG_END
+}
+
+static GList *
+csr_to_list(const cml_csr *csr, int index)
+{
+    GList *list = 0;
+    unsigned int j;
+
+    MEM_TAG_BEGIN(CML_MEM_NODES)
+    for (j = csr->offsets[index+1] ; j > csr->offsets[index] ; j--)
+    	list = g_list_prepend(list, csr->edges[j-1]);
+    MEM_TAG_END
+    return list;
+}
+
+void
+rb_thaw_graph(cml_rulebase *rb)
+{
+    int i, rel;
+    GList **fieldp;
+
+    /* anything derived from the relations is now out of date */
+    rb_free_users(rb);
+    visible_clear(rb);
+
+    if (rb->adj_nodes == 0)
+    	return;
+
+    DDPRINTF0(DEBUG_NODES, "thawing\n");
+    for (i = 0 ; i < rb->num_adj_nodes ; i++)
+    {
+    	cml_node *mn = rb->adj_nodes[i];
+
+	for (rel = 0 ; rel < MN_ADJ_NUM ; rel++)
+	{
+	    fieldp = mn_adj_field(mn, rel);
+	    if (*fieldp == 0)
+	    	*fieldp = csr_to_list(&rb->adjacency[rel], i);
+	}
+	mn->adj_index = -1;
+    }
+    rb_free_graph(rb);
+}
+
+/*
+ * Releases the frozen arrays without touching the nodes,
+ * for use when the nodes are being deleted anyway.
+ */
+void
+rb_free_graph(cml_rulebase *rb)
+{
+    int rel;
+
+    for (rel = 0 ; rel < MN_ADJ_NUM ; rel++)
+    {
+    	g_free(rb->adjacency[rel].offsets);
+    	g_free(rb->adjacency[rel].edges);
+	rb->adjacency[rel].offsets = 0;
+	rb->adjacency[rel].edges = 0;
+    }
+    g_free(rb->adj_nodes);
+    rb->adj_nodes = 0;
+    rb->num_adj_nodes = 0;
+}
+
+/*============================================================*/
+
+unsigned int
+mn_adj_count(const cml_node *mn, cml_adjacency rel)
+{
+    const cml_csr *csr;
+
+    if (mn->adj_index < 0)
+    	return g_list_length(*mn_adj_field((cml_node *)mn, rel));
+    csr = &mn->rulebase->adjacency[rel];
+    return csr->offsets[mn->adj_index+1] - csr->offsets[mn->adj_index];
+}
+
+/*
+ * Returns the n'th member of the relation, or 0 if there
+ * are not that many.
+ */
+gpointer
+mn_adj_nth(const cml_node *mn, cml_adjacency rel, unsigned int n)
+{
+    const cml_csr *csr;
+
+    if (mn->adj_index < 0)
+    	return g_list_nth_data(*mn_adj_field((cml_node *)mn, rel), n);
+    csr = &mn->rulebase->adjacency[rel];
+    if (n >= csr->offsets[mn->adj_index+1] - csr->offsets[mn->adj_index])
+    	return 0;
+    return csr->edges[csr->offsets[mn->adj_index] + n];
+}
+
+void
+mn_adj_iter_init(cml_adj_iter *iter, const cml_node *mn, cml_adjacency rel)
+{
+    if (mn->adj_index >= 0)
+    {
+    	const cml_csr *csr = &mn->rulebase->adjacency[rel];
+
+	iter->edge = csr->edges + csr->offsets[mn->adj_index];
+	iter->end = csr->edges + csr->offsets[mn->adj_index+1];
+	iter->list = 0;
+    }
+    else
+    {
+    	iter->edge = iter->end = 0;
+	iter->list = *mn_adj_field((cml_node *)mn, rel);
+    }
+}
+
+gpointer
+_mn_adj_iter_next_list(cml_adj_iter *iter)
+{
+    gpointer data;
+
+    if (iter->list == 0)
+    	return 0;
+    data = iter->list->data;
+    iter->list = iter->list->next;
+    return data;
+}
+
+/*============================================================*/
+/*
+ * The users of a node are the nodes whose value or visibility is
+ * computed from it: through a default, derivation or visibility
+ * expression, by depending on it, or as a radio button of its
+ * choice menu and vice versa.  Nothing needs this reverse map
+ * except the notifier and the visible children cache, so it is
+ * built the first time one of them asks.
+ */
+
+static void
+add_user(cml_rulebase *rb, cml_node *used, cml_node *user)
+{
+    GList *users;
+
+    if (used == user)
+    	return;
+    users = (GList *)g_hash_table_lookup(rb->users, used);
+    g_hash_table_insert(rb->users, used, g_list_prepend(users, user));
+}
+
+static void
+add_expr_users(cml_rulebase *rb, const cml_expr *expr, cml_node *user)
+{
+    int i;
+
+    if (expr == 0)
+    	return;
+    if (expr->type == E_SYMBOL && expr->symbol != 0)
+    	add_user(rb, expr->symbol, user);
+    for (i = 0 ; i < EXPR_MAX_CHILDREN ; i++)
+    	add_expr_users(rb, expr->children[i], user);
+}
+
+static void
+collect_users(gpointer key, gpointer value, gpointer user_data)
+{
+    cml_rulebase *rb = (cml_rulebase *)user_data;
+    cml_node *mn = (cml_node *)value;
+    cml_adj_iter iter;
+    cml_node *dep;
+
+    if (mn->treetype == MN_UNKNOWN || mn->treetype == MN_EXPLANATION)
+    	return;
+
+    /* default or derivation, then visibility */
+    add_expr_users(rb, mn->expr, mn);
+    add_expr_users(rb, mn->visibility_expr, mn);
+    mn_adj_iter_init(&iter, mn, MN_ADJ_DEPENDEES);
+    while ((dep = (cml_node *)mn_adj_iter_next(&iter)) != 0)
+    	add_user(rb, dep, mn);
+    if (mn->parent != 0 && cml_node_is_radio(mn->parent))
+    {
+    	/* a radio button's value is decided by its menu's */
+    	add_user(rb, mn, mn->parent);
+    	add_user(rb, mn->parent, mn);
+    }
+}
+
+static GList *
+rb_get_users(cml_rulebase *rb, const cml_node *mn)
+{
+    if (rb->users == 0)
+    {
+    	MEM_TAG_BEGIN(CML_MEM_NODES)
+    	rb->users = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_hash_table_foreach(rb->menu_nodes, collect_users, rb);
+	MEM_TAG_END
+    }
+    return (GList *)g_hash_table_lookup(rb->users, mn);
+}
+
+static gboolean
+delete_one_users(gpointer key, gpointer value, gpointer user_data)
+{
+    g_list_free((GList *)value);
+    return TRUE;    /* please remove me */
+}
+
+void
+rb_free_users(cml_rulebase *rb)
+{
+    if (rb->users == 0)
+    	return;
+    g_hash_table_foreach_remove(rb->users, delete_one_users, 0);
+    g_hash_table_destroy(rb->users);
+    rb->users = 0;
+}
+
+static void
+dirty_to_list(gpointer key, gpointer value, gpointer user_data)
+{
+    GList **listp = (GList **)user_data;
+
+    *listp = g_list_prepend(*listp, key);
+}
+
+static int
+node_compare_by_id(gconstpointer c1, gconstpointer c2)
+{
+    const cml_node *mn1 = (const cml_node *)c1;
+    const cml_node *mn2 = (const cml_node *)c2;
+
+    if (mn1->uniqueid > mn2->uniqueid)
+    	return 1;
+    else if (mn1->uniqueid < mn2->uniqueid)
+    	return -1;
+    else
+    	return 0;
+}
+
+/*
+ * Given a set of nodes whose bindings have changed, adds every node
+ * which transitively uses them to the set, and returns the whole set
+ * as a list: the original nodes in uniqueid order, then the rest
+ * breadth first.
+ */
+GList *
+rb_expand_users(cml_rulebase *rb, GHashTable *dirty)
+{
+    GList *queue = 0, *tail, *list, *users;
+
+    g_hash_table_foreach(dirty, dirty_to_list, &queue);
+    queue = g_list_sort(queue, node_compare_by_id);
+
+    tail = g_list_last(queue);
+    for (list = queue ; list != 0 ; list = list->next)
+    {
+    	users = rb_get_users(rb, (cml_node *)list->data);
+	for ( ; users != 0 ; users = users->next)
+	{
+	    if (g_hash_table_lookup(dirty, users->data) != 0)
+	    	continue;
+	    g_hash_table_insert(dirty, users->data, users->data);
+	    tail = g_list_last(g_list_append(tail, users->data));
+	}
+    }
+    return queue;
+}
+
+/*============================================================*/
+/*END*/
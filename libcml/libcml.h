@@ -22,6 +22,7 @@
 
 #include <glib.h>
 #include <memory.h>
+#include <stdio.h>
 
 typedef struct cml_location_s	    cml_location;
 typedef struct cml_subrange_s	    cml_subrange;
@@ -115,6 +116,107 @@ struct cml_enumdef_s
     unsigned long value;
 };
 
+/*
+ * Memory accounting, available when built with MEMSTATS=1.
+ * Allocations are charged to the subsystem which made them.
+ */
+typedef enum
+{
+    CML_MEM_OTHER,
+    CML_MEM_NODES,
+    CML_MEM_EXPRS,
+    CML_MEM_RULES,
+    CML_MEM_TRANSACTIONS,   /* transactions and bindings */
+    CML_MEM_STRINGS,
+    CML_MEM_RANGES,
+    CML_MEM_PARSER, 	    /* anything else allocated while parsing */
+    
+    CML_MEM_NUM_TAGS
+} cml_mem_tag;
+
+typedef struct
+{
+    unsigned long live_bytes;
+    unsigned long peak_bytes;
+    unsigned long num_allocs;	/* total ever allocated */
+    unsigned long num_live; 	/* currently allocated */
+} cml_mem_stats;
+
+/*
+ * Counters of calls into the rule engine's hot paths,
+ * which are always kept.
+ */
+typedef enum
+{
+    CML_STAT_EXPR_EVALUATE,
+    CML_STAT_EXPR_SIMPLIFY,
+    CML_STAT_EXPR_SOLVE,
+    CML_STAT_RULE_TRIGGER,
+    CML_STAT_NODE_SET_VALUE,
+    CML_STAT_TX_SET,
+    CML_STAT_NODE_IS_VISIBLE,
+    CML_STAT_VISIBLE_EVAL,  	/* visibility computed, not taken from the cache */
+    CML_STAT_NODE_GET_VALUE,
+    CML_STAT_FAILED_SETS,   	/* cml_node_set_value() calls which failed */
+    CML_STAT_RULES_BROKEN,  	/* rules which went from satisfied to broken */
+    CML_STAT_RULES_REPAIRED,	/* ...and back again */
+    
+    CML_STAT_NUM
+} cml_stat_id;
+
+typedef struct
+{
+    unsigned long counts[CML_STAT_NUM];
+    unsigned long compacted_bytes;  /* this rulebase's parse-only data
+				     * released after post-parse */
+} cml_stats;
+
+/*
+ * Phases timed when cml_rulebase_enable_timings() has been called.
+ * Lexing is timed separately from parsing, and overlap analysis is
+ * part of CML1 pass 2 so is also counted there.
+ */
+typedef enum
+{
+    CML_PHASE_LEX,
+    CML_PHASE_PARSE,	    	/* excluding lexing */
+    CML_PHASE_CML1_PASS2,
+    CML_PHASE_CHECK_NODES,
+    CML_PHASE_DEPS_TO_RULES,
+    CML_PHASE_CHECK_RULES,
+    CML_PHASE_OVERLAP,
+    CML_PHASE_LOAD_DEFCONFIG,
+    CML_PHASE_SAVE_DEFCONFIG,
+    
+    CML_PHASE_NUM
+} cml_phase;
+
+typedef struct
+{
+    double seconds;
+    unsigned long count;    	/* times entered, tokens for CML_PHASE_LEX */
+} cml_timing;
+
+typedef void (*cml_file_timing_func)(const char *filename,
+    	    	    	    	     const cml_timing *lex, void *user_data);
+
+/*
+ * Cost of one rule or derived symbol, recorded when
+ * cml_rulebase_enable_profile() has been called.
+ */
+typedef struct
+{
+    const char *symbol;     	/* name of derived symbol, or 0 for a rule */
+    unsigned long uniqueid; 	/* rule's id, 0 for a symbol */
+    cml_location location;
+    unsigned long evaluations;
+    double seconds; 	    	/* including anything triggered from it */
+    unsigned long broken;   	/* rules only: times left broken */
+    unsigned long punts;    	/* rules only: times expr_solve() gave up */
+    unsigned long tabled;   	/* derived only: times a rule's forcing
+				 * table answered without evaluating it */
+} cml_profile_entry;
+
 
 
 typedef enum 
@@ -127,6 +229,16 @@ typedef enum
 #define MN_MAX	MN_EXPLANATION
 } cml_node_treetype;
 
+/*
+ * For walking a node's children without building a list.
+ * The fields belong to libcml.
+ */
+typedef struct
+{
+    gpointer *edge, *end;
+    GList *list;
+} cml_node_iter;
+
 /* atom.c */
 char *cml_atom_value_as_string(const cml_atom *ap);
 const char *cml_atom_type_as_string(const cml_atom *ap);
@@ -137,7 +249,16 @@ cml_node_treetype cml_node_get_treetype(const cml_node *);
 cml_atom_type cml_node_get_value_type(const cml_node *);
 gboolean cml_node_is_radio(const cml_node *);
 gboolean cml_node_is_visible(const cml_node *);
+/* builds a new list which the caller must g_list_free(); walking
+ * the children with an iterator instead doesn't cost any memory */
 GList *cml_node_get_children(const cml_node *);
+int cml_node_get_num_children(const cml_node *);
+cml_node *cml_node_get_child(const cml_node *, int n);
+void cml_node_iter_children(cml_node_iter *, const cml_node *);
+cml_node *cml_node_iter_next(cml_node_iter *);
+/* cached, as is cml_node_is_visible() once this is first called;
+ * the list is only valid until the next binding change */
+const GList *cml_node_get_visible_children(cml_node *);
 const cml_atom *cml_node_get_value(cml_node *);
 char *cml_node_get_value_as_string(cml_node *mn);
 void cml_node_set_value(cml_node *mn, const cml_atom *ap);
@@ -152,6 +273,7 @@ unsigned long cml_node_get_range_count(const cml_node *);
 #define CML_NODE_MAX_STATES 	64
 int cml_node_get_states(const cml_node *, int n, char **);
 const char *cml_node_get_help_text(const cml_node *);
+gboolean cml_node_has_help_text(const cml_node *);
 const GList *cml_node_get_enumdefs(const cml_node *mn);
 
 /* rulebase.c */
@@ -159,6 +281,8 @@ cml_node *cml_rulebase_find_node(cml_rulebase *, const char *name);
 const char *cml_rulebase_get_banner(const cml_rulebase *rb);
 const cml_blob *cml_rulebase_get_icon(cml_rulebase*);
 cml_node *cml_rulebase_get_start(const cml_rulebase *rb);
+/* all rules files read, including sourced ones, in order first read */
+const GList *cml_rulebase_get_filenames(const cml_rulebase *rb);
 #if TESTSCRIPT
 gboolean cml_rulebase_run_test(cml_rulebase *rb);
 #endif
@@ -175,8 +299,25 @@ gboolean cml_rulebase_parse(cml_rulebase *, const char *filename);
 void cml_rulebase_set_merge_mode(cml_rulebase *rb);
 void cml_rulebase_set_xref_filename(cml_rulebase *rb, const char *filename);
 gboolean cml_rulebase_post_parse(cml_rulebase *rb);
+/*
+ * In progressive mode cml_rulebase_parse() returns as soon as the
+ * menu tree can be displayed, and the rule checks are left for
+ * cml_rulebase_finish_parse().  Until then values can be read but
+ * not set; libcml finishes the parse itself if one is.  If that
+ * fails, setting values, committing and loading fail from then on.
+ * Front ends can instead do the checks a piece at a time from their
+ * main loop with cml_rulebase_finish_parse_step(), reading the menus
+ * in between.
+ */
+void cml_rulebase_set_progressive(cml_rulebase *rb, gboolean b);
+gboolean cml_rulebase_finish_parse(cml_rulebase *rb);
+gboolean cml_rulebase_finish_parse_step(cml_rulebase *rb);
 void cml_rulebase_delete(cml_rulebase *rb);
 gboolean cml_rulebase_load_defconfig(cml_rulebase *, const char *filename);
+/* sets changed values only, returns how many or -1; caller commits */
+int cml_rulebase_update_defconfig(cml_rulebase *, const char *filename);
+/* binds only symbols the .config just loaded didn't mention; caller commits */
+int cml_rulebase_load_answers(cml_rulebase *, const char *filename);
 void cml_rulebase_menu_apply(cml_rulebase *,
     	cml_rulebase_node_visitor_func visitor,
 	void *user_data);
@@ -189,6 +330,7 @@ gboolean cml_rulebase_commit(cml_rulebase *, gboolean freeze);
 void cml_rulebase_abort(cml_rulebase *);
 void cml_rulebase_undo(cml_rulebase *);
 void cml_rulebase_redo(cml_rulebase *);
+/* also forgets which symbols were loaded from a .config */
 void cml_rulebase_clear(cml_rulebase *rb);
 gboolean cml_rulebase_can_undo(const cml_rulebase *rb);
 gboolean cml_rulebase_can_redo(const cml_rulebase *rb);
@@ -196,6 +338,63 @@ gboolean cml_rulebase_can_freeze(const cml_rulebase *rb);
 GList *cml_rulebase_get_broken_rules(const cml_rulebase *rb);
 void cml_rulebase_check_all_rules(cml_rulebase *rb);
 void cml_rulebase_set_warning(cml_rulebase *rb, int id, gboolean enabled);
+/* fills in stats[CML_MEM_NUM_TAGS], FALSE if not built with MEMSTATS */
+gboolean cml_rulebase_get_memory_stats(const cml_rulebase *rb, cml_mem_stats *stats);
+const char *cml_mem_tag_name(cml_mem_tag);
+/* the counters are shared by every rulebase in the process */
+void cml_rulebase_get_stats(const cml_rulebase *rb, cml_stats *stats);
+void cml_rulebase_reset_stats(cml_rulebase *rb);
+const char *cml_stat_name(cml_stat_id);
+/* the report printed by the front ends' --stats option */
+void cml_rulebase_print_stats(const cml_rulebase *rb, FILE *fp);
+void cml_rulebase_enable_timings(cml_rulebase *rb);
+/* fills in timings[CML_PHASE_NUM], FALSE if timings not enabled */
+gboolean cml_rulebase_get_timings(const cml_rulebase *rb, cml_timing *timings);
+/* lexing time for each file read, in the order first read */
+void cml_rulebase_foreach_file_timing(const cml_rulebase *rb,
+    	    	    	    	      cml_file_timing_func, void *user_data);
+const char *cml_phase_name(cml_phase);
+/* format is "json" or "tsv"; FALSE if timings not enabled */
+gboolean cml_rulebase_print_timings(const cml_rulebase *rb, FILE *fp,
+    	    	    	    	    const char *format);
+/* quoted and escaped as a JSON string */
+void cml_print_json_string(FILE *fp, const char *s);
+void cml_rulebase_enable_profile(cml_rulebase *rb);
+/* list of const cml_profile_entry*, most expensive first; g_list_free() it */
+GList *cml_rulebase_get_profile(const cml_rulebase *rb);
+
+/* notify.c */
+/* what changed about a node, passed or'ed to a cml_change_func */
+#define CML_CHANGED_VALUE	(1<<0)
+#define CML_CHANGED_VISIBLE	(1<<1)
+#define CML_CHANGED_FROZEN	(1<<2)
+#define CML_CHANGED_BROKEN	(1<<3)	/* used by a rule now broken or repaired */
+typedef void (*cml_change_func)(cml_rulebase *rb, cml_node *mn,
+    	    	    	    	unsigned int changed, void *user_data);
+/* called per changed node after commit, abort, undo, redo & clear; 0 to stop */
+void cml_rulebase_set_change_func(cml_rulebase *rb, cml_change_func func,
+    	    	    	    	  void *user_data);
+
+/* rulebase.c */
+typedef enum
+{
+    CML_PROGRESS_PARSE,     	/* done=files opened so far, total=0 */
+    CML_PROGRESS_LOAD,	    	/* done, total in bytes */
+    CML_PROGRESS_SAVE,	    	/* done, total in symbols */
+    CML_PROGRESS_CHECK	    	/* done, total in steps of rule checking */
+} cml_progress_phase;
+/* return FALSE to cancel the operation, which then fails */
+typedef gboolean (*cml_progress_func)(cml_rulebase *rb, cml_progress_phase phase,
+    	    	    	    	      const char *filename, unsigned long done,
+				      unsigned long total, void *user_data);
+/* called periodically during parse, rule checks, load and save; 0 to stop */
+void cml_rulebase_set_progress_func(cml_rulebase *rb, cml_progress_func func,
+    	    	    	    	    void *user_data);
+
+/* trace.c */
+void cml_rulebase_enable_trace(cml_rulebase *rb);
+/* write folded stacks for flame graph tools */
+gboolean cml_rulebase_save_trace(cml_rulebase *rb, const char *filename);
 
 
 /* message.c */
@@ -209,6 +408,10 @@ int cml_warning_get_num(void);
 int cml_warning_id_by_name(const char *name);
 const char *cml_warning_name_by_id(int id);
 
+/* util.c */
+/* a timestamp in seconds, for measuring intervals */
+double cml_timer_now(void);
+
 
 
 #endif /* _libcml_h_ */
@@ -21,120 +21,195 @@
 #include "debug.h"
 #include "util.h"
 #include <ctype.h>
+#include <sys/stat.h>
 
 CVSID("$Id: load.c,v 1.7 2002/09/01 08:19:14 gnb Exp $");
 
 /*============================================================*/
 
+/*
+ * Parse one line of a .config file in place, returning FALSE
+ * if it doesn't bind a value to a symbol.
+ */
 static gboolean
-rb_parse(cml_rulebase *rb, FILE *fp)
+parse_line(cml_rulebase *rb, char *buf, char **namep, char **valuep)
 {
     char *p, *x;
     char *name;
     char *value;
     int preflen = (rb->prefix == 0 ? 0 : strlen(rb->prefix));
-    cml_atom a;
-    cml_node *mn;
-    char buf[1024];
-    
-    while (fgets(buf, sizeof(buf), fp) != 0)
+
+    /* strip off trailing newline */
+    if ((p = strrchr(buf, '\n')) != 0)
+	*p = '\0';
+    if ((p = strrchr(buf, '\r')) != 0)
+	*p = '\0';
+
+    /* skip any initial whitespace */
+    for (p = buf ; *p && isspace(*p) ; p++)
+	;
+    if (!*p)
+	return FALSE;	/* ignore empty lines */
+
+    if (*p == '#')
     {
-    	/* strip off trailing newline */
-	if ((p = strrchr(buf, '\n')) != 0)
-	    *p = '\0';
-	if ((p = strrchr(buf, '\r')) != 0)
-	    *p = '\0';
-	    
-	/* skip any initial whitespace */
-    	for (p = buf ; *p && isspace(*p) ; p++)
+	if (strstr(p, "is not set") == 0)
+	    return FALSE;   /* normal comment */
+	if (preflen)
+	{
+	    /* use the prefix to find the symbol name */
+	    if ((name = strstr(p, rb->prefix)) == 0)
+		return FALSE;
+	    name += preflen;
+	}
+	else
+	{
+	    /* assume the symbol name is after leading '#' and whitespace */
+    	    for (p++ ; *p && isspace(*p) ; p++)
+		;
+	    if (!isalpha(*p) && *p != '_')
+		return FALSE;
+	    name = p;
+	}
+	/* scan for end of name */
+	for (x = name ; *x && !isspace(*x) ; x++)
 	    ;
-	if (!*p)
-	    continue;	/* ignore empty lines */
-
-    	if (*p == '#')
+	if (!*x)
+	    return FALSE;
+	*x = '\0';	/* terminate name */
+	value = "n";
+    }
+    else
+    {
+	/* CONFIG_FOO=value */
+	if (preflen)
 	{
-	    if (strstr(p, "is not set") == 0)
-	    	continue;   /* normal comment */
-	    if (preflen)
-	    {
-	    	/* use the prefix to find the symbol name */
-		if ((name = strstr(p, rb->prefix)) == 0)
-		    continue;
-		name += preflen;
-	    }
-	    else
-	    {
-	    	/* assume the symbol name is after leading '#' and whitespace */
-    		for (p++ ; *p && isspace(*p) ; p++)
-		    ;
-		if (!isalpha(*p) && *p != '_')
-		    continue;
-		name = p;
-	    }
-	    /* scan for end of name */
-	    for (x = name ; *x && !isspace(*x) ; x++)
-	    	;
-	    if (!*x)
-	    	continue;
-	    *x = '\0';	/* terminate name */
-	    value = "n";
+	    /* check the symbol has the prefix */
+	    if (strncmp(p, rb->prefix, preflen))
+		return FALSE;
+	    name = p + preflen;
 	}
 	else
 	{
-	    /* CONFIG_FOO=value */
-	    if (preflen)
-	    {
-	    	/* check the symbol has the prefix */
-		if (strncmp(p, rb->prefix, preflen))
-		    continue;
-		name = p + preflen;
-	    }
-	    else
-	    {
-	    	name = p;
-	    }
-	    if ((value = strchr(name, '=')) == 0)
-	    	continue;
-	    /* trim whitespace off end of name */
-    	    for (x = value - 1 ; x > name && isspace(*x) ; --x)
-	    	*x = '\0';
-	    /* seperate name and value */
-	    *value++ = '\0';
-	    /* trim whitespace off start of value */
-	    while (*value && isspace(*value))
-	    	value++;
-	    if (!*value)
-	    	continue;
-	    /* handle quoted value */
-	    if (*value == '"')
-	    {
-	    	value++;
-		if ((x = strchr(value, '"')) == 0)
-		    continue;
-		*x = '\0';
-	    }
-	    else
-	    {
-		/* trim whitespace off end of value */
-    		for (x = value + strlen(value) ; x != value && isspace(*x) ; --x)
-	    	    *x = '\0';
-    	    }
+	    name = p;
 	}
-	
-	/* add binding */
-	if ((mn = cml_rulebase_find_node(rb, name)) == 0)
-	    continue;
-	if (cml_node_get_treetype(mn) != MN_SYMBOL)
-	    continue;
+	if ((value = strchr(name, '=')) == 0)
+	    return FALSE;
+	/* trim whitespace off end of name */
+    	for (x = value - 1 ; x > name && isspace(*x) ; --x)
+	    *x = '\0';
+	/* seperate name and value */
+	*value++ = '\0';
+	/* trim whitespace off start of value */
+	while (*value && isspace(*value))
+	    value++;
+	if (!*value)
+	    return FALSE;
+	/* handle quoted value */
+	if (*value == '"')
+	{
+	    value++;
+	    if ((x = strchr(value, '"')) == 0)
+		return FALSE;
+	    *x = '\0';
+	}
+	else
+	{
+	    /* trim whitespace off end of value */
+    	    for (x = value + strlen(value) ; x != value && isspace(*x) ; --x)
+	    	*x = '\0';
+    	}
+    }
+
+    *namep = name;
+    *valuep = value;
+    return TRUE;
+}
+
+/*
+ * Find the symbol bound by one line of a .config file and
+ * convert the value, returning 0 if the line can't be used.
+ */
+static cml_node *
+parse_binding(cml_rulebase *rb, char *buf, cml_atom *ap)
+{
+    char *name;
+    char *value;
+    cml_node *mn;
+    
+    if (!parse_line(rb, buf, &name, &value))
+    	return 0;
+    if ((mn = cml_rulebase_find_node(rb, name)) == 0)
+	return 0;
+    if (cml_node_get_treetype(mn) != MN_SYMBOL)
+	return 0;
+
+    cml_atom_init(ap);
+    ap->type = cml_node_get_value_type(mn);
+    if (!cml_atom_from_string(ap, value))
+	return 0;
+
+    DDPRINTF2(DEBUG_LOAD, "`%s'=`%s'\n", name, value);
+    return mn;
+}
 
-	cml_atom_init(&a);
-	a.type = cml_node_get_value_type(mn);
-	if (!cml_atom_from_string(&a, value))
+/*
+ * A .config lists every alternative of a choice, but only the one
+ * which is set says anything; binding the others to n as well would
+ * clash with the choice setting them when the set one is bound.
+ */
+static gboolean
+is_unset_alternative(const cml_node *mn, const cml_atom *ap)
+{
+    return (mn->parent != 0 &&
+    	    cml_node_is_radio(mn->parent) &&
+	    ap->value.tritval != CML_Y);
+}
+
+/* report progress every this many lines */
+#define PROGRESS_LINES	64
+
+static unsigned long
+file_size(FILE *fp)
+{
+    struct stat sb;
+
+    if (fstat(fileno(fp), &sb) < 0)
+    	return 0;
+    return sb.st_size;
+}
+
+static gboolean
+load_progress(cml_rulebase *rb, const char *filename, FILE *fp,
+    	      unsigned long lineno, unsigned long size)
+{
+    if (lineno % PROGRESS_LINES != 0)
+    	return TRUE;
+    return rb_progress(rb, CML_PROGRESS_LOAD, filename, ftell(fp), size);
+}
+
+static gboolean
+rb_parse(cml_rulebase *rb, const char *filename, FILE *fp)
+{
+    cml_atom a;
+    cml_node *mn;
+    char buf[1024];
+    unsigned long lineno = 0;
+    unsigned long size = file_size(fp);
+    
+    while (fgets(buf, sizeof(buf), fp) != 0)
+    {
+	if (!load_progress(rb, filename, fp, ++lineno, size))
+	    return FALSE;
+	if ((mn = parse_binding(rb, buf, &a)) == 0)
 	    continue;
 
-	DDPRINTF2(DEBUG_LOAD, "`%s'=`%s'\n", name, value);
-	mn_set_value(mn, &a, rb->start);
+	/* add binding */
+	if (!is_unset_alternative(mn, &a))
+	    mn_set_value(mn, &a, rb->start);
 	mn->flags |= MN_LOADED;
+	if (a.type == A_STRING)
+	    g_free(a.value.string);
     }
     return TRUE;
 }
@@ -146,18 +221,174 @@ cml_rulebase_load_defconfig(cml_rulebase *rb, const char *filename)
     FILE *fp;
     gboolean ret;
     
+    if (!RB_FINISH_PARSE(rb))
+    	return FALSE;
+    rb->cancelled = FALSE;
     if ((fp = fopen(filename, "r")) == 0)
     {
     	cml_perror(filename);
     	return FALSE;
     }
 
-    ret = rb_parse(rb, fp);
+    PHASE_BEGIN(rb, CML_PHASE_LOAD_DEFCONFIG)
+    ret = rb_parse(rb, filename, fp);
+    PHASE_END(rb, CML_PHASE_LOAD_DEFCONFIG)
         
     fclose(fp);
     
     return ret;
 }
 
+/*
+ * Re-read a .config into a live rulebase, setting only those
+ * symbols whose value in the file differs from their current
+ * value, as if by cml_node_set_value().  Bindings which have
+ * been removed from the file keep their current value.  The
+ * caller must commit.  Returns the number of symbols set, or
+ * -1 if the file can't be read, the load is cancelled or the
+ * rules are unusable.
+ */
+int
+cml_rulebase_update_defconfig(cml_rulebase *rb, const char *filename)
+{
+    FILE *fp;
+    cml_atom a;
+    const cml_atom *curr;
+    cml_node *mn;
+    int nchanged = 0;
+    char buf[1024];
+    unsigned long lineno = 0;
+    unsigned long size;
+    
+    if (!RB_FINISH_PARSE(rb))
+    	return -1;
+    rb->cancelled = FALSE;
+    if ((fp = fopen(filename, "r")) == 0)
+    {
+    	cml_perror(filename);
+    	return -1;
+    }
+    size = file_size(fp);
+
+    PHASE_BEGIN(rb, CML_PHASE_LOAD_DEFCONFIG)
+    while (fgets(buf, sizeof(buf), fp) != 0)
+    {
+	if (!load_progress(rb, filename, fp, ++lineno, size))
+	{
+	    nchanged = -1;
+	    break;
+	}
+	if ((mn = parse_binding(rb, buf, &a)) == 0)
+	    continue;
+
+	curr = cml_node_get_value(mn);
+	if (!is_unset_alternative(mn, &a) &&
+	    (curr == 0 || curr->type != a.type || _atom_compare(curr, &a)))
+	{
+	    DDPRINTF1(DEBUG_LOAD, "    %s changed\n", mn->name);
+	    cml_node_set_value(mn, &a);
+	    mn->flags |= MN_LOADED;
+	    nchanged++;
+	}
+	if (a.type == A_STRING)
+	    g_free(a.value.string);
+    }
+    PHASE_END(rb, CML_PHASE_LOAD_DEFCONFIG)
+        
+    fclose(fp);
+    
+    return nchanged;
+}
+
+/*============================================================*/
+/*
+ * True if the last .config loaded mentioned the symbol, or for
+ * a choice, any of its alternatives.
+ */
+static gboolean
+was_loaded(const cml_node *mn)
+{
+    cml_adj_iter kids;
+    const cml_node *child;
+
+    if (mn->parent == 0 || !cml_node_is_radio(mn->parent))
+    	return ((mn->flags & MN_LOADED) != 0);
+
+    mn_adj_iter_init(&kids, mn->parent, MN_ADJ_CHILDREN);
+    while ((child = (const cml_node *)mn_adj_iter_next(&kids)) != 0)
+    {
+    	if ((child->flags & MN_LOADED))
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Read a file in .config format giving answers for new symbols,
+ * i.e. those the .config loaded since the last clear didn't
+ * mention, and bind each of those as if the .config had.  Call
+ * it after cml_rulebase_load_defconfig() and before committing.
+ * Answers for symbols which were loaded are ignored, as are
+ * answers which earlier answers have already brought about.
+ * The caller must commit, which fails if an answer couldn't be
+ * bound.  Returns the number of symbols set, or -1 if the file
+ * can't be read, the load is cancelled or the rules are unusable.
+ */
+int
+cml_rulebase_load_answers(cml_rulebase *rb, const char *filename)
+{
+    FILE *fp;
+    cml_atom a;
+    const cml_atom *curr;
+    cml_node *mn;
+    int nset = 0;
+    char buf[1024];
+    unsigned long lineno = 0;
+    unsigned long size;
+    
+    if (!RB_FINISH_PARSE(rb))
+    	return -1;
+    rb->cancelled = FALSE;
+    if ((fp = fopen(filename, "r")) == 0)
+    {
+    	cml_perror(filename);
+    	return -1;
+    }
+    size = file_size(fp);
+
+    PHASE_BEGIN(rb, CML_PHASE_LOAD_DEFCONFIG)
+    while (fgets(buf, sizeof(buf), fp) != 0)
+    {
+	if (!load_progress(rb, filename, fp, ++lineno, size))
+	{
+	    nset = -1;
+	    break;
+	}
+	if ((mn = parse_binding(rb, buf, &a)) == 0)
+	    continue;
+
+	curr = cml_node_get_value(mn);
+	if (!was_loaded(mn) &&
+	    !is_unset_alternative(mn, &a) &&
+	    (curr == 0 || curr->type != a.type || _atom_compare(curr, &a)))
+	{
+	    DDPRINTF1(DEBUG_LOAD, "    %s answered\n", mn->name);
+	    /* like a .config binding, rules may be broken until the end */
+	    mn_set_value(mn, &a, rb->start);
+	    curr = cml_node_get_value(mn);
+	    if (curr == 0 || _atom_compare(curr, &a))
+	    	rb->num_failed_sets++;
+	    nset++;
+	}
+	if (a.type == A_STRING)
+	    g_free(a.value.string);
+    }
+    PHASE_END(rb, CML_PHASE_LOAD_DEFCONFIG)
+        
+    fclose(fp);
+    
+    return nset;
+}
+
 /*============================================================*/
 /*END*/
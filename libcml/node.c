@@ -22,6 +22,10 @@
 
 CVSID("$Id: node.c,v 1.18 2002/09/01 08:24:36 gnb Exp $");
 
+/* relations can only be modified when not frozen */
+#define mn_thaw(mn) \
+    do { if ((mn)->rulebase != 0) rb_thaw_graph((mn)->rulebase); } while (0)
+
 /*============================================================*/
 
 cml_enumdef *
@@ -29,7 +33,9 @@ cml_enumdef_new(cml_node *symbol, unsigned long value)
 {
     cml_enumdef *ed;
     
+    MEM_TAG_BEGIN(CML_MEM_NODES)
     ed = g_new(cml_enumdef, 1);
+    MEM_TAG_END
     memset(ed, 0, sizeof(*ed));
     
     ed->symbol = symbol;
@@ -46,27 +52,70 @@ cml_enumdef_delete(cml_enumdef *ed)
 
 /*============================================================*/
 
+/*
+ * Nodes are carved out of blocks so that nodes created together,
+ * which is mostly nodes of the same rulebase, are adjacent in memory
+ * and rule evaluation walks a dense array.  Deleted nodes go on a
+ * free list for reuse; the blocks themselves are never released, so
+ * deleting a rulebase doesn't give its nodes' memory back.
+ *
+ * The free list, the current block and the id counter in mn_new()
+ * are shared by every rulebase and aren't locked, so only one thread
+ * at a time may create or delete nodes.  The GTK front end's worker
+ * thread (gtk/worker.c) is safe only because the GTK thread doesn't
+ * call into libcml while a job runs.
+ */
+#define MN_BLOCK_SIZE	256
+
+static cml_node *mn_free_list;
+static cml_node *mn_block;
+static int mn_block_used = MN_BLOCK_SIZE;
+
+static cml_node *
+mn_alloc(void)
+{
+    cml_node *mn;
+    
+    if ((mn = mn_free_list) != 0)
+    {
+	mn_free_list = mn->parent;
+	return mn;
+    }
+    if (mn_block_used == MN_BLOCK_SIZE)
+    {
+    	MEM_TAG_BEGIN(CML_MEM_NODES)
+    	mn_block = g_new(cml_node, MN_BLOCK_SIZE);
+	MEM_TAG_END
+	mn_block_used = 0;
+    }
+    return &mn_block[mn_block_used++];
+}
+
 cml_node *
-mn_new(const char *name)
+mn_new(cml_rulebase *rb, const char *name)
 {
-    cml_node *mn = g_new(cml_node, 1);
+    cml_node *mn = mn_alloc();
     static unsigned long last_uniqueid = 0;
     
     if (mn == 0)
     	return 0;
     memset(mn, 0, sizeof(*mn));
+    MEM_TAG_BEGIN(CML_MEM_NODES)
+    mn->cold = g_new0(cml_node_cold, 1);
+    MEM_TAG_END
     mn->treetype = MN_UNKNOWN;
     mn->flags = 0;
-    mn->name = g_strdup(name);
+    mn->name = rb_intern(rb, name);
+    mn->rulebase = rb;
     mn->uniqueid = ++last_uniqueid;
+    mn->adj_index = -1;
     return mn;
 }
 
 void
 mn_delete(cml_node *mn)
 {
-    strdelete(mn->name);
-    strdelete(mn->banner);
+    /* name and banner belong to the rulebase's string pool */
     listclear(mn->rules_using);
     if (mn->visibility_expr != 0)
     	expr_destroy(mn->visibility_expr);
@@ -76,15 +125,18 @@ mn_delete(cml_node *mn)
     listclear(mn->children);
     if (mn->expr != 0)
     	expr_destroy(mn->expr);
-    atom_dtor(&mn->value);
+    /* mn->value is only a shallow cache of a derived or default value */
     listclear(mn->transactions_guarded);
     listclear(mn->bindings);
     range_delete(mn->range);
-    listdelete(mn->enumdefs, cml_enumdef, cml_enumdef_delete);
+    listdelete(mn->cold->enumdefs, cml_enumdef, cml_enumdef_delete);
     listclear(mn->dependants);
     listclear(mn->dependees);
-    strdelete(mn->help_text);
-    g_free(mn);
+    strdelete(mn->cold->help_text);
+    g_free(mn->cold);
+    
+    mn->parent = mn_free_list;
+    mn_free_list = mn;
 }
 
 /*============================================================*/
@@ -135,12 +187,12 @@ int
 cml_node_get_states(const cml_node *mn, int maxn, char **states)
 {
     int n = 0;
-    GList *iter;
+    cml_adj_iter iter;
+    cml_node *dee;
     
-    for (iter = mn->dependees ; iter != 0 ; iter = iter->next)
+    mn_adj_iter_init(&iter, mn, MN_ADJ_DEPENDEES);
+    while ((dee = (cml_node *)mn_adj_iter_next(&iter)) != 0)
     {
-    	cml_node *dee = (cml_node *)iter->data;
-	
 	if (n < maxn && (dee->flags & MN_FLAG_WARNDEPEND))
     	    states[n++] = dee->name;
     }
@@ -186,10 +238,21 @@ mn_add_visibility_expr(cml_node *mn, cml_expr *expr)
 
 gboolean
 cml_node_is_visible(const cml_node *mn)
+{
+    STAT_INC(CML_STAT_NODE_IS_VISIBLE);
+    if (mn->rulebase != 0 && mn->rulebase->visible_dirty != 0)
+    	return visible_lookup(mn);
+    return mn_evaluate_visibility(mn);
+}
+
+gboolean
+mn_evaluate_visibility(const cml_node *mn)
 {
     cml_atom a;
-    GList *iter;
+    cml_adj_iter iter;
+    cml_node *dep;
     
+    STAT_INC(CML_STAT_VISIBLE_EVAL);
     if (mn->visibility_expr == 0)
     	return TRUE;	/* default is to be visible always */
     
@@ -198,10 +261,9 @@ cml_node_is_visible(const cml_node *mn)
     if (a.value.tritval != CML_Y)
     	return FALSE;
     
-    for (iter = mn->dependees ; iter != 0 ; iter = iter->next)
+    mn_adj_iter_init(&iter, mn, MN_ADJ_DEPENDEES);
+    while ((dep = (cml_node *)mn_adj_iter_next(&iter)) != 0)
     {
-    	cml_node *dep = (cml_node *)iter->data;
-	
 	if (!cml_node_is_visible(dep))
 	    return FALSE;
     }
@@ -286,12 +348,11 @@ cml_node_get_value(cml_node *mn)
 {
     const cml_binding *bd;
 
+    STAT_INC(CML_STAT_NODE_GET_VALUE);
     switch (mn->treetype)
     {
     case MN_DERIVED:
-	assert(mn->expr != 0);
-	cml_atom_init(&mn->value);
-	expr_evaluate(mn->expr, &mn->value);
+	expr_evaluate_derived(mn);
 	return &mn->value;
 	
     case MN_MENU:
@@ -320,8 +381,11 @@ cml_node_get_value(cml_node *mn)
 		
     	    	if (mn->value_type == A_NODE)
 		{
+		    cml_adj_iter kids;
+		    
+		    mn_adj_iter_init(&kids, mn, MN_ADJ_CHILDREN);
 		    mn->value.type = A_NODE;
-		    mn->value.value.node = (mn->children == 0 ? 0 : mn->children->data);
+		    mn->value.value.node = (cml_node *)mn_adj_iter_next(&kids);
 		}
 		else if (!mn->rulebase->cml1_default_vals)
 		{
@@ -357,9 +421,9 @@ mn_set_value2(
     const cml_atom *ap,
     cml_node *source)
 {
-    gboolean ret = TRUE;
     GList *nodes;
     
+    STAT_INC(CML_STAT_NODE_SET_VALUE);
     if (mn_is_chilled(mn))
     {
     	cml_errorl(0, "Ruleset found unsatisfiable while setting %s", mn->name);
@@ -375,17 +439,16 @@ mn_set_value2(
     {
     	cml_node *trig = (cml_node *)nodes->data;
 
-    	DDPRINTF1(DEBUG_RULES, "triggering rules for node %s\n", trig->name);
-	if (!rb_trigger_rules(mn->rulebase, trig->rules_using, source))
-    	    ret = FALSE;
+    	DDPRINTF1(DEBUG_RULES, "queueing rules for node %s\n", trig->name);
+	rb_queue_rules_using(mn->rulebase, trig);
     	nodes = g_list_remove_link(nodes, nodes);
     }
     
-    return ret;
+    return rb_propagate(mn->rulebase, source);
 }
 
-gboolean
-mn_set_value(
+static gboolean
+mn_set_value_untraced(
     cml_node *mn,
     const cml_atom *ap,
     cml_node *source)
@@ -393,7 +456,8 @@ mn_set_value(
     if (cml_node_is_radio(mn))
     {
 	/* if the menunode is a `choices', set the children using radio behaviour */
-	GList *list;
+	cml_adj_iter kids;
+	cml_node *child;
 	cml_atom childval;
 	
 	if (!mn_set_value2(mn, ap, source))
@@ -402,10 +466,9 @@ mn_set_value(
 	cml_atom_init(&childval);
 	childval.type = A_BOOLEAN;
 	
-	for (list = mn->children ; list != 0 ; list = list->next)
+	mn_adj_iter_init(&kids, mn, MN_ADJ_CHILDREN);
+	while ((child = (cml_node *)mn_adj_iter_next(&kids)) != 0)
 	{
-	    cml_node *child = (cml_node *)list->data;
-
 	    assert(child->treetype == MN_SYMBOL);
 	    assert(child->value_type == A_BOOLEAN);
 	    childval.value.tritval = (child == ap->value.node ? CML_Y : CML_N);
@@ -431,13 +494,40 @@ mn_set_value(
     return TRUE;
 }
 
+gboolean
+mn_set_value(
+    cml_node *mn,
+    const cml_atom *ap,
+    cml_node *source)
+{
+    cml_tracer *tr = mn->rulebase->tracer;
+    gboolean ret;
+
+    if (tr == 0)
+    	return mn_set_value_untraced(mn, ap, source);
+    trace_push_set(tr, mn, source);
+    ret = mn_set_value_untraced(mn, ap, source);
+    trace_pop(tr);
+    return ret;
+}
+
 void
 cml_node_set_value(cml_node *mn, const cml_atom *ap)
 {
+    if (!RB_FINISH_PARSE(mn->rulebase))
+    {
+    	/* the rules are unusable, so make the commit fail */
+	mn->rulebase->num_failed_sets++;
+	STAT_INC(CML_STAT_FAILED_SETS);
+	return;
+    }
     if (mn->treetype == MN_SYMBOL || cml_node_is_radio(mn))
     {
 	if (!mn_set_value(mn, ap, mn))
+	{
 	    mn->rulebase->num_failed_sets++;
+	    STAT_INC(CML_STAT_FAILED_SETS);
+	}
     }
 }
 
@@ -475,7 +565,7 @@ cml_node_get_name(const cml_node *mn)
 const char *
 cml_node_get_banner(const cml_node *mn)
 {
-    return mn->banner;
+    return mn->cold->banner;
 }
 
 cml_node *
@@ -487,7 +577,40 @@ cml_node_get_parent(const cml_node *mn)
 GList *
 cml_node_get_children(const cml_node *mn)
 {
-    return mn->children;
+    cml_adj_iter kids;
+    cml_node *child;
+    GList *list = 0;
+
+    mn_adj_iter_init(&kids, mn, MN_ADJ_CHILDREN);
+    while ((child = (cml_node *)mn_adj_iter_next(&kids)) != 0)
+    	list = g_list_prepend(list, child);
+    return g_list_reverse(list);
+}
+
+int
+cml_node_get_num_children(const cml_node *mn)
+{
+    return mn_adj_count(mn, MN_ADJ_CHILDREN);
+}
+
+cml_node *
+cml_node_get_child(const cml_node *mn, int n)
+{
+    if (n < 0)
+    	return 0;
+    return (cml_node *)mn_adj_nth(mn, MN_ADJ_CHILDREN, n);
+}
+
+void
+cml_node_iter_children(cml_node_iter *iter, const cml_node *mn)
+{
+    mn_adj_iter_init(iter, mn, MN_ADJ_CHILDREN);
+}
+
+cml_node *
+cml_node_iter_next(cml_node_iter *iter)
+{
+    return (cml_node *)mn_adj_iter_next(iter);
 }
 
 const cml_range *
@@ -505,7 +628,7 @@ cml_node_get_range_count(const cml_node *mn)
 const GList *
 cml_node_get_enumdefs(const cml_node *mn)
 {
-    return mn->enumdefs;
+    return mn->cold->enumdefs;
 }
 
 /*============================================================*/
@@ -513,13 +636,13 @@ cml_node_get_enumdefs(const cml_node *mn)
 void *
 cml_node_get_user_data(const cml_node *mn)
 {
-    return mn->user_data;
+    return mn->cold->user_data;
 }
 
 void
 cml_node_set_user_data(cml_node *mn, void *ud)
 {
-    mn->user_data = ud;
+    mn->cold->user_data = ud;
 }
 
 /*============================================================*/
@@ -531,6 +654,7 @@ mn_set_children(cml_node *node, GList *children)
     
     /* TODO: issue error if this node already has children */
     /* TODO: issue error if node->type != MN_MENU */
+    mn_thaw(node);
     node->children = children;
     for (list = children ; list != 0 ; list = list->next)
     {
@@ -545,7 +669,10 @@ mn_add_child(cml_node *node, cml_node *child)
 {
     assert(child->parent == 0);
     assert(node->treetype == MN_MENU);
+    mn_thaw(node);
+    MEM_TAG_BEGIN(CML_MEM_NODES)
     node->children = g_list_append(node->children, child);
+    MEM_TAG_END
     child->parent = node;
 }
 
@@ -553,12 +680,15 @@ void
 mn_reparent(cml_node *newparent, cml_node *child)
 {
     assert(newparent->treetype == MN_MENU);
+    mn_thaw(newparent);
     if (child->parent != 0)
     {
 	assert(child->parent->treetype == MN_MENU);
     	child->parent->children = g_list_remove(child->parent->children, child);
     }
+    MEM_TAG_BEGIN(CML_MEM_NODES)
     newparent->children = g_list_append(newparent->children, child);
+    MEM_TAG_END
     child->parent = newparent;
 }
 
@@ -568,7 +698,10 @@ _mn_add_using_rule(cml_node *mn, cml_rule *rule)
     DDPRINTF2(DEBUG_RULES, "Rule %ld uses symbol %s\n",
 	rule->uniqueid,
 	mn->name);
+    mn_thaw(mn);
+    MEM_TAG_BEGIN(CML_MEM_NODES)
     mn->rules_using = g_list_prepend(mn->rules_using, rule);
+    MEM_TAG_END
 }
 
 /*============================================================*/
@@ -585,19 +718,23 @@ mn_add_dependant(
     assert(dependee->treetype == MN_SYMBOL || dependee->treetype == MN_DERIVED || dependee->treetype == MN_UNKNOWN);
     assert(dependant->treetype == MN_MENU || dependant->treetype == MN_SYMBOL);
 
+    mn_thaw(dependee);
+    MEM_TAG_BEGIN(CML_MEM_NODES)
     dependee->dependants = g_list_prepend(dependee->dependants, dependant);
     dependant->dependees = g_list_prepend(dependant->dependees, dependee);
+    MEM_TAG_END
 }
 
 GList *
 cml_node_get_warn_dependees(const cml_node *mn)
 {
-    GList *ret = 0, *list;
+    GList *ret = 0;
+    cml_adj_iter iter;
+    cml_node *dee;
     
-    for (list = mn->dependees ; list != 0 ; list = list->next)
+    mn_adj_iter_init(&iter, mn, MN_ADJ_DEPENDEES);
+    while ((dee = (cml_node *)mn_adj_iter_next(&iter)) != 0)
     {
-    	cml_node *dee = (cml_node *)list->data;
-	
 	if (dee->flags & MN_FLAG_WARNDEPEND)
 	    ret = g_list_prepend(ret, dee);
     }
@@ -607,10 +744,50 @@ cml_node_get_warn_dependees(const cml_node *mn)
 
 /*============================================================*/
 
+/*
+ * Help text stays in the rulebase file until first asked for.
+ * It is the text's lines joined by newlines; blank lines are
+ * dropped, as they always were by the lexer.
+ */
+static char *
+help_text_read(cml_rulebase *rb, const cml_text_ref *ref)
+{
+    char *raw, *in, *out;
+    
+    if ((raw = textref_read(rb, ref)) == 0)
+    	return 0;
+	
+    for (in = out = raw ; *in ; in++)
+    {
+    	if (*in == '\n' && (out == raw || out[-1] == '\n'))
+	    continue;
+	*out++ = *in;
+    }
+    while (out > raw && out[-1] == '\n')
+    	out--;
+    *out = '\0';
+    
+    return raw;
+}
+
 const char *
 cml_node_get_help_text(const cml_node *mn)
 {
-    return mn->help_text;
+    cml_node_cold *cold = mn->cold;
+    
+    if (cold->help_text == 0 && cold->help_ref.length > 0)
+    {
+    	MEM_TAG_BEGIN(CML_MEM_STRINGS)
+    	cold->help_text = help_text_read(mn->rulebase, &cold->help_ref);
+	MEM_TAG_END
+    }
+    return cold->help_text;
+}
+
+gboolean
+cml_node_has_help_text(const cml_node *mn)
+{
+    return (mn->cold->help_text != 0 || mn->cold->help_ref.length > 0);
 }
 
 /*============================================================*/
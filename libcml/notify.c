@@ -0,0 +1,302 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "private.h"
+#include "debug.h"
+
+CVSID("$Id$");
+
+/*============================================================*/
+/*
+ * The notifier tells a front end which nodes have changed at the
+ * end of each commit, abort, undo, redo or clear, so it can refresh
+ * just their widgets.  In between, the transaction code records
+ * each node whose binding is added or removed and the rule code
+ * records each rule which breaks or is repaired.  At the end those
+ * are expanded through a reverse dependency map to every node whose
+ * value, visibility, frozen state or broken-rule membership might
+ * depend on them, and each of those is compared with the state last
+ * reported for it.
+ */
+
+typedef struct
+{
+    cml_atom value;
+    unsigned int visible:1;
+    unsigned int frozen:1;
+    unsigned int broken:1;  	/* used by a broken rule */
+} notify_state;
+
+struct cml_notifier_s
+{
+    cml_rulebase *rulebase;
+    cml_change_func func;
+    void *user_data;
+    GHashTable *states;     	/* key=cml_node value=notify_state* */
+    GHashTable *dirty;	    	/* nodes to recheck, key=value=cml_node */
+    GHashTable *rules;	    	/* rules broken or repaired, key=value=cml_rule */
+    gboolean flushing;
+};
+
+/*============================================================*/
+
+static gboolean
+node_is_broken(cml_rulebase *rb, const cml_node *mn)
+{
+    cml_adj_iter iter;
+    cml_rule *rule;
+
+    mn_adj_iter_init(&iter, mn, MN_ADJ_RULES_USING);
+    while ((rule = (cml_rule *)mn_adj_iter_next(&iter)) != 0)
+    {
+    	if (g_hash_table_lookup(rb->broken_rules, rule) != 0)
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+static void
+get_state(cml_rulebase *rb, cml_node *mn, notify_state *st)
+{
+    const cml_atom *ap = cml_node_get_value(mn);
+
+    cml_atom_init(&st->value);
+    if (ap != 0)
+    {
+    	st->value = *ap;
+	atom_ctor(&st->value);
+    }
+    st->visible = cml_node_is_visible(mn);
+    st->frozen = cml_node_is_frozen(mn);
+    st->broken = node_is_broken(rb, mn);
+}
+
+static gboolean
+atoms_equal(const cml_atom *a, const cml_atom *b)
+{
+    if (a->type != b->type)
+    	return FALSE;
+    switch (a->type)
+    {
+    case A_NONE:
+    	return TRUE;
+    case A_HEXADECIMAL:
+    case A_DECIMAL:
+    	return (a->value.integer == b->value.integer);
+    case A_STRING:
+    	return !strcmp((a->value.string == 0 ? "" : a->value.string),
+	    	       (b->value.string == 0 ? "" : b->value.string));
+    case A_NODE:
+    	return (a->value.node == b->value.node);
+    case A_BOOLEAN:
+    case A_TRISTATE:
+    	return (a->value.tritval == b->value.tritval);
+    }
+    return FALSE;
+}
+
+/*============================================================*/
+
+static void
+add_node(gpointer key, gpointer value, gpointer user_data)
+{
+    cml_notifier *nt = (cml_notifier *)user_data;
+    cml_node *mn = (cml_node *)value;
+    notify_state *st;
+
+    if (mn->treetype == MN_UNKNOWN || mn->treetype == MN_EXPLANATION)
+    	return;
+
+    st = g_new(notify_state, 1);
+    get_state(nt->rulebase, mn, st);
+    g_hash_table_insert(nt->states, mn, st);
+}
+
+cml_notifier *
+notify_new(cml_rulebase *rb, cml_change_func func, void *user_data)
+{
+    cml_notifier *nt = g_new0(cml_notifier, 1);
+
+    nt->rulebase = rb;
+    nt->func = func;
+    nt->user_data = user_data;
+    nt->states = g_hash_table_new(g_direct_hash, g_direct_equal);
+    nt->dirty = g_hash_table_new(g_direct_hash, g_direct_equal);
+    nt->rules = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    g_hash_table_foreach(rb->menu_nodes, add_node, nt);
+
+    return nt;
+}
+
+static gboolean
+delete_one_state(gpointer key, gpointer value, gpointer user_data)
+{
+    notify_state *st = (notify_state *)value;
+
+    atom_dtor(&st->value);
+    g_free(st);
+    return TRUE;    /* please remove me */
+}
+
+void
+notify_delete(cml_notifier *nt)
+{
+    g_hash_table_foreach_remove(nt->states, delete_one_state, 0);
+    g_hash_table_destroy(nt->states);
+    g_hash_table_destroy(nt->dirty);
+    g_hash_table_destroy(nt->rules);
+    g_free(nt);
+}
+
+/*============================================================*/
+
+static void
+notify_node(cml_notifier *nt, cml_node *mn)
+{
+    g_hash_table_insert(nt->dirty, mn, mn);
+}
+
+void
+notify_rule(cml_notifier *nt, cml_rule *rule)
+{
+    g_hash_table_insert(nt->rules, rule, rule);
+}
+
+static void
+add_expr_dirty(cml_notifier *nt, const cml_expr *expr)
+{
+    int i;
+
+    if (expr == 0)
+    	return;
+    if (expr->type == E_SYMBOL && expr->symbol != 0)
+    	notify_node(nt, expr->symbol);
+    for (i = 0 ; i < EXPR_MAX_CHILDREN ; i++)
+    	add_expr_dirty(nt, expr->children[i]);
+}
+
+static gboolean
+rule_to_dirty(gpointer key, gpointer value, gpointer user_data)
+{
+    add_expr_dirty((cml_notifier *)user_data, ((cml_rule *)key)->expr);
+    return TRUE;    /* please remove me */
+}
+
+/*
+ * Call the front end back for each node whose state differs
+ * from the last reported state.
+ */
+void
+notify_flush(cml_notifier *nt)
+{
+    GList *queue, *list;
+    GHashTable *dirty;
+    notify_state *st, newst;
+    unsigned int changed;
+
+    if (nt->flushing)
+    	return;
+    nt->flushing = TRUE;
+
+    g_hash_table_foreach_remove(nt->rules, rule_to_dirty, nt);
+    queue = rb_expand_users(nt->rulebase, nt->dirty);
+    DDPRINTF1(DEBUG_TXN, "notify: %d nodes to recheck\n", g_list_length(queue));
+
+    /* anything the front end changes in its callbacks waits for next time */
+    dirty = nt->dirty;
+    nt->dirty = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    for (list = queue ; list != 0 ; list = list->next)
+    {
+    	cml_node *mn = (cml_node *)list->data;
+
+	if ((st = (notify_state *)g_hash_table_lookup(nt->states, mn)) == 0)
+	    continue;
+	get_state(nt->rulebase, mn, &newst);
+
+	changed = 0;
+	if (!atoms_equal(&st->value, &newst.value))
+	    changed |= CML_CHANGED_VALUE;
+	if (st->visible != newst.visible)
+	    changed |= CML_CHANGED_VISIBLE;
+	if (st->frozen != newst.frozen)
+	    changed |= CML_CHANGED_FROZEN;
+	if (st->broken != newst.broken)
+	    changed |= CML_CHANGED_BROKEN;
+
+	atom_dtor(&st->value);
+	*st = newst;
+	if (changed)
+	    (*nt->func)(nt->rulebase, mn, changed, nt->user_data);
+    }
+
+    g_list_free(queue);
+    g_hash_table_destroy(dirty);
+    nt->flushing = FALSE;
+}
+
+/*============================================================*/
+/*
+ * Called by the transaction code for each node whose bindings
+ * have changed, on behalf of whichever of the notifier and the
+ * visible children cache are in use.
+ */
+void
+rb_node_changed(cml_rulebase *rb, cml_node *mn)
+{
+    if (rb->notifier != 0)
+    	notify_node(rb->notifier, mn);
+    if (rb->visible_dirty != 0)
+    	g_hash_table_insert(rb->visible_dirty, mn, mn);
+}
+
+static void
+changed_one_binding(gpointer key, gpointer value, gpointer user_data)
+{
+    rb_node_changed((cml_rulebase *)user_data, (cml_node *)key);
+}
+
+void
+rb_transaction_changed(cml_rulebase *rb, cml_transaction *tx)
+{
+    g_hash_table_foreach(tx->bindings, changed_one_binding, rb);
+}
+
+/*============================================================*/
+
+void
+cml_rulebase_set_change_func(
+    cml_rulebase *rb,
+    cml_change_func func,
+    void *user_data)
+{
+    if (!RB_FINISH_PARSE(rb))
+    	return;
+    if (rb->notifier != 0)
+    {
+    	notify_delete(rb->notifier);
+	rb->notifier = 0;
+    }
+    if (func != 0)
+    	rb->notifier = notify_new(rb, func, user_data);
+}
+
+/*============================================================*/
+/*END*/
@@ -29,6 +29,55 @@ CVSID("$Id: postparse.c,v 1.4 2002/09/01 08:22:01 gnb Exp $");
 
 /*============================================================*/
 
+static unsigned long
+discard_locations(GList **listp)
+{
+    unsigned long nbytes = 0;
+    GList *list;
+
+    while ((list = *listp) != 0)
+    {
+    	g_free(list->data);
+	*listp = g_list_remove_link(list, list);
+	g_list_free(list);
+	nbytes += sizeof(cml_location) + sizeof(GList);
+    }
+    return nbytes;
+}
+
+static void
+compact_node(gpointer key, gpointer value, gpointer user_data)
+{
+    cml_node *mn = (cml_node *)value;
+    cml_rulebase *rb = (cml_rulebase *)user_data;
+
+    rb->compact_bytes += discard_locations(&mn->cold->forward_refs);
+    rb->compact_bytes += discard_locations(&mn->cold->forward_deps);
+    /*
+     * In a CML1 rulebase the user_data still holds the branches of
+     * any node which pass 2 didn't reach.  Otherwise it belongs to
+     * the front end, which can't have set it yet.
+     */
+    if (rb->cml1_default_vals)
+	rb->compact_bytes += cml1_discard_branches(mn);
+    mn->flags &= ~MN_SUBTREE_SEEN;
+}
+
+/*
+ * Discard the things which are only needed while parsing
+ * and checking, so that they don't stay resident for the
+ * rest of a long configuration session.
+ */
+static void
+rb_compact(cml_rulebase *rb)
+{
+    rb->compact_bytes = 0;
+    g_hash_table_foreach(rb->menu_nodes, compact_node, rb);
+    DDPRINTF1(DEBUG_NODES, "compact released %lu bytes\n", rb->compact_bytes);
+}
+
+/*============================================================*/
+
 static void
 check_menu_node(gpointer key, gpointer value, gpointer user_data)
 {
@@ -37,22 +86,22 @@ check_menu_node(gpointer key, gpointer value, gpointer user_data)
     
     if (mn->treetype == MN_UNKNOWN)
     {
-    	if (mn->forward_refs != 0)
+    	if (mn->cold->forward_refs != 0)
 	{
-    	    while (mn->forward_refs != 0)
+    	    while (mn->cold->forward_refs != 0)
 	    {
-		cml_location *loc = (cml_location *)mn->forward_refs->data;
+		cml_location *loc = (cml_location *)mn->cold->forward_refs->data;
 
 		cml_errorl(loc,
 		    "symbol `%s' used but not declared or derived.",
 		    mn->name);
 		g_free(loc);
-		mn->forward_refs = g_list_remove_link(mn->forward_refs, mn->forward_refs);
+		mn->cold->forward_refs = g_list_remove_link(mn->cold->forward_refs, mn->cold->forward_refs);
 	    }
 	}
 	else
 	{
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		    "symbol `%s' used but not declared or derived.",
 		    mn->name);
 	}
@@ -61,15 +110,15 @@ check_menu_node(gpointer key, gpointer value, gpointer user_data)
     if (mn->treetype == MN_MENU)
     {
     	if (mn->expr_count > 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"menu `%s' used in expressions.",
 		mn->name);
 	if (mn != rb->start && mn != rb->banner && mn->parent == 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"menu `%s' not used in a menu.",
 		mn->name);
 	if (mn->saveability_expr != 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"menu `%s' may not have saveability expression.",
 		mn->name);
     }
@@ -77,14 +126,14 @@ check_menu_node(gpointer key, gpointer value, gpointer user_data)
     if (mn->treetype == MN_SYMBOL)
     {
 	if (mn->parent == 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"symbol `%s' not used in a menu.",
 		mn->name);
 		
 	if (mn->visibility_expr != 0 &&
     	    expr_get_value_type(mn->visibility_expr) != A_BOOLEAN)
 	{
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		     "visibility expression for symbol `%s' must be boolean.",
 		     mn->name);
 	}
@@ -94,15 +143,15 @@ check_menu_node(gpointer key, gpointer value, gpointer user_data)
     if (mn->treetype == MN_EXPLANATION)
     {
     	if (mn->expr_count > 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"explanation `%s' used in expressions.",
 		mn->name);
 	if (mn->parent != 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"explanation `%s' used in a menu.",
 		mn->name);
 	if (mn->saveability_expr != 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"explanation `%s' may not have saveability expression.",
 		mn->name);
     }
@@ -111,11 +160,11 @@ check_menu_node(gpointer key, gpointer value, gpointer user_data)
     {    
     	/* these only detect parser internal errors and so represent paranoia */
     	if (mn->expr == 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"no derivation expression for derived symbol %s\n",
 		mn->name);
 	if (mn->visibility_expr != 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"derived symbol %s may not have visibility expression",
 		mn->name);
 		
@@ -133,14 +182,14 @@ check_menu_node(gpointer key, gpointer value, gpointer user_data)
 	    }
 	    else
 	    {
-		cml_errorl(&mn->location,
+		cml_errorl(&mn->cold->location,
 		    "sorry, derived symbol %s is derived from forward-declared derived symbol.\n",
 		    mn->name);
 	    }
 	}
 	
 	if (mn->parent != 0)
-	    cml_errorl(&mn->location,
+	    cml_errorl(&mn->cold->location,
 		"derived symbol `%s' is used in a menu.",
 		mn->name);
     }
@@ -154,7 +203,7 @@ check_menu_node(gpointer key, gpointer value, gpointer user_data)
         mn->saveability_expr != 0 &&
         mn->expr_count == 0)
     {
-	cml_errorl(&mn->location,
+	cml_errorl(&mn->cold->location,
 		"%s `%s' potentially unsaveable and not used in any expression or used as subtree guard",
 		mn_get_treetype_as_string(mn),
 		mn->name);
@@ -212,14 +261,6 @@ conv_dep_to_rule_2(cml_node *mn, GList *deelist)
     }
 }
 
-static void
-conv_dep_to_rule(gpointer key, gpointer value, gpointer user_data)
-{
-    cml_node *mn = (cml_node *)value;
-    
-    conv_dep_to_rule_2(mn, mn->dependees);
-}
-
 /* TODO: record the fact that errors have happened!!! */
 
 static void
@@ -282,16 +323,17 @@ check_rule(const cml_rule *rule)
 #define rb_condition_is_tied(rb, feature) \
     ((rb)->features[(feature)].tie != 0)
 
-extern void cml1_pass2(cml_rulebase *rb);
-
-gboolean
-cml_rulebase_post_parse(cml_rulebase *rb)
+/*
+ * The first half of post-parse: the checks which make the menu
+ * tree safe to display.  Nothing here depends on the rules.
+ */
+static gboolean
+post_parse_menus(cml_rulebase *rb)
 {
-    GList *list;
     cml_atom_type atype;
     int old_nerrs = cml_message_count[CML_ERROR];
 
-    if (rb->merge_mode)
+    if (rb->merge_mode && rb->cml1_default_vals)
     	cml1_pass2(rb);     /* HACK HACK HACK */
 
     
@@ -322,26 +364,233 @@ cml_rulebase_post_parse(cml_rulebase *rb)
 
     
     /* check menu nodes */
+    PHASE_BEGIN(rb, CML_PHASE_CHECK_NODES)
     g_hash_table_foreach(rb->menu_nodes, check_menu_node, rb);
+    PHASE_END(rb, CML_PHASE_CHECK_NODES)
+
+    /*
+     * Compact now rather than at the end, because after this
+     * the front end may start using the nodes' user_data.
+     */
+    rb_compact(rb);
     
-    /* convert dependencies into rules */
-    g_hash_table_foreach(rb->menu_nodes, conv_dep_to_rule, rb);
-    
-    /* check rules */
-    for (list = rb->rules ; list != 0 ; list = list->next)
+    return (cml_message_count[CML_ERROR] == old_nerrs);
+}
+
+/*
+ * How far the second half of post-parse has got.  Each piece
+ * also counts as one step of progress.
+ */
+enum
+{
+    PP_DEPS_TO_RULES,
+    PP_CHECK_RULES,
+    PP_FORCING,
+    PP_FREEZE,
+    PP_DONE
+};
+
+#define PP_CHUNK    256     /* nodes or rules per cml_rulebase_finish_parse_step() */
+
+static void
+node_to_list(gpointer key, gpointer value, gpointer user_data)
+{
+    GList **listp = (GList **)user_data;
+
+    *listp = g_list_prepend(*listp, value);
+}
+
+/*
+ * Does the next piece of the second half of post-parse: turn
+ * dependencies into rules, check the rules and build the tables
+ * used to propagate them, covering at most `max' nodes or rules
+ * or everything if `max' is 0.  Until this is all done values
+ * can be read but not set.  Returns FALSE if the progress func
+ * cancelled; the checks are left pending and the next call
+ * carries on from where this one stopped.
+ */
+static gboolean
+post_parse_rules_step(cml_rulebase *rb, int max)
+{
+    cml_rule *rule;
+    int n;
+    int old_nerrs = cml_message_count[CML_ERROR];
+    gboolean ok;
+
+    if (!rb_progress(rb, CML_PROGRESS_CHECK, 0, rb->post_parse_step, PP_DONE))
     {
-    	cml_rule *rule = (cml_rule *)list->data;
-	
-	check_rule(rule);
+    	/* being cancelled isn't an error in the rules */
+    	rb->post_parse_nerrs += cml_message_count[CML_ERROR] - old_nerrs;
+    	return FALSE;
+    }
 
-	/*
-	 * This has to be done in pass 2 to allow rules
-	 * to use forward-declared derived symbols.
-	 */
-	_expr_add_using_rule_recursive(rule->expr, rule);
+    /*
+     * Drop anything the front end caused to be cached from the
+     * unfinished graph since the last piece, before adding rules
+     * invalidates it once per rule.  It is rebuilt when next asked
+     * for, so the nodes mustn't keep their cached visibility either.
+     */
+    rb_free_users(rb);
+    visible_clear(rb);
+    visible_delete(rb);
+
+    switch (rb->post_parse_step)
+    {
+    case PP_DEPS_TO_RULES:
+	PHASE_BEGIN(rb, CML_PHASE_DEPS_TO_RULES)
+    	if (rb->post_parse_nodes == 0)
+	{
+	    /* in hash table order, as the rules have always been made */
+	    rb->post_parse_nerrs = cml_message_count[CML_ERROR];
+	    g_hash_table_foreach(rb->menu_nodes, node_to_list, &rb->post_parse_nodes);
+	    rb->post_parse_nodes = g_list_reverse(rb->post_parse_nodes);
+	    rb->post_parse_next = rb->post_parse_nodes;
+	}
+	for (n = 0 ; rb->post_parse_next != 0 && (max == 0 || n < max) ; n++)
+	{
+	    cml_node *mn = (cml_node *)rb->post_parse_next->data;
+
+	    conv_dep_to_rule_2(mn, mn->dependees);
+	    rb->post_parse_next = rb->post_parse_next->next;
+	}
+	PHASE_END(rb, CML_PHASE_DEPS_TO_RULES)
+	if (rb->post_parse_next == 0)
+	{
+	    g_list_free(rb->post_parse_nodes);
+	    rb->post_parse_nodes = 0;
+	    rb->post_parse_next = rb->rules;
+	    rb->post_parse_step = PP_CHECK_RULES;
+	}
+	break;
+
+    case PP_CHECK_RULES:
+	PHASE_BEGIN(rb, CML_PHASE_CHECK_RULES)
+	for (n = 0 ; rb->post_parse_next != 0 && (max == 0 || n < max) ; n++)
+	{
+	    rule = (cml_rule *)rb->post_parse_next->data;
+	    check_rule(rule);
+
+	    /*
+	     * This has to be done in pass 2 to allow rules
+	     * to use forward-declared derived symbols.
+	     */
+	    _expr_add_using_rule_recursive(rule->expr, rule);
+	    rb->post_parse_next = rb->post_parse_next->next;
+	}
+	PHASE_END(rb, CML_PHASE_CHECK_RULES)
+	if (rb->post_parse_next == 0)
+	{
+	    if (cml_message_count[CML_ERROR] != rb->post_parse_nerrs)
+		rb->post_parse_ok = FALSE;
+	    rb->post_parse_next = rb->rules;
+	    rb->post_parse_step = PP_FORCING;
+	}
+	break;
+
+    case PP_FORCING:
+    	/* precompute forcing tables, but only for a rulebase which makes sense */
+	if (!rb->post_parse_ok)
+	    rb->post_parse_next = 0;
+	for (n = 0 ; rb->post_parse_next != 0 && (max == 0 || n < max) ; n++)
+	{
+    	    rule_build_forcing((cml_rule *)rb->post_parse_next->data);
+	    rb->post_parse_next = rb->post_parse_next->next;
+	}
+	if (rb->post_parse_next == 0)
+	    rb->post_parse_step = PP_FREEZE;
+	break;
+
+    case PP_FREEZE:
+    	/* the node graph is complete, so pack it */
+	ok = rb->post_parse_ok;
+	if (ok)
+    	    rb_freeze_graph(rb);
+	if (rb->progressive && cml_message_count[CML_ERROR] != rb->post_parse_nerrs)
+	{
+	    cml_errorl(0, "rule checks: %d errors\n",
+	    	    	cml_message_count[CML_ERROR] - rb->post_parse_nerrs);
+	    ok = FALSE;
+	}
+	rb->post_parse_step = PP_DONE;
+	rb->post_parse_pending = FALSE;
+	rb->post_parse_failed = !ok;
+	rb_progress(rb, CML_PROGRESS_CHECK, 0, PP_DONE, PP_DONE);
+	break;
     }
-    
-    return (cml_message_count[CML_ERROR] == old_nerrs);
+    return TRUE;
+}
+
+/*
+ * Runs the rest of the second half of post-parse in one go.
+ * Returns FALSE if the rules had errors or the progress func
+ * cancelled; after a cancel the checks are still pending, so
+ * a later call can finish them.
+ */
+static gboolean
+post_parse_rules(cml_rulebase *rb)
+{
+    rb->cancelled = FALSE;
+    while (rb->post_parse_pending)
+    {
+    	if (!post_parse_rules_step(rb, 0))
+	    return FALSE;
+    }
+    return !rb->post_parse_failed;
+}
+
+gboolean
+cml_rulebase_post_parse(cml_rulebase *rb)
+{
+    gboolean ok;
+
+    rb->cancelled = FALSE;
+    ok = post_parse_menus(rb);
+    rb->post_parse_step = PP_DEPS_TO_RULES;
+    rb->post_parse_ok = ok;
+    if (rb->progressive)
+    {
+    	/* leave the rest for cml_rulebase_finish_parse() */
+    	rb->post_parse_pending = ok;
+    	rb->post_parse_failed = !ok;
+	return ok;
+    }
+    rb->post_parse_pending = TRUE;
+    rb->post_parse_failed = FALSE;
+    return post_parse_rules(rb);
+}
+
+/*
+ * Finish a parse begun in progressive mode.  Front ends call this
+ * once they have shown the top menu; libcml calls it itself before
+ * anything which needs the rules.  Returns FALSE if the rules had
+ * errors, in which case the rulebase is unusable and every later
+ * call returns FALSE too, or if the progress func cancelled, in
+ * which case a later call carries on with the checks.
+ */
+gboolean
+cml_rulebase_finish_parse(cml_rulebase *rb)
+{
+    if (!rb->post_parse_pending)
+    	return !rb->post_parse_failed;
+    return post_parse_rules(rb);
+}
+
+/*
+ * Does the next small piece of a progressive parse's rule checks,
+ * for front ends which would rather do them a bit at a time from
+ * their main loop than block on cml_rulebase_finish_parse().  The
+ * menus can be read in between.  Returns TRUE while there is more
+ * to do; once it returns FALSE cml_rulebase_finish_parse() gives
+ * the result without doing any more work, unless the progress func
+ * cancelled.
+ */
+gboolean
+cml_rulebase_finish_parse_step(cml_rulebase *rb)
+{
+    if (!rb->post_parse_pending)
+    	return FALSE;
+    rb->cancelled = FALSE;
+    return (post_parse_rules_step(rb, PP_CHUNK) && rb->post_parse_pending);
 }
 
 /*============================================================*/
@@ -22,6 +22,8 @@
 
 #include "libcml.h"
 #include "common.h"
+#include <sys/types.h>
+#include <time.h>
 
 
 void atom_ctor(cml_atom *a);
@@ -31,6 +33,39 @@ cml_atom *atom_copy(const cml_atom *a);
 void atom_free(cml_atom *a);
 void atom_assign(cml_atom *to, const cml_atom *from);
 const char *atom_type_as_string(cml_atom_type);
+void atom_intern(cml_atom *a);
+
+/* strpool.c */
+typedef struct cml_strpool_s cml_strpool;
+cml_strpool *strpool_new(void);
+void strpool_delete(cml_strpool *);
+char *strpool_ref(cml_strpool *, const char *str);
+char *strpool_take(cml_strpool *, char *str);
+void strpool_unref(cml_strpool *, const char *str);
+unsigned int strpool_size(const cml_strpool *);
+
+/* trace.c */
+typedef struct cml_tracer_s cml_tracer;
+cml_tracer *trace_new(void);
+void trace_delete(cml_tracer *);
+void trace_push_symbol(cml_tracer *, const cml_node *mn);
+void trace_push_rule(cml_tracer *, const cml_rule *rule);
+void trace_push_set(cml_tracer *, const cml_node *mn, const cml_node *source);
+void trace_pop(cml_tracer *);
+
+/* notify.c */
+typedef struct cml_notifier_s cml_notifier;
+void notify_delete(cml_notifier *);
+void notify_rule(cml_notifier *, cml_rule *rule);
+void notify_flush(cml_notifier *);
+#define rb_tracking_changes(rb)	((rb)->notifier != 0 || (rb)->visible_dirty != 0)
+void rb_node_changed(cml_rulebase *rb, cml_node *mn);
+void rb_transaction_changed(cml_rulebase *rb, cml_transaction *tx);
+
+/* visible.c */
+gboolean visible_lookup(const cml_node *mn);
+void visible_clear(cml_rulebase *rb);
+void visible_delete(cml_rulebase *rb);
 
 typedef enum
 {
@@ -124,18 +159,70 @@ struct cml_binding_s
 
 cml_enumdef *cml_enumdef_new(cml_node *symbol, unsigned long value);
 
+/*
+ * Adjacency relations between nodes, frozen after post-parse
+ * into compressed sparse row arrays in the rulebase (graph.c).
+ */
+typedef enum
+{
+    MN_ADJ_CHILDREN,
+    MN_ADJ_DEPENDANTS,
+    MN_ADJ_DEPENDEES,
+    MN_ADJ_RULES_USING,
 
-struct cml_node_s
+    MN_ADJ_NUM
+} cml_adjacency;
+
+typedef struct
+{
+    unsigned int *offsets;  	/* [num_adj_nodes+1] indices into edges */
+    gpointer *edges;	    	/* cml_node* or cml_rule* */
+} cml_csr;
+
+/*
+ * The same as the public cml_node_iter, which wraps it: edge
+ * and end when frozen, list when not.
+ */
+typedef cml_node_iter cml_adj_iter;
+
+#define mn_adj_iter_next(it)     ((it)->edge < (it)->end ? *(it)->edge++ : _mn_adj_iter_next_list(it))
+
+
+/*
+ * A region of a rulebase file whose contents are left in the file
+ * until needed, e.g. help text.
+ */
+typedef struct
+{
+    const char *filename;   	    /* singular storage in rb->filenames */
+    unsigned long offset;
+    unsigned long length;   	    /* 0 if there is no region */
+} cml_text_ref;
+
+/*
+ * Node data is split by how often it is touched.  The cml_node
+ * proper holds what value lookup and rule evaluation use, with the
+ * hottest fields packed into the first cache line, and nodes are
+ * allocated densely from blocks (see mn_new()).  Data used only by
+ * the parsers and the user interface lives in a cml_node_cold.
+ */
+typedef struct cml_node_cold_s cml_node_cold;
+
+struct cml_node_cold_s
 {
-    char *name;
     char *banner;
-    unsigned long uniqueid;
-    cml_rulebase *rulebase;
-    int visited;
     cml_location location;
-    cml_node_treetype treetype;
-    int expr_count; 	    	    	/* number of times used in expressions */
-    
+    cml_text_ref help_ref;  	    /* where the help text is */
+    char *help_text;	    	    /* read from help_ref on demand */
+    GList *enumdefs;
+    void *user_data;
+    GList *forward_refs;    	    /* list of forward reference cml_locations */
+    GList *forward_deps;    	    /* list of forward dependence cml_locations */
+};
+
+struct cml_node_s
+{
+    /* hot */
     unsigned int flags;
 #define MN_FLAG_WARNDEPEND    	0x4 	/* warn user when nodes depend on this symbol */
 #define MN_FLAG_IS_RADIO    	0x8 	/* an MN_MENU represents a radio def */
@@ -147,13 +234,14 @@ struct cml_node_s
 #define MN_OBSOLETE     	0x400 	/* banner has (OBSOLETE) tag */
 #define MN_CONSTANT     	0x800 	/* value never changes e.g. $ARCH */
 #define MN_WEAK_POSITION     	0x1000 	/* tree location may be overriden later */
+#define MN_VISIBLE_KNOWN     	0x2000 	/* MN_VISIBLE is up to date */
+#define MN_VISIBLE     	    	0x4000 	/* cached result of cml_node_is_visible() */
     /* TODO: enum status??? */
-    GList *rules_using;    	    /* list of cml_rule */
-    cml_expr *visibility_expr;	    /* merged visibility expression */
-    cml_expr *saveability_expr;	    /* merged saveability expression */
-    cml_node *parent;
-    GList *children;	    	    /* even symbols can have children */
-    
+    cml_node_treetype treetype;
+    cml_atom_type value_type;	    /* type allowed in binding */
+    	    	    	    	    /* MN_MENUs which is_radio have value */
+    cml_atom value; 	    	    /* for MN_DERIVED */
+    GList *bindings;	    	    /* in txn order, i.e. most recent 1st */
     /*
      * Used as:
      * MN_MENU if is_radio() default choice
@@ -161,27 +249,31 @@ struct cml_node_s
      * MN_DERIVED derivation expression
      */
     cml_expr *expr;
-    cml_atom value; 	    	    /* for MN_DERIVED */
-     
-    GList *transactions_guarded;    /* txns which this node guards */
-    GList *bindings;	    	    /* in txn order, i.e. most recent 1st */
-    cml_atom_type value_type;	    /* type allowed in binding */
-    	    	    	    	    /* MN_MENUs which is_radio have value */
+    cml_expr *visibility_expr;	    /* merged visibility expression */
+    cml_rulebase *rulebase;
 
-    /* symbols */
-    cml_range *range;
-    GList *enumdefs;
+    /* warm */
+    cml_expr *saveability_expr;	    /* merged saveability expression */
+    cml_node *parent;
+    int adj_index;  	    	    /* index into frozen adjacency, or -1 */
+    int visited;
+    GList *rules_using;    	    /* list of cml_rule */
+    GList *children;	    	    /* even symbols can have children */
     GList *dependants;	    	    /* symbols which depend on me */
     GList *dependees;	    	    /* symbols I depend on */
-    
-    char *help_text;
-    
-    void *user_data;
-    GList *forward_refs;    	    /* list of forward reference cml_locations */
-    GList *forward_deps;    	    /* list of forward dependence cml_locations */
+    GList *transactions_guarded;    /* txns which this node guards */
+    cml_range *range;	    	    /* symbols */
+    char *name;
+    unsigned long uniqueid;
+    int expr_count; 	    	    	/* number of times used in expressions */
+
+    cml_node_cold *cold;
 };
 
 
+#define RULE_FORCE_MAXSYMS  6	/* max symbols in a rule's forcing table */
+typedef struct cml_rule_forcing_s cml_rule_forcing;
+
 struct cml_rule_s
 {
     unsigned long uniqueid;
@@ -189,6 +281,8 @@ struct cml_rule_s
     cml_expr *expr;
     cml_node *explanation;
     cml_rulebase *rulebase;
+    cml_rule_forcing *forcing;	    /* precomputed in post-parse, may be 0 */
+    gboolean queued;	    	    /* on the rulebase's trigger queue */
 };
 
 gboolean rule_trigger(cml_rulebase *rb, cml_rule *rule, cml_node *source);
@@ -267,6 +361,22 @@ typedef enum
     CW_NUM_WARNINGS
 } cml_warning_t;
 
+typedef struct
+{
+    const char *filename;   	/* in rb->strings */
+    cml_timing lex;
+} cml_file_timing;
+
+/*
+ * How a rules file looked when it was read, so that regions
+ * left in it (cml_text_ref) aren't read back after it changes.
+ */
+typedef struct
+{
+    off_t size;
+    time_t mtime;
+    gboolean unreadable;    /* already reported, don't try again */
+} cml_file_stamp;
 
 struct cml_rulebase_s
 {
@@ -281,12 +391,13 @@ struct cml_rulebase_s
     FILE *xref_fp;
     char *prefix;
     cml_node *banner;  	/* use the (l10n'ed) banner text for this node as global banner */
-    cml_blob *icon;
+    cml_text_ref icon_ref;  	/* base64 icon data in the file */
+    cml_blob *icon; 	    	/* decoded from icon_ref on demand */
     GList *rules;  	    	/* list of cml_rule* */
     cml_node *start;   	    	/* root of menu tree */
     cml_location start_loc; 	/* file location of "start" statement */
     GHashTable *menu_nodes;	/* hashtable of cml_node's */
-    GList *filenames;	    	/* singular storage for filenames */
+    cml_strpool *strings;   	/* names, banners & filenames */
     GList *transactions;    	/* all transactions, most recent first */
     int last_visited;	    	/* used in topological sort of menu nodes */
     int last_undo_id;	    	/* largest undo_id of transactions */
@@ -294,6 +405,35 @@ struct cml_rulebase_s
     GHashTable *broken_rules;	/* rules broken in this txn */
     GHashTable *chilled;    	/* chilled symbols key=cml_node value=cml_node */
     int num_failed_sets;    	/* number of failed cml_node_set_value() calls */
+    GList *trigger_queue;   	/* rules waiting to be triggered, FIFO */
+    GList *trigger_queue_tail;
+    gboolean propagating;   	/* trigger_queue is being drained */
+    cml_csr adjacency[MN_ADJ_NUM];	/* frozen node relations */
+    cml_node **adj_nodes;   	/* nodes by adj_index, 0 unless frozen */
+    int num_adj_nodes;
+    unsigned long compact_bytes;    /* released by compacting after post-parse */
+    cml_timing *timings;    	/* [CML_PHASE_NUM], 0 unless enabled */
+    GList *filenames;	    	/* rules files read, in rb->strings, in order */
+    GHashTable *file_stamps;	/* key=filename value=cml_file_stamp */
+    GList *file_timings;    	/* list of cml_file_timing, in order read */
+    cml_file_timing *last_file_timing;
+    GHashTable *profile;    	/* key=cml_rule or cml_node, value=cml_profile_entry */
+    cml_tracer *tracer;     	/* 0 unless tracing evaluation */
+    cml_notifier *notifier; 	/* 0 unless front end wants changes */
+    GHashTable *users;	    	/* key=cml_node value=GList of cml_node using it */
+    GHashTable *visible_children;	/* key=menu value=GList of visible children */
+    GHashTable *visible_dirty;	/* changed since cache updated, key=value=cml_node */
+    cml_progress_func progress_func;	/* 0 unless front end wants progress */
+    void *progress_data;
+    gboolean cancelled;     	/* progress_func cancelled current operation */
+    gboolean progressive;   	/* parse leaves the rule checks pending */
+    gboolean post_parse_pending;	/* cml_rulebase_finish_parse() not yet done */
+    gboolean post_parse_failed;	/* ...or it was and the rules are unusable */
+    int post_parse_step;    	/* how far the rule checks have got */
+    gboolean post_parse_ok; 	/* no errors in them so far */
+    int post_parse_nerrs;   	/* error count before they started */
+    GList *post_parse_nodes;	/* nodes whose dependencies are converted */
+    GList *post_parse_next; 	/* next of those nodes, or of the rules */
 #if TESTSCRIPT
     GList *test_script;     	/* list of cml_test_script */
     gboolean parsetest;     	/* run test script after parse, even if failed */
@@ -307,21 +447,45 @@ struct cml_rulebase_s
 #define _rb_enable_warning(rb, w)    	(rb)->warnings |= (1UL<<(w))
 #define _rb_disable_warning(rb, w)    	(rb)->warnings &= ~(1UL<<(w))
 
+/* time the code in between as `phase', if timings are enabled */
+#define PHASE_BEGIN(rb, phase) \
+    { double _phase_start = ((rb)->timings != 0 ? cml_timer_now() : 0.0);
+#define PHASE_END(rb, phase) \
+    if ((rb)->timings != 0) \
+    	rb_add_timing((rb), (phase), cml_timer_now() - _phase_start); }
+
 /* range.c */
 cml_range *range_new(unsigned long begin, unsigned long end);
 void range_delete(cml_range *range);
 cml_range *range_add(cml_range *, unsigned long begin, unsigned long end);
 unsigned long range_count(const cml_range *range);
+unsigned long range_count_within(const cml_range *range,
+    	    	    unsigned long lo, unsigned long hi, unsigned long *firstp);
 gboolean range_check(const cml_range *range, unsigned long x);
 void range_dump(const cml_range *range, FILE *);
 
+/* util.c */
+#if MEMSTATS
+cml_mem_tag mem_set_tag(cml_mem_tag);
+void mem_get_stats(cml_mem_stats *);
+/* charge allocations in between to `tag' */
+#define MEM_TAG_BEGIN(tag) \
+    { cml_mem_tag _saved_mem_tag = mem_set_tag(tag);
+#define MEM_TAG_END \
+    mem_set_tag(_saved_mem_tag); }
+#else
+#define MEM_TAG_BEGIN(tag)  {
+#define MEM_TAG_END 	    }
+#endif
+
 /* blob.c */
 cml_blob *blob_new(unsigned char *data, unsigned long length);
 cml_blob *blob_new_copy(unsigned char *data, unsigned long length);
 void blob_delete(cml_blob *);
+char *textref_read(cml_rulebase *rb, const cml_text_ref *ref);
 
 /* node.c */
-cml_node *mn_new(const char *name);
+cml_node *mn_new(cml_rulebase *rb, const char *name);
 void mn_delete(cml_node *mn);
 void mn_set_children(cml_node *parent, GList *children);
 void mn_add_child(cml_node *node, cml_node *child);
@@ -336,11 +500,29 @@ void mn_add_visibility_expr2(cml_node *mn, cml_expr *expr,  cml_expr_type join);
 void mn_add_saveability_expr(cml_node *mn, cml_expr *expr);
 void mn_chill(cml_node *mn);
 gboolean mn_is_chilled(const cml_node *mn);
+gboolean mn_evaluate_visibility(const cml_node *mn);
 gboolean mn_is_saveable(const cml_node *mn);
 
+/* graph.c */
+void rb_freeze_graph(cml_rulebase *rb);
+void rb_thaw_graph(cml_rulebase *rb);
+void rb_free_graph(cml_rulebase *rb);
+void rb_free_users(cml_rulebase *rb);
+GList *rb_expand_users(cml_rulebase *rb, GHashTable *dirty);
+#define rb_graph_is_frozen(rb)	((rb)->adj_nodes != 0)
+unsigned int mn_adj_count(const cml_node *mn, cml_adjacency rel);
+gpointer mn_adj_nth(const cml_node *mn, cml_adjacency rel, unsigned int n);
+void mn_adj_iter_init(cml_adj_iter *, const cml_node *mn, cml_adjacency rel);
+gpointer _mn_adj_iter_next_list(cml_adj_iter *);
+
 /* expr.c */
 void _expr_add_using_rule_recursive(cml_expr *expr, cml_rule *rule);
 void expr_evaluate(const cml_expr *expr, cml_atom *val);
+/* into mn->value */
+void expr_evaluate_derived(cml_node *mn);
+void expr_evaluate_assigned(const cml_expr *expr, int nsyms,
+    	    cml_node *const *syms, const cml_atom *vals, cml_atom *val);
+int expr_get_free_symbols(const cml_expr *expr, cml_node **syms, int maxsyms);
 void _expr_add_dependant(const cml_expr *expr, cml_node *dependant);
 cml_expr *expr_simplify(cml_expr *expr);
 char *expr_as_string(const cml_expr *expr);
@@ -349,6 +531,8 @@ char *expr_as_string(const cml_expr *expr);
 cml_rule *rule_new_require(cml_expr *);
 cml_rule *rule_new_prohibit(cml_expr *);
 void rule_delete(cml_rule *);
+void rule_build_forcing(cml_rule *rule);
+void rule_forcing_delete(cml_rule_forcing *rf);
 #if DEBUG
 void rule_dump(const cml_rule *rule, FILE *fp);
 #endif
@@ -359,10 +543,36 @@ void rb_dump_nodes(const cml_rulebase *rb, FILE *fp);
 void rb_dump_rules(const cml_rulebase *rb, FILE *fp);
 #endif
 gboolean rb_trigger_rules(cml_rulebase *rb, GList *rules, cml_node *source);
+void rb_queue_rules(cml_rulebase *rb, GList *rules);
+void rb_queue_rules_using(cml_rulebase *rb, const cml_node *mn);
+gboolean rb_propagate(cml_rulebase *rb, cml_node *source);
 void rb_add_rule(cml_rulebase *rb, cml_rule *rule);
 cml_node *rb_add_node(cml_rulebase *, const char *name);
+void rb_add_filename(cml_rulebase *rb, const char *filename, FILE *fp);
+gboolean rb_progress(cml_rulebase *rb, cml_progress_phase phase,
+    	    	     const char *filename, unsigned long done,
+		     unsigned long total);
+/*
+ * Anything which needs the rules must finish a progressive parse
+ * first, and fail if that did.  Evaluates to FALSE on failure.
+ */
+#define RB_FINISH_PARSE(rb) \
+    ((rb)->post_parse_pending ? \
+    	cml_rulebase_finish_parse(rb) : !(rb)->post_parse_failed)
 void rb_remove_node(cml_rulebase *rb, cml_node *mn);
 void rb_unchill_all(cml_rulebase *rb);
+/* always-on counters, see cml_rulebase_get_stats() */
+extern unsigned long cml_stat_counts[CML_STAT_NUM];
+#define STAT_INC(id)	    	(cml_stat_counts[(id)]++)
+void rb_add_timing(cml_rulebase *rb, cml_phase phase, double seconds);
+void rb_add_file_lex_timing(cml_rulebase *rb, const char *filename, double seconds);
+void rb_profile_rule(cml_rulebase *rb, const cml_rule *rule, double seconds,
+    	    	     gboolean broken, gboolean punted);
+void rb_profile_symbol(cml_rulebase *rb, const cml_node *mn, double seconds);
+void rb_profile_tabled(cml_rulebase *rb, const cml_node *mn);
+/* strings which live as long as the rulebase */
+#define rb_intern(rb, s)    	strpool_ref((rb)->strings, (s))
+#define rb_intern_take(rb, s)	strpool_take((rb)->strings, (s))
 #if TESTSCRIPT
 void rb_add_test(cml_rulebase *rb, cml_location loc,
     	    	cml_test_script_op op, cml_node *symbol, cml_expr *expr);
@@ -373,6 +583,10 @@ void rb_add_xref(cml_rulebase *rb, const cml_node *mn, const char *usage,
 /* cml1_parser.y */
 gboolean _cml_rulebase_parse_cml1(cml_rulebase *, const char *filename);
 
+/* cml1pass2.c */
+void cml1_pass2(cml_rulebase *rb);
+unsigned long cml1_discard_branches(cml_node *mn);
+
 /* cml2_parser.y */
 gboolean _cml_rulebase_parse_cml2(cml_rulebase *, const char *filename);
 
@@ -0,0 +1,113 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Parses a rules file with the profile enabled, sets each
+ * SYMBOL=value given in its own transaction, and prints which
+ * rules and derived symbols the profile says were evaluated, or
+ * answered for by a rule's forcing table.  No counts or times
+ * are shown, so the output doesn't depend on timing.
+ */
+
+#include "private.h"
+
+CVSID("$Id$");
+
+static int
+compare_names(gconstpointer v1, gconstpointer v2)
+{
+    return strcmp((const char *)v1, (const char *)v2);
+}
+
+int
+main(int argc, char **argv)
+{
+    cml_rulebase *rb;
+    cml_node *mn;
+    cml_atom a;
+    GList *profile, *names = 0, *list;
+    char *eq;
+    int i;
+
+    if (argc < 2)
+    {
+    	fprintf(stderr, "Usage: %s rulesfile [SYMBOL=value...]\n", argv[0]);
+	return 1;
+    }
+
+    rb = cml_rulebase_new();
+    cml_rulebase_enable_profile(rb);
+    if (!cml_rulebase_parse(rb, argv[1]) || !cml_rulebase_post_parse(rb))
+    	return 1;
+
+    for (i = 2 ; i < argc ; i++)
+    {
+    	if ((eq = strchr(argv[i], '=')) == 0)
+	{
+	    fprintf(stderr, "%s: expecting SYMBOL=value\n", argv[i]);
+	    return 1;
+	}
+	*eq++ = '\0';
+	if ((mn = cml_rulebase_find_node(rb, argv[i])) == 0)
+	{
+	    fprintf(stderr, "%s: no such symbol\n", argv[i]);
+	    return 1;
+	}
+	cml_atom_init(&a);
+	a.type = cml_node_get_value_type(mn);
+	if (!cml_atom_from_string(&a, eq))
+	{
+	    fprintf(stderr, "%s: can't set to \"%s\"\n", argv[i], eq);
+	    return 1;
+	}
+	cml_node_set_value(mn, &a);
+	if (!cml_rulebase_commit(rb, FALSE))
+	    printf("set %s=%s failed\n", argv[i], eq);
+    }
+
+    profile = cml_rulebase_get_profile(rb);
+    for (list = profile ; list != 0 ; list = list->next)
+    {
+    	const cml_profile_entry *pe = (const cml_profile_entry *)list->data;
+
+	if (pe->symbol != 0)
+	    names = g_list_prepend(names, g_strdup_printf("symbol %s%s%s",
+	    	    	pe->symbol,
+			(pe->evaluations ? " evaluated" : ""),
+			(pe->tabled ? " tabled" : "")));
+	else
+	    names = g_list_prepend(names, g_strdup_printf("rule %lu%s",
+	    	    	pe->uniqueid,
+			(pe->evaluations ? " evaluated" : "")));
+    }
+    g_list_free(profile);
+
+    names = g_list_sort(names, compare_names);
+    for (list = names ; list != 0 ; list = list->next)
+    {
+    	printf("%s\n", (char *)list->data);
+	g_free(list->data);
+    }
+    g_list_free(names);
+
+    cml_rulebase_delete(rb);
+    return 0;
+}
+
+/*END*/
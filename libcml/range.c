@@ -18,6 +18,7 @@
  */
  
 #include "private.h"
+#include <limits.h>
 
 CVSID("$Id: range.c,v 1.3 2001/04/05 21:18:11 gnb Exp $");
 
@@ -29,8 +30,11 @@ CVSID("$Id: range.c,v 1.3 2001/04/05 21:18:11 gnb Exp $");
 static cml_subrange *
 subrange_new(unsigned long begin, unsigned long end)
 {
-    cml_subrange *sr = g_new(cml_subrange, 1);
+    cml_subrange *sr;
 
+    MEM_TAG_BEGIN(CML_MEM_RANGES)
+    sr = g_new(cml_subrange, 1);
+    MEM_TAG_END
     if (sr == 0)
     	return 0;
     sr->begin = begin;
@@ -46,7 +50,13 @@ cml_range *
 range_new(unsigned long begin, unsigned long end)
 {
     cml_subrange *sr = subrange_new(begin, end);
-    return (sr == 0 ? 0 : g_list_append(0, sr));
+    cml_range *range = 0;
+
+    MEM_TAG_BEGIN(CML_MEM_RANGES)
+    if (sr != 0)
+    	range = g_list_append(0, sr);
+    MEM_TAG_END
+    return range;
 }
 
 void
@@ -205,6 +215,41 @@ range_count(const cml_range *range)
 
 /*============================================================*/
 
+/*
+ * Count the values in the range which lie in the interval
+ * [lo, hi], and return the smallest one in *firstp.  The
+ * count sticks at ULONG_MAX rather than wrapping.
+ */
+unsigned long
+range_count_within(
+    const cml_range *range,
+    unsigned long lo,
+    unsigned long hi,
+    unsigned long *firstp)
+{
+    unsigned long count = 0;
+    unsigned long b, e;
+    const GList *list;
+    
+    for (list=range ; list!=0 ; list=list->next)
+    {
+    	cml_subrange *sr = (cml_subrange *)list->data;
+	b = (sr->begin > lo ? sr->begin : lo);
+	e = (sr->end < hi ? sr->end : hi);
+	if (b > e)
+	    continue;
+	if (count == 0 || b < *firstp)
+	    *firstp = b;
+	if (e - b >= ULONG_MAX - count)
+	    count = ULONG_MAX;	/* saturate, e.g. the whole domain */
+	else
+	    count += e - b + 1;
+    }
+    return count;
+}
+
+/*============================================================*/
+
 gboolean
 range_check(const cml_range *range, unsigned long x)
 {
@@ -247,14 +292,39 @@ range_dump(const cml_range *range, FILE *fp)
 
 #define MAX_NARGS 3
 
+/*
+ * Numbers may also be given as `max' for ULONG_MAX, and are
+ * shown relative to it when near, so the output is the same
+ * whatever the size of unsigned long.
+ */
+static unsigned long
+parse_ulong(const char *str)
+{
+    if (!strcmp(str, "max"))
+    	return ULONG_MAX;
+    return strtoul(str, 0, 0);
+}
+
+static const char *
+format_ulong(unsigned long x, char *buf)
+{
+    if (x == ULONG_MAX)
+    	return "max";
+    if (x > ULONG_MAX - 1000)
+    	sprintf(buf, "max-%lu", ULONG_MAX - x);
+    else
+	sprintf(buf, "%lu", x);
+    return buf;
+}
+
 int
 main(int argc, char **argv)
 {
     cml_range *range = 0;
-    unsigned long x, y;
+    unsigned long x, y, count, first;
     int nargs;
     char *args[MAX_NARGS];
-    char buf[1024];
+    char buf[1024], xbuf[32], ybuf[32];
     
     while ((fgets(buf, sizeof(buf), stdin)) != 0)
     {
@@ -295,9 +365,9 @@ main(int argc, char **argv)
 	    	fprintf(stderr, "syntax: add <begin> <end>\n");
 	    	continue;
 	    }
-	    x = atoi(args[1]);
-	    y = atoi(args[2]);
-	    printf("added: {%ld,%ld} + ", x, y);
+	    x = parse_ulong(args[1]);
+	    y = parse_ulong(args[2]);
+	    printf("added: {%s,%s} + ", format_ulong(x, xbuf), format_ulong(y, ybuf));
 	    range_dump(range, stdout);
 	    range = range_add(range, x, y);
 	    fputs(" -> ", stdout);
@@ -325,6 +395,23 @@ main(int argc, char **argv)
 	    }
 	    printf("count: %ld\n", range_count(range));
 	}
+	else if (!strcmp(args[0], "within"))
+	{
+	    if (nargs != 3)
+	    {
+	    	fprintf(stderr, "syntax: within <lo> <hi>\n");
+	    	continue;
+	    }
+	    x = parse_ulong(args[1]);
+	    y = parse_ulong(args[2]);
+	    first = 0;
+	    count = range_count_within(range, x, y, &first);
+	    printf("within %s %s: count %s", format_ulong(x, xbuf),
+	    	format_ulong(y, ybuf), format_ulong(count, buf));
+	    if (count != 0)
+	    	printf(" first %s", format_ulong(first, buf));
+	    fputs("\n", stdout);
+	}
 	else if (!strcmp(args[0], "help"))
 	{
 	    fputs("\
@@ -333,6 +420,7 @@ delete	    	    delete current range\n\
 add <begin> <end>   add to current range\n\
 check <num> 	    check if num is in current range\n\
 count	    	    show count of current range\n\
+within <lo> <hi>    count values of current range in [lo,hi]\n\
 ", stdout);
 	}
 	else
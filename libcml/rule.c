@@ -27,9 +27,12 @@ CVSID("$Id: rule.c,v 1.21 2002/09/01 08:19:34 gnb Exp $");
 static cml_rule *
 rule_new(cml_expr *expr)
 {
-    cml_rule *rule = g_new(cml_rule, 1);
+    cml_rule *rule;
     static unsigned long last_uniqueid = 0;
     
+    MEM_TAG_BEGIN(CML_MEM_RULES)
+    rule = g_new(cml_rule, 1);
+    MEM_TAG_END
     if (rule == 0)
     	return 0;
     memset(rule, 0, sizeof(*rule));
@@ -59,37 +62,311 @@ void
 rule_delete(cml_rule *rule)
 {
     expr_destroy(rule->expr);
+    rule_forcing_delete(rule->forcing);
     g_free(rule);
 }
 
 /*============================================================*/
+/*
+ * Forcing tables.
+ *
+ * A rule over a handful of boolean and tristate symbols is
+ * analysed once after parsing by evaluating it for every
+ * possible assignment of those symbols.  The results are kept
+ * in a bitmap, together with a table which for each symbol and
+ * each of its values gives the only assignment which satisfies
+ * the rule when that symbol alone is fixed.  When the rule
+ * breaks, rule_trigger() finds the bindings to force by table
+ * lookup instead of simplifying and solving the expression.
+ */
+
+#define FORCE_NONE  	(-1)	/* no satisfying assignment */
+#define FORCE_MANY  	(-2)	/* more than one satisfying assignment */
+
+struct cml_rule_forcing_s
+{
+    int nsyms;
+    int nassigns;   	    	    	/* product of all the radices */
+    cml_node *syms[RULE_FORCE_MAXSYMS];
+    int radix[RULE_FORCE_MAXSYMS];  	/* 2 for boolean, 3 for tristate */
+    int stride[RULE_FORCE_MAXSYMS];
+    short forced[RULE_FORCE_MAXSYMS][3];
+    unsigned char satisfied[1];     	/* bitmap, actually nassigns bits */
+};
+
+#define force_val(rf, idx, i) \
+    (((idx) / (rf)->stride[(i)]) % (rf)->radix[(i)])
+#define force_is_satisfied(rf, idx) \
+    ((rf)->satisfied[(idx)>>3] & (1<<((idx)&7)))
+
+void
+rule_forcing_delete(cml_rule_forcing *rf)
+{
+    if (rf != 0)
+    	g_free(rf);
+}
+
+/*
+ * Returns the index of the only satisfying assignment in which
+ * each symbol in `fixedmask' has the value in `fixedvals', or
+ * FORCE_NONE or FORCE_MANY.
+ */
+static int
+rule_forcing_search(
+    const cml_rule_forcing *rf,
+    unsigned int fixedmask,
+    const int *fixedvals)
+{
+    int idx, i, sol = FORCE_NONE;
+    
+    for (idx = 0 ; idx < rf->nassigns ; idx++)
+    {
+    	if (!force_is_satisfied(rf, idx))
+	    continue;
+	for (i = 0 ; i < rf->nsyms ; i++)
+	    if ((fixedmask & (1<<i)) && force_val(rf, idx, i) != fixedvals[i])
+	    	break;
+	if (i < rf->nsyms)
+	    continue;
+	if (sol != FORCE_NONE)
+	    return FORCE_MANY;
+	sol = idx;
+    }
+    return sol;
+}
+
+void
+rule_build_forcing(cml_rule *rule)
+{
+    cml_node *syms[RULE_FORCE_MAXSYMS];
+    cml_atom vals[RULE_FORCE_MAXSYMS];
+    int fixedvals[RULE_FORCE_MAXSYMS];
+    cml_rule_forcing *rf;
+    int nsyms, nassigns, idx, i, v;
+    cml_atom res;
+    
+    rule_forcing_delete(rule->forcing);
+    rule->forcing = 0;
+    
+    nsyms = expr_get_free_symbols(rule->expr, syms, RULE_FORCE_MAXSYMS);
+    if (nsyms <= 0)
+    	return;     /* leave it to expr_solve() */
+	
+    nassigns = 1;
+    for (i = 0 ; i < nsyms ; i++)
+    	nassigns *= (syms[i]->value_type == A_TRISTATE ? 3 : 2);
+	
+    MEM_TAG_BEGIN(CML_MEM_RULES)
+    rf = (cml_rule_forcing *)g_malloc0(sizeof(cml_rule_forcing) + nassigns/8);
+    MEM_TAG_END
+    rf->nsyms = nsyms;
+    rf->nassigns = nassigns;
+    for (i = 0 ; i < nsyms ; i++)
+    {
+    	rf->syms[i] = syms[i];
+    	rf->radix[i] = (syms[i]->value_type == A_TRISTATE ? 3 : 2);
+	rf->stride[i] = (i == 0 ? 1 : rf->stride[i-1] * rf->radix[i-1]);
+	cml_atom_init(&vals[i]);
+	vals[i].type = syms[i]->value_type;
+    }
+    
+    for (idx = 0 ; idx < nassigns ; idx++)
+    {
+    	for (i = 0 ; i < nsyms ; i++)
+	    vals[i].value.tritval = force_val(rf, idx, i);
+	cml_atom_init(&res);
+	expr_evaluate_assigned(rule->expr, nsyms, syms, vals, &res);
+	if (res.type == A_BOOLEAN && res.value.tritval == CML_Y)
+	    rf->satisfied[idx>>3] |= (1<<(idx&7));
+    }
+
+    for (i = 0 ; i < nsyms ; i++)
+    {
+	for (v = 0 ; v < 3 ; v++)
+	{
+	    if (v >= rf->radix[i])
+	    {
+	    	rf->forced[i][v] = FORCE_NONE;
+		continue;
+	    }
+	    fixedvals[i] = v;
+	    rf->forced[i][v] = rule_forcing_search(rf, (1<<i), fixedvals);
+	}
+    }
+    
+    DDPRINTF3(DEBUG_RULES, "rule %ld forcing table: %d symbols, %d assignments\n",
+    	rule->uniqueid, nsyms, nassigns);
+    rule->forcing = rf;
+}
+
+/*
+ * Evaluate the rule from the forcing table and the current
+ * values of its symbols.  Returns TRUE or FALSE, or -1 if there
+ * is no table or it doesn't cover the current values.
+ */
+static int
+rule_forcing_evaluate(const cml_rule *rule)
+{
+    const cml_rule_forcing *rf = rule->forcing;
+    const cml_atom *cur;
+    int i, idx = 0;
+    
+    if (rf == 0)
+    	return -1;
+    for (i = 0 ; i < rf->nsyms ; i++)
+    {
+	cur = cml_node_get_value(rf->syms[i]);
+	if (cur == 0 ||
+	    (cur->type != A_BOOLEAN && cur->type != A_TRISTATE) ||
+	    cur->value.tritval >= rf->radix[i])
+	    return -1;
+	idx += cur->value.tritval * rf->stride[i];
+    }
+    return (force_is_satisfied(rf, idx) ? TRUE : FALSE);
+}
+
+/*
+ * Use the forcing table to find and apply the bindings which
+ * will satisfy a broken rule, given the symbols already fixed
+ * in the current transaction.  Returns 1 if the rule was
+ * repaired, 0 if it cannot be, or -1 if the table doesn't
+ * cover the current values and the caller should fall back
+ * to solving the expression.
+ */
+static int
+rule_apply_forcing(cml_rule *rule, cml_node *source)
+{
+    const cml_rule_forcing *rf = rule->forcing;
+    int fixedvals[RULE_FORCE_MAXSYMS];
+    unsigned int fixedmask = 0;
+    int i, sol, key = -1;
+    const cml_atom *cur;
+    cml_atom a;
+    
+    for (i = 0 ; i < rf->nsyms ; i++)
+    {
+    	cml_node *mn = rf->syms[i];
+	
+	if (!cml_node_is_frozen(mn) && !mn_is_chilled(mn))
+	    continue;
+	cur = cml_node_get_value(mn);
+	if (cur == 0 ||
+	    (cur->type != A_BOOLEAN && cur->type != A_TRISTATE) ||
+	    cur->value.tritval >= rf->radix[i])
+	    return -1;
+	fixedmask |= (1<<i);
+	fixedvals[i] = cur->value.tritval;
+	if (key < 0 || mn == source)
+	    key = i;
+    }
+    
+    if (key < 0)
+    	sol = rule_forcing_search(rf, fixedmask, fixedvals);
+    else if ((sol = rf->forced[key][fixedvals[key]]) >= 0)
+    {
+    	/* only solution with one symbol fixed, check the others agree */
+	for (i = 0 ; i < rf->nsyms ; i++)
+	    if ((fixedmask & (1<<i)) && force_val(rf, sol, i) != fixedvals[i])
+	    	return 0;
+    }
+    else if (sol == FORCE_MANY && (fixedmask & ~(1<<key)))
+    	sol = rule_forcing_search(rf, fixedmask, fixedvals);
+	
+    if (sol < 0)
+    	return 0;
+	
+    for (i = 0 ; i < rf->nsyms ; i++)
+    {
+    	if (fixedmask & (1<<i))
+	    continue;
+	cml_atom_init(&a);
+	a.type = rf->syms[i]->value_type;
+	a.value.tritval = force_val(rf, sol, i);
+	cur = cml_node_get_value(rf->syms[i]);
+	if (cur != 0 && _atom_compare(cur, &a) == 0)
+	    continue;
+    	DDPRINTF2(DEBUG_RULES, "forcing %s to %c\n",
+	    rf->syms[i]->name, "nym"[a.value.tritval]);
+	if (!mn_set_value(rf->syms[i], &a, source))
+	    return 0;
+    }
+    return 1;
+}
+
+/*============================================================*/
+
+/*
+ * A forcing table is built through any derived symbols in the
+ * rule, so when it answers they aren't evaluated.  Note them in
+ * the profile anyway, so every derived symbol a rule reads shows.
+ */
+static void
+profile_tabled_derived(cml_rulebase *rb, const cml_expr *expr)
+{
+    int i;
+
+    if (expr == 0)
+    	return;
+    if (expr->type == E_SYMBOL && expr->symbol->treetype == MN_DERIVED)
+    {
+    	rb_profile_tabled(rb, expr->symbol);
+	profile_tabled_derived(rb, expr->symbol->expr);
+    }
+    for (i = 0 ; i < EXPR_MAX_CHILDREN ; i++)
+    	profile_tabled_derived(rb, expr->children[i]);
+}
 
 gboolean
 rule_trigger(cml_rulebase *rb, cml_rule *rule, cml_node *source)
 {
     cml_atom val;
     gboolean broken;
+    gboolean punted = FALSE;
+    int forced, satisfied;
+    double start = 0.0;
 
+    STAT_INC(CML_STAT_RULE_TRIGGER);
+    if (rb->profile != 0)
+    	start = cml_timer_now();
+    if (rb->tracer != 0)
+    	trace_push_rule(rb->tracer, rule);
     DDPRINTF3(DEBUG_RULES, "triggering rule %ld (%s:%d)\n",
 	rule->uniqueid,
 	rule->location.filename,
 	rule->location.lineno);
 	
-    cml_atom_init(&val);
-    expr_evaluate(rule->expr, &val);
-#if DEBUG
-    if (debug & DEBUG_RULES)
+    if ((satisfied = rule_forcing_evaluate(rule)) >= 0)
     {
-	char *valstr = cml_atom_value_as_string(&val);
-	DDPRINTF1(DEBUG_RULES, "rule expression is %s\n",
-	    (valstr == 0 ? "(null)" : valstr));
-	g_free(valstr);
+	DDPRINTF1(DEBUG_RULES, "rule table gives %s\n",
+	    (satisfied ? "y" : "n"));
+    	broken = !satisfied;
+	if (rb->profile != 0)
+	    profile_tabled_derived(rb, rule->expr);
     }
+    else
+    {
+	cml_atom_init(&val);
+	expr_evaluate(rule->expr, &val);
+#if DEBUG
+	if (debug & DEBUG_RULES)
+	{
+	    char *valstr = cml_atom_value_as_string(&val);
+	    DDPRINTF1(DEBUG_RULES, "rule expression is %s\n",
+		(valstr == 0 ? "(null)" : valstr));
+	    g_free(valstr);
+	}
 #endif
-    assert(val.type == A_BOOLEAN);
+	assert(val.type == A_BOOLEAN);
     
-    broken = !val.value.tritval;
-    if (broken && source != 0)
+	broken = !val.value.tritval;
+    }
+    if (broken && source != 0 && rule->forcing != 0 &&
+    	(forced = rule_apply_forcing(rule, source)) >= 0)
+    {
+    	/* the precomputed table covers the current values */
+	broken = !forced;
+    }
+    else if (broken && source != 0)
     {
     	/* attempt to find a set of bindings which will please the rule */
 	cml_atom yes;
@@ -111,16 +388,41 @@ rule_trigger(cml_rulebase *rb, cml_rule *rule, cml_node *source)
 	
 	yes.type = A_BOOLEAN;
 	yes.value.tritval = CML_Y;
-	if (expr_solve(simple, &yes, source) == 1)
+	switch (expr_solve(simple, &yes, source))
+	{
+	case 1:
 	    broken = FALSE;
+	    break;
+	case 2:
+	    punted = TRUE;  /* too many solutions to choose from */
+	    break;
+	}
 	    
 	expr_destroy(simple);
     }
     
-    if (broken)
+    if (g_hash_table_lookup(rb->broken_rules, rule) != 0)
+    {
+    	if (!broken)
+	{
+	    g_hash_table_remove(rb->broken_rules, rule);
+	    STAT_INC(CML_STAT_RULES_REPAIRED);
+	    if (rb->notifier != 0)
+	    	notify_rule(rb->notifier, rule);
+	}
+    }
+    else if (broken)
+    {
 	g_hash_table_insert(rb->broken_rules, rule, rule);
-    else
-	g_hash_table_remove(rb->broken_rules, rule);
+	STAT_INC(CML_STAT_RULES_BROKEN);
+	if (rb->notifier != 0)
+	    notify_rule(rb->notifier, rule);
+    }
+    
+    if (rb->profile != 0)
+    	rb_profile_rule(rb, rule, cml_timer_now() - start, broken, punted);
+    if (rb->tracer != 0)
+    	trace_pop(rb->tracer);
 	
     return !broken;
 }
@@ -149,7 +451,7 @@ cml_rule_get_explanation(const cml_rule *rule)
     char *expr_str, *str;
     
     if (rule->explanation != 0)
-    	return g_strdup(rule->explanation->banner);
+    	return g_strdup(rule->explanation->cold->banner);
 	
     expr_str = expr_as_string(rule->expr);
     str = g_strdup_printf("Rule %ld (%s:%d) require %s",
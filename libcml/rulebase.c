@@ -19,7 +19,9 @@
  
 #include "private.h"
 #include "util.h"
+#include "base64.h"
 #include "debug.h"
+#include <sys/stat.h>
 
 CVSID("$Id: rulebase.c,v 1.38 2002/09/01 08:43:06 gnb Exp $");
 
@@ -38,6 +40,7 @@ cml_rulebase_new(void)
     memset(rb, 0, sizeof(*rb));
     
     rb->menu_nodes = g_hash_table_new(g_str_hash, g_str_equal);
+    rb->strings = strpool_new();
     rb->broken_rules = g_hash_table_new(g_direct_hash, g_direct_equal);
     rb->chilled = g_hash_table_new(g_direct_hash, g_direct_equal);
     
@@ -57,9 +60,29 @@ delete_one_node(gpointer key, gpointer value, gpointer userdata)
     return TRUE;    /* remove me please */
 }
 
+static gboolean
+delete_one_profile_entry(gpointer key, gpointer value, gpointer userdata)
+{
+    g_free(value);
+    return TRUE;    /* remove me please */
+}
+
+static gboolean
+delete_one_file_stamp(gpointer key, gpointer value, gpointer userdata)
+{
+    g_free(value);
+    return TRUE;    /* remove me please */
+}
+
 void
 cml_rulebase_delete(cml_rulebase *rb)
 {
+    if (rb->notifier != 0)
+    {
+    	notify_delete(rb->notifier);
+	rb->notifier = 0;
+    }
+    visible_delete(rb);
     _cml_tx_clear(rb);
     
     strdelete(rb->prefix);
@@ -71,29 +94,47 @@ cml_rulebase_delete(cml_rulebase *rb)
     if (rb->icon != 0)
     	blob_delete(rb->icon);
     listdelete(rb->rules, cml_rule, rule_delete);
+    g_list_free(rb->post_parse_nodes);
+    rb_free_graph(rb);
+    rb_free_users(rb);
     g_hash_table_foreach_remove(rb->menu_nodes, delete_one_node, 0);
     g_hash_table_destroy(rb->menu_nodes);
-    listdelete(rb->filenames, char *, g_free);
     assert(rb->transactions == 0);
     g_hash_table_destroy(rb->broken_rules);
     g_hash_table_destroy(rb->chilled);
 #if TESTSCRIPT
     listdelete(rb->test_script, cml_test_script, cml_test_script_delete);
 #endif
+    g_free(rb->timings);
+    g_list_free(rb->filenames);
+    if (rb->file_stamps != 0)
+    {
+	g_hash_table_foreach_remove(rb->file_stamps, delete_one_file_stamp, 0);
+	g_hash_table_destroy(rb->file_stamps);
+    }
+    listdelete(rb->file_timings, cml_file_timing, g_free);
+    if (rb->profile != 0)
+    {
+    	g_hash_table_foreach_remove(rb->profile, delete_one_profile_entry, 0);
+	g_hash_table_destroy(rb->profile);
+    }
+    if (rb->tracer != 0)
+    	trace_delete(rb->tracer);
+    strpool_delete(rb->strings);
     g_free(rb);
 }
 
 /*============================================================*/
 
-static int
+static gboolean
 str_has_suffix(const char *s, const char *p)
 {
     int plen = strlen(p);
     int slen = strlen(s);
     
     if (slen < plen)
-    	return -1;
-    return strcmp(s+slen-plen, p);
+    	return FALSE;
+    return (strcmp(s+slen-plen, p) == 0);
 }
 
 gboolean
@@ -102,16 +143,21 @@ cml_rulebase_parse(cml_rulebase *rb, const char *filename)
     gboolean failed;
     const char *lang = 0;
     
+    rb->cancelled = FALSE;
     if (str_has_suffix(filename, "/Config.in") ||
     	str_has_suffix(filename, "/config.in") ||
 	str_has_suffix(filename, ".cml1"))
     {
+    	MEM_TAG_BEGIN(CML_MEM_PARSER)
     	failed = !_cml_rulebase_parse_cml1(rb, filename);
+	MEM_TAG_END
 	lang = "CML1";
     }
     else if (str_has_suffix(filename, ".cml"))
     {
+    	MEM_TAG_BEGIN(CML_MEM_PARSER)
     	failed = !_cml_rulebase_parse_cml2(rb, filename);
+	MEM_TAG_END
 	lang = "CML2";
     }
     else
@@ -123,6 +169,8 @@ cml_rulebase_parse(cml_rulebase *rb, const char *filename)
     	return FALSE;
     }
     
+    if (rb->cancelled)
+    	failed = TRUE;
     if (!failed && !rb->merge_mode && !cml_rulebase_post_parse(rb))
     	failed = TRUE;
 
@@ -160,7 +208,7 @@ cml_rulebase_parse(cml_rulebase *rb, const char *filename)
 const char *
 cml_rulebase_get_banner(const cml_rulebase *rb)
 {
-    return (rb->banner == 0 ? 0 : rb->banner->banner);
+    return (rb->banner == 0 ? 0 : rb->banner->cold->banner);
 }
 
 /*============================================================*/
@@ -192,11 +240,10 @@ cml_rulebase_find_node(cml_rulebase *rb, const char *name)
 cml_node *
 rb_add_node(cml_rulebase *rb, const char *name)
 {
-    cml_node *mn = mn_new(name);
+    cml_node *mn = mn_new(rb, name);
     if (mn == 0)
     	return 0;
     g_hash_table_insert(rb->menu_nodes, mn->name, mn);
-    mn->rulebase = rb;
     
     return mn;
 }
@@ -204,6 +251,7 @@ rb_add_node(cml_rulebase *rb, const char *name)
 void
 rb_remove_node(cml_rulebase *rb, cml_node *mn)
 {
+    rb_thaw_graph(rb);
     g_hash_table_remove(rb->menu_nodes, mn->name);
 }
 
@@ -217,7 +265,8 @@ _cml_rulebase_menu_apply_recursive(
     int depth,
     void *user_data)
 {
-    GList *list;
+    cml_adj_iter kids;
+    cml_node *child;
     cml_visit_result res;
     
     res = (*visitor)(rb, mn, depth, user_data);
@@ -226,10 +275,9 @@ _cml_rulebase_menu_apply_recursive(
 
     if (res == CML_CONTINUE)
     {	
-	for (list = mn->children ; list != 0 ; list = list->next)
+	mn_adj_iter_init(&kids, mn, MN_ADJ_CHILDREN);
+	while ((child = (cml_node *)mn_adj_iter_next(&kids)) != 0)
 	{
-    	    cml_node *child = (cml_node *)list->data;
-
 	    res = _cml_rulebase_menu_apply_recursive(rb, visitor, child, depth+1, user_data);
 	    if (res == CML_RETURN)
 	    	return CML_RETURN;
@@ -285,44 +333,126 @@ cml_rulebase_derived_apply(
 
 /*============================================================*/
 
+/*
+ * The icon is decoded the first time it's asked for.
+ */
 const cml_blob *
 cml_rulebase_get_icon(cml_rulebase *rb)
 {
+    char *raw;
+    
+    if (rb->icon == 0 && (raw = textref_read(rb, &rb->icon_ref)) != 0)
+    {
+	/* the decoder skips the whitespace between base64 words */
+    	b64_decode_begin();
+	b64_decode_input(raw);
+	rb->icon = b64_decode_take_data_as_blob();
+	b64_decode_end();
+	g_free(raw);
+    }
     return rb->icon;
 }
 
 /*============================================================*/
 
+/*
+ * Rules are triggered from a FIFO queue rather than by recursing
+ * from mn_set_value(), so that a cascade of forced bindings is
+ * propagated breadth-first with each rule queued at most once no
+ * matter how many of its symbols change before it is triggered.
+ * Each symbol's rules_using list serves as its watch list.
+ */
+static void
+rb_queue_rule(cml_rulebase *rb, cml_rule *rule)
+{
+    if (rule->queued)
+	return;
+    rule->queued = TRUE;
+    if (rb->trigger_queue == 0)
+	rb->trigger_queue = rb->trigger_queue_tail = g_list_append(0, rule);
+    else
+	rb->trigger_queue_tail = g_list_append(rb->trigger_queue_tail, rule)->next;
+}
+
+void
+rb_queue_rules(cml_rulebase *rb, GList *rules)
+{
+    for ( ; rules != 0 ; rules = rules->next)
+    	rb_queue_rule(rb, (cml_rule *)rules->data);
+}
+
+void
+rb_queue_rules_using(cml_rulebase *rb, const cml_node *mn)
+{
+    cml_adj_iter iter;
+    cml_rule *rule;
+    
+    mn_adj_iter_init(&iter, mn, MN_ADJ_RULES_USING);
+    while ((rule = (cml_rule *)mn_adj_iter_next(&iter)) != 0)
+    	rb_queue_rule(rb, rule);
+}
+
+/*
+ * Trigger queued rules until the queue is empty, i.e. until no
+ * rule has any more bindings to force.  Nested calls made while
+ * the queue is already being drained return immediately and
+ * leave the outermost call to trigger the rules they queued.
+ * Returns FALSE if any rule was left broken.
+ */
 gboolean
-rb_trigger_rules(
-    cml_rulebase *rb,
-    GList *rules,
-    cml_node *source)
+rb_propagate(cml_rulebase *rb, cml_node *source)
 {
     gboolean ret = TRUE;
+    GList *link;
+    cml_rule *rule;
     
-    for ( ; rules != 0 ; rules = rules->next)
+    if (rb->propagating)
+    	return TRUE;
+	
+    rb->propagating = TRUE;
+    while ((link = rb->trigger_queue) != 0)
     {
-    	cml_rule *rule = (cml_rule *)rules->data;
+    	rule = (cml_rule *)link->data;
+	rb->trigger_queue = g_list_remove_link(rb->trigger_queue, link);
+	if (rb->trigger_queue == 0)
+	    rb->trigger_queue_tail = 0;
+	g_list_free(link);
+	rule->queued = FALSE;
 	
 	if (!rule_trigger(rb, rule, source))
 	    ret = FALSE;
     }
+    rb->propagating = FALSE;
     
     return ret;
 }
 
+gboolean
+rb_trigger_rules(
+    cml_rulebase *rb,
+    GList *rules,
+    cml_node *source)
+{
+    rb_queue_rules(rb, rules);
+    return rb_propagate(rb, source);
+}
+
 void
 cml_rulebase_check_all_rules(cml_rulebase *rb)
 {
     GList *list;
     
+    if (!RB_FINISH_PARSE(rb))
+    	return;
     for (list = rb->rules ; list != 0 ; list = list->next)
     {
     	cml_rule *rule = (cml_rule *)list->data;
 	
 	rule_trigger(rb, rule, /*source*/0);
     }
+    
+    if (rb->notifier != 0)
+    	notify_flush(rb->notifier);
 }
 
 
@@ -374,10 +504,10 @@ dump_rulebase_visitor(
     fprintf(stderr, "{\n");
 
     indent(depth, fp);
-    if (mn->banner == 0)
+    if (mn->cold->banner == 0)
 	fprintf(fp, "    banner=null\n");
     else
-	fprintf(fp, "    banner=\"%s\"\n", mn->banner);
+	fprintf(fp, "    banner=\"%s\"\n", mn->cold->banner);
 
     if (mn->visibility_expr != 0)
     {
@@ -489,6 +619,12 @@ cml_rulebase_set_arch(cml_rulebase *rb, const char *arch)
     mn->expr = expr_new_atom_v(A_STRING, g_strdup(arch));
 }
 
+void
+cml_rulebase_set_progressive(cml_rulebase *rb, gboolean b)
+{
+    rb->progressive = b;
+}
+
 /* only useful for CML1 */
 void
 cml_rulebase_set_merge_mode(cml_rulebase *rb)
@@ -550,7 +686,7 @@ cml_rulebase_commit(cml_rulebase *rb, gboolean freeze)
     /* TODO: check feature ties here? */
     gboolean failed;
     
-    failed = (rb->num_failed_sets > 0);
+    failed = (!RB_FINISH_PARSE(rb) || rb->num_failed_sets > 0);
     if (failed)
 	_cml_tx_abort(rb);
     else
@@ -559,7 +695,8 @@ cml_rulebase_commit(cml_rulebase *rb, gboolean freeze)
     rb_unchill_all(rb);
     rb->num_failed_sets = 0;
     
-    /* TODO: notify front-end that values have changed */
+    if (rb->notifier != 0)
+    	notify_flush(rb->notifier);
     
     return !failed;
 }
@@ -569,10 +706,11 @@ cml_rulebase_abort(cml_rulebase *rb)
 {
     _cml_tx_abort(rb);
 
-    /* TODO: notify front-end that values have changed */
-    
     rb_unchill_all(rb);
     rb->num_failed_sets = 0;
+    
+    if (rb->notifier != 0)
+    	notify_flush(rb->notifier);
 }
 
 void
@@ -580,7 +718,8 @@ cml_rulebase_undo(cml_rulebase *rb)
 {
     _cml_tx_undo(rb);
     
-    /* TODO: notify front-end that values have changed */
+    if (rb->notifier != 0)
+    	notify_flush(rb->notifier);
 }
 
 void
@@ -588,13 +727,24 @@ cml_rulebase_redo(cml_rulebase *rb)
 {
     _cml_tx_redo(rb);
     
-    /* TODO: notify front-end that values have changed */
+    if (rb->notifier != 0)
+    	notify_flush(rb->notifier);
+}
+
+static void
+forget_loaded(gpointer key, gpointer value, gpointer user_data)
+{
+    ((cml_node *)value)->flags &= ~MN_LOADED;
 }
 
 void
 cml_rulebase_clear(cml_rulebase *rb)
 {
     _cml_tx_clear(rb);
+    g_hash_table_foreach(rb->menu_nodes, forget_loaded, 0);
+    
+    if (rb->notifier != 0)
+    	notify_flush(rb->notifier);
 }
 
 /*============================================================*/
@@ -655,6 +805,83 @@ cml_rulebase_get_broken_rules(const cml_rulebase *rb)
 
 /*============================================================*/
 
+/*
+ * Called by the lexers for each rules file opened.  Filenames
+ * are pooled so duplicates can be found by pointer.  The file's
+ * size and modification time are noted for textref_read().
+ */
+void
+rb_add_filename(cml_rulebase *rb, const char *filename, FILE *fp)
+{
+    struct stat sb;
+    cml_file_stamp *stamp;
+
+    if (g_list_find(rb->filenames, (gpointer)filename) == 0)
+    	rb->filenames = g_list_append(rb->filenames, (gpointer)filename);
+
+    if (fstat(fileno(fp), &sb) < 0)
+    	return;
+    if (rb->file_stamps == 0)
+    	rb->file_stamps = g_hash_table_new(g_direct_hash, g_direct_equal);
+    if ((stamp = g_hash_table_lookup(rb->file_stamps, filename)) == 0)
+    {
+	stamp = g_new(cml_file_stamp, 1);
+	g_hash_table_insert(rb->file_stamps, (gpointer)filename, stamp);
+    }
+    stamp->size = sb.st_size;
+    stamp->mtime = sb.st_mtime;
+    stamp->unreadable = FALSE;
+}
+
+const GList *
+cml_rulebase_get_filenames(const cml_rulebase *rb)
+{
+    return rb->filenames;
+}
+
+/*============================================================*/
+
+void
+cml_rulebase_set_progress_func(
+    cml_rulebase *rb,
+    cml_progress_func func,
+    void *user_data)
+{
+    rb->progress_func = func;
+    rb->progress_data = user_data;
+}
+
+/*
+ * Called from time to time during parse, load and save.  Returns
+ * FALSE if the front end has cancelled the current operation, in
+ * which case the caller should stop as soon as it safely can.  The
+ * public entry points clear rb->cancelled when they begin.
+ */
+gboolean
+rb_progress(
+    cml_rulebase *rb,
+    cml_progress_phase phase,
+    const char *filename,
+    unsigned long done,
+    unsigned long total)
+{
+    cml_location loc;
+
+    if (rb->cancelled)
+    	return FALSE;
+    if (rb->progress_func == 0 ||
+    	(*rb->progress_func)(rb, phase, filename, done, total, rb->progress_data))
+    	return TRUE;
+
+    rb->cancelled = TRUE;
+    loc.filename = filename;
+    loc.lineno = 0;
+    cml_errorl(&loc, "cancelled\n");
+    return FALSE;
+}
+
+/*============================================================*/
+
 #if TESTSCRIPT
 
 void
@@ -882,5 +1109,381 @@ cml_rulebase_set_warning(cml_rulebase *rb, int id, gboolean enabled)
 	_rb_disable_warning(rb, id);
 }
 
+/*============================================================*/
+
+const char *
+cml_mem_tag_name(cml_mem_tag tag)
+{
+    switch (tag)
+    {
+    case CML_MEM_OTHER:     	return "other";
+    case CML_MEM_NODES:     	return "nodes";
+    case CML_MEM_EXPRS:     	return "exprs";
+    case CML_MEM_RULES:     	return "rules";
+    case CML_MEM_TRANSACTIONS:	return "transactions";
+    case CML_MEM_STRINGS:   	return "strings";
+    case CML_MEM_RANGES:    	return "ranges";
+    case CML_MEM_PARSER:    	return "parser";
+    case CML_MEM_NUM_TAGS:  	break;
+    }
+    return 0;
+}
+
+/*
+ * The allocator is shared by everything in the process, so
+ * the figures cover all rulebases and the caller's own
+ * allocations (which are charged to CML_MEM_OTHER).
+ */
+gboolean
+cml_rulebase_get_memory_stats(const cml_rulebase *rb, cml_mem_stats *stats)
+{
+#if MEMSTATS
+    mem_get_stats(stats);
+    return TRUE;
+#else
+    memset(stats, 0, sizeof(cml_mem_stats) * CML_MEM_NUM_TAGS);
+    return FALSE;
+#endif
+}
+
+/*============================================================*/
+/*
+ * Many of the counted functions (e.g. expr_evaluate()) don't
+ * know which rulebase they are working for, so like the memory
+ * statistics the counters are shared by all rulebases.  The
+ * functions to get and reset them take a rulebase all the same,
+ * like cml_rulebase_get_memory_stats(), so that the API doesn't
+ * change if some counters become per-rulebase.
+ */
+unsigned long cml_stat_counts[CML_STAT_NUM];
+
+const char *
+cml_stat_name(cml_stat_id id)
+{
+    switch (id)
+    {
+    case CML_STAT_EXPR_EVALUATE:    return "expr_evaluate";
+    case CML_STAT_EXPR_SIMPLIFY:    return "expr_simplify";
+    case CML_STAT_EXPR_SOLVE:	    return "expr_solve";
+    case CML_STAT_RULE_TRIGGER:     return "rule_trigger";
+    case CML_STAT_NODE_SET_VALUE:   return "node_set_value";
+    case CML_STAT_TX_SET:   	    return "tx_set";
+    case CML_STAT_NODE_IS_VISIBLE:  return "node_is_visible";
+    case CML_STAT_VISIBLE_EVAL:    return "visible_eval";
+    case CML_STAT_NODE_GET_VALUE:   return "node_get_value";
+    case CML_STAT_FAILED_SETS:	    return "failed_sets";
+    case CML_STAT_RULES_BROKEN:     return "rules_broken";
+    case CML_STAT_RULES_REPAIRED:   return "rules_repaired";
+    case CML_STAT_NUM:	    	    break;
+    }
+    return 0;
+}
+
+void
+cml_rulebase_get_stats(const cml_rulebase *rb, cml_stats *stats)
+{
+    memcpy(stats->counts, cml_stat_counts, sizeof(cml_stat_counts));
+    stats->compacted_bytes = rb->compact_bytes;
+}
+
+void
+cml_rulebase_reset_stats(cml_rulebase *rb)
+{
+    memset(cml_stat_counts, 0, sizeof(cml_stat_counts));
+}
+
+void
+cml_rulebase_print_stats(const cml_rulebase *rb, FILE *fp)
+{
+    cml_stats stats;
+    int id;
+
+    cml_rulebase_get_stats(rb, &stats);
+    for (id = 0 ; id < CML_STAT_NUM ; id++)
+    	fprintf(fp, "%-16s %12lu\n", cml_stat_name(id), stats.counts[id]);
+    fprintf(fp, "%-16s %12lu\n", "compacted_bytes", stats.compacted_bytes);
+}
+
+/*============================================================*/
+/*
+ * The profile records what each rule and derived symbol costs
+ * to evaluate, to show which parts of the rules are worth
+ * restructuring.  Like the timings it's off by default, and
+ * the hot paths only test rb->profile.
+ */
+
+void
+cml_rulebase_enable_profile(cml_rulebase *rb)
+{
+    if (rb->profile == 0)
+    	rb->profile = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+static cml_profile_entry *
+rb_profile_entry(cml_rulebase *rb, gconstpointer key)
+{
+    cml_profile_entry *pe;
+
+    if ((pe = (cml_profile_entry *)g_hash_table_lookup(rb->profile, key)) == 0)
+    {
+    	pe = g_new0(cml_profile_entry, 1);
+	g_hash_table_insert(rb->profile, (gpointer)key, pe);
+    }
+    return pe;
+}
+
+void
+rb_profile_rule(
+    cml_rulebase *rb,
+    const cml_rule *rule,
+    double seconds,
+    gboolean broken,
+    gboolean punted)
+{
+    cml_profile_entry *pe = rb_profile_entry(rb, rule);
+
+    pe->uniqueid = rule->uniqueid;
+    pe->location = rule->location;
+    pe->evaluations++;
+    pe->seconds += seconds;
+    if (broken)
+    	pe->broken++;
+    if (punted)
+    	pe->punts++;
+}
+
+void
+rb_profile_symbol(cml_rulebase *rb, const cml_node *mn, double seconds)
+{
+    cml_profile_entry *pe = rb_profile_entry(rb, mn);
+
+    pe->symbol = mn->name;
+    pe->location = mn->cold->location;
+    pe->evaluations++;
+    pe->seconds += seconds;
+}
+
+void
+rb_profile_tabled(cml_rulebase *rb, const cml_node *mn)
+{
+    cml_profile_entry *pe = rb_profile_entry(rb, mn);
+
+    pe->symbol = mn->name;
+    pe->location = mn->cold->location;
+    pe->tabled++;
+}
+
+static void
+append_profile_entry(gpointer key, gpointer value, gpointer user_data)
+{
+    GList **listp = (GList **)user_data;
+
+    *listp = g_list_prepend(*listp, value);
+}
+
+static int
+compare_profile_entries(gconstpointer v1, gconstpointer v2)
+{
+    const cml_profile_entry *pe1 = (const cml_profile_entry *)v1;
+    const cml_profile_entry *pe2 = (const cml_profile_entry *)v2;
+
+    if (pe1->seconds > pe2->seconds)
+    	return -1;
+    if (pe1->seconds < pe2->seconds)
+    	return 1;
+    return (pe2->evaluations > pe1->evaluations) - (pe2->evaluations < pe1->evaluations);
+}
+
+GList *
+cml_rulebase_get_profile(const cml_rulebase *rb)
+{
+    GList *list = 0;
+
+    if (rb->profile == 0)
+    	return 0;
+    g_hash_table_foreach(rb->profile, append_profile_entry, &list);
+    return g_list_sort(list, compare_profile_entries);
+}
+
+/*============================================================*/
+
+const char *
+cml_phase_name(cml_phase phase)
+{
+    switch (phase)
+    {
+    case CML_PHASE_LEX:     	    return "lex";
+    case CML_PHASE_PARSE:   	    return "parse";
+    case CML_PHASE_CML1_PASS2:	    return "cml1_pass2";
+    case CML_PHASE_CHECK_NODES:     return "check_menu_node";
+    case CML_PHASE_DEPS_TO_RULES:   return "conv_dep_to_rule";
+    case CML_PHASE_CHECK_RULES:     return "check_rule";
+    case CML_PHASE_OVERLAP: 	    return "overlap";
+    case CML_PHASE_LOAD_DEFCONFIG:  return "load_defconfig";
+    case CML_PHASE_SAVE_DEFCONFIG:  return "save_defconfig";
+    case CML_PHASE_NUM:     	    break;
+    }
+    return 0;
+}
+
+/*
+ * Timings are off by default because lexing is timed per token.
+ */
+void
+cml_rulebase_enable_timings(cml_rulebase *rb)
+{
+    if (rb->timings == 0)
+    	rb->timings = g_new0(cml_timing, CML_PHASE_NUM);
+}
+
+void
+rb_add_timing(cml_rulebase *rb, cml_phase phase, double seconds)
+{
+    rb->timings[phase].seconds += seconds;
+    rb->timings[phase].count++;
+}
+
+void
+rb_add_file_lex_timing(cml_rulebase *rb, const char *filename, double seconds)
+{
+    cml_file_timing *ft = rb->last_file_timing;
+    GList *list;
+
+    /* filenames are pooled so can be compared by pointer */
+    if (ft == 0 || ft->filename != filename)
+    {
+    	for (list = rb->file_timings ; list != 0 ; list = list->next)
+	{
+	    ft = (cml_file_timing *)list->data;
+	    if (ft->filename == filename)
+	    	break;
+	}
+	if (list == 0)
+	{
+	    ft = g_new0(cml_file_timing, 1);
+	    ft->filename = filename;
+	    rb->file_timings = g_list_append(rb->file_timings, ft);
+	}
+	rb->last_file_timing = ft;
+    }
+    ft->lex.seconds += seconds;
+    ft->lex.count++;
+    rb_add_timing(rb, CML_PHASE_LEX, seconds);
+}
+
+gboolean
+cml_rulebase_get_timings(const cml_rulebase *rb, cml_timing *timings)
+{
+    if (rb->timings == 0)
+    {
+	memset(timings, 0, sizeof(cml_timing) * CML_PHASE_NUM);
+    	return FALSE;
+    }
+    memcpy(timings, rb->timings, sizeof(cml_timing) * CML_PHASE_NUM);
+    /* the parser's time includes the lexer which it calls */
+    timings[CML_PHASE_PARSE].seconds -= timings[CML_PHASE_LEX].seconds;
+    return TRUE;
+}
+
+void
+cml_rulebase_foreach_file_timing(
+    const cml_rulebase *rb,
+    cml_file_timing_func func,
+    void *user_data)
+{
+    GList *list;
+
+    for (list = rb->file_timings ; list != 0 ; list = list->next)
+    {
+    	cml_file_timing *ft = (cml_file_timing *)list->data;
+
+    	(*func)(ft->filename, &ft->lex, user_data);
+    }
+}
+
+/*
+ * JSON string literal, with the control characters JSON
+ * doesn't allow in a string escaped.
+ */
+void
+cml_print_json_string(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for ( ; *s ; s++)
+    {
+    	if (*s == '"' || *s == '\\')
+	    fprintf(fp, "\\%c", *s);
+	else if ((unsigned char)*s < 0x20)
+	    fprintf(fp, "\\u%04x", (unsigned char)*s);
+	else
+	    fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+typedef struct
+{
+    FILE *fp;
+    int nfiles;
+} json_state;
+
+static void
+print_file_timing_json(const char *filename, const cml_timing *lex, void *user_data)
+{
+    json_state *js = (json_state *)user_data;
+
+    fprintf(js->fp, "%s    {\"file\": ", (js->nfiles++ ? ",\n" : ""));
+    cml_print_json_string(js->fp, filename);
+    fprintf(js->fp, ", \"lex_seconds\": %.6f, \"tokens\": %lu}",
+    	    lex->seconds, lex->count);
+}
+
+static void
+print_file_timing_tsv(const char *filename, const cml_timing *lex, void *user_data)
+{
+    FILE *fp = (FILE *)user_data;
+
+    fprintf(fp, "lex:%s\t%.6f\t%lu\n", filename, lex->seconds, lex->count);
+}
+
+/*
+ * Print the phase timings, as JSON or as TSV lines of
+ * phase, seconds and count followed by a line per file.
+ */
+gboolean
+cml_rulebase_print_timings(const cml_rulebase *rb, FILE *fp, const char *format)
+{
+    cml_timing timings[CML_PHASE_NUM];
+    json_state js;
+    int phase;
+
+    if (!cml_rulebase_get_timings(rb, timings))
+    	return FALSE;
+    if (!strcmp(format, "tsv"))
+    {
+	for (phase = 0 ; phase < CML_PHASE_NUM ; phase++)
+    	    fprintf(fp, "%s\t%.6f\t%lu\n",
+	    	    cml_phase_name(phase),
+		    timings[phase].seconds,
+		    timings[phase].count);
+	cml_rulebase_foreach_file_timing(rb, print_file_timing_tsv, fp);
+	return TRUE;
+    }
+
+    fprintf(fp, "{\n  \"phases\": {\n");
+    for (phase = 0 ; phase < CML_PHASE_NUM ; phase++)
+    	fprintf(fp, "    \"%s\": {\"seconds\": %.6f, \"count\": %lu}%s\n",
+	    	cml_phase_name(phase),
+		timings[phase].seconds,
+		timings[phase].count,
+		(phase < CML_PHASE_NUM-1 ? "," : ""));
+    fprintf(fp, "  },\n  \"files\": [\n");
+    js.fp = fp;
+    js.nfiles = 0;
+    cml_rulebase_foreach_file_timing(rb, print_file_timing_json, &js);
+    fprintf(fp, "\n  ]\n}\n");
+    return TRUE;
+}
+
 /*============================================================*/
 /*END*/
@@ -0,0 +1,149 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Times repeated cml_rulebase_check_all_rules() passes over a whole
+ * rulebase, which is dominated by node access, and on Linux counts
+ * the hardware cache misses they take with perf_event_open(2).  If
+ * the kernel won't give us the counter (see perf_event_paranoid) it
+ * says so and reports the time only; the same figure then comes from
+ *
+ *  perf stat -e cache-references,cache-misses ./rulebench -n 1000 rules.cml
+ *
+ * which also counts the parse.
+ */
+
+#include "private.h"
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+CVSID("$Id$");
+
+static void
+usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--arch arch] [-n iterations] rulesfile [rulesfile...]\n",
+    	    argv0);
+    exit(1);
+}
+
+/*
+ * Returns a file descriptor counting this process's cache misses,
+ * stopped and zeroed, or -1 if they can't be counted.
+ */
+static int
+cache_misses_open(void)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static void
+cache_misses_enable(int fd, gboolean enable)
+{
+#ifdef __linux__
+    if (fd >= 0)
+	ioctl(fd, (enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE), 0);
+#endif
+}
+
+int
+main(int argc, char **argv)
+{
+    cml_rulebase *rb;
+    const char *arch = "i386";
+    char **files;
+    int nfiles = 0;
+    int niters = 100;
+    int i, fd;
+    double start, elapsed;
+    unsigned long long misses;
+
+    files = (char **)g_malloc0(sizeof(char *) * argc);
+    for (i = 1 ; i < argc ; i++)
+    {
+    	if (!strcmp(argv[i], "--arch") && i+1 < argc)
+	    arch = argv[++i];
+	else if (!strcmp(argv[i], "-n") && i+1 < argc)
+	    niters = atoi(argv[++i]);
+	else if (argv[i][0] == '-')
+	    usage(argv[0]);
+	else
+	    files[nfiles++] = argv[i];
+    }
+    if (nfiles == 0 || niters <= 0)
+    	usage(argv[0]);
+
+    rb = cml_rulebase_new();
+    if (nfiles > 1)
+	cml_rulebase_set_merge_mode(rb);
+    cml_rulebase_set_arch(rb, arch);
+    for (i = 0 ; i < nfiles ; i++)
+    	if (!cml_rulebase_parse(rb, files[i]))
+	    return 1;
+    if (nfiles > 1 && !cml_rulebase_post_parse(rb))
+    	return 1;
+
+    /* warm up once, so that derived values and defaults are settled */
+    cml_rulebase_check_all_rules(rb);
+
+    fd = cache_misses_open();
+    start = cml_timer_now();
+    cache_misses_enable(fd, TRUE);
+    for (i = 0 ; i < niters ; i++)
+	cml_rulebase_check_all_rules(rb);
+    cache_misses_enable(fd, FALSE);
+    elapsed = cml_timer_now() - start;
+
+    printf("nodes %d rules %d sizeof(cml_node) %d sizeof(cml_node_cold) %d\n",
+    	    g_hash_table_size(rb->menu_nodes),
+	    g_list_length(rb->rules),
+	    (int)sizeof(cml_node),
+	    (int)sizeof(cml_node_cold));
+    printf("%d passes in %.3f sec, %.1f usec/pass\n",
+    	    niters, elapsed, elapsed * 1e6 / niters);
+    if (fd >= 0 && read(fd, &misses, sizeof(misses)) == sizeof(misses))
+	printf("%llu cache misses, %.1f/pass\n",
+	    	misses, (double)misses / niters);
+    else
+    	printf("cache misses not available, use perf stat\n");
+    if (fd >= 0)
+    	close(fd);
+
+    cml_rulebase_delete(rb);
+    return 0;
+}
+
+/*END*/
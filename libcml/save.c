@@ -22,11 +22,23 @@
 #include "debug.h"
 #include <ctype.h>
 #include <errno.h>
+#include <unistd.h>
 
 CVSID("$Id: save.c,v 1.14 2002/09/01 08:21:08 gnb Exp $");
 
 #define safestr(s)  ((s) == 0 ? "" : (s))
 
+/* report progress every this many nodes */
+#define PROGRESS_NODES	256
+
+typedef struct
+{
+    FILE *fp;
+    const char *filename;
+    unsigned long count;
+    unsigned long total;
+} save_state;
+
 /*============================================================*/
 
 static cml_visit_result
@@ -36,9 +48,16 @@ save_defconfig_visitor(
     int depth,
     void *user_data)
 {
-    FILE *fp = (FILE *)user_data;
+    save_state *ss = (save_state *)user_data;
+    FILE *fp = ss->fp;
     const cml_atom *ap;
 
+    if (++ss->count % PROGRESS_NODES == 0 &&
+    	!rb_progress(rb, CML_PROGRESS_SAVE, ss->filename, ss->count, ss->total))
+    	return CML_RETURN;
+    if (rb->cancelled)
+    	return CML_RETURN;  /* derived_apply can't stop early */
+
     if (mn->treetype == MN_MENU && !cml_node_is_visible(mn))
     	return CML_SKIP;
 
@@ -47,10 +66,10 @@ save_defconfig_visitor(
 	
     if (mn->treetype == MN_MENU &&
     	!cml_node_is_radio(mn) &&
-	mn->children != 0 &&
-	mn->banner != 0)
+	mn_adj_count(mn, MN_ADJ_CHILDREN) != 0 &&
+	mn->cold->banner != 0)
     {
-    	fprintf(fp, "\n#\n# %s\n#\n", mn->banner);
+    	fprintf(fp, "\n#\n# %s\n#\n", mn->cold->banner);
     	return CML_CONTINUE;
     }
 
@@ -119,30 +138,54 @@ cml_rulebase_save_defconfig(cml_rulebase *rb, const char *filename)
 {
     /* TODO: write a tmp file, diff em, and replace only if different */
     /* TODO: escape strings properly */
-    FILE *fp;
+    save_state ss;
     char *bakfile;
+    gboolean had_old = TRUE;
     
+    rb->cancelled = FALSE;
+
     /* First, backup the file */
     bakfile = g_strconcat(filename, ".old", 0);
-    if (rename(filename, bakfile) < 0 && errno != ENOENT)
+    if (rename(filename, bakfile) < 0)
     {
-    	cml_perror(bakfile);
-    	g_free(bakfile);
-	return FALSE;
+    	if (errno != ENOENT)
+	{
+	    cml_perror(bakfile);
+	    g_free(bakfile);
+	    return FALSE;
+	}
+	had_old = FALSE;
     }
-    g_free(bakfile);
     
-    if ((fp = fopen(filename, "w")) == 0)
+    if ((ss.fp = fopen(filename, "w")) == 0)
     {
     	cml_perror(filename);
+	g_free(bakfile);
     	return FALSE;
     }
+    ss.filename = filename;
+    ss.count = 0;
+    ss.total = g_hash_table_size(rb->menu_nodes);
     DDPRINTF1(DEBUG_SAVE, "    Writing %s\n", filename);
-    fputs(banner, fp);
-    cml_rulebase_menu_apply(rb, save_defconfig_visitor, (void*)fp);
-    fprintf(fp, "\n# Derived symbols\n");
-    cml_rulebase_derived_apply(rb, save_defconfig_visitor, (void*)fp);
-    fclose(fp);
+    PHASE_BEGIN(rb, CML_PHASE_SAVE_DEFCONFIG)
+    fputs(banner, ss.fp);
+    cml_rulebase_menu_apply(rb, save_defconfig_visitor, (void*)&ss);
+    fprintf(ss.fp, "\n# Derived symbols\n");
+    cml_rulebase_derived_apply(rb, save_defconfig_visitor, (void*)&ss);
+    fclose(ss.fp);
+    PHASE_END(rb, CML_PHASE_SAVE_DEFCONFIG)
+    
+    if (rb->cancelled)
+    {
+    	/* put back the file we started with */
+    	DDPRINTF1(DEBUG_SAVE, "    Restoring %s\n", filename);
+    	unlink(filename);
+	if (had_old)
+	    rename(bakfile, filename);
+	g_free(bakfile);
+	return FALSE;
+    }
+    g_free(bakfile);
 
     return TRUE;
 }
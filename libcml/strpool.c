@@ -0,0 +1,135 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "private.h"
+
+CVSID("$Id$");
+
+/*============================================================*/
+/*
+ * A string pool keeps exactly one copy of each distinct string,
+ * so that the same name, banner or value used in many places is
+ * stored once and two pooled strings are equal if and only if
+ * the pointers are equal.  Each string has a reference count;
+ * strings still referenced when the pool is deleted are freed
+ * with it, so users which live as long as the pool (e.g. node
+ * names in a rulebase's pool) need never unref.
+ *
+ * Pooled strings must not be modified.
+ */
+
+struct cml_strpool_s
+{
+    GHashTable *table;	    	/* key=string value=refcount */
+};
+
+cml_strpool *
+strpool_new(void)
+{
+    cml_strpool *pool;
+
+    MEM_TAG_BEGIN(CML_MEM_STRINGS)
+    pool = g_new(cml_strpool, 1);
+    pool->table = g_hash_table_new(g_str_hash, g_str_equal);
+    MEM_TAG_END
+    return pool;
+}
+
+static gboolean
+delete_one_string(gpointer key, gpointer value, gpointer user_data)
+{
+    g_free(key);
+    return TRUE;    /* please remove me */
+}
+
+void
+strpool_delete(cml_strpool *pool)
+{
+    g_hash_table_foreach_remove(pool->table, delete_one_string, 0);
+    g_hash_table_destroy(pool->table);
+    g_free(pool);
+}
+
+/*
+ * Returns the pooled copy of `str', adding a reference.
+ */
+char *
+strpool_ref(cml_strpool *pool, const char *str)
+{
+    gpointer key, count;
+
+    if (str == 0)
+    	return 0;
+    if (g_hash_table_lookup_extended(pool->table, str, &key, &count))
+    {
+	g_hash_table_insert(pool->table, key,
+	    	    	    GUINT_TO_POINTER(GPOINTER_TO_UINT(count)+1));
+	return (char *)key;
+    }
+    MEM_TAG_BEGIN(CML_MEM_STRINGS)
+    key = g_strdup(str);
+    g_hash_table_insert(pool->table, key, GUINT_TO_POINTER(1));
+    MEM_TAG_END
+    return (char *)key;
+}
+
+/*
+ * Like strpool_ref() but takes over `str', which
+ * must have been allocated by g_malloc().
+ */
+char *
+strpool_take(cml_strpool *pool, char *str)
+{
+    char *pooled = strpool_ref(pool, str);
+
+    g_free(str);
+    return pooled;
+}
+
+void
+strpool_unref(cml_strpool *pool, const char *str)
+{
+    gpointer key, count;
+
+    if (str == 0)
+    	return;
+    if (!g_hash_table_lookup_extended(pool->table, str, &key, &count))
+    {
+    	assert(0);
+	return;
+    }
+    assert(key == (gpointer)str);
+    if (GPOINTER_TO_UINT(count) > 1)
+    {
+	g_hash_table_insert(pool->table, key,
+	    	    	    GUINT_TO_POINTER(GPOINTER_TO_UINT(count)-1));
+	return;
+    }
+    g_hash_table_remove(pool->table, key);
+    g_free(key);
+}
+
+unsigned int
+strpool_size(const cml_strpool *pool)
+{
+    return g_hash_table_size(pool->table);
+}
+
+/*============================================================*/
+/*END*/
@@ -0,0 +1,213 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "private.h"
+#include "debug.h"
+
+CVSID("$Id$");
+
+/*============================================================*/
+/*
+ * The tracer records where evaluation time goes in terms of the
+ * rulebase rather than the C code: each frame is a symbol being
+ * evaluated, a rule being triggered, or a symbol being set.  The
+ * self time of each distinct stack of frames is accumulated and
+ * saved in the "folded stacks" format read by flame graph tools,
+ * one line per stack:
+ *
+ * set FOO from FOO;rule 12 at rules.cml:34;BAR 1500
+ *
+ * where the weight is in nanoseconds.
+ */
+
+typedef struct
+{
+    double start;
+    double children;	    /* time spent in frames above this */
+    int length;     	    /* of stack string before this frame */
+} trace_frame;
+
+struct cml_tracer_s
+{
+    char *stack;    	    /* frames separated by ';' */
+    int stack_len;
+    int stack_size;
+    trace_frame *frames;
+    int depth;
+    int max_depth;
+    GHashTable *weights;    /* key=stack string value=double* seconds */
+};
+
+cml_tracer *
+trace_new(void)
+{
+    cml_tracer *tr = g_new0(cml_tracer, 1);
+
+    tr->stack_size = 256;
+    tr->stack = g_new(char, tr->stack_size);
+    tr->stack[0] = '\0';
+    tr->weights = g_hash_table_new(g_str_hash, g_str_equal);
+    return tr;
+}
+
+static gboolean
+delete_one_weight(gpointer key, gpointer value, gpointer user_data)
+{
+    g_free(key);
+    g_free(value);
+    return TRUE;    /* please remove me */
+}
+
+void
+trace_delete(cml_tracer *tr)
+{
+    g_hash_table_foreach_remove(tr->weights, delete_one_weight, 0);
+    g_hash_table_destroy(tr->weights);
+    g_free(tr->stack);
+    g_free(tr->frames);
+    g_free(tr);
+}
+
+/*============================================================*/
+
+/*
+ * Start a new frame called `name', which must not contain ';'.
+ */
+static void
+trace_push(cml_tracer *tr, const char *name)
+{
+    trace_frame *fr;
+    int len = strlen(name);
+
+    if (tr->depth == tr->max_depth)
+    {
+    	tr->max_depth = (tr->max_depth == 0 ? 32 : tr->max_depth * 2);
+	tr->frames = g_renew(trace_frame, tr->frames, tr->max_depth);
+    }
+    fr = &tr->frames[tr->depth++];
+    fr->length = tr->stack_len;
+    fr->children = 0.0;
+
+    if (tr->stack_len + len + 2 > tr->stack_size)
+    {
+    	while (tr->stack_len + len + 2 > tr->stack_size)
+	    tr->stack_size *= 2;
+	tr->stack = g_renew(char, tr->stack, tr->stack_size);
+    }
+    if (tr->stack_len > 0)
+    	tr->stack[tr->stack_len++] = ';';
+    memcpy(tr->stack + tr->stack_len, name, len+1);
+    tr->stack_len += len;
+
+    fr->start = cml_timer_now();
+}
+
+void
+trace_push_symbol(cml_tracer *tr, const cml_node *mn)
+{
+    trace_push(tr, mn->name);
+}
+
+void
+trace_push_rule(cml_tracer *tr, const cml_rule *rule)
+{
+    char *name = g_strdup_printf("rule %lu at %s:%d",
+    	    	    	    	 rule->uniqueid,
+				 rule->location.filename,
+				 rule->location.lineno);
+
+    trace_push(tr, name);
+    g_free(name);
+}
+
+void
+trace_push_set(cml_tracer *tr, const cml_node *mn, const cml_node *source)
+{
+    char *name = g_strdup_printf("set %s from %s",
+    	    	    	    	 mn->name,
+				 (source == 0 ? "nothing" : source->name));
+
+    trace_push(tr, name);
+    g_free(name);
+}
+
+void
+trace_pop(cml_tracer *tr)
+{
+    trace_frame *fr;
+    double elapsed;
+    double *weight;
+
+    assert(tr->depth > 0);
+    fr = &tr->frames[--tr->depth];
+    elapsed = cml_timer_now() - fr->start;
+
+    if ((weight = (double *)g_hash_table_lookup(tr->weights, tr->stack)) == 0)
+    {
+    	weight = g_new0(double, 1);
+	g_hash_table_insert(tr->weights, g_strdup(tr->stack), weight);
+    }
+    *weight += elapsed - fr->children;
+
+    if (tr->depth > 0)
+    	tr->frames[tr->depth-1].children += elapsed;
+    tr->stack_len = fr->length;
+    tr->stack[tr->stack_len] = '\0';
+}
+
+/*============================================================*/
+
+static void
+save_one_weight(gpointer key, gpointer value, gpointer user_data)
+{
+    FILE *fp = (FILE *)user_data;
+    double seconds = *(double *)value;
+
+    fprintf(fp, "%s %.0f\n", (const char *)key, (seconds < 0.0 ? 0.0 : seconds * 1e9));
+}
+
+void
+cml_rulebase_enable_trace(cml_rulebase *rb)
+{
+    if (rb->tracer == 0)
+    	rb->tracer = trace_new();
+}
+
+gboolean
+cml_rulebase_save_trace(cml_rulebase *rb, const char *filename)
+{
+    FILE *fp;
+
+    if (rb->tracer == 0)
+    	return FALSE;
+
+    if ((fp = fopen(filename, "w")) == 0)
+    {
+    	cml_perror(filename);
+    	return FALSE;
+    }
+    DDPRINTF1(DEBUG_SAVE, "    Writing trace %s\n", filename);
+    g_hash_table_foreach(rb->tracer->weights, save_one_weight, fp);
+    fclose(fp);
+
+    return TRUE;
+}
+
+/*============================================================*/
+/*END*/
@@ -46,6 +46,19 @@ CVSID("$Id: transactions.c,v 1.10 2002/09/01 08:23:40 gnb Exp $");
     ((rb)->transactions == 0 ? 0 : (cml_transaction *)(rb)->transactions->data)
 #define remove_head(l) \
     (l) = g_list_remove_link((l), (l))
+
+/*
+ * Only the first of a guard's transactions is current, so when
+ * the first changes its bindings must be rechecked.
+ */
+static void
+tx_notify_guarded(const cml_node *guard)
+{
+    cml_rulebase *rb = guard->rulebase;
+    
+    if (rb_tracking_changes(rb) && guard->transactions_guarded != 0)
+    	rb_transaction_changed(rb, (cml_transaction *)guard->transactions_guarded->data);
+}
     
 
 /*============================================================*/
@@ -55,7 +68,9 @@ bd_new(const cml_atom *a)
 {
     cml_binding *bd;
     
+    MEM_TAG_BEGIN(CML_MEM_TRANSACTIONS)
     bd = g_new(cml_binding, 1);
+    MEM_TAG_END
     if (bd == 0)
     	return 0;
 	
@@ -84,7 +99,9 @@ tx_new(cml_node *guard)
     cml_transaction *tx;
     static unsigned long last_uniqueid;
     
+    MEM_TAG_BEGIN(CML_MEM_TRANSACTIONS)
     tx = g_new(cml_transaction, 1);
+    MEM_TAG_END
     if (tx == 0)
     	return 0;
 	
@@ -93,7 +110,9 @@ tx_new(cml_node *guard)
     tx->uniqueid = ++last_uniqueid;
     tx->flags = TX_NEW;
     tx->guard = guard;
+    MEM_TAG_BEGIN(CML_MEM_TRANSACTIONS)
     tx->bindings = g_hash_table_new(g_direct_hash, g_direct_equal);
+    MEM_TAG_END
     
     return tx;
 }
@@ -104,6 +123,8 @@ _tx_delete_one_binding(gpointer key, gpointer value, gpointer user)
     cml_binding *bd = (cml_binding *)value;
     
     bd->node->bindings = g_list_remove(bd->node->bindings, bd);
+    if (rb_tracking_changes(bd->node->rulebase))
+    	rb_node_changed(bd->node->rulebase, bd->node);
     bd_delete(bd);
     
     return TRUE;    /* so remove it already */
@@ -113,7 +134,10 @@ static void
 tx_delete(cml_transaction *tx)
 {
     if (tx->guard != 0)
+    {
     	tx->guard->transactions_guarded = g_list_remove(tx->guard->transactions_guarded, tx);
+	tx_notify_guarded(tx->guard);
+    }
     g_hash_table_foreach_remove(tx->bindings, _tx_delete_one_binding, 0);
     g_free(tx);
 }
@@ -148,7 +172,10 @@ _cml_tx_delete_first(cml_rulebase *rb)
     
     remove_head(rb->transactions);
     if (tx == (cml_transaction *)g_list_data(tx->guard->transactions_guarded))
+    {
 	remove_head(tx->guard->transactions_guarded);
+	tx_notify_guarded(tx->guard);
+    }
     
     tx_delete(tx);
 }
@@ -168,6 +195,7 @@ _cml_tx_set(
     cml_transaction *tx;
     cml_binding *bd;
     
+    STAT_INC(CML_STAT_TX_SET);
     if (source == 0)
     	source = mn;
 
@@ -193,19 +221,26 @@ _cml_tx_set(
 	    rb->last_undo_id = ++rb->curr_undo_id;
 	tx = tx_new(source);
 	tx->undo_id = rb->curr_undo_id;
+	tx_notify_guarded(tx->guard);
+	MEM_TAG_BEGIN(CML_MEM_TRANSACTIONS)
 	rb->transactions = g_list_prepend(rb->transactions, tx);
 	tx->guard->transactions_guarded = g_list_prepend(
 	    	    	tx->guard->transactions_guarded, tx);
+	MEM_TAG_END
     }
 
 
     bd = bd_new(a);
 
+    MEM_TAG_BEGIN(CML_MEM_TRANSACTIONS)
     bd->node = mn;
     mn->bindings = g_list_prepend(mn->bindings, bd);
 
     bd->transaction = tx;
     g_hash_table_insert(tx->bindings, mn, (gpointer)bd);
+    MEM_TAG_END
+    if (rb_tracking_changes(rb))
+    	rb_node_changed(rb, mn);
 
 #if DEBUG
     if (debug & DEBUG_TXN)
@@ -262,7 +297,11 @@ _cml_tx_commit(cml_rulebase *rb, gboolean freeze)
 	    
 	tx->flags &= ~TX_NEW;
 	if (freeze)
+	{
 	    tx->flags |= TX_FROZEN;
+	    if (rb_tracking_changes(rb))
+	    	rb_transaction_changed(rb, tx);
+	}
     }
 }
 
@@ -366,7 +405,10 @@ _cml_tx_undo(cml_rulebase *rb)
 	    assert(!(tx->flags & TX_NEW));
 	    tx->flags |= TX_UNDONE;
 	    assert(!_cml_tx_is_superceded(tx));
+	    if (rb_tracking_changes(rb))
+	    	rb_transaction_changed(rb, tx);
 	    remove_head(tx->guard->transactions_guarded);
+	    tx_notify_guarded(tx->guard);
 	}
     }
     rb->curr_undo_id--;
@@ -398,7 +440,10 @@ _cml_tx_redo(cml_rulebase *rb)
 	    assert((tx->flags & TX_UNDONE));
 	    assert(!(tx->flags & TX_NEW));
 	    tx->flags &= ~TX_UNDONE;
+	    if (rb_tracking_changes(rb))
+	    	rb_transaction_changed(rb, tx);
 	    assert(g_list_find(tx->guard->transactions_guarded, tx) == 0);
+	    tx_notify_guarded(tx->guard);
 	    tx->guard->transactions_guarded = g_list_prepend(
 	    		tx->guard->transactions_guarded, tx);
 	}
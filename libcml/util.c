@@ -19,15 +19,39 @@
  
 #include "util.h"
 #include "common.h"
+#include "private.h"
 #include "debug.h"
 #include <unistd.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/time.h>
 
 CVSID("$Id: util.c,v 1.6 2002/09/01 08:23:19 gnb Exp $");
 
 /*============================================================*/
 
+/*
+ * Returns a timestamp in seconds, for measuring intervals.
+ */
+double
+cml_timer_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+}
+
+/*============================================================*/
+
 int
 build_directories(const char *filename)
 {
@@ -67,14 +91,29 @@ build_directories(const char *filename)
 
 /*============================================================*/
 
-#if SYLVESTER
+#if SYLVESTER || MEMSTATS
+
+/*
+ * Replacements for the libc allocator.  Every block carries a
+ * header just before the pointer handed out, recording its size
+ * and the memory tag which was current when it was allocated.
+ * With SYLVESTER each block is also followed by a cage of known
+ * bytes which is checked on free to catch overruns.  With MEMSTATS
+ * live & peak bytes and allocation counts are kept per tag, which
+ * is cheap enough to leave on in production.
+ */
 
+#if SYLVESTER
 #define CAGE	32
+#else
+#define CAGE	0
+#endif
 #define MAGIC1	0xdeadbeef
 #define MAGIC2	0xbdefaced
 #define TWEETY	0xa5
 
 extern void *__libc_malloc(size_t);
+extern void *__libc_memalign(size_t, size_t);
 extern void *__libc_realloc(void *, size_t);
 extern void __libc_free(void *);
 
@@ -82,18 +121,125 @@ struct header
 {
     uint32_t	magic;
     uint32_t	size;
+    uint32_t	tag;
+    uint32_t	offset;     /* of header from start of libc block */
 };
 
+/*
+ * The GTK front end runs libcml on a worker thread while its own
+ * thread keeps allocating, so the tag is per thread and the
+ * counters are updated atomically.
+ */
+static __thread cml_mem_tag mem_current_tag = CML_MEM_OTHER;
+
+#if MEMSTATS
+
+static cml_mem_stats mem_stats[CML_MEM_NUM_TAGS];
+
+static void
+mem_account_alloc(const struct header *h)
+{
+    cml_mem_stats *ms = &mem_stats[h->tag];
+    unsigned long live, peak;
+    
+    live = __sync_add_and_fetch(&ms->live_bytes, h->size);
+    while (live > (peak = ms->peak_bytes) &&
+    	   !__sync_bool_compare_and_swap(&ms->peak_bytes, peak, live))
+	;
+    __sync_add_and_fetch(&ms->num_allocs, 1);
+    __sync_add_and_fetch(&ms->num_live, 1);
+}
+
+static void
+mem_account_free(const struct header *h)
+{
+    cml_mem_stats *ms = &mem_stats[h->tag];
+    
+    __sync_sub_and_fetch(&ms->live_bytes, h->size);
+    __sync_sub_and_fetch(&ms->num_live, 1);
+}
+
+/*
+ * Makes `tag' the tag for this thread's subsequent
+ * allocations, returning the previous one.
+ */
+cml_mem_tag
+mem_set_tag(cml_mem_tag tag)
+{
+    cml_mem_tag old = mem_current_tag;
+    
+    mem_current_tag = tag;
+    return old;
+}
+
+void
+mem_get_stats(cml_mem_stats *stats)
+{
+    memcpy(stats, mem_stats, sizeof(mem_stats));
+}
+
+#else
+#define mem_account_alloc(h)
+#define mem_account_free(h)
+#endif /* MEMSTATS */
+
+/*
+ * A new block may reuse one we freed, don't mistake it for freed.
+ * Smaller blocks are safe because the cage is part of the word.
+ */
+#if SYLVESTER
+#define mem_unfree(x, sz) \
+    do { if ((sz) >= sizeof(gulong)) *(gulong *)(x) = 0; } while (0)
+#else
+#define mem_unfree(x, sz)
+#endif
+
+/*
+ * Mark a freed block for sylvester().  Only done with the cage,
+ * which makes room for the mark in blocks smaller than a word.
+ */
+#if SYLVESTER
+#define mem_poison(x)	(*(gulong *)(x) = MAGIC2)
+#else
+#define mem_poison(x)
+#endif
+
+static void *
+mem_finish(void *base, uint32_t offset, size_t sz, cml_mem_tag tag)
+{
+    struct header *h = (struct header *)((char *)base + offset);
+    
+    h->magic = MAGIC1 ^ sz;
+    h->size = sz;
+    h->tag = tag;
+    h->offset = offset;
+#if SYLVESTER
+    memset((char *)(h+1) + sz, TWEETY, CAGE);
+#endif
+    mem_account_alloc(h);
+    return (h+1);
+}
+
+static struct header *
+mem_check(void *x)
+{
+#if SYLVESTER
+    sylvester(x);
+#else
+    assert((((struct header *)x)[-1].magic ^ ((struct header *)x)[-1].size) == MAGIC1);
+#endif
+    return ((struct header *)x) - 1;
+}
+
 void *
 malloc(size_t sz)
 {
     void *x;
     if ((x = __libc_malloc(sizeof(struct header) + sz + CAGE)) == 0)
     	return 0;
-    ((struct header *)x)->magic = MAGIC1 ^ sz;
-    ((struct header *)x)->size = sz;
-    memset((char *)x + sizeof(struct header) + sz, TWEETY, CAGE);
-    return ((char *)x + sizeof(struct header));
+    x = mem_finish(x, 0, sz, mem_current_tag);
+    mem_unfree(x, sz);
+    return x;
 }
 
 void *
@@ -101,39 +247,100 @@ calloc(size_t unit, size_t qty)
 {
     size_t sz = unit * qty;
     void *x;
-    if ((x = __libc_malloc(sizeof(struct header) + sz + CAGE)) == 0)
+    if (unit != 0 && sz / unit != qty)
+    	return 0;
+    if ((x = malloc(sz)) == 0)
     	return 0;
-    ((struct header *)x)->magic = MAGIC1 ^ sz;
-    ((struct header *)x)->size = sz;
-    memset((char *)x + sizeof(struct header), 0, sz);
-    memset((char *)x + sizeof(struct header) + sz, TWEETY, CAGE);
-    return ((char *)x + sizeof(struct header));
+    memset(x, 0, sz);
+    return x;
 }
 
 void *
 realloc(void *x, size_t sz)
 {
-    if (x != 0)
+    struct header *h;
+    cml_mem_tag tag;
+    void *newx;
+
+    if (x == 0)
+    	return malloc(sz);
+    h = mem_check(x);
+    if (h->offset != 0)
     {
-	sylvester(x);
-    	x = (void *)((char *)x - sizeof(struct header));
+    	/* aligned block, can't hand it to __libc_realloc */
+    	if ((newx = malloc(sz)) == 0)
+	    return 0;
+	memcpy(newx, x, (sz < h->size ? sz : h->size));
+	free(x);
+	return newx;
     }
-    if ((x = __libc_realloc(x, sizeof(struct header) + sz + CAGE)) == 0)
+    /* the block keeps the tag it was first allocated with */
+    tag = h->tag;
+    mem_account_free(h);
+    if ((newx = __libc_realloc(h, sizeof(struct header) + sz + CAGE)) == 0)
+    {
+    	mem_account_alloc(h);
     	return 0;
-    ((struct header *)x)->magic = MAGIC1 ^ sz;
-    ((struct header *)x)->size = sz;
-    memset((char *)x + sizeof(struct header) + sz, TWEETY, CAGE);
-    return ((char *)x + sizeof(struct header));
+    }
+    return mem_finish(newx, 0, sz, tag);
+}
+
+static void *
+mem_aligned(size_t align, size_t sz)
+{
+    void *x;
+
+    /* the header must fit in the space before an aligned pointer */
+    if (align < sizeof(struct header))
+    	align = sizeof(struct header);
+    if ((x = __libc_memalign(align, align + sz + CAGE)) == 0)
+    	return 0;
+    x = mem_finish(x, align - sizeof(struct header), sz, mem_current_tag);
+    mem_unfree(x, sz);
+    return x;
+}
+
+/*
+ * glib's slice allocator gets its pages from posix_memalign()
+ * and gives them back with free(), so these must be wrapped too.
+ */
+int
+posix_memalign(void **xp, size_t align, size_t sz)
+{
+    void *x;
+
+    if ((x = mem_aligned(align, sz)) == 0)
+    	return ENOMEM;
+    *xp = x;
+    return 0;
+}
+
+void *
+memalign(size_t align, size_t sz)
+{
+    return mem_aligned(align, sz);
+}
+
+void *
+aligned_alloc(size_t align, size_t sz)
+{
+    return mem_aligned(align, sz);
 }
 
 void
 free(void *x)
 {
-    sylvester(x);
-    *(gulong *)x = MAGIC2;
-    __libc_free((char *)x - sizeof(struct header));
+    struct header *h;
+
+    if (x == 0)
+    	return;
+    h = mem_check(x);
+    mem_account_free(h);
+    mem_poison(x);
+    __libc_free((char *)h - h->offset);
 }
 
+#if SYLVESTER
 void
 sylvester(void *x)
 {
@@ -153,8 +360,9 @@ sylvester(void *x)
     assert(cage[6] == TWEETY);
     assert(cage[7] == TWEETY);
 }
-
 #endif
 
+#endif /* SYLVESTER || MEMSTATS */
+
 /*============================================================*/
 /*END*/
@@ -0,0 +1,174 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "private.h"
+#include "debug.h"
+
+CVSID("$Id$");
+
+/*============================================================*/
+/*
+ * Front ends draw a menu by asking which of its children are
+ * visible, and a menu may have hundreds of children of which only
+ * a few are shown.  Once anyone has asked for a menu's visible
+ * children, each node's visibility is cached in its flags and the
+ * visible children are cached as a list per menu.  The transaction
+ * code records each node whose bindings change, and before the next
+ * question those are expanded to every node whose visibility might
+ * depend on them.  Only those nodes are re-evaluated, and only their
+ * parents' lists are rebuilt.
+ */
+
+static void
+visible_enable(cml_rulebase *rb)
+{
+    if (rb->visible_dirty != 0)
+    	return;
+    DDPRINTF0(DEBUG_NODES, "enabling visible children cache\n");
+    rb->visible_dirty = g_hash_table_new(g_direct_hash, g_direct_equal);
+    rb->visible_children = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+static void
+forget_children(cml_rulebase *rb, cml_node *menu)
+{
+    gpointer key, value;
+
+    if (g_hash_table_lookup_extended(rb->visible_children, menu, &key, &value))
+    {
+    	g_hash_table_remove(rb->visible_children, menu);
+	g_list_free((GList *)value);
+    }
+}
+
+static void
+visible_update(cml_rulebase *rb)
+{
+    GList *queue, *list;
+
+    if (g_hash_table_size(rb->visible_dirty) == 0)
+    	return;
+
+    queue = rb_expand_users(rb, rb->visible_dirty);
+    DDPRINTF1(DEBUG_NODES, "visible: %d nodes to recheck\n", g_list_length(queue));
+    for (list = queue ; list != 0 ; list = list->next)
+    {
+    	cml_node *mn = (cml_node *)list->data;
+
+	mn->flags &= ~MN_VISIBLE_KNOWN;
+	if (mn->parent != 0)
+	    forget_children(rb, mn->parent);
+    }
+    g_list_free(queue);
+
+    g_hash_table_destroy(rb->visible_dirty);
+    rb->visible_dirty = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+/*
+ * Called from cml_node_is_visible() once the cache is enabled.
+ */
+gboolean
+visible_lookup(const cml_node *mn)
+{
+    cml_node *mutable_mn = (cml_node *)mn;
+
+    visible_update(mn->rulebase);
+    if (!(mn->flags & MN_VISIBLE_KNOWN))
+    {
+    	if (mn_evaluate_visibility(mn))
+	    mutable_mn->flags |= MN_VISIBLE;
+	else
+	    mutable_mn->flags &= ~MN_VISIBLE;
+	mutable_mn->flags |= MN_VISIBLE_KNOWN;
+    }
+    return ((mn->flags & MN_VISIBLE) != 0);
+}
+
+/*============================================================*/
+
+static void
+clear_one_node(gpointer key, gpointer value, gpointer user_data)
+{
+    ((cml_node *)value)->flags &= ~MN_VISIBLE_KNOWN;
+}
+
+static gboolean
+delete_one_children(gpointer key, gpointer value, gpointer user_data)
+{
+    g_list_free((GList *)value);
+    return TRUE;    /* please remove me */
+}
+
+/*
+ * Forget everything, because the menu tree has changed.
+ */
+void
+visible_clear(cml_rulebase *rb)
+{
+    if (rb->visible_dirty == 0)
+    	return;
+    g_hash_table_foreach_remove(rb->visible_children, delete_one_children, 0);
+    g_hash_table_foreach(rb->menu_nodes, clear_one_node, 0);
+}
+
+void
+visible_delete(cml_rulebase *rb)
+{
+    if (rb->visible_dirty == 0)
+    	return;
+    g_hash_table_foreach_remove(rb->visible_children, delete_one_children, 0);
+    g_hash_table_destroy(rb->visible_children);
+    g_hash_table_destroy(rb->visible_dirty);
+    rb->visible_children = 0;
+    rb->visible_dirty = 0;
+}
+
+/*============================================================*/
+
+const GList *
+cml_node_get_visible_children(cml_node *mn)
+{
+    cml_rulebase *rb = mn->rulebase;
+    gpointer key, value;
+    GList *list = 0;
+    cml_adj_iter iter;
+    cml_node *child;
+
+    visible_enable(rb);
+    visible_update(rb);
+    if (g_hash_table_lookup_extended(rb->visible_children, mn, &key, &value))
+    	return (const GList *)value;
+
+    MEM_TAG_BEGIN(CML_MEM_NODES)
+    mn_adj_iter_init(&iter, mn, MN_ADJ_CHILDREN);
+    while ((child = (cml_node *)mn_adj_iter_next(&iter)) != 0)
+    {
+    	if (visible_lookup(child))
+	    list = g_list_prepend(list, child);
+    }
+    list = g_list_reverse(list);
+    g_hash_table_insert(rb->visible_children, mn, list);
+    MEM_TAG_END
+
+    return list;
+}
+
+/*============================================================*/
+/*END*/
@@ -0,0 +1,664 @@
+/*
+ *  gcml2 -- an implementation of Eric Raymond's CML2 in C
+ *  Copyright (C) 2000-2001 Greg Banks
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * A resident configuration server.  The rulebase is parsed once
+ * per architecture at startup, and clients then talk to it over
+ * a Unix domain socket instead of paying for a parse per query.
+ *
+ * Each connection is a session with its own configuration: the
+ * server forks for every connection, so the child starts with a
+ * copy-on-write image of the freshly parsed rulebases and any
+ * number of sessions can run at once without sharing state.
+ *
+ * The protocol is line based.  A request is one line, a command
+ * word followed by its arguments; a line too long for the request
+ * buffer is discarded whole and answered `error line too long'.
+ * The reply is zero or more data lines starting with `-', then one
+ * status line starting with `ok' or `error'.  Messages from libcml
+ * appear as data lines.
+ *
+ * arch [NAME]	    	select the rulebase for NAME, or report the current
+ * load FILE	    	load a .config
+ * save FILE	    	save a .config
+ * get SYMBOL	    	reply `ok VALUE'
+ * set SYMBOL VALUE 	set and commit; rejected sets list the broken rules
+ * visible SYMBOL   	reply `ok y' or `ok n'
+ * broken   	    	one data line per broken rule, then `ok COUNT'
+ * undo, redo
+ * help, quit
+ */
+
+#include "common.h"
+#include "libcml.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+CVSID("$Id$");
+
+#define MAX_REQUEST 	1024	/* including newline and nul */
+
+typedef struct
+{
+    const char *arch;
+    cml_rulebase *rb;
+} server_rulebase;
+
+static char *argv0;
+static GList *arches = 0;   	/* list of char*, default "i386" */
+static char **files;
+static int nfiles;
+static const char *socket_filename = 0;
+static gboolean fork_flag = TRUE;
+static gboolean freeze_flag = TRUE;
+
+static server_rulebase *rulebases;
+static int nrulebases;
+
+/* per-session state, only ever set in the process serving the session */
+static server_rulebase *current;
+static FILE *session_fp;
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static void
+reply_data(const char *str)
+{
+    const char *p;
+
+    /* keep one line per data item whatever the text */
+    fputc('-', session_fp);
+    for (p = str ; *p ; p++)
+    	fputc((*p == '\n' ? ' ' : *p), session_fp);
+    fputc('\n', session_fp);
+}
+
+static gboolean
+reply(gboolean ok, const char *fmt, ...)
+{
+    va_list args;
+
+    fputs((ok ? "ok" : "error"), session_fp);
+    if (fmt != 0)
+    {
+	fputc(' ', session_fp);
+	va_start(args, fmt);
+	vfprintf(session_fp, fmt, args);
+	va_end(args);
+    }
+    fputc('\n', session_fp);
+    fflush(session_fp);
+    return ok;
+}
+
+static void
+session_error_func(
+    cml_severity sev,
+    const cml_location *loc,
+    const char *fmt,
+    va_list args)
+{
+    static const char *severity_strings[] = { "info", "warning", "error" };
+    char *msg, *line;
+    int len;
+
+    msg = g_strdup_vprintf(fmt, args);
+    for (len = strlen(msg) ; len > 0 && msg[len-1] == '\n' ; len--)
+    	msg[len-1] = '\0';
+    if (loc != 0 && loc->filename != 0 && *loc->filename != '\0')
+    {
+    	if (loc->lineno > 0)
+	    line = g_strdup_printf("%s:%s:%d:%s", severity_strings[sev],
+	    	    	    	   loc->filename, loc->lineno, msg);
+	else
+	    line = g_strdup_printf("%s:%s:%s", severity_strings[sev],
+	    	    	    	   loc->filename, msg);
+    }
+    else
+    	line = g_strdup_printf("%s:%s", severity_strings[sev], msg);
+
+    reply_data(line);
+    g_free(line);
+    g_free(msg);
+}
+
+static void
+list_broken_rules(cml_rulebase *rb)
+{
+    GList *list = cml_rulebase_get_broken_rules(rb);
+
+    while (list != 0)
+    {
+	char *explanation = cml_rule_get_explanation((cml_rule *)list->data);
+
+	reply_data(explanation);
+	g_free(explanation);
+	list = g_list_remove_link(list, list);
+    }
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static cml_node *
+find_symbol(const char *name)
+{
+    cml_node *mn = cml_rulebase_find_node(current->rb, name);
+
+    if (mn == 0)
+    	return 0;
+    switch (cml_node_get_treetype(mn))
+    {
+    case MN_SYMBOL:
+    case MN_DERIVED:
+    	return mn;
+    default:
+    	return 0;
+    }
+}
+
+static gboolean
+do_arch(const char *name, const char *rest)
+{
+    int i;
+
+    if (name == 0)
+    	return reply(TRUE, "%s", current->arch);
+    for (i = 0 ; i < nrulebases ; i++)
+    {
+    	if (!strcmp(rulebases[i].arch, name))
+	{
+	    current = &rulebases[i];
+	    return reply(TRUE, 0);
+	}
+    }
+    return reply(FALSE, "no rulebase for arch \"%s\"", name);
+}
+
+static gboolean
+do_load(const char *filename, const char *rest)
+{
+    if (!cml_rulebase_load_defconfig(current->rb, filename))
+    	return reply(FALSE, "cannot load \"%s\"", filename);
+    cml_rulebase_commit(current->rb, /*freeze*/FALSE);
+    return reply(TRUE, 0);
+}
+
+static gboolean
+do_save(const char *filename, const char *rest)
+{
+    if (!cml_rulebase_save_defconfig(current->rb, filename))
+    	return reply(FALSE, "cannot save \"%s\"", filename);
+    return reply(TRUE, 0);
+}
+
+static gboolean
+do_get(const char *name, const char *rest)
+{
+    cml_node *mn;
+    char *value;
+
+    if ((mn = find_symbol(name)) == 0)
+    	return reply(FALSE, "no symbol \"%s\"", name);
+    value = cml_node_get_value_as_string(mn);
+    reply(TRUE, "%s", value);
+    g_free(value);
+    return TRUE;
+}
+
+static gboolean
+do_set(const char *name, const char *value)
+{
+    cml_node *mn;
+    cml_atom a;
+
+    if ((mn = find_symbol(name)) == 0 ||
+    	cml_node_get_treetype(mn) != MN_SYMBOL)
+    	return reply(FALSE, "no settable symbol \"%s\"", name);
+
+    cml_atom_init(&a);
+    a.type = cml_node_get_value_type(mn);
+    if (!cml_atom_from_string(&a, value))
+    	return reply(FALSE, "bad value \"%s\" for %s", value, name);
+
+    cml_node_set_value(mn, &a);
+    if (a.type == A_STRING)
+    	g_free(a.value.string);
+
+    if (cml_rulebase_commit(current->rb, freeze_flag))
+    	return reply(TRUE, 0);
+    list_broken_rules(current->rb);
+    return reply(FALSE, "rejected");
+}
+
+static gboolean
+do_visible(const char *name, const char *rest)
+{
+    cml_node *mn = cml_rulebase_find_node(current->rb, name);
+
+    if (mn == 0)
+    	return reply(FALSE, "no node \"%s\"", name);
+    return reply(TRUE, "%c", (cml_node_is_visible(mn) ? 'y' : 'n'));
+}
+
+static gboolean
+do_broken(const char *arg, const char *rest)
+{
+    GList *list = cml_rulebase_get_broken_rules(current->rb);
+    int n = g_list_length(list);
+
+    g_list_free(list);
+    list_broken_rules(current->rb);
+    return reply(TRUE, "%d", n);
+}
+
+static gboolean
+do_undo(const char *arg, const char *rest)
+{
+    if (!cml_rulebase_can_undo(current->rb))
+    	return reply(FALSE, "nothing to undo");
+    cml_rulebase_undo(current->rb);
+    return reply(TRUE, 0);
+}
+
+static gboolean
+do_redo(const char *arg, const char *rest)
+{
+    if (!cml_rulebase_can_redo(current->rb))
+    	return reply(FALSE, "nothing to redo");
+    cml_rulebase_redo(current->rb);
+    return reply(TRUE, 0);
+}
+
+static gboolean do_help(const char *arg, const char *rest);
+
+static gboolean
+do_quit(const char *arg, const char *rest)
+{
+    return reply(TRUE, 0);
+}
+
+typedef struct
+{
+    const char *name;
+    int nargs;	    	    /* -1 means optional, 2 means the rest of the line */
+    gboolean (*func)(const char *arg, const char *rest);
+    const char *usage;
+} server_command;
+
+static const server_command commands[] =
+{
+    {"arch",	-1, do_arch, 	"arch [NAME]"},
+    {"load",	1, do_load, 	"load FILE"},
+    {"save",	1, do_save, 	"save FILE"},
+    {"get", 	1, do_get,  	"get SYMBOL"},
+    {"set", 	2, do_set,  	"set SYMBOL VALUE"},
+    {"visible",	1, do_visible,	"visible SYMBOL"},
+    {"broken",	0, do_broken,	"broken"},
+    {"undo",	0, do_undo, 	"undo"},
+    {"redo",	0, do_redo, 	"redo"},
+    {"help",	0, do_help, 	"help"},
+    {"quit",	0, do_quit, 	"quit"},
+    {0, 0, 0, 0}
+};
+
+static gboolean
+do_help(const char *arg, const char *rest)
+{
+    const server_command *cmd;
+
+    for (cmd = commands ; cmd->name != 0 ; cmd++)
+    	reply_data(cmd->usage);
+    return reply(TRUE, 0);
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static char *
+next_word(char **bufp)
+{
+    char *p = *bufp, *word;
+
+    while (*p && isspace(*p))
+    	p++;
+    if (*p == '\0')
+    	return 0;
+    word = p;
+    while (*p && !isspace(*p))
+    	p++;
+    if (*p)
+    	*p++ = '\0';
+    *bufp = p;
+    return word;
+}
+
+/*
+ * Handle one request line.  Returns FALSE when the
+ * session should end.
+ */
+static gboolean
+handle_request(char *buf)
+{
+    const server_command *cmd;
+    char *name, *arg, *rest, *p;
+
+    for (p = buf+strlen(buf) ; p > buf && isspace(p[-1]) ; --p)
+    	;
+    *p = '\0';
+
+    if ((name = next_word(&buf)) == 0)
+    	return TRUE;
+    for (cmd = commands ; cmd->name != 0 ; cmd++)
+    	if (!strcmp(cmd->name, name))
+	    break;
+    if (cmd->name == 0)
+    {
+    	reply(FALSE, "unknown command \"%s\"", name);
+	return TRUE;
+    }
+
+    arg = next_word(&buf);
+    while (*buf && isspace(*buf))
+    	buf++;
+    rest = (*buf ? buf : 0);
+    if ((cmd->nargs >= 1 && arg == 0) ||
+    	(cmd->nargs == 0 && arg != 0) ||
+    	(cmd->nargs == 2) != (rest != 0))
+    {
+    	reply(FALSE, "usage: %s", cmd->usage);
+	return TRUE;
+    }
+
+    (*cmd->func)(arg, rest);
+    return (cmd->func != do_quit);
+}
+
+static void
+serve_session(int fd)
+{
+    FILE *in;
+    char buf[MAX_REQUEST];
+    int c;
+
+    if ((in = fdopen(fd, "r")) == 0 ||
+	(session_fp = fdopen(dup(fd), "w")) == 0)
+    {
+    	perror("fdopen");
+	return;
+    }
+    current = &rulebases[0];
+    cml_set_error_func(session_error_func);
+
+    while (fgets(buf, sizeof(buf), in) != 0)
+    {
+    	if (strchr(buf, '\n') == 0 && !feof(in))
+	{
+	    /* don't run the rest of the line as another request */
+	    while ((c = getc(in)) != EOF && c != '\n')
+	    	;
+	    reply(FALSE, "line too long");
+	    continue;
+	}
+    	if (!handle_request(buf))
+	    break;
+    }
+
+    cml_set_error_func(0);
+    fclose(session_fp);
+    session_fp = 0;
+    fclose(in);
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static cml_rulebase *
+load_rulebase(const char *arch)
+{
+    cml_rulebase *rb;
+    int i;
+
+    rb = cml_rulebase_new();
+    if (nfiles > 1)
+	cml_rulebase_set_merge_mode(rb);
+    cml_rulebase_set_arch(rb, arch);
+    for (i = 0 ; i < nfiles ; i++)
+    {
+	if (!cml_rulebase_parse(rb, files[i]))
+	{
+	    cml_rulebase_delete(rb);
+	    return 0;
+	}
+    }
+    if (nfiles > 1 && !cml_rulebase_post_parse(rb))
+    {
+	cml_rulebase_delete(rb);
+	return 0;
+    }
+    return rb;
+}
+
+static void
+remove_socket(int sig)
+{
+    unlink(socket_filename);
+    _exit(0);
+}
+
+static int
+open_socket(void)
+{
+    struct sockaddr_un sun;
+    mode_t old_umask;
+    int fd, bound;
+
+    if (strlen(socket_filename) >= sizeof(sun.sun_path))
+    {
+    	fprintf(stderr, "%s: socket name too long\n", socket_filename);
+	return -1;
+    }
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+    	perror("socket");
+	return -1;
+    }
+
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, socket_filename);
+    unlink(socket_filename);
+
+    /*
+     * Sessions can read and write files as us, so keep the socket
+     * private.  Only the bind needs the tight umask: files saved by
+     * sessions should get the user's usual permissions.
+     */
+    old_umask = umask(077);
+    bound = bind(fd, (struct sockaddr *)&sun, sizeof(sun));
+    umask(old_umask);
+    if (bound < 0 || listen(fd, 16) < 0)
+    {
+    	perror(socket_filename);
+	close(fd);
+	return -1;
+    }
+    return fd;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+
+static const char usage_str[] =
+"Usage: %s [--arch arch]... [--no-fork] [--no-freeze] --socket path\n"
+"    rulesfile [rulesfile...]\n"
+;
+
+static void
+usagef(int ec, const char *fmt, ...)
+{
+    if (fmt != 0)
+    {
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "%s: ", argv0);
+	vfprintf(stderr, fmt, args);
+	fputc('\n', stderr);
+	va_end(args);
+    }
+
+    fprintf(stderr, usage_str, argv0);
+
+    fflush(stderr); /* JIC */
+
+    exit(ec);
+}
+
+static void
+parse_args(int argc, char **argv)
+{
+    int i;
+
+    argv0 = argv[0];
+
+    files = (char **)g_malloc0(sizeof(char *) * argc);
+
+    for (i = 1 ; i < argc ; i++)
+    {
+    	if (argv[i][0] == '-')
+	{
+	    if (!strcmp(argv[i], "--help"))
+	    {
+	    	usagef(0, 0);
+	    }
+	    else if (!strcmp(argv[i], "--version"))
+	    {
+	    	printf("cml-server %s\n", VERSION);
+    		exit(0);
+	    }
+	    else if (!strcmp(argv[i], "--arch"))
+	    {
+		if (argv[++i] == 0)
+    		    usagef(1, "Expecting argument for --arch\n");
+		arches = g_list_append(arches, argv[i]);
+	    }
+	    else if (!strcmp(argv[i], "--socket"))
+	    {
+		if ((socket_filename = argv[++i]) == 0)
+    		    usagef(1, "Expecting argument for --socket\n");
+	    }
+	    else if (!strcmp(argv[i], "--no-fork"))
+	    {
+	    	fork_flag = FALSE;
+	    }
+	    else if (!strcmp(argv[i], "--no-freeze"))
+	    {
+	    	freeze_flag = FALSE;
+	    }
+	    else
+	    	usagef(1, "Unknown option \"%s\"", argv[i]);
+	}
+	else
+	{
+	    files[nfiles++] = argv[i];
+	}
+    }
+    if (nfiles == 0)
+    	usagef(1, "expecting at least one rulebase filename\n");
+    if (socket_filename == 0)
+    	usagef(1, "expecting --socket\n");
+    if (arches == 0)
+    	arches = g_list_append(arches, "i386");
+}
+
+int
+main(int argc, char **argv)
+{
+    GList *list;
+    int listen_fd, fd;
+    pid_t pid;
+
+    parse_args(argc, argv);
+
+    nrulebases = g_list_length(arches);
+    rulebases = g_new(server_rulebase, nrulebases);
+    for (list = arches, nrulebases = 0 ; list != 0 ; list = list->next)
+    {
+    	server_rulebase *sr = &rulebases[nrulebases++];
+
+	sr->arch = (const char *)list->data;
+	if ((sr->rb = load_rulebase(sr->arch)) == 0)
+	{
+	    fprintf(stderr, "%s: failed to load rulebase for %s\n",
+	    	    argv0, sr->arch);
+	    return 1;
+	}
+    }
+
+    if ((listen_fd = open_socket()) < 0)
+    	return 1;
+    signal(SIGINT, remove_socket);
+    signal(SIGTERM, remove_socket);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGCHLD, SIG_IGN);	/* no zombies */
+
+    for (;;)
+    {
+    	if ((fd = accept(listen_fd, 0, 0)) < 0)
+	{
+	    if (errno != EINTR)
+	    	perror("accept");
+	    continue;
+	}
+
+	if (!fork_flag)
+	{
+	    serve_session(fd);
+	    continue;
+	}
+
+	if ((pid = fork()) < 0)
+	{
+	    perror("fork");
+	    close(fd);
+	}
+	else if (pid == 0)
+	{
+	    /* child */
+	    close(listen_fd);
+	    signal(SIGINT, SIG_DFL);
+	    signal(SIGTERM, SIG_DFL);
+	    serve_session(fd);
+	    _exit(0);
+	}
+	else
+	{
+	    /* parent */
+	    close(fd);
+	}
+    }
+    return 0;
+}
+
+/*-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-*/
+/*END*/
@@ -53,6 +53,10 @@ ifneq ($(SYLVESTER),)
     CPPFLAGS += -DSYLVESTER=$(SYLVESTER)
 endif
 
+ifneq ($(MEMSTATS),)
+    CPPFLAGS += -DMEMSTATS=$(MEMSTATS)
+endif
+
 ifneq ($(PROFILE),)
     CFLAGS += -pg
     CPPFLAGS += -DPROFILE=1